@@ -7,6 +7,7 @@
 #include "FileWatcherDemoDlg.h"
 #include "afxdialogex.h"
 #include "spdlog_header.h"
+#include "event_journal.h"
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -103,6 +104,16 @@ BOOL CFileWatcherDemoDlg::OnInitDialog()
 
 	// TODO: Add extra initialization here
 	died::initialze();
+	// per-event records, read with: file_watcher_tools journal events.fwj
+	died::event_journal::start(L"events.fwj");
+	// classified events, shown by: file_watcher_tools receive; kept in .\spool until then
+	mWatcher.set_event_pipe(died::event_sender::DEFAULT_PIPE, 8192, L"spool");
+	// and in shared memory for local readers: file_watcher_tools ring
+	mWatcher.set_event_ring(died::event_ring::DEFAULT_NAME);
+	// autosave floods: one modify per file every 2 seconds, with its count
+	mWatcher.set_coalescing(std::chrono::milliseconds(2000));
+	// raw events before correlation, in .\raw: file_watcher_tools raw raw, or replay raw
+	mWatcher.set_raw_journal(L"raw");
 
 	return TRUE;  // return TRUE  unless you set the focus to a control
 }
@@ -0,0 +1,168 @@
+#include "busy_probe.h"
+#include "common_utils.h"
+#include "spdlog_header.h"
+#include <algorithm>
+#include <memory>
+
+namespace died
+{
+	namespace
+	{
+		constexpr size_t MAX_CACHED = 4096;
+	}
+
+	busy_probe::busy_probe(unsigned long threads, size_t maxInFlight, size_t ttl) :
+		mMaxInFlight{ maxInFlight },
+		mTtl{ ttl }
+	{
+		::InitializeThreadpoolEnvironment(&mEnv);
+
+		// A private pool, slow drives must not starve the process default pool
+		mPool = ::CreateThreadpool(nullptr);
+		if (!mPool) {
+			SPDLOG_ERROR("CreateThreadpool. Last error code: {}", ::GetLastError());
+			return;
+		}
+		::SetThreadpoolThreadMaximum(mPool, threads);
+		::SetThreadpoolThreadMinimum(mPool, 1);
+		::SetThreadpoolCallbackPool(&mEnv, mPool);
+
+		mCleanup = ::CreateThreadpoolCleanupGroup();
+		if (!mCleanup) {
+			SPDLOG_ERROR("CreateThreadpoolCleanupGroup. Last error code: {}", ::GetLastError());
+			return;
+		}
+		::SetThreadpoolCallbackCleanupGroup(&mEnv, mCleanup, nullptr);
+	}
+
+	busy_probe::~busy_probe()
+	{
+		// wait for the submitted probes, they own their job
+		if (mCleanup) {
+			::CloseThreadpoolCleanupGroupMembers(mCleanup, FALSE, nullptr);
+			::CloseThreadpoolCleanupGroup(mCleanup);
+		}
+		if (mPool) {
+			::CloseThreadpool(mPool);
+		}
+		::DestroyThreadpoolEnvironment(&mEnv);
+	}
+
+	busy_probe::result busy_probe::query(std::wstring const& path)
+	{
+		return query_info(path, mTtl).mResult;
+	}
+
+	busy_probe::info busy_probe::query_info(std::wstring const& path, std::chrono::milliseconds maxAge)
+	{
+		auto now = event_clock::now();
+		{
+			std::lock_guard<std::mutex> lk(mSync);
+			auto found = mCache.find(path);
+			if (std::end(mCache) != found) {
+				auto const& item = found->second;
+				if (result::pending == item.mResult || now - item.mTime < std::min(maxAge, mTtl)) {
+					if (mMetrics && result::pending != item.mResult) {
+						mMetrics->probed(probe_outcome::cached);
+					}
+					return item;
+				}
+			}
+
+			// Too many probes on the way => ask again later
+			if (mInFlight >= mMaxInFlight) {
+				if (mMetrics) {
+					mMetrics->probed(probe_outcome::deferred);
+				}
+				return info{};
+			}
+
+			if (mCache.size() > MAX_CACHED) {
+				sweep(now);
+			}
+			mCache[path] = info{};
+			++mInFlight;
+		}
+
+		auto work = std::make_unique<job>();
+		work->mOwner = this;
+		work->mPath = path;
+		if (mCleanup && !mSynchronous.load(std::memory_order_relaxed) && ::TrySubmitThreadpoolCallback(&busy_probe::probe_proc, work.get(), &mEnv)) {
+			work.release();
+			return info{};
+		}
+
+		// No pool => probe here, as before
+		auto probed = probe(path);
+		complete(path, probed);
+		return probed;
+	}
+
+	void busy_probe::set_synchronous(bool synchronous) noexcept
+	{
+		mSynchronous = synchronous;
+	}
+
+	void busy_probe::set_metrics(std::shared_ptr<pipeline_metrics> metrics)
+	{
+		mMetrics = std::move(metrics);
+	}
+
+	void busy_probe::set_prober(std::function<info(std::wstring const&)> prober)
+	{
+		mProber = std::move(prober);
+	}
+
+	void CALLBACK busy_probe::probe_proc(PTP_CALLBACK_INSTANCE, PVOID context)
+	{
+		std::unique_ptr<job> work{ static_cast<job*>(context) };
+		work->mOwner->complete(work->mPath, work->mOwner->probe(work->mPath));
+	}
+
+	busy_probe::info busy_probe::probe(std::wstring const& path) const
+	{
+		if (mProber) {
+			return mProber(path);
+		}
+
+		info probed;
+		int error{};
+		if (died::fileIsProcessing(path, error)) {
+			probed.mResult = result::busy;
+		}
+		else {
+			probed.mResult = result::idle;
+
+			// metadata only, the file is not opened again
+			WIN32_FILE_ATTRIBUTE_DATA data{};
+			if (::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) {
+				probed.mSize = (static_cast<unsigned long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+				probed.mWriteTime = (static_cast<unsigned long long>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+			}
+		}
+		probed.mTime = event_clock::now();
+		return probed;
+	}
+
+	void busy_probe::complete(std::wstring const& path, info const& probed)
+	{
+		if (mMetrics) {
+			mMetrics->probed(result::busy == probed.mResult ? probe_outcome::busy : probe_outcome::idle);
+		}
+		std::lock_guard<std::mutex> lk(mSync);
+		--mInFlight;
+		mCache[path] = probed;
+	}
+
+	void busy_probe::sweep(time_point now)
+	{
+		for (auto it = std::begin(mCache); it != std::end(mCache);) {
+			if (result::pending != it->second.mResult && now - it->second.mTime >= mTtl) {
+				it = mCache.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+}
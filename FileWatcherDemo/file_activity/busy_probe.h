@@ -0,0 +1,86 @@
+#pragma once
+
+#include "event_clock.h"
+#include "pipeline_metrics.h"
+#include <Windows.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace died
+{
+	// Asynchronous fileIsProcessing().
+	// query() never opens the file on the calling thread: it returns the cached
+	// result of the path, or submits a probe to a small private thread pool and
+	// answers 'pending' until the result arrives (next timer tick in practice).
+	// Results are kept for a short time, so the checkers of all shards asking
+	// about the same path in a tick share one CreateFileW.
+	class busy_probe
+	{
+	public:
+		enum class result { pending, busy, idle };
+
+		struct info
+		{
+			using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+			result mResult{ result::pending };
+			unsigned long long mSize{};			// when not busy
+			unsigned long long mWriteTime{};	// when not busy, FILETIME
+			time_point mTime;					// probe completion
+		};
+
+		explicit busy_probe(unsigned long threads = 4, size_t maxInFlight = 64, size_t ttl = 1000);
+		~busy_probe();
+
+		busy_probe(busy_probe const&) = delete;
+		busy_probe& operator=(busy_probe const&) = delete;
+
+		// Any thread
+		result query(std::wstring const& path);
+
+		// Same, with size and last write time; a result older than 'maxAge' is probed again
+		info query_info(std::wstring const& path, std::chrono::milliseconds maxAge);
+
+		// Probe on the calling thread, results do not depend on the pool timing (replay)
+		void set_synchronous(bool synchronous) noexcept;
+
+		// Before the first query
+		void set_metrics(std::shared_ptr<pipeline_metrics> metrics);
+
+		// Before the first query: answers in place of the file system, e.g. when the files are not on this machine (replay)
+		void set_prober(std::function<info(std::wstring const&)> prober);
+
+	private:
+		using time_point = info::time_point;
+
+		struct job
+		{
+			busy_probe* mOwner{ nullptr };
+			std::wstring mPath;
+		};
+
+		static void CALLBACK probe_proc(PTP_CALLBACK_INSTANCE instance, PVOID context);
+		void complete(std::wstring const& path, info const& probed);
+		info probe(std::wstring const& path) const;
+		void sweep(time_point now);
+
+	private:
+		const size_t mMaxInFlight;
+		const std::chrono::milliseconds mTtl;
+
+		std::mutex mSync;
+		std::unordered_map<std::wstring, info> mCache;
+		size_t mInFlight{};
+		std::atomic<bool> mSynchronous{};
+		std::shared_ptr<pipeline_metrics> mMetrics;
+		std::function<info(std::wstring const&)> mProber;
+
+		PTP_POOL mPool{ nullptr };
+		PTP_CLEANUP_GROUP mCleanup{ nullptr };
+		TP_CALLBACK_ENVIRON mEnv{};
+	};
+}
@@ -72,6 +72,11 @@ namespace died
 			return mEmpty.load(std::memory_order_relaxed);
 		}
 
+		unsigned long long overwrites() const noexcept
+		{
+			return mOverwrites.load(std::memory_order_relaxed);
+		}
+
 		const_reference find(key_type const& key) const
 		{
 			auto pos = find_internal(key);
@@ -175,6 +180,10 @@ namespace died
 
 			// Not found => create new pair
 			size_type curIndex = next_push_index();
+			if (mData[curIndex]) {
+				// ring is full => the oldest item is lost
+				mOverwrites.fetch_add(1, std::memory_order_relaxed);
+			}
 			mKeys[key] = curIndex;
 			return mData[curIndex];
 		}
@@ -286,5 +295,6 @@ namespace died
 		const mapped_type	EMPTY_ITEM{};
 		std::shared_mutex	mSyncClear;
 		clear_map_condition mClearCond;
+		std::atomic<unsigned long long> mOverwrites{};
 	};
 }
\ No newline at end of file
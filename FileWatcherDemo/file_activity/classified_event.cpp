@@ -0,0 +1,72 @@
+#include "classified_event.h"
+#include <array>
+
+namespace died
+{
+	std::wstring const& name_of(event_kind kind) noexcept
+	{
+		static const std::array<std::wstring, EVENT_KIND_COUNT> NAMES{
+			L"Create only", L"Create rename", L"Rename only", L"Modify", L"Remove",
+			L"Attribute", L"Security", L"Folder remove", L"Folder move", L"Pattern" };
+		return NAMES[static_cast<size_t>(kind)];
+	}
+
+	classified_event& event_batch::add(event_kind kind, std::wstring path, std::wstring oldPath, std::wstring auxPath)
+	{
+		classified_event ev;
+		ev.mKind = kind;
+		ev.mName = &name_of(kind);
+		ev.mPath = keep(std::move(path));
+		ev.mOldPath = keep(std::move(oldPath));
+		ev.mAuxPath = keep(std::move(auxPath));
+		ev.mClassified = event_clock::now();
+		mEvents.push_back(ev);
+		return mEvents.back();
+	}
+
+	classified_event& event_batch::add(classified_event const& ev)
+	{
+		mEvents.push_back(ev);
+		auto& copy = mEvents.back();
+		copy.mPath = keep(std::wstring(ev.mPath));
+		copy.mOldPath = keep(std::wstring(ev.mOldPath));
+		copy.mAuxPath = keep(std::wstring(ev.mAuxPath));
+		return copy;
+	}
+
+	std::vector<classified_event> const& event_batch::events() const noexcept
+	{
+		return mEvents;
+	}
+
+	bool event_batch::empty() const noexcept
+	{
+		return mEvents.empty() && mSettled.empty();
+	}
+
+	void event_batch::clear() noexcept
+	{
+		mEvents.clear();
+		mPaths.clear();
+		mSettled.clear();
+	}
+
+	std::wstring_view event_batch::keep(std::wstring path)
+	{
+		if (path.empty()) {
+			return {};
+		}
+		mPaths.push_back(std::move(path));
+		return mPaths.back();
+	}
+
+	void event_batch::settle(std::wstring path)
+	{
+		mSettled.push_back(std::move(path));
+	}
+
+	std::vector<std::wstring> const& event_batch::settled() const noexcept
+	{
+		return mSettled;
+	}
+}
\ No newline at end of file
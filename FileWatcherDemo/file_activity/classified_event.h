@@ -0,0 +1,97 @@
+#pragma once
+
+#include "event_clock.h"
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace died
+{
+	enum class event_kind : unsigned char
+	{
+		create_only,
+		create_rename,		// created then renamed once
+		rename_only,
+		modify,
+		remove,
+		attribute,
+		security,
+		folder_remove,
+		folder_move,
+		pattern				// a file_pattern of correlation_engine, see mPattern
+	};
+	constexpr size_t EVENT_KIND_COUNT = 10;
+
+	// Masks of kinds, as subscription and store_query take them
+	constexpr unsigned int kind_bit(event_kind kind) noexcept
+	{
+		return 1u << static_cast<unsigned int>(kind);
+	}
+	constexpr unsigned int ALL_KINDS = (1u << EVENT_KIND_COUNT) - 1;
+
+	// Classification name sent to the server ("Create only"...), "Pattern" for event_kind::pattern
+	std::wstring const& name_of(event_kind kind) noexcept;
+
+	// One classified file operation, no string is built for it.
+	// Paths are views on the strings of its event_batch, valid while the sink is called.
+	struct classified_event
+	{
+		event_kind mKind{};
+		size_t mPattern{};					// event_kind::pattern: index in correlation_engine::patterns()
+		std::wstring const* mName{};		// classification name, static or owned by the pattern
+		std::wstring_view mPath;			// the file, the new name of a rename, the destination of a folder move
+		std::wstring_view mOldPath;			// rename: old name, folder move: source
+		std::wstring_view mAuxPath;
+		event_clock::time_point mFirst;		// first raw event of the operation
+		event_clock::time_point mLast;		// last raw event, of the last merged event when coalesced
+		event_clock::time_point mClassified;
+		event_stamps mStamps{};				// pipeline stages of the last raw event
+		unsigned int mSource{};				// watching group (drive)
+		unsigned int mCount{ 1 };			// events merged into this one, see event_coalescer
+		bool mStillOpen{};					// reported after the longest wait, still opened by other process
+	};
+	// event_kind::pattern: mPath, mOldPath, mAuxPath are the paths of file_pattern::mReport, in order
+
+	// Events of one checker round. The paths are moved in and owned here.
+	class event_batch
+	{
+	public:
+		classified_event& add(event_kind kind, std::wstring path, std::wstring oldPath = {}, std::wstring auxPath = {});
+		classified_event& add(classified_event const& ev);		// copy of an event of another batch, its paths kept here
+
+		std::vector<classified_event> const& events() const noexcept;
+		bool empty() const noexcept;
+		void clear() noexcept;
+		std::wstring_view keep(std::wstring path);		// owned until clear()
+
+		// Processed without report, settled once the events are delivered
+		void settle(std::wstring path);
+		std::vector<std::wstring> const& settled() const noexcept;
+
+	private:
+		std::vector<classified_event> mEvents;
+		std::vector<std::wstring> mSettled;
+		std::deque<std::wstring> mPaths;	// never moved once added, the views point here
+	};
+
+	// Receives the classified events, one batch per checker round.
+	// Called from the correlation thread and its shard workers, one batch at a time.
+	class event_sink
+	{
+	public:
+		virtual ~event_sink() = default;
+		virtual void deliver(std::vector<classified_event> const& events) = 0;
+
+		// Backpressure: the correlation does not classify while a sink is saturated
+		virtual bool saturated() const noexcept
+		{
+			return false;
+		}
+
+		// Once per timer round: a sink holding events delivers the due ones, all of them at time_point::max()
+		virtual void flush(event_clock::time_point /*now*/)
+		{
+		}
+	};
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "common_utils.h"
+#include "event_tracer.h"
 #include <array>
 #include <Windows.h>
 
@@ -42,6 +43,7 @@ namespace died
 
 	bool fileIsProcessing(const std::wstring& filePath, int& error)
 	{
+		TRACE_SCOPE("fileIsProcessing");
 		//++ TODO use scoped handle
 		HANDLE hFile = ::CreateFileW(filePath.c_str(),
 			GENERIC_READ,
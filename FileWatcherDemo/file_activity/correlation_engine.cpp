@@ -0,0 +1,486 @@
+#include "correlation_engine.h"
+#include "std_filesystem.h"
+#include <algorithm>
+#include <Windows.h>
+
+namespace died
+{
+	namespace
+	{
+		// '?' is not allowed in a path => no clash with path keys
+		std::wstring name_key(std::wstring const& fileName)
+		{
+			return L"?" + fileName;
+		}
+
+		std::wstring const& subject_of(correlation_event const& ev)
+		{
+			return ACTION_RENAMED == ev.mAction ? ev.mOldPath : ev.mPath;
+		}
+
+		bool elapsed(correlation_event::time_point from, correlation_event::time_point to, size_t ms)
+		{
+			return to - from > std::chrono::milliseconds(ms);
+		}
+	}
+
+	std::wstring correlation_event::get_file_name_wstring() const
+	{
+		return std::filesystem::path(mPath).filename().wstring();
+	}
+
+	std::wstring correlation_event::get_parent_path_wstring() const
+	{
+		return std::filesystem::path(mPath).parent_path().wstring();
+	}
+
+	/************************************************************************************************/
+
+	correlation_engine::correlation_engine(std::vector<file_pattern> patterns, unsigned long long enabled) :
+		mPatterns{ std::move(patterns) },
+		mEnabled{ enabled }
+	{}
+
+	void correlation_engine::post(unsigned long action, std::wstring path, time_point time, unsigned int source, event_stamps stamps)
+	{
+		correlation_event ev;
+		ev.mAction = action;
+		ev.mPath = std::move(path);
+		ev.mTime = time;
+		ev.mSource = source;
+		ev.mStamps = stamps;
+		if (time_point{} == ev.mStamps.front()) {
+			ev.mStamps.fill(time);
+		}
+		ev.mStamps[static_cast<size_t>(event_stage::insert)] = event_clock::now();
+		mInbox.push(std::move(ev));
+	}
+
+	size_t correlation_engine::active() const noexcept
+	{
+		return mMatches.size();
+	}
+
+	bool correlation_engine::involves(std::wstring const& path) const
+	{
+		// A match of only its first step is just a possibility
+		auto range = mIndex.equal_range(path);
+		return std::any_of(range.first, range.second, [this](auto const& el) {
+			auto const& m = mMatches.at(el.second);
+			return !m.mDead && (m.mComplete || m.mEvents.size() > 1);
+		});
+	}
+
+	bool correlation_engine::tracks(std::wstring const& path) const
+	{
+		return !path.empty() && std::end(mIndex) != mIndex.find(path);
+	}
+
+	std::vector<file_pattern> const& correlation_engine::patterns() const noexcept
+	{
+		return mPatterns;
+	}
+
+	void correlation_engine::feed(correlation_event&& ev)
+	{
+		// 1. pair rename events, like path_state_table does
+		switch (ev.mAction)
+		{
+		case FILE_ACTION_RENAMED_OLD_NAME:
+			mPendingOldName[ev.mSource] = std::move(ev);
+			return;
+
+		case FILE_ACTION_RENAMED_NEW_NAME:
+		{
+			auto found = mPendingOldName.find(ev.mSource);
+			if (std::end(mPendingOldName) == found) {
+				return;
+			}
+			ev.mOldPath = std::move(found->second.mPath);
+			mPendingOldName.erase(found);
+			ev.mAction = ACTION_RENAMED;
+			break;
+		}
+
+		default:
+			break;
+		}
+		if (0 == ev.mSeq) {
+			ev.mSeq = ++mNextSeq;
+		}
+
+		// 2. only visit matches indexed under the paths of this event
+		std::vector<size_t> candidates;
+		auto collect = [this, &candidates](std::wstring const& key) {
+			auto range = mIndex.equal_range(key);
+			for (auto it = range.first; it != range.second; ++it) {
+				candidates.push_back(it->second);
+			}
+		};
+		collect(ev.mPath);
+		if (!ev.mOldPath.empty()) {
+			collect(ev.mOldPath);
+		}
+		collect(name_key(ev.get_file_name_wstring()));
+		std::sort(std::begin(candidates), std::end(candidates));
+		candidates.erase(std::unique(std::begin(candidates), std::end(candidates)), std::end(candidates));
+
+		for (auto id : candidates) {
+			auto found = mMatches.find(id);
+			if (std::end(mMatches) != found && !found->second.mDead) {
+				advance(found->second, id, ev);
+			}
+		}
+
+		// 3. every event may be the first step of a pattern
+		start(ev);
+	}
+
+	void correlation_engine::advance(match& m, size_t id, correlation_event const& ev)
+	{
+		auto const& pat = mPatterns[m.mPattern];
+
+		// Complete match only waits for quiet time
+		if (m.mComplete) {
+			if (!touches(m, ev)) {
+				return;
+			}
+			if (pat.mAbsorb & action_bit(ev.mAction)) {
+				m.mLast = ev.mTime;
+			}
+			else {
+				// conflicting event => not this pattern any more
+				m.mDead = true;
+			}
+			return;
+		}
+
+		if (elapsed(m.mLast, ev.mTime, window_of(m))) {
+			m.mDead = true;
+			return;
+		}
+
+		auto const& step = pat.mSteps[m.mStep];
+		if (step.mAction == ev.mAction && relates(m, step, ev)) {
+			m.mEvents.push_back(ev);
+			m.mLast = ev.mTime;
+			index(id, m, ev);
+			if (++m.mStep == pat.mSteps.size()) {
+				complete(m);
+			}
+			return;
+		}
+
+		if ((pat.mCancel & action_bit(ev.mAction)) && touches(m, ev)) {
+			m.mDead = true;
+		}
+	}
+
+	void correlation_engine::start(correlation_event const& ev)
+	{
+		for (size_t i = 0; i < mPatterns.size(); ++i) {
+			auto const& pat = mPatterns[i];
+			if (!(mEnabled & (1ull << i)) || pat.mSteps.empty() || pat.mSteps.front().mAction != ev.mAction) {
+				continue;
+			}
+
+			auto id = mNextId++;
+			auto& m = mMatches[id];
+			m.mPattern = i;
+			m.mStep = 1;
+			m.mEvents.push_back(ev);
+			m.mLast = ev.mTime;
+			index(id, m, ev);
+			if (m.mStep == pat.mSteps.size()) {
+				complete(m);
+			}
+		}
+	}
+
+	bool correlation_engine::relates(match const& m, pattern_step const& step, correlation_event const& ev) const
+	{
+		auto const& anchor = m.mEvents.front();
+		auto const& last = m.mEvents.back();
+		auto const& anchorPath = subject_of(anchor);
+		bool isRename = ACTION_RENAMED == ev.mAction;
+
+		switch (step.mRelation)
+		{
+		case path_relation::none:
+			return true;
+
+		case path_relation::same_path:
+			return subject_of(ev) == anchorPath;
+
+		case path_relation::rename_to_anchor:
+			return isRename
+				&& ev.mPath == anchorPath
+				&& ev.mOldPath != last.mPath;
+
+		case path_relation::rename_from_last:
+			return isRename
+				&& ACTION_RENAMED == last.mAction
+				&& ev.mOldPath == last.mPath
+				&& ev.mPath != anchorPath;
+
+		case path_relation::rename_family:
+			return isRename
+				&& (ev.mOldPath == anchor.mOldPath || ev.mOldPath == anchor.mPath
+					|| ev.mPath == anchor.mOldPath || ev.mPath == anchor.mPath);
+
+		case path_relation::same_name_other_dir:
+			return ev.get_file_name_wstring() == anchor.get_file_name_wstring()
+				&& ev.get_parent_path_wstring() != anchor.get_parent_path_wstring();
+
+		default:
+			return false;
+		}
+	}
+
+	bool correlation_engine::touches(match const& m, correlation_event const& ev) const
+	{
+		auto same = [](std::wstring const& lhs, std::wstring const& rhs) {
+			return !lhs.empty() && lhs == rhs;
+		};
+		return std::any_of(std::begin(m.mEvents), std::end(m.mEvents), [&ev, &same](auto const& item) {
+			return same(item.mPath, ev.mPath) || same(item.mPath, ev.mOldPath)
+				|| same(item.mOldPath, ev.mPath) || same(item.mOldPath, ev.mOldPath);
+		});
+	}
+
+	void correlation_engine::complete(match& m)
+	{
+		// Conflicts with other matches are resolved when emitting,
+		// a more specific pattern may still complete on the same events.
+		m.mComplete = true;
+	}
+
+	bool correlation_engine::shares_event(match const& lhs, match const& rhs) const
+	{
+		for (auto const& l : lhs.mEvents) {
+			for (auto const& r : rhs.mEvents) {
+				if (l.mSeq == r.mSeq) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	void correlation_engine::index(size_t id, match& m, correlation_event const& ev)
+	{
+		auto add = [this, id, &m](std::wstring key) {
+			if (key.empty() || std::end(m.mKeys) != std::find(std::begin(m.mKeys), std::end(m.mKeys), key)) {
+				return;
+			}
+			mIndex.emplace(key, id);
+			m.mKeys.push_back(std::move(key));
+		};
+		add(ev.mPath);
+		add(ev.mOldPath);
+		add(name_key(ev.get_file_name_wstring()));
+	}
+
+	void correlation_engine::remove(size_t id)
+	{
+		auto found = mMatches.find(id);
+		if (std::end(mMatches) == found) {
+			return;
+		}
+
+		for (auto const& key : found->second.mKeys) {
+			auto range = mIndex.equal_range(key);
+			for (auto it = range.first; it != range.second; ++it) {
+				if (it->second == id) {
+					mIndex.erase(it);
+					break;
+				}
+			}
+		}
+		mMatches.erase(found);
+	}
+
+	size_t correlation_engine::window_of(match const& m) const
+	{
+		return mPatterns[m.mPattern].mSteps[m.mStep].mWindow;
+	}
+
+	std::vector<size_t> correlation_engine::rivals_of(size_t id, match const& m) const
+	{
+		// Other matches on the same paths
+		std::vector<size_t> rivals;
+		for (auto const& key : m.mKeys) {
+			auto range = mIndex.equal_range(key);
+			for (auto it = range.first; it != range.second; ++it) {
+				if (it->second != id) {
+					rivals.push_back(it->second);
+				}
+			}
+		}
+		std::sort(std::begin(rivals), std::end(rivals));
+		rivals.erase(std::unique(std::begin(rivals), std::end(rivals)), std::end(rivals));
+		return rivals;
+	}
+
+	bool correlation_engine::contested(size_t id, match const& m) const
+	{
+		// Another sequence in progress on the same events may still claim them
+		auto rivals = rivals_of(id, m);
+		return std::any_of(std::begin(rivals), std::end(rivals), [this, &m](size_t rid) {
+			auto const& r = mMatches.at(rid);
+			return !r.mDead
+				&& !r.mComplete
+				&& r.mEvents.size() > 1
+				&& shares_event(m, r);
+		});
+	}
+
+	void correlation_engine::consume(correlation_event&& ev)
+	{
+		feed(std::move(ev));
+	}
+
+	std::vector<size_t> correlation_engine::holders(std::vector<correlation_event> const& events) const
+	{
+		// matches holding one of 'events', found through the index of their paths
+		std::vector<size_t> result;
+		for (auto const& ev : events) {
+			for (auto const* key : { &ev.mPath, &ev.mOldPath }) {
+				if (key->empty()) {
+					continue;
+				}
+				auto range = mIndex.equal_range(*key);
+				for (auto it = range.first; it != range.second; ++it) {
+					auto const& m = mMatches.at(it->second);
+					if (std::any_of(std::begin(m.mEvents), std::end(m.mEvents), [&ev](auto const& el) { return el.mSeq == ev.mSeq; })) {
+						result.push_back(it->second);
+					}
+				}
+			}
+		}
+		std::sort(std::begin(result), std::end(result));
+		result.erase(std::unique(std::begin(result), std::end(result)), std::end(result));
+		return result;
+	}
+
+	bool correlation_engine::claims(std::vector<correlation_event> const& events, size_t pattern) const
+	{
+		auto found = holders(events);
+		return std::any_of(std::begin(found), std::end(found), [this, pattern](size_t id) {
+			auto const& m = mMatches.at(id);
+			return !m.mDead && m.mPattern < pattern && (m.mComplete || m.mEvents.size() > 1);
+		});
+	}
+
+	bool correlation_engine::contests(std::vector<correlation_event> const& events) const
+	{
+		auto found = holders(events);
+		return std::any_of(std::begin(found), std::end(found), [this](size_t id) {
+			auto const& m = mMatches.at(id);
+			return !m.mDead && !m.mComplete && m.mEvents.size() > 1;
+		});
+	}
+
+	void correlation_engine::discard(std::vector<correlation_event> const& events)
+	{
+		for (auto id : holders(events)) {
+			remove(id);
+		}
+	}
+
+	void correlation_engine::process(time_point now, result_sink const& sink)
+	{
+		// 1. advance on new events
+		correlation_event ev;
+		while (mInbox.try_pop(ev)) {
+			feed(std::move(ev));
+		}
+		emit(now, sink);
+	}
+
+	void correlation_engine::emit(time_point now, result_sink const& sink)
+	{
+		// 2. drop dead, expired matches and pick the settled ones.
+		// An uncontested match is settled after the short quiet time of its pattern,
+		// an ambiguous one waits the full quiet time.
+		std::vector<size_t> dead;
+		std::vector<size_t> ready;
+		for (auto& el : mMatches) {
+			auto const& m = el.second;
+			if (m.mDead) {
+				dead.push_back(el.first);
+			}
+			else if (!m.mComplete) {
+				if (elapsed(m.mLast, now, window_of(m))) {
+					dead.push_back(el.first);
+				}
+			}
+			else if (elapsed(m.mLast, now, mPatterns[m.mPattern].mSettle)) {
+				if (!contested(el.first, m) || elapsed(m.mLast, now, mPatterns[m.mPattern].mQuiet)) {
+					ready.push_back(el.first);
+				}
+			}
+		}
+		for (auto id : dead) {
+			remove(id);
+		}
+
+		// most specific pattern first, then the oldest
+		std::sort(std::begin(ready), std::end(ready), [this](size_t lhs, size_t rhs) {
+			auto const& l = mMatches.at(lhs);
+			auto const& r = mMatches.at(rhs);
+			if (l.mPattern != r.mPattern) {
+				return l.mPattern < r.mPattern;
+			}
+			return l.mEvents.front().mSeq < r.mEvents.front().mSeq;
+		});
+
+		// 3. emit
+		for (auto id : ready) {
+			auto found = mMatches.find(id);
+			if (std::end(mMatches) == found) {
+				continue;
+			}
+			auto& m = found->second;
+
+			auto rivals = rivals_of(id, m);
+
+			// A more specific pattern on the same events wins, or is still in progress.
+			// A match of only its first step is just a possibility, it does not block.
+			bool blocked = std::any_of(std::begin(rivals), std::end(rivals), [this, &m](size_t rid) {
+				auto const& r = mMatches.at(rid);
+				return !r.mDead
+					&& r.mPattern < m.mPattern
+					&& (r.mComplete || r.mEvents.size() > 1)
+					&& shares_event(m, r);
+			});
+			if (blocked) {
+				continue;
+			}
+
+			auto const& pat = mPatterns[m.mPattern];
+			correlation_result result;
+			result.mPattern = m.mPattern;
+			result.mName = &pat.mName;
+			result.mEvents = &m.mEvents;
+			result.mEarly = !elapsed(m.mLast, now, pat.mQuiet);
+			for (auto const& ref : pat.mReport) {
+				auto const& step = m.mEvents[ref.mStep];
+				result.mPaths.push_back(path_ref::side::old_name == ref.mSide ? step.mOldPath : step.mPath);
+			}
+
+			if (!sink(result)) {
+				continue;
+			}
+
+			// Events are consumed => drop every other match built on them
+			for (auto rid : rivals) {
+				auto const& r = mMatches.at(rid);
+				if (shares_event(m, r)) {
+					remove(rid);
+				}
+			}
+			remove(id);
+		}
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "file_pattern.h"
+#include "event_clock.h"
+#include <concurrent_queue.h>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace died
+{
+	struct correlation_event
+	{
+		using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+		unsigned long mAction{};
+		std::wstring mPath;			// new name of a rename
+		std::wstring mOldPath;		// rename only
+		time_point mTime;
+		unsigned int mSource{};		// index of the watching group
+		unsigned long long mSeq{};
+		event_stamps mStamps{};		// pipeline stages, insert = posted
+
+		std::wstring get_file_name_wstring() const;
+		std::wstring get_parent_path_wstring() const;
+	};
+
+	struct correlation_result
+	{
+		size_t mPattern{};
+		std::wstring const* mName{ nullptr };
+		std::vector<std::wstring> mPaths;				// reported paths, the first one is the subject
+		std::vector<correlation_event> const* mEvents{ nullptr };
+		bool mEarly{};									// settled before the quiet time of its pattern
+	};
+
+	// Incremental matcher of file_pattern over the file name event stream.
+	// Events are posted lock-free from the observer threads and consumed on the
+	// correlation (timer) thread by process(). Every event only visits the
+	// matches indexed under its own paths, so the cost of one event is
+	// O(active matches for that path) instead of a scan of all models.
+	class correlation_engine
+	{
+		using time_point = correlation_event::time_point;
+
+		struct match
+		{
+			size_t mPattern{};
+			size_t mStep{};					// next step to match
+			std::vector<correlation_event> mEvents;
+			std::vector<std::wstring> mKeys;	// index keys of this match
+			time_point mLast;				// last matched or absorbed event
+			bool mComplete{};
+			bool mDead{};
+		};
+
+	public:
+		// Return false to keep the result and retry on next process()
+		using result_sink = std::function<bool(correlation_result const&)>;
+
+		// 'enabled': bit i set => patterns[i] is matched. The indexes of the results stay those of 'patterns'
+		explicit correlation_engine(std::vector<file_pattern> patterns = default_patterns(), unsigned long long enabled = ~0ull);
+
+		correlation_engine(correlation_engine const&) = delete;
+		correlation_engine& operator=(correlation_engine const&) = delete;
+
+		// Any thread
+		void post(unsigned long action, std::wstring path, time_point time, unsigned int source, event_stamps stamps = {});
+
+		// Correlation thread: consume posted events, then emit the settled matches
+		void process(time_point now, result_sink const& sink);
+
+		// Correlation thread, when the caller owns the event queue (correlation_shards).
+		// 'ev.mSeq' is kept when set: it must be unique among the engines sharing events
+		void consume(correlation_event&& ev);
+		void emit(time_point now, result_sink const& sink);
+
+		// Other engines holding the same events, while this one does not change
+		bool claims(std::vector<correlation_event> const& events, size_t pattern) const;	// a more specific sequence in progress on them
+		bool contests(std::vector<correlation_event> const& events) const;					// an incomplete sequence of several events on them
+		void discard(std::vector<correlation_event> const& events);							// consumed elsewhere: drop the matches on them
+
+		size_t active() const noexcept;
+		std::vector<file_pattern> const& patterns() const noexcept;
+
+		// Correlation thread, or its workers between two process()
+		bool involves(std::wstring const& path) const;	// a multi-event match is in progress on 'path'
+		bool tracks(std::wstring const& path) const;	// any match, first step included, holds 'path'
+
+	private:
+		void feed(correlation_event&& ev);
+		void advance(match& m, size_t id, correlation_event const& ev);
+		void start(correlation_event const& ev);
+		bool relates(match const& m, pattern_step const& step, correlation_event const& ev) const;
+		bool touches(match const& m, correlation_event const& ev) const;
+		void complete(match& m);
+		bool shares_event(match const& lhs, match const& rhs) const;
+		void index(size_t id, match& m, correlation_event const& ev);
+		void remove(size_t id);
+		size_t window_of(match const& m) const;
+		std::vector<size_t> rivals_of(size_t id, match const& m) const;
+		bool contested(size_t id, match const& m) const;
+		std::vector<size_t> holders(std::vector<correlation_event> const& events) const;
+
+	private:
+		std::vector<file_pattern> mPatterns;
+		const unsigned long long mEnabled;
+		Concurrency::concurrent_queue<correlation_event> mInbox;
+
+		// Correlation thread only
+		std::unordered_map<size_t, match> mMatches;
+		std::unordered_multimap<std::wstring, size_t> mIndex;
+		std::unordered_map<unsigned int, correlation_event> mPendingOldName;
+		size_t mNextId{};
+		unsigned long long mNextSeq{};
+	};
+}
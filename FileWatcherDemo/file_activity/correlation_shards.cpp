@@ -0,0 +1,208 @@
+#include "correlation_shards.h"
+#include "state_shards.h"
+#include <algorithm>
+
+namespace died
+{
+	namespace
+	{
+		unsigned long long local_patterns(std::vector<file_pattern> const& patterns, bool cross)
+		{
+			unsigned long long mask{};
+			for (size_t i = 0; i < patterns.size(); ++i) {
+				if (cross == correlation_shards::crosses_folders(patterns[i])) {
+					mask |= 1ull << i;
+				}
+			}
+			return mask;
+		}
+
+		unsigned long step_actions(std::vector<file_pattern> const& patterns)
+		{
+			// what starts or advances a cross-folder match
+			unsigned long actions{};
+			for (auto const& el : patterns) {
+				if (correlation_shards::crosses_folders(el)) {
+					for (auto const& step : el.mSteps) {
+						actions |= action_bit(step.mAction);
+					}
+				}
+			}
+			return actions;
+		}
+	}
+
+	correlation_shards::shard::shard(std::vector<file_pattern> const& patterns, unsigned long long enabled) :
+		mEngine{ patterns, enabled }
+	{}
+
+	correlation_shards::correlation_shards(size_t count, std::vector<file_pattern> patterns) :
+		mPatterns{ std::move(patterns) },
+		mCrossActions{ step_actions(mPatterns) },
+		mMoves{ mPatterns, local_patterns(mPatterns, true) }
+	{
+		count = std::max<size_t>(count, 1);
+		auto enabled = local_patterns(mPatterns, false);
+		for (size_t i = 0; i < count; ++i) {
+			mShards.push_back(std::make_unique<shard>(mPatterns, enabled));
+		}
+	}
+
+	bool correlation_shards::crosses_folders(file_pattern const& pattern)
+	{
+		return std::any_of(std::begin(pattern.mSteps), std::end(pattern.mSteps), [](auto const& el) {
+			return path_relation::same_name_other_dir == el.mRelation;
+		});
+	}
+
+	void correlation_shards::post(unsigned long action, std::wstring path, time_point time, unsigned int source, event_stamps stamps)
+	{
+		correlation_event ev;
+		ev.mAction = action;
+		ev.mPath = std::move(path);
+		ev.mTime = time;
+		ev.mSource = source;
+		ev.mStamps = stamps;
+		if (time_point{} == ev.mStamps.front()) {
+			ev.mStamps.fill(time);
+		}
+		ev.mStamps[static_cast<size_t>(event_stage::insert)] = event_clock::now();
+
+		// a rename stays in its folder => both names in the same shard
+		auto index = state_shards::shard_index(ev.mPath, mShards.size());
+		mShards[index]->mInbox.push(std::move(ev));
+	}
+
+	size_t correlation_shards::size() const noexcept
+	{
+		return mShards.size();
+	}
+
+	size_t correlation_shards::active() const noexcept
+	{
+		auto count = mMoves.active();
+		for (auto const& el : mShards) {
+			count += el->mEngine.active();
+		}
+		return count;
+	}
+
+	std::vector<file_pattern> const& correlation_shards::patterns() const noexcept
+	{
+		return mPatterns;
+	}
+
+	void correlation_shards::consume(size_t index)
+	{
+		auto& sh = *mShards[index];
+		correlation_event ev;
+		while (sh.mInbox.try_pop(ev)) {
+			// pair rename events here, both halves go to the same engines
+			if (FILE_ACTION_RENAMED_OLD_NAME == ev.mAction) {
+				sh.mPendingOldName[ev.mSource] = std::move(ev);
+				continue;
+			}
+			if (FILE_ACTION_RENAMED_NEW_NAME == ev.mAction) {
+				auto found = sh.mPendingOldName.find(ev.mSource);
+				if (std::end(sh.mPendingOldName) == found) {
+					continue;
+				}
+				ev.mOldPath = std::move(found->second.mPath);
+				sh.mPendingOldName.erase(found);
+				ev.mAction = ACTION_RENAMED;
+			}
+
+			// unique over the shards without a shared counter
+			ev.mSeq = ++sh.mNextSeq * mShards.size() + index;
+			if (forwards(sh, ev)) {
+				for (auto const* path : { &ev.mPath, &ev.mOldPath }) {
+					if (!path->empty()) {
+						sh.mForwardPaths.insert(*path);
+					}
+				}
+				sh.mForward.push_back(ev);
+			}
+			sh.mEngine.consume(std::move(ev));
+		}
+	}
+
+	bool correlation_shards::forwards(shard const& sh, correlation_event const& ev) const
+	{
+		if (mCrossActions & action_bit(ev.mAction)) {
+			return true;
+		}
+
+		// any event on a path of a cross-folder match keeps or drops it.
+		// A path and its renames stay in the shard => its own forwarded paths are enough
+		auto tracked = [this, &sh](std::wstring const& path) {
+			return !path.empty() && (sh.mForwardPaths.count(path) || mMoves.tracks(path));
+		};
+		return tracked(ev.mPath) || tracked(ev.mOldPath);
+	}
+
+	void correlation_shards::process_moves(time_point now, result_sink const& sink)
+	{
+		// forwarded events in time order, as one engine would have seen them
+		std::vector<correlation_event> events;
+		for (auto const& el : mShards) {
+			std::move(std::begin(el->mForward), std::end(el->mForward), std::back_inserter(events));
+			el->mForward.clear();
+			el->mForwardPaths.clear();
+		}
+		std::stable_sort(std::begin(events), std::end(events), [](auto const& lhs, auto const& rhs) {
+			return lhs.mTime < rhs.mTime;
+		});
+		for (auto& el : events) {
+			mMoves.consume(std::move(el));
+		}
+
+		mMoves.emit(now, [this, &sink](correlation_result const& result) {
+			auto const& events = *result.mEvents;
+			for (auto const& el : events) {
+				auto const& local = mShards[state_shards::shard_index(el.mPath, mShards.size())]->mEngine;
+				if (local.claims(events, result.mPattern) || (result.mEarly && local.contests(events))) {
+					return false;
+				}
+			}
+			if (!sink(result)) {
+				return false;
+			}
+			for (auto const& el : events) {
+				mShards[state_shards::shard_index(el.mPath, mShards.size())]->mEngine.discard(events);
+			}
+			return true;
+		});
+	}
+
+	void correlation_shards::process(size_t index, time_point now, result_sink const& sink)
+	{
+		auto& sh = *mShards[index];
+		sh.mEngine.emit(now, [this, &sh, &sink](correlation_result const& result) {
+			auto const& events = *result.mEvents;
+			if (mMoves.claims(events, result.mPattern) || (result.mEarly && mMoves.contests(events))) {
+				return false;
+			}
+			if (!sink(result)) {
+				return false;
+			}
+			sh.mConsumed.insert(std::end(sh.mConsumed), std::begin(events), std::end(events));
+			return true;
+		});
+	}
+
+	void correlation_shards::settle()
+	{
+		for (auto const& el : mShards) {
+			if (!el->mConsumed.empty()) {
+				mMoves.discard(el->mConsumed);
+				el->mConsumed.clear();
+			}
+		}
+	}
+
+	bool correlation_shards::involves(std::wstring const& path) const
+	{
+		auto const& local = mShards[state_shards::shard_index(path, mShards.size())]->mEngine;
+		return local.involves(path) || mMoves.involves(path);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "correlation_engine.h"
+#include <memory>
+#include <unordered_set>
+
+namespace died
+{
+	// correlation_engine split like state_shards, by parent directory.
+	// The patterns inside one folder (renames, save-as, copy...) run per shard, on the
+	// worker of the shard. The patterns across folders (moves) run in one engine fed
+	// through a channel: each shard forwards the events those patterns start or match on.
+	// The engines share the event sequence numbers, so a result of one of them blocks
+	// or drops the matches of the others on the same events, like inside one engine.
+	//
+	// One correlation round, in order:
+	// 1. consume(shard) on the workers: new events of the shard
+	// 2. process_moves() on the correlation thread: cross-folder patterns, checked against the shards
+	// 3. process(shard) on the workers: patterns of the shard, checked against the moves
+	// 4. settle() on the correlation thread: events consumed in 3. leave the cross-folder matches
+	class correlation_shards
+	{
+		using time_point = correlation_event::time_point;
+
+	public:
+		using result_sink = correlation_engine::result_sink;
+
+		explicit correlation_shards(size_t count, std::vector<file_pattern> patterns = default_patterns());
+
+		correlation_shards(correlation_shards const&) = delete;
+		correlation_shards& operator=(correlation_shards const&) = delete;
+
+		// Any thread
+		void post(unsigned long action, std::wstring path, time_point time, unsigned int source, event_stamps stamps = {});
+
+		size_t size() const noexcept;
+		size_t active() const noexcept;
+		std::vector<file_pattern> const& patterns() const noexcept;
+
+		void consume(size_t shard);
+		void process_moves(time_point now, result_sink const& sink);
+		void process(size_t shard, time_point now, result_sink const& sink);
+		void settle();
+
+		// Step 3, on the worker of the shard of 'path'
+		bool involves(std::wstring const& path) const;
+
+		static bool crosses_folders(file_pattern const& pattern);
+
+	private:
+		struct shard
+		{
+			explicit shard(std::vector<file_pattern> const& patterns, unsigned long long enabled);
+
+			correlation_engine mEngine;
+			Concurrency::concurrent_queue<correlation_event> mInbox;
+			std::unordered_map<unsigned int, correlation_event> mPendingOldName;	// per source
+			std::vector<correlation_event> mForward;	// to the cross-folder engine, step 1 => 2
+			std::unordered_set<std::wstring> mForwardPaths;	// paths of mForward
+			std::vector<correlation_event> mConsumed;	// reported in step 3, dropped in step 4
+			unsigned long long mNextSeq{};
+		};
+
+		bool forwards(shard const& sh, correlation_event const& ev) const;
+
+	private:
+		std::vector<file_pattern> mPatterns;
+		unsigned long mCrossActions{};					// actions of the cross-folder steps
+		std::vector<std::unique_ptr<shard>> mShards;
+		correlation_engine mMoves;						// correlation thread, read-only in steps 1 and 3
+	};
+}
\ No newline at end of file
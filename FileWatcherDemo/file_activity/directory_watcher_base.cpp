@@ -4,6 +4,8 @@
 
 #include "gsl\gsl_assert"
 #include "spdlog_header.h"
+#include "event_probes.h"
+#include "event_tracer.h"
 #include <utility>
 
 namespace died
@@ -13,17 +15,31 @@ namespace died
 		stop();
 	}
 
-	void directory_watcher_base::set_rule(std::shared_ptr<fat::UnnecessaryDirectory> rule)
+	void directory_watcher_base::set_rule(std::shared_ptr<filter_rules> rule)
 	{
 		mRule = rule;
 	}
 
+	void directory_watcher_base::set_metrics(std::shared_ptr<pipeline_metrics> metrics, watcher_kind kind)
+	{
+		mMetrics = std::move(metrics);
+		mKind = kind;
+	}
+
+	void directory_watcher_base::set_raw_journal(std::shared_ptr<raw_journal> journal)
+	{
+		mRawJournal = std::move(journal);
+	}
+
 	directory_watcher_base::directory_watcher_base(directory_watcher_base&& other) noexcept :
 		mSettings{ std::exchange(other.mSettings, std::vector<watching_setting>{}) },
 		mObserverThread{ std::exchange(other.mObserverThread, nullptr) },
 		mThreadId{ std::exchange(other.mThreadId, 0) },
 		mObserver{ std::exchange(other.mObserver, nullptr) },
-		mRule{ std::exchange(other.mRule, nullptr) }
+		mRule{ std::exchange(other.mRule, nullptr) },
+		mMetrics{ std::exchange(other.mMetrics, nullptr) },
+		mRawJournal{ std::exchange(other.mRawJournal, nullptr) },
+		mKind{ other.mKind }
 	{}
 
 	directory_watcher_base& directory_watcher_base::operator=(directory_watcher_base&& other) noexcept
@@ -34,6 +50,9 @@ namespace died
 			mThreadId = std::exchange(other.mThreadId, 0);
 			mObserver = std::exchange(other.mObserver, nullptr);
 			mRule = std::exchange(other.mRule, nullptr);
+			mMetrics = std::exchange(other.mMetrics, nullptr);
+			mRawJournal = std::exchange(other.mRawJournal, nullptr);
+			mKind = other.mKind;
 		}
 		return *this;
 	}
@@ -140,11 +159,26 @@ namespace died
 		LOGEXIT;
 	}
 
-	void directory_watcher_base::filter_notify(file_notify_info info)
+	void directory_watcher_base::filter_notify(std::vector<file_notify_info>& infos)
 	{
+		TRACE_SCOPE("filter_notify");
 		Ensures(mRule);
-		if (!mRule->contains(info)) {
-			do_notify(std::move(info));
+		// Take the published version once for the buffer, it may be swapped by the rule thread meanwhile
+		auto rule = mRule->current();
+		for (auto& info : infos) {
+			auto by = rule->match(info);
+			probe_filter(info, static_cast<size_t>(mKind), static_cast<size_t>(by));
+			if (mMetrics) {
+				mMetrics->received(mKind);
+				mMetrics->filtered(by);
+			}
+			if (fat::UnnecessaryDirectory::Rule::none == by) {
+				if (mRawJournal) {
+					mRawJournal->write(mKind, info);
+				}
+				info.stamp(event_stage::filter, event_clock::now());
+				do_notify(std::move(info));
+			}
 		}
 	}
 }
\ No newline at end of file
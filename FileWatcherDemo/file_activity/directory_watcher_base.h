@@ -4,7 +4,9 @@
 #include <Windows.h>
 #include "iobserver.h"
 #include "watching_setting.h"
-#include "unnecessary_directory.h" //++ TODO
+#include "filter_rules.h"
+#include "pipeline_metrics.h"
+#include "raw_journal.h"
 
 namespace died
 {
@@ -14,7 +16,9 @@ namespace died
 		directory_watcher_base() noexcept = default;
 		~directory_watcher_base() noexcept override;
 
-		void set_rule(std::shared_ptr<fat::UnnecessaryDirectory>);
+		void set_rule(std::shared_ptr<filter_rules>);
+		void set_metrics(std::shared_ptr<pipeline_metrics> metrics, watcher_kind kind);
+		void set_raw_journal(std::shared_ptr<raw_journal> journal);
 
 		bool add_setting(watching_setting&& sett);
 
@@ -26,7 +30,7 @@ namespace died
 		directory_watcher_base& operator=(directory_watcher_base&&) noexcept;
 
 	private:
-		void filter_notify(file_notify_info info) final;
+		void filter_notify(std::vector<file_notify_info>& infos) final;
 		virtual void do_notify(file_notify_info info) = 0;
 
 	private:
@@ -34,6 +38,9 @@ namespace died
 		HANDLE mObserverThread{ nullptr };
 		unsigned mThreadId{};
 		std::unique_ptr<iobserver> mObserver{};
-		std::shared_ptr<fat::UnnecessaryDirectory> mRule; //++ TODO
+		std::shared_ptr<filter_rules> mRule;
+		std::shared_ptr<pipeline_metrics> mMetrics;
+		std::shared_ptr<raw_journal> mRawJournal;
+		watcher_kind mKind{};
 	};
 }
\ No newline at end of file
@@ -2,79 +2,208 @@
 #include "common_utils.h"
 #include "watching_setting.h"
 #include "spdlog_header.h"
+#include "event_journal.h"
+#include "event_probes.h"
+#include "event_tracer.h"
+#include <cwctype>
+#include <ppl.h>
 
 namespace died
 {
-	constexpr size_t DELAY_PROCESS = 3000; // milli-second
-	directory_watcher_mgr::directory_watcher_mgr(unsigned long interval) :
+	constexpr size_t DELAY_PROCESS = 3000; // milli-second, ambiguous events
+	constexpr size_t SETTLE_PROCESS = 300; // milli-second, unambiguous events: let the rest of a burst arrive
+	constexpr size_t PROVISIONAL_TIMEOUT = 3600000; // milli-second, longest pattern window (download)
+
+	// events on the file name, an attribute/security change of these is part of them
+	constexpr unsigned int FILE_NAME_ACTIONS = pending_bit(path_action::added)
+		| pending_bit(path_action::removed)
+		| pending_bit(path_action::modified)
+		| pending_bit(path_action::renamed);
+
+	// a pending remove/rename in the folder may still turn an event into a save-as, move...
+	constexpr unsigned int UNSETTLED_ACTIONS = pending_bit(path_action::removed)
+		| pending_bit(path_action::renamed);
+
+	namespace
+	{
+		bool waited_too_long(std::chrono::time_point<std::chrono::steady_clock> since, size_t maxWait)
+		{
+			return event_clock::now() - since >= std::chrono::milliseconds(maxWait);
+		}
+
+		// written under a temporary name, then renamed to the final one (download, office, editors)
+		bool has_temporary_name(std::wstring const& path)
+		{
+			std::filesystem::path file{ path };
+			auto name = file.filename().wstring();
+			if (!name.empty() && L'~' == name.front()) {
+				return true;
+			}
+
+			auto ext = file.extension().wstring();
+			for (auto& el : ext) {
+				el = static_cast<wchar_t>(std::towlower(el));
+			}
+			return L".tmp" == ext || L".crdownload" == ext || L".part" == ext || L".partial" == ext || L".download" == ext;
+		}
+
+		// classifications of the checkers, then of the patterns
+		std::vector<std::wstring> event_classes(std::vector<file_pattern> const& patterns)
+		{
+			std::vector<std::wstring> classes{ L"Attribute", L"Security", L"Folder remove", L"Folder move",
+				L"Rename only", L"Create rename", L"Create only", L"Remove", L"Modify" };
+			for (auto const& el : patterns) {
+				if (std::end(classes) == std::find(std::begin(classes), std::end(classes), el.mName)) {
+					classes.push_back(el.mName);
+				}
+			}
+			return classes;
+		}
+	}
+
+	directory_watcher_mgr::directory_watcher_mgr(unsigned long interval, std::wstring ruleConfig, size_t shards) :
 		TaskTimer(interval),
-		mRule{ std::make_shared<fat::UnnecessaryDirectory>() }
+		mRule{ std::make_shared<filter_rules>(std::move(ruleConfig)) },
+		mEngine{ std::make_shared<correlation_shards>(shards) },
+		mState{ std::make_shared<state_shards>(shards) },
+		mStability{ mProbe },
+		mSender{ std::make_shared<notify_to_server>() },
+		mRouter{ std::make_shared<event_router>() },
+		mSinks{ mSender, mRouter },
+		mLatency{ event_classes(mEngine->patterns()) },
+		mMetrics{ std::make_shared<pipeline_metrics>(event_classes(mEngine->patterns())) },
+		mExport{ [this] { return mLatency.dump(); } }
 	{
-		mRule->setAppDataDir(true);
-		mRule->addUserDefinePath(L"C:\\Windows\\");
-		mRule->addUserDefinePath(L"C:\\ProgramData\\");
-		mRule->addUserDefinePath(L"C:\\project\\");
-		mRule->addUserDefinePath(L"D:\\work\\");
-		mRule->addUserDefinePath(L"D:\\share\\");
-		mRule->addUserDefinePath(L"C:\\Program Files (x86)\\");
-		mRule->addUserDefinePath(L"C:\\Program Files\\");
+		register_probes();
+		mProbe.set_metrics(mMetrics);
 	}
 
 	bool directory_watcher_mgr::start(unsigned long notifyChange, bool subtree)
+	{
+		return start(notifyChange, enumerate_drives(), subtree);
+	}
+
+	bool directory_watcher_mgr::start(unsigned long notifyChange, std::vector<std::wstring> const& folders, bool subtree)
+	{
+		create_groups(notifyChange, folders, subtree);
+
+		// load rules then keep watching the rule file
+		mRule->start();
+
+		if (mRawJournal) {
+			mRawJournal->start();
+		}
+
+		// start watching
+		for (auto& el : mWatchers) {
+			el->mFileName.start();
+			el->mAttr.start();
+			el->mSecu.start();
+			el->mFolderName.start();
+		}
+
+		if (mPipe) {
+			mPipe->start();
+		}
+		if (mRing) {
+			mRing->open();
+		}
+
+		// start timer threads
+		startTimer();
+		mExport.start();
+		return true;
+	}
+
+	bool directory_watcher_mgr::start_manual(unsigned long notifyChange, std::vector<std::wstring> const& drives, bool subtree)
+	{
+		create_groups(notifyChange, drives, subtree);
+		mRule->reload();
+
+		// same verdicts on every run, the recorded files are not on this machine => never busy
+		mProbe.set_synchronous(true);
+		mProbe.set_prober([](std::wstring const&) {
+			busy_probe::info probed;
+			probed.mResult = busy_probe::result::idle;
+			probed.mTime = event_clock::now();
+			return probed;
+		});
+		return !mWatchers.empty();
+	}
+
+	bool directory_watcher_mgr::feed(file_notify_info info)
+	{
+		auto path = info.get_path_wstring();
+		for (auto& el : mWatchers) {
+			if (path.size() >= el->mDrive.size() && 0 == _wcsnicmp(path.c_str(), el->mDrive.c_str(), el->mDrive.size())) {
+				// through the rules, like an event of the observer thread
+				el->mFileName.notify(std::move(info));
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void directory_watcher_mgr::tick()
+	{
+		onTimer();
+	}
+
+	void directory_watcher_mgr::create_groups(unsigned long notifyChange, std::vector<std::wstring> const& drives, bool subtree)
 	{
 		unsigned long actionFileName	= notifyChange & (notifyChange ^ (FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SECURITY));
 		unsigned long actionAttr		= FILE_NOTIFY_CHANGE_ATTRIBUTES & notifyChange;
 		unsigned long actionSecu		= FILE_NOTIFY_CHANGE_SECURITY & notifyChange;
 		unsigned long actionFolderName	= FILE_NOTIFY_CHANGE_DIR_NAME & notifyChange;
 
-		auto drives = enumerate_drives();
-		auto size = drives.size();
-
 		// cleanup data
 		mWatchers.clear();
-		mWatchers.reserve(size);
+		mWatchers.reserve(drives.size());
 		
 		for (auto const& el : drives) {
 			auto group = std::make_unique<watching_group>();
+			group->mDrive = el;
 			
 			// 1. watching file name
 			watching_setting setFileName(actionFileName, el, subtree);
 			group->mFileName.add_setting(std::move(setFileName));
 			group->mFileName.set_rule(mRule);
+			group->mFileName.set_metrics(mMetrics, watcher_kind::file_name);
+			group->mFileName.set_raw_journal(mRawJournal);
+			group->mFileName.set_state(mState);
+			group->mFileName.set_correlation(mEngine, static_cast<unsigned int>(mWatchers.size()));
+			group->mFileName.set_sender(mSender);
 
 			// 2. watching attribute
 			watching_setting setAttr(actionAttr, el, subtree);
 			group->mAttr.add_setting(std::move(setAttr));
 			group->mAttr.set_rule(mRule);
+			group->mAttr.set_metrics(mMetrics, watcher_kind::attribute);
+			group->mAttr.set_raw_journal(mRawJournal);
+			group->mAttr.set_state(mState);
 
 			// 3. watching security
 			watching_setting setSecu(actionSecu, el, subtree);
 			group->mSecu.add_setting(std::move(setSecu));
 			group->mSecu.set_rule(mRule);
+			group->mSecu.set_metrics(mMetrics, watcher_kind::security);
+			group->mSecu.set_raw_journal(mRawJournal);
+			group->mSecu.set_state(mState);
 
 			// 4. watching folder name
 			watching_setting setFolderName(actionFolderName, el, subtree);
 			group->mFolderName.add_setting(std::move(setFolderName));
 			group->mFolderName.set_rule(mRule);
+			group->mFolderName.set_metrics(mMetrics, watcher_kind::folder_name);
+			group->mFolderName.set_raw_journal(mRawJournal);
 
 			mWatchers.push_back(std::move(group));
 		}
-
-		// start watching
-		for (auto& el : mWatchers) {
-			el->mFileName.start();
-			el->mAttr.start();
-			el->mSecu.start();
-			el->mFolderName.start();
-		}
-
-		// start timer thread
-		startTimer();
-		return true;
 	}
 
 	void directory_watcher_mgr::stop()
 	{
+		mExport.stop();
 		stopTimer();
 		for (auto& el : mWatchers) {
 			el->mFileName.stop();
@@ -82,164 +211,487 @@ namespace died
 			el->mSecu.stop();
 			el->mFolderName.stop();
 		}
+		mRule->stop();
+		if (mRawJournal) {
+			mRawJournal->stop();
+		}
+		if (mCoalescer) {
+			std::lock_guard<std::mutex> lk(mSinkSync);
+			mCoalescer->flush(event_clock::time_point::max());
+		}
+		if (mPipe) {
+			mPipe->stop();
+		}
+		if (mRing) {
+			mRing->close();
+		}
+
+		if (mSender->speculative()) {
+			auto stats = speculation();
+			SPDLOG_INFO(L"provisional: {}, confirmed: {}, replaced: {}, retracted: {}, retraction rate: {:.3f}",
+				stats.mProvisional, stats.mConfirmed, stats.mReplaced, stats.mRetracted, stats.retraction_rate());
+		}
+		for (auto const& el : mLatency.dump()) {
+			SPDLOG_INFO(el);
+		}
+	}
+
+	void directory_watcher_mgr::add_consumer(std::wstring name, bool speculative, notify_to_server::deliver_fn deliver)
+	{
+		mSender->add_consumer(std::move(name), speculative, std::move(deliver));
+	}
+
+	void directory_watcher_mgr::add_sink(std::shared_ptr<event_sink> sink)
+	{
+		mSinks.push_back(std::move(sink));
+	}
+
+	unsigned int directory_watcher_mgr::subscribe(subscription sub)
+	{
+		return mRouter->subscribe(std::move(sub));
+	}
+
+	bool directory_watcher_mgr::unsubscribe(unsigned int id)
+	{
+		return mRouter->unsubscribe(id);
+	}
+
+	void directory_watcher_mgr::set_event_pipe(std::wstring pipe, size_t capacity, std::wstring spoolDir)
+	{
+		mPipe = std::make_shared<event_sender>(std::move(pipe), capacity, std::move(spoolDir));
+		add_sink(mPipe);
+	}
+
+	void directory_watcher_mgr::set_event_ring(std::wstring name, size_t capacity)
+	{
+		mRing = std::make_shared<event_ring>(std::move(name), capacity);
+		add_sink(mRing);
+	}
+
+	void directory_watcher_mgr::set_raw_journal(std::wstring dir, size_t segmentBytes, size_t maxSegments)
+	{
+		mRawJournal = std::make_shared<raw_journal>(std::move(dir), 16384, segmentBytes, maxSegments);
+	}
+
+	void directory_watcher_mgr::set_coalescing(std::chrono::milliseconds window, size_t capacity)
+	{
+		mCoalescer = std::make_shared<event_coalescer>([this](std::vector<classified_event> const& events) {
+			deliver_sinks(events);
+		}, window, capacity);
+	}
+
+	void directory_watcher_mgr::set_event_store(size_t maxEvents)
+	{
+		mStore = std::make_shared<event_store>(maxEvents);
+		add_sink(mStore);
+	}
+
+	std::shared_ptr<event_store const> directory_watcher_mgr::history() const
+	{
+		return mStore;
+	}
+
+	void directory_watcher_mgr::set_max_wait(max_wait limits)
+	{
+		mMaxWait = limits;
+	}
+
+	speculation_stats directory_watcher_mgr::speculation() const
+	{
+		return mSender->stats();
+	}
+
+	std::vector<latency_report> directory_watcher_mgr::latency() const
+	{
+		return mLatency.snapshot();
+	}
+
+	void directory_watcher_mgr::set_metrics_file(std::wstring path, size_t interval)
+	{
+		mExport.set_file(std::move(path), interval, [this] { return metrics_text(); });
+	}
+
+	std::string directory_watcher_mgr::metrics_text() const
+	{
+		// depths and drops are read from their owners, nothing is counted on the hot path
+		metric_family pending{ "file_watcher_pending", "Events waiting in a model.", "gauge", "model" };
+		metric_family overwrites{ "file_watcher_ring_overwrites_total", "Oldest events lost on a full model.", "counter", "model" };
+
+		static const std::array<std::pair<path_action, wchar_t const*>, PATH_ACTION_COUNT> ACTIONS{ {
+			{ path_action::added, L"added" }, { path_action::removed, L"removed" }, { path_action::modified, L"modified" },
+			{ path_action::renamed, L"renamed" }, { path_action::attribute, L"attribute" }, { path_action::security, L"security" } } };
+		unsigned long long dropped = 0;
+		for (auto const& el : ACTIONS) {
+			unsigned long long depth = 0;
+			for (size_t shard = 0; shard < mState->size(); ++shard) {
+				depth += mState->at(shard).depth(el.first);
+			}
+			pending.mSamples.emplace_back(el.second, depth);
+		}
+		for (size_t shard = 0; shard < mState->size(); ++shard) {
+			dropped += mState->at(shard).dropped();
+		}
+
+		unsigned long long folderAdd = 0, folderRemove = 0, folderAddLost = 0, folderRemoveLost = 0;
+		for (auto const& el : mWatchers) {
+			folderAdd += el->mFolderName.get_add().size();
+			folderRemove += el->mFolderName.get_remove().size();
+			folderAddLost += el->mFolderName.get_add().overwrites();
+			folderRemoveLost += el->mFolderName.get_remove().overwrites();
+		}
+		pending.mSamples.emplace_back(L"folder_add", folderAdd);
+		pending.mSamples.emplace_back(L"folder_remove", folderRemove);
+		overwrites.mSamples.emplace_back(L"path_state", dropped);
+		overwrites.mSamples.emplace_back(L"folder_add", folderAddLost);
+		overwrites.mSamples.emplace_back(L"folder_remove", folderRemoveLost);
+
+		metric_family journal{ "file_watcher_journal_records_total", "Event journal records, per result.", "counter", "result" };
+		journal.mSamples.emplace_back(L"written", event_journal::written());
+		journal.mSamples.emplace_back(L"dropped", event_journal::dropped());
+
+		metric_family sender{ "file_watcher_sender_pending", "Provisional events waiting for their final classification.", "gauge" };
+		sender.mSamples.emplace_back(L"", mSender->pending());
+
+		metric_family held{ "file_watcher_backpressure_ticks_total", "Timer rounds without classification, a sink was saturated.", "counter" };
+		held.mSamples.emplace_back(L"", mHeldTicks.load(std::memory_order_relaxed));
+
+		metric_family routed{ "file_watcher_routed_events_total", "Events routed to a subscription.", "counter", "subscriber" };
+		for (auto const& el : mRouter->stats()) {
+			routed.mSamples.emplace_back(std::to_wstring(el.mId) + L":" + el.mName, el.mDelivered);
+		}
+
+		std::vector<metric_family> extra{ pending, overwrites, journal, sender, held, routed };
+		if (mRawJournal) {
+			auto stats = mRawJournal->stats();
+			metric_family raw{ "file_watcher_raw_journal_events_total", "Raw events of the raw journal, per result.", "counter", "result" };
+			raw.mSamples.emplace_back(L"written", stats.mWritten);
+			raw.mSamples.emplace_back(L"dropped", stats.mDropped);
+			metric_family bytes{ "file_watcher_raw_journal_bytes_total", "Bytes written to the raw journal segments.", "counter" };
+			bytes.mSamples.emplace_back(L"", stats.mBytes);
+			extra.insert(std::end(extra), { raw, bytes });
+		}
+		if (mPipe) {
+			auto stats = mPipe->stats();
+			metric_family depth{ "file_watcher_pipe_queue_depth", "Events waiting for the event pipe.", "gauge" };
+			depth.mSamples.emplace_back(L"", mPipe->depth());
+			metric_family events{ "file_watcher_pipe_events_total", "Events of the event pipe, per result.", "counter", "result" };
+			events.mSamples.emplace_back(L"sent", stats.mSent);
+			events.mSamples.emplace_back(L"dropped", stats.mDropped);
+			metric_family frames{ "file_watcher_pipe_frames_total", "Frames written to the event pipe.", "counter" };
+			frames.mSamples.emplace_back(L"", stats.mFrames);
+			metric_family spooled{ "file_watcher_pipe_spooled", "Events kept in the spool, not acknowledged by a write yet.", "gauge" };
+			spooled.mSamples.emplace_back(L"", stats.mSpooled);
+			extra.insert(std::end(extra), { depth, events, frames, spooled });
+		}
+		if (mRing) {
+			auto stats = mRing->stats();
+			metric_family records{ "file_watcher_shm_records_total", "Events written to the shared memory ring.", "counter" };
+			records.mSamples.emplace_back(L"", stats.mWritten);
+			metric_family consumers{ "file_watcher_shm_consumers", "Readers attached to the shared memory ring.", "gauge" };
+			consumers.mSamples.emplace_back(L"", stats.mConsumers);
+			metric_family lag{ "file_watcher_shm_lag", "Records the slowest ring reader is behind.", "gauge" };
+			lag.mSamples.emplace_back(L"", stats.mMaxLag);
+			metric_family overruns{ "file_watcher_shm_overruns", "Records the attached ring readers lost, overwritten before read.", "gauge" };
+			overruns.mSamples.emplace_back(L"", stats.mOverruns);
+			extra.insert(std::end(extra), { records, consumers, lag, overruns });
+		}
+		if (mStore) {
+			auto stats = mStore->stats();
+			metric_family events{ "file_watcher_store_events", "Classified events kept in the event store.", "gauge" };
+			events.mSamples.emplace_back(L"", stats.mEvents);
+			metric_family bytes{ "file_watcher_store_bytes", "Encoded columns of the sealed event store blocks.", "gauge" };
+			bytes.mSamples.emplace_back(L"", stats.mBytes);
+			metric_family paths{ "file_watcher_store_paths", "Paths and folders in the event store dictionary.", "gauge" };
+			paths.mSamples.emplace_back(L"", stats.mPaths);
+			metric_family evicted{ "file_watcher_store_evicted_total", "Oldest events dropped from the event store.", "counter" };
+			evicted.mSamples.emplace_back(L"", stats.mEvicted);
+			extra.insert(std::end(extra), { events, bytes, paths, evicted });
+		}
+		if (mCoalescer) {
+			metric_family merged{ "file_watcher_coalesced_total", "Events folded into a held event of the same path.", "counter" };
+			merged.mSamples.emplace_back(L"", mCoalescer->merged());
+			metric_family waiting{ "file_watcher_coalescer_held", "Events held in their coalescing window.", "gauge" };
+			waiting.mSamples.emplace_back(L"", mCoalescer->held());
+			extra.insert(std::end(extra), { merged, waiting });
+		}
+		return mMetrics->prometheus_text(extra);
 	}
 
 	TimerStatus directory_watcher_mgr::onTimer()
 	{
+		auto now = event_clock::now();
+
+		// Backpressure: a sink is behind => the events wait in their models, classified next round
+		if (sinks_saturated()) {
+			mHeldTicks.fetch_add(1, std::memory_order_relaxed);
+			return TimerStatus::TIMER_CONTINUE;
+		}
+
+		// coalesced events whose window closed
+		if (mCoalescer) {
+			std::lock_guard<std::mutex> lk(mSinkSync);
+			mCoalescer->flush(now);
+		}
+
+		// multi-event sequences first, they consume pending paths
+		Concurrency::parallel_for(size_t(0), mEngine->size(), [this](size_t shard) {
+			mEngine->consume(shard);
+		});
+		checking_moves();
+
+		// provisional events of paths dropped without processing
+		mSender->expire(now, PROVISIONAL_TIMEOUT);
+
+		event_batch folders;
 		for (auto& el : mWatchers) {
 			watching_group& grp = *el.get();
-			checking_attribute(grp);
-			checking_security(grp);
-			checking_folder_remove(grp);
-			checking_folder_move(grp);
-			checking_rename(grp);
-			checking_create(grp);
-			checking_remove(grp);
-			checking_modify(grp);
-			checking_modify_without_modify_event(grp);
-			checking_copy(grp);
-			checking_move(grp);
+			checking_folder_remove(grp, folders);
+			checking_folder_move(grp, folders);
 		}
+		publish(folders);
+
+		// A busy folder only delays its own shard
+		Concurrency::parallel_for(size_t(0), mState->size(), [this](size_t shard) {
+			checking_shard(shard);
+		});
+		mEngine->settle();
 		return TimerStatus::TIMER_CONTINUE;
 	}
 
-	void directory_watcher_mgr::erase_all(watching_group& group, std::wstring const& key)
+	void directory_watcher_mgr::checking_shard(size_t shard)
 	{
-		SPDLOG_INFO(key);
-		// 1. attribute and security first
-		group.mAttr.get_model().erase(key);
-		group.mSecu.get_model().erase(key);
-
-		// 2. add, remove, modiy
-		group.mFileName.get_add().erase(key);
-		group.mFileName.get_remove().erase(key);
-		group.mFileName.get_modify().erase(key);
+		TRACE_SCOPE("checking_shard");
+		event_batch out;
+		// sequences inside the folders of the shard, before their paths are classified one by one
+		mEngine->process(shard, event_clock::now(), [this, &out](correlation_result const& result) {
+			return report_pattern(result, out);
+		});
+		checking_attribute(shard, out);
+		checking_security(shard, out);
+		checking_rename(shard, out);
+		checking_create(shard, out);
+		checking_remove(shard, out);
+		checking_modify(shard, out);
+		publish(out);
 	}
 
-	void directory_watcher_mgr::erase_rename(watching_group& group, rename_notify_info const& info)
+	void directory_watcher_mgr::checking_moves()
 	{
-		SPDLOG_INFO(info.get_key());
-		auto oldName = info.mOldName.get_path_wstring();
-		auto newName = info.mNewName.get_path_wstring();
-
-		// 1. attribute and security first
-		group.mAttr.get_model().erase(oldName);
-		group.mSecu.get_model().erase(oldName);
-		group.mAttr.get_model().erase(newName);
-		group.mSecu.get_model().erase(newName);
-
-		// 2. add, remove, modiy
-		group.mFileName.get_add().erase(oldName);
-		group.mFileName.get_remove().erase(oldName);
-		group.mFileName.get_modify().erase(oldName);
-		group.mFileName.get_add().erase(newName);
-		group.mFileName.get_remove().erase(newName);
-		group.mFileName.get_modify().erase(newName);
-
-		// 3.rename
-		group.mFileName.get_rename().erase(info.get_key());
+		TRACE_SCOPE("checking_moves");
+		event_batch out;
+		mEngine->process_moves(event_clock::now(), [this, &out](correlation_result const& result) {
+			return report_pattern(result, out);
+		});
+		publish(out);
 	}
 
-	void directory_watcher_mgr::checking_attribute(watching_group& group) 
+	bool directory_watcher_mgr::report_pattern(correlation_result const& result, event_batch& out)
 	{
-		auto& model = group.mAttr.get_model();
-		auto const& info = model.front();
+		auto const& pattern = mEngine->patterns()[result.mPattern];
+		auto const& subject = result.mPaths.front();
 
-		//1. Invlid item => should jump to next one for next step
-		if (!info) {
-			model.next_available_item();
-			return;
+		// file is still written => keep the match for next time, up to the longest wait
+		bool stillOpen = pattern.mWaitStable && !mStability.is_stable(subject, result.mEvents->back().mTime);
+		if (stillOpen && !waited_too_long(result.mEvents->front().mTime, mMaxWait.mPattern)) {
+			return false;
 		}
 
-		// 2. Valid item but need delay
-		if (DELAY_PROCESS > info.alive()) {
-			return;
+		// a later rename cancels the pattern (copy) => early only when none can follow
+		if (result.mEarly && pattern.mCancel && may_be_renamed(mState->of(subject), subject, result.mEvents->back().mTime, 0)) {
+			return false;
 		}
 
-		auto key = info.get_path_wstring();
+		// paths in file_pattern::mReport order, they resolve the provisional events of the sequence
+		auto const& paths = result.mPaths;
+		auto& ev = report(out, event_kind::pattern, paths[0], 1 < paths.size() ? paths[1] : std::wstring{},
+			result.mEvents->front().mTime, result.mEvents->back().mStamps, stillOpen);
+		if (2 < paths.size()) {
+			ev.mAuxPath = out.keep(paths[2]);
+		}
+		ev.mPattern = result.mPattern;
+		ev.mName = result.mName;
+		ev.mSource = result.mEvents->front().mSource;
+
+		// erase processed items, a move spans two shards: only on the correlation thread
+		for (auto const& el : *result.mEvents) {
+			auto& table = mState->of(el.mPath);
+			erase_all(table, el.mPath, out);
+			if (ACTION_RENAMED == el.mAction) {
+				erase_all(table, el.mOldPath, out);
+				table.unlink(el.mOldPath, el.mPath);
+			}
+		}
+		return true;
+	}
 
-		// 3. should not exist in add, modify, remove, rename
-		if (group.mFileName.get_add().find(key)) {
-			model.next_available_item();
+	classified_event& directory_watcher_mgr::report(event_batch& out, event_kind kind, std::wstring path, std::wstring oldPath,
+		event_clock::time_point first, event_stamps const& stamps, bool stillOpen)
+	{
+		auto& ev = out.add(kind, std::move(path), std::move(oldPath));
+		ev.mFirst = first;
+		auto read = stamps[static_cast<size_t>(event_stage::read)];
+		ev.mLast = event_clock::time_point{} != read ? read : first;		// the read of its last raw event
+		ev.mStamps = stamps;
+		ev.mStillOpen = stillOpen;
+		ev.mSource = group_of(ev.mPath);
+		return ev;
+	}
+
+	void directory_watcher_mgr::publish(event_batch& batch)
+	{
+		if (batch.empty()) {
 			return;
 		}
 
-		if (group.mFileName.get_remove().find(key)) {
-			model.next_available_item();
-			return;
+		for (auto const& ev : batch.events()) {
+			auto inserted = ev.mStamps[static_cast<size_t>(event_stage::insert)];
+			if (event_clock::time_point{} != inserted) {
+				probe_classify(*ev.mName, ev.mPath, std::chrono::duration_cast<std::chrono::microseconds>(ev.mClassified - inserted).count());
+			}
+		}
+		for (auto const& ev : batch.events()) {
+			mMetrics->classified(*ev.mName);
+		}
+		{
+			std::lock_guard<std::mutex> lk(mSinkSync);
+			if (mCoalescer) {
+				// a guess is settled once the held events of its path reached the sinks
+				mCoalescer->deliver(batch.events());
+				mCoalescer->release_paths(batch.settled());
+			}
+			else {
+				deliver_sinks(batch.events());
+			}
 		}
+		for (auto const& el : batch.settled()) {
+			mSender->settle(el);
+		}
+		batch.clear();
+	}
 
-		if (group.mFileName.get_modify().find(key)) {
-			model.next_available_item();
-			return;
+	void directory_watcher_mgr::deliver_sinks(std::vector<classified_event> const& events)
+	{
+		for (auto const& el : mSinks) {
+			el->deliver(events);
 		}
 
-		if (group.mFileName.get_rename().get_number_family(key) > 0) {
-			model.next_available_item();
-			return;
+		// sent once the sinks have them, a held event after its window
+		auto sent = event_clock::now();
+		for (auto const& ev : events) {
+			mLatency.record(*ev.mName, ev.mStamps, ev.mClassified, sent);
 		}
+	}
 
-		// 4. notify this item
-		mSender.send(L"Attribute", key);
+	bool directory_watcher_mgr::sinks_saturated() const
+	{
+		return std::any_of(std::begin(mSinks), std::end(mSinks), [](auto const& el) { return el->saturated(); });
+	}
 
-		// 5. erase processed item
-		model.erase(info.get_path_wstring());
+	unsigned int directory_watcher_mgr::group_of(std::wstring_view path) const
+	{
+		for (size_t i = 0; i < mWatchers.size(); ++i) {
+			auto const& drive = mWatchers[i]->mDrive;
+			if (path.size() >= drive.size() && 0 == _wcsnicmp(path.data(), drive.c_str(), drive.size())) {
+				return static_cast<unsigned int>(i);
+			}
+		}
+		return 0;
+	}
 
-		// 6. jump to next item for next step
-		model.next_available_item();
+	void directory_watcher_mgr::erase_all(path_state_table& table, std::wstring const& key, event_batch& out)
+	{
+		JOURNAL_DEBUG(erased, 0, key);
+
+		// add, remove, modify, attribute, security in one update
+		table.erase(key, PENDING_CHANGES);
+		mStability.forget(key);
+
+		// processed without report => its provisional event was wrong, once the batch is delivered
+		out.settle(key);
 	}
 
-	void directory_watcher_mgr::checking_security(watching_group& group) 
+	void directory_watcher_mgr::erase_rename(path_state_table& table, rename_link const& link)
 	{
-		auto& model = group.mSecu.get_model();
-		auto const& info = model.front();
+		JOURNAL_DEBUG(rename_erased, 0, link.mOldName, link.mNewName);
+
+		// 1. add, remove, modify, attribute, security
+		table.erase(link.mOldName, PENDING_CHANGES);
+		table.erase(link.mNewName, PENDING_CHANGES);
+
+		// 2.rename
+		table.unlink(link.mOldName, link.mNewName);
+		mStability.forget(link.mNewName);
+	}
+
+	void directory_watcher_mgr::checking_attribute(size_t shard, event_batch& out) 
+	{
+		TRACE_SCOPE("checking_attribute");
+		auto& table = mState->at(shard);
+		auto const info = table.front(path_action::attribute);
 
 		//1. Invlid item => should jump to next one for next step
 		if (!info) {
-			model.next_available_item();
+			table.next(path_action::attribute);
 			return;
 		}
 
 		// 2. Valid item but need delay
-		if (DELAY_PROCESS > info.alive()) {
+		if (!is_settled(table, info, path_action::attribute)) {
 			return;
 		}
 
-		auto key = info.get_path_wstring();
-
 		// 3. should not exist in add, modify, remove, rename
-		if (group.mFileName.get_add().find(key)) {
-			model.next_available_item();
+		if (info.has_any(FILE_NAME_ACTIONS)) {
+			table.next(path_action::attribute);
 			return;
 		}
 
-		if (group.mFileName.get_remove().find(key)) {
-			model.next_available_item();
+		// 4. notify this item
+		report(out, event_kind::attribute, info.mPath, {}, info.since(path_action::attribute), info.mStamps);
+
+		// 5. erase processed item
+		table.erase(info.mPath, pending_bit(path_action::attribute));
+
+		// 6. jump to next item for next step
+		table.next(path_action::attribute);
+	}
+
+	void directory_watcher_mgr::checking_security(size_t shard, event_batch& out) 
+	{
+		TRACE_SCOPE("checking_security");
+		auto& table = mState->at(shard);
+		auto const info = table.front(path_action::security);
+
+		//1. Invlid item => should jump to next one for next step
+		if (!info) {
+			table.next(path_action::security);
 			return;
 		}
 
-		if (group.mFileName.get_modify().find(key)) {
-			model.next_available_item();
+		// 2. Valid item but need delay
+		if (!is_settled(table, info, path_action::security)) {
 			return;
 		}
 
-		if (group.mFileName.get_rename().get_number_family(key) > 0) {
-			model.next_available_item();
+		// 3. should not exist in add, modify, remove, rename
+		if (info.has_any(FILE_NAME_ACTIONS)) {
+			table.next(path_action::security);
 			return;
 		}
 
 		// 4. notify this item
-		mSender.send(L"Security", key);
+		report(out, event_kind::security, info.mPath, {}, info.since(path_action::security), info.mStamps);
 
 		// 5. erase processed item
-		model.erase(info.get_path_wstring());
+		table.erase(info.mPath, pending_bit(path_action::security));
 
 		// 6. jump to next item for next step
-		model.next_available_item();
+		table.next(path_action::security);
 	}
 
-	void directory_watcher_mgr::checking_folder_remove(watching_group& group) 
+	void directory_watcher_mgr::checking_folder_remove(watching_group& group, event_batch& out) 
 	{
+		TRACE_SCOPE("checking_folder_remove");
 		auto& model = group.mFolderName.get_remove();
 		auto const& info = model.front();
 
@@ -274,13 +726,14 @@ namespace died
 		}
 
 		// 100% only remove
-		mSender.send(L"Folder remove", key);
+		report(out, event_kind::folder_remove, key, {}, info.get_created_time(), info.get_stamps());
 		model.erase(key);
 		model.next_available_item();
 	}
 
-	void directory_watcher_mgr::checking_folder_move(watching_group& group)
+	void directory_watcher_mgr::checking_folder_move(watching_group& group, event_batch& out)
 	{
+		TRACE_SCOPE("checking_folder_move");
 		// get model
 		auto& model = group.mFolderName.get_add();
 
@@ -313,7 +766,7 @@ namespace died
 			// The parent path must differnt
 			// 100% MOVE
 			if (found) {
-				mSender.send(L"Folder move", found.get_path_wstring() + L", " + key);
+				report(out, event_kind::folder_move, key, found.get_path_wstring(), info.get_created_time(), info.get_stamps());
 				model.erase(key);
 				w->mFolderName.get_remove().erase(found.get_path_wstring());
 				model.next_available_item();
@@ -326,19 +779,20 @@ namespace died
 		model.next_available_item();
 	}
 
-	void directory_watcher_mgr::checking_rename(watching_group& group) 
+	void directory_watcher_mgr::checking_rename(size_t shard, event_batch& out) 
 	{
-		auto& model = group.mFileName.get_rename();
-		auto const& info = model.front();
+		TRACE_SCOPE("checking_rename");
+		auto& table = mState->at(shard);
+		auto const info = table.front_rename();
 
 		// 1. Invlid item => should jump to next one for next step
 		if (!info) {
-			model.next_available_item();
+			table.next_rename();
 			return;
 		}
 
-		// 2. Valid item but need delay
-		if (DELAY_PROCESS > info.mNewName.alive()) {
+		// 2. Valid item but need delay, the old and new name are unsettled by this rename itself
+		if (!is_settled(table, info.mNewName, info.alive(), 2)) {
 			// Waiting on this file
 			return;
 		}
@@ -346,27 +800,22 @@ namespace died
 		// **Goal of rename
 		// newName and oldName should not appear in 'add' or 'remove' or 'modify'
 
-		auto oldName = info.mOldName.get_path_wstring();
-		auto newName = info.mNewName.get_path_wstring();
+		auto const& oldName = info.mOldName;
+		auto const& newName = info.mNewName;
+		auto const oldState = table.find(oldName);
+		auto const newState = table.find(newName);
 
-		// 3. file is processing => ignore this file, jump to next one
-		static std::chrono::time_point<std::chrono::steady_clock> lastProcessingTime{};
-		int error{};
-		bool isProcessing = died::fileIsProcessing(newName, error) || died::fileIsProcessing(oldName, error);
-		if (isProcessing) {
-			lastProcessingTime = std::chrono::steady_clock::now();
-		}
-		// Just wait for stable file
-		constexpr unsigned long DELAY_FOR_STABLE = 1000; // milli-second
-		std::chrono::duration<double, std::milli> diff = std::chrono::steady_clock::now() - lastProcessingTime;
-		bool needDelay = diff.count() < DELAY_FOR_STABLE;
+		// 3. Just wait for stable file, the old name does not exist any more.
+		// Still opened after the longest wait => report it anyway
+		bool stillOpen = !mStability.is_stable(newName, std::max(info.mTime, newState.last_time()));
+		bool needDelay = stillOpen && mMaxWait.mRename > info.alive();
 
 		// **case 1: only rename action
 		// happen when rename a file
-		if (!needDelay && is_rename_only(info, group)) {
-			mSender.send(L"Rename only", oldName + L", " + newName);
-			erase_rename(group, info);
-			model.next_available_item();
+		if (!needDelay && is_rename_only(info, oldState, newState)) {
+			report(out, event_kind::rename_only, newName, oldName, info.mTime, info.mStamps, stillOpen);
+			erase_rename(table, info);
+			table.next_rename();
 			return;
 		}
 
@@ -374,70 +823,17 @@ namespace died
 		// use Word: save-as, save
 		// use Excel: save
 		// Brower download file: auto-save
-		auto family = group.mFileName.get_rename().get_family(info);
-		auto numRename = family.size();
-
-		if (numRename >= 2) {
-			rename_notify_info const& before = family[0].get();
-			rename_notify_info const& after = family[1].get();
-
-			// 2.1 Should wait for stable file on second rename
-			auto finalName = after.mNewName.get_path_wstring();
-			if (DELAY_PROCESS > after.mNewName.alive()) {
-				// Waiting on this file
-				return;
-			}
-
-			// 2.2 brower download file auto-save
-			if (is_rename_download_auto_save(group, before, after)) {
-				mSender.send(L"Create download auto-save", 
-					finalName + L", " +
-					after.mOldName.get_path_wstring() + L", "
-					+ before.mOldName.get_path_wstring());
-				erase_rename(group, after);
-				erase_rename(group, before);
-				model.next_available_item();
-				return;
-			}
-
-			// 2.3 Using Word
-			if (is_rename_word(group, before, after)) {
-				// 2.1.1 Save-as
-				// realFile exist in add model
-				std::wstring msgAction;
-				if (group.mFileName.get_add().find(finalName)) {
-					msgAction = L"Create Word save-as";
-				}
-				// 2.1.2 Save
-				// realFile not exist in add model
-				else {
-					msgAction = L"Modify Word save";
-				}
-				mSender.send(msgAction,
-					finalName + L", " +
-					after.mOldName.get_path_wstring() + L", "
-					+ before.mNewName.get_path_wstring());
-				erase_rename(group, after);
-				erase_rename(group, before);
-				model.next_available_item();
-				return;
-			}
-
-			// **case 2.4: special case for Excel save-as => save
-			// Actually, there is more 2 rename events
-			// Assume current event is create
-			mSender.send(L"Create excel save-as", newName + L", " + oldName);
-			erase_rename(group, info);
-			model.next_available_item();
+		// => recognized by correlation engine, see file_pattern
+		if (1u != rename_family(info, oldState, newState)) {
 			return;
 		}
 
 		// **case 3: 1 event rename
 		// happen when: save-as brower, create and rename a file
-		if (!needDelay && is_rename_one_time(info, group)) {
-			mSender.send(L"Create rename", newName + L", " + oldName);
-			erase_rename(group, info);
-			model.next_available_item();
+		if (!needDelay && is_rename_one_time(info, oldState, newState)) {
+			report(out, event_kind::create_rename, newName, oldName, info.mTime, info.mStamps, stillOpen);
+			erase_rename(table, info);
+			table.next_rename();
 			return;
 		}
 
@@ -445,661 +841,301 @@ namespace died
 		// Hence, continue waiting on this file
 	}
 
-	void directory_watcher_mgr::checking_create(watching_group& group)
+	void directory_watcher_mgr::checking_create(size_t shard, event_batch& out)
 	{
-		// get model
-		auto& model = group.mFileName.get_add();
+		TRACE_SCOPE("checking_create");
+		auto& table = mState->at(shard);
 
 		// pop item
-		auto const& info = model.front();
+		auto const info = table.front(path_action::added);
 
 		//1. Invlid item => should jump to next one for next step
 		if (!info) {
-			model.next_available_item();
+			table.next(path_action::added);
 			return;
 		}
 
 		// 2. Valid item but need delay
-		if (DELAY_PROCESS > info.alive()) {
+		if (!is_settled(table, info, path_action::added)) {
 			return;
 		}
 
 		// get key
-		auto key = info.get_path_wstring();
+		auto key = info.mPath;
 
-		// 3. file is processing => ignore this file, jump to next one
-		int error;
-		if (died::fileIsProcessing(key, error)) {
-			model.next_available_item();
+		// 3. file is processing => ignore this file, jump to next one.
+		// Still opened after the longest wait => report it anyway
+		bool stillOpen = !mStability.is_stable(key, info.last_time());
+		if (stillOpen && mMaxWait.mCreate > info.waiting(path_action::added)) {
+			table.next(path_action::added);
 			return;
 		}
 
 		// **case 1: dont interest in file that exist in rename
 		// happen when save, save-as word
-		if (group.mFileName.exist_in_rename_any(key)) {
+		if (info.has(path_action::renamed)) {
 			// will be processed in rename
-			model.next_available_item();
+			table.next(path_action::added);
 			return;
 		}
 
 		// **case 2: temporary file
 		// happen when download big file by save-as
 		// will create -> remove -> waiting to rename
-		if (is_temporary_file(info, group)) {
+		if (is_temporary_file(info)) {
 			// will be processed in remove
-			model.next_available_item();
+			table.next(path_action::added);
 			return;
 		}
 
 		// **case 3: save-as .txt by notepad
-		if (is_save_as_txt(info, group)) {
-			mSender.send(L"Create by save-as", key);
-			erase_all(group, key);
-			model.next_available_item();
-			return;
-		}
+		// => recognized by correlation engine, see file_pattern
 
 		// **case 4: only create
-		if (is_create_only(info, group)) {
-			mSender.send(L"Create only", key);
-			erase_all(group, key);
-			model.next_available_item();
+		if (is_create_only(info)) {
+			report(out, event_kind::create_only, key, {}, info.since(path_action::added), info.mStamps, stillOpen);
+			erase_all(table, key, out);
+			table.next(path_action::added);
 			return;
 		}
 	}
 
-	void directory_watcher_mgr::checking_remove(watching_group& group)
+	void directory_watcher_mgr::checking_remove(size_t shard, event_batch& out)
 	{
-		auto& model = group.mFileName.get_remove();
-		auto const& info = model.front();
+		TRACE_SCOPE("checking_remove");
+		auto& table = mState->at(shard);
+		auto const info = table.front(path_action::removed);
 
 		//1. Invlid item => should jump to next one for next step
 		if (!info) {
-			model.next_available_item();
+			table.next(path_action::removed);
 			return;
 		}
 
 		// 2. Valid item but need delay
-		if (DELAY_PROCESS > info.alive()) {
+		if (!is_settled(table, info, path_action::removed)) {
 			return;
 		}
 
 		// get key
-		auto key = info.get_path_wstring();
+		auto const& key = info.mPath;
 
 		// **Goal of remove : should not exist in any groups
 
 		// case 1: should not exist in rename
 		// happen when create, save, save-as word
-		if (group.mFileName.exist_in_rename_any(key)) {
-			model.next_available_item();
+		if (info.has(path_action::renamed)) {
+			table.next(path_action::removed);
 			return;
 		}
 
 		// case 2: clear the temporary file
-		if (is_temporary_file(info, group)) {
-			erase_all(group, key);
-			model.next_available_item();
+		if (is_temporary_file(info)) {
+			erase_all(table, key, out);
+			table.next(path_action::removed);
 			return;
 		}
 
 		// Case 3: should not exist in add
 		// happen when edit image file
-		auto const& add = group.mFileName.get_add().find(key);
-		if (add) {
-			model.next_available_item();
+		if (info.has(path_action::added)) {
+			table.next(path_action::removed);
 			return;
 		}
 
-		// case 4: 'filename' should not exist in any 'add model' of other groups
+		// case 4: 'filename' should not exist in any 'add' of other folders
 		// happen when move file
 		// receive: add, delete (in the same disk)
 		// reveive: add, delete, modify (different disk)
-		for (auto& w : mWatchers) {
-			auto const& found = w->mFileName.get_add().find_if([&info](auto const& item) {
-				return info.get_file_name_wstring() == item.get_file_name_wstring()
-					&& info.get_parent_path_wstring() != item.get_parent_path_wstring();
-			});
-
+		auto const found = mState->find_by_name(path_action::added, info.get_file_name_wstring(), info.get_parent_path_wstring());
+		if (found) {
 			// this is not remove action
-			if (found) {
-				model.next_available_item();
-				return;
-			}
+			table.next(path_action::removed);
+			return;
 		}
 
 		// 100% only remove
-		mSender.send(L"Remove", key);
-		model.erase(key);
-		model.next_available_item();
+		report(out, event_kind::remove, key, {}, info.since(path_action::removed), info.mStamps);
+		table.erase(key, pending_bit(path_action::removed));
+		table.next(path_action::removed);
 	}
 
-	void directory_watcher_mgr::checking_modify(watching_group& group) 
+	void directory_watcher_mgr::checking_modify(size_t shard, event_batch& out) 
 	{
-		// get model
-		auto& model = group.mFileName.get_modify();
-		auto const& info = model.front();
+		TRACE_SCOPE("checking_modify");
+		auto& table = mState->at(shard);
+		auto const info = table.front(path_action::modified);
 
 		//1. Invlid item => should jump to next one for next step
 		if (!info) {
-			model.next_available_item();
+			table.next(path_action::modified);
 			return;
 		}
 
 		// 2. Valid item but need delay
-		if (DELAY_PROCESS > info.alive()) {
+		if (!is_settled(table, info, path_action::modified)) {
 			return;
 		}
 
 		// get key
-		auto key = info.get_path_wstring();
+		auto const& key = info.mPath;
 
-		// 3. file is processing => ignore this file, jump to next one
-		int error;
-		if (died::fileIsProcessing(key, error)) {
-			model.next_available_item();
+		// 3. file is still written => ignore this file, jump to next one.
+		// Still written after the longest wait (log, database) => report it anyway
+		bool stillOpen = !mStability.is_stable(key, info.last_time());
+		if (stillOpen && mMaxWait.mModify > info.waiting(path_action::modified)) {
+			table.next(path_action::modified);
 			return;
 		}
 
 		// **case 1: should not exist in rename
 		// happen when save, save-as word
-		if (group.mFileName.exist_in_rename_any(key)) {
+		if (info.has(path_action::renamed)) {
 			// will be processed in rename
-			model.next_available_item();
+			table.next(path_action::modified);
 			return;
 		}
 
 		// **case 2: not exist in add
-		auto const& add = group.mFileName.get_add().find(key);
-		if (add) {
-			model.next_available_item();
-			return;
-		}
-
 		// **case 3: not exist in remove
-		auto const& rmv = group.mFileName.get_remove().find(key);
-		if (rmv) {
-			model.next_available_item();
+		if (info.has(path_action::added) || info.has(path_action::removed)) {
+			table.next(path_action::modified);
 			return;
 		}
 
 		// 100% modify
-		mSender.send(L"Modify", key);
-		erase_all(group, key);
-		model.next_available_item();
-	}
-
-	void directory_watcher_mgr::checking_modify_without_modify_event(watching_group& group) 
-	{
-		// get model
-		auto& model = group.mFileName.get_add();
-
-		// pop item
-		auto const& info = model.front();
-
-		//1. Invlid item => should jump to next one for next step
-		if (!info) {
-			model.next_available_item();
-			return;
-		}
-
-		// 2. Valid item but need delay
-		if (DELAY_PROCESS > info.alive()) {
-			return;
-		}
-
-		// get key
-		auto key = info.get_path_wstring();
-
-		// 3. file is processing => ignore this file, jump to next one
-		int error;
-		if (died::fileIsProcessing(key, error)) {
-			model.next_available_item();
-			return;
-		}
-
-		// Make sure not exist in modify
-		auto const& modi = group.mFileName.get_modify().find(key);
-		if (modi) {
-			return;
-		}
-
-		// **case 1: should not exist in rename
-		// happen when save, save-as word
-		if (group.mFileName.exist_in_rename_any(key)) {
-			// will be processed in rename
-			model.next_available_item();
-			return;
-		}
-
-		// **case 2: temporary file
-		// happen when download big file by save-as
-		// will create -> remove -> waiting to rename
-		if (is_temporary_file(info, group)) {
-			// will be processed in remove
-			model.next_available_item();
-			return;
-		}
-
-		// **case 3: save-as .txt by notepad
-		if (is_save_as_txt(info, group)) {
-			// process in create
-			return;
-		}
-
-		// **case 4: only create
-		if (is_create_only(info, group)) {
-			// process in create
-			return;
-		}
-
-		// **case 5: modify
-		// Happen when edit image files
-		// receive: remove -> add
-		auto const& rmv = group.mFileName.get_remove().find(key);
-		if (!rmv) {
-			return;
-		}
-
-		std::chrono::duration<double> diff = info.get_created_time() - rmv.get_created_time();
-		if (diff.count() < 0) {
-			return;
-		}
-
-		// 100% for edit emage by mspaint
-		mSender.send(L"Modify without modify event", key);
-		erase_all(group, key);
-		// jump to next item for next step
-		model.next_available_item();
-	}
-
-	void directory_watcher_mgr::checking_copy(watching_group& group)
-	{
-		// get model
-		auto& model = group.mFileName.get_add();
-
-		// pop item
-		auto const& info = model.front();
-
-		//1. Invlid item => should jump to next one for next step
-		if (!info) {
-			model.next_available_item();
-			return;
-		}
-
-		// 2. Valid item but need delay
-		if (DELAY_PROCESS > info.alive()) {
-			return;
-		}
-
-		// get key
-		auto key = info.get_path_wstring();
-
-		// 3. file is processing => ignore this file, jump to next one
-		int error;
-		if (died::fileIsProcessing(key, error)) {
-			model.next_available_item();
-			return;
-		}
-
-		// **case 1: should not exist in rename
-		// happen when save, save-as word
- 		if (group.mFileName.exist_in_rename_any(key)) {
-			// will be processed in rename
-			model.next_available_item();
-			return;
-		}
-
-		// **case 2: temporary file
-		// happen when download big file by save-as
-		// will create -> remove -> waiting to rename
-		if (is_temporary_file(info, group)) {
-			// will be processed in remove
-			model.next_available_item();
-			return;
-		}
-
-		// **case 3: save-as .txt by notepad
-		if (is_save_as_txt(info, group)) {
-			// process in create
-			return;
-		}
-
-		// **case 4: only create
-		if (is_create_only(info, group)) {
-			// process in create
-			return;
-		}
-
-		// ** Goal copy: 
-		// exist in 'modify' 
-		// but NOT in 'remove', 'rename'
-		auto const& modi = group.mFileName.get_modify().find(key);
-		if (!modi) {
-			// Not action copy
-			// lets other function checking this item
-			return;
-		}
-
-		auto const& rmv = group.mFileName.get_remove().find(key);
-		if (rmv) {
-			// Not action copy
-			// lets other function checking this item
-			return;
-		}
-
-		// Not action copy => maybe move
-		for (auto& w : mWatchers) {
-			auto const& found = w->mFileName.get_remove().find_if([&info](auto const& item) {
-				return info.get_file_name_wstring() == item.get_file_name_wstring()
-					&& info.get_parent_path_wstring() != item.get_parent_path_wstring();
-			});
-
-			// this is not copy
-			// lets other function checking this item
-			if (found) {
-				return;
-			}
-		}
-
-		// 100% copy
-		mSender.send(L"Copy", key);
-		erase_all(group, key);
-		// jump to next item for next step
-		model.next_available_item();
+		report(out, event_kind::modify, key, {}, info.since(path_action::modified), info.mStamps, stillOpen);
+		erase_all(table, key, out);
+		table.next(path_action::modified);
 	}
 
-	void directory_watcher_mgr::checking_move(watching_group& group)
-	{
-		// get model
-		auto& model = group.mFileName.get_add();
-
-		// pop item
-		auto const& info = model.front();
-
-		//1. Invlid item => should jump to next one for next step
-		if (!info) {
-			model.next_available_item();
-			return;
-		}
-
-		// 2. Valid item but need delay
-		if (DELAY_PROCESS > info.alive()) {
-			return;
-		}
-
-		// get key
-		auto key = info.get_path_wstring();
-
-		// 3. file is processing => ignore this file, jump to next one
-		int error;
-		if (died::fileIsProcessing(key, error)) {
-			model.next_available_item();
-			return;
-		}
-
-		// **case 1: should not exist in rename
-		// happen when save, save-as word
-		if (group.mFileName.exist_in_rename_any(key)) {
-			// will be processed in rename
-			model.next_available_item();
-			return;
-		}
-
-		// **case 2: temporary file
-		// happen when download big file by save-as
-		// will create -> remove -> waiting to rename
-		if (is_temporary_file(info, group)) {
-			// will be process in remove
-			model.next_available_item();
-			return;
-		}
-
-		// **case 3: save-as .txt by notepad
-		if (is_save_as_txt(info, group)) {
-			// process in create
-			return;
-		}
-
-		// **case 4: only create
-		if (is_create_only(info, group)) {
-			// process in create
-			return;
-		}
-
-		// **Goal move
-		// exist in remove but other path
-		// NOT exist in rename
-
-		auto const& rmv = group.mFileName.get_remove().find(key);
-		if (rmv) {
-			// this is not MOVE
-			// lets other function checking this item
-			return;
-		}
-
-		// Should exist filename in other path
-		for (auto& w : mWatchers) {
-			auto const& found = w->mFileName.get_remove().find_if([&info](auto const& item) {
-				return info.get_file_name_wstring() == item.get_file_name_wstring()
-					&& info.get_parent_path_wstring() != item.get_parent_path_wstring();
-			});
-
-			// The parent path must differnt
-			// 100% MOVE
-			if (found) {
-				mSender.send(L"Move", found.get_path_wstring() + L", " + key);
-				erase_all(group, key);
-				w->mFileName.get_remove().erase(found.get_path_wstring());
-				model.next_available_item();
-				return;
-			}
-		}
-	}
-
-	bool directory_watcher_mgr::is_rename_only(rename_notify_info const& info, watching_group& group)
+	bool directory_watcher_mgr::is_rename_only(rename_link const& link, path_state const& oldName, path_state const& newName)
 	{
 		// oldName and newName should not exist in add
-		auto oldName = info.mOldName.get_path_wstring();
-		auto newName = info.mNewName.get_path_wstring();
-
-		auto const& addModel = group.mFileName.get_add();
-		if (addModel.find(oldName)) {
+		if (oldName.has(path_action::added)) {
 			return false;
 		}
 
-		if (addModel.find(newName)) {
+		if (newName.has(path_action::added)) {
 			return false;
 		}
 
 		// Make sure oldName, newName appears only 1 time
-		if (!group.mFileName.get_rename().is_only_one_family_info(info)) {
+		if (1u != rename_family(link, oldName, newName)) {
 			return false;
 		}
 
 		return true;
 	}
 
-	bool directory_watcher_mgr::is_rename_one_time(rename_notify_info const& info, watching_group& group)
+	bool directory_watcher_mgr::is_rename_one_time(rename_link const& link, path_state const& oldName, path_state const& newName)
 	{
 		// method
 		// step 1: oldName must exist in add
 		// step 2: newName must NOT exist in other 'oldname rename model'
 		// step 3: oldName must NOT exist in other 'newname rename model'
 
-		auto oldName = info.mOldName.get_path_wstring();
-		auto newName = info.mNewName.get_path_wstring();
-
-		auto const& addModel = group.mFileName.get_add();
-
 		// step 1
-		if (!addModel.find(oldName)) {
+		if (!oldName.has(path_action::added)) {
 			return false;
 		}
 
 		// step 2
 		// Make sure oldName, newName appears only 1 time
-		if (!group.mFileName.get_rename().is_only_one_family_info(info)) {
-			return false;
-		}
-
-		return true;
-	}
-
-	bool directory_watcher_mgr::is_rename_download_auto_save(
-		watching_group& group,
-		rename_notify_info const& before, 
-		rename_notify_info const& after)
-	{
-		// **behaviour
-		//step 1: create - D:\test\9be830ee-221a-4a6e-a369-c53ac5a76098.tmp
-		//step 2: modify - D:\test\9be830ee-221a-4a6e-a369-c53ac5a76098.tmp
-		//step 3: rename - D:\test\9be830ee-221a-4a6e-a369-c53ac5a76098.tmp => D:\test\1.jpg.crdownload
-		//step 4: modify - D:\test\1.jpg.crdownload
-		//step 5: rename - D:\test\1.jpg.crdownload => D:\test\1.jpg
-		//step 6: modify - D:\test\1.jpg
-		//step 7: modify - D:\test\1.jpg
-		bool sequenceRename = before.mNewName.get_path_wstring() == after.mOldName.get_path_wstring()
-						   && before.mOldName.get_path_wstring() != after.mNewName.get_path_wstring();
-
-		if (!sequenceRename) {
-			return false;
-		}
-		// newName must not exist in delete
-		auto const& rmv = group.mFileName.get_remove().find(after.mNewName.get_path_wstring());
-		if (rmv) {
-			std::chrono::duration<double> diff = after.mNewName.get_created_time() - rmv.get_created_time();
-			if (diff.count() < 0) {
-				return false;
-			}
-		}
-		return true;
-	}
-
-	bool directory_watcher_mgr::is_rename_word(
-		watching_group& group,
-		rename_notify_info const& before, 
-		rename_notify_info const& after)
-	{
-		//step 1: create - D:\test\8.docx
-		//step 2: remove - D:\test\8.docx
-		//step 3: create - D:\test\8.docx
-		//step 4: create - D:\test\~.tmp
-		//step 5: modify - D:\test\~.tmp
-		//step 6: create - D:\test\8.docx~RF1994986.TMP
-		//step 7: remove - D:\test\8.docx~RF1994986.TMP
-		//step 8: rename - D:\test\8.docx => D:\test\8.docx~RF1994986.TMP
-		//step 9: rename - D:\test\~.tmp => D:\test\8.docx
-		//step 10 remove - D:\test\8.docx~RF1994986.TMP
-		bool circleRename = before.mOldName.get_path_wstring() == after.mNewName.get_path_wstring()
-						 && before.mNewName.get_path_wstring() != after.mOldName.get_path_wstring();
-
-		if (!circleRename) {
+		if (1u != rename_family(link, oldName, newName)) {
 			return false;
 		}
 
-		// newName must not exist in delete
-		auto const& rmv = group.mFileName.get_remove().find(after.mNewName.get_path_wstring());
-		if (rmv) {
-			std::chrono::duration<double> diff = after.mNewName.get_created_time() - rmv.get_created_time();
-			if (diff.count() < 0) {
-				return false;
-			}
-		}
 		return true;
 	}
 
-	bool directory_watcher_mgr::is_temporary_file(file_notify_info const& info, watching_group& group)
+	bool directory_watcher_mgr::is_temporary_file(path_state const& info)
 	{
 		// happen when download big file by save-as
 		// will create -> remove -> waiting to rename
-		auto key = info.get_path_wstring();
-		auto const& rmv = group.mFileName.get_remove().find(key);
-		if (!rmv) {
+		if (!info.has(path_action::removed)) {
 			return false;
 		}
 
 		// Consider as temporary file when exist remove and add or modify
-		auto const& add = group.mFileName.get_add().find(key);
-		auto const& modi = group.mFileName.get_add().find(key);
+		bool add = info.has(path_action::added);
+		bool modi = info.has(path_action::modified);
 		if (!add && !modi) {
 			return false;
 		}
 
-		if (add) {
-			std::chrono::duration<double> diff = rmv.get_created_time() - add.get_created_time();
-			if (diff.count() < 0) {
-				return false;
-			}
+		auto rmv = info.time_of(path_action::removed);
+		if (add && rmv < info.time_of(path_action::added)) {
+			return false;
 		}
 
-		if (modi) {
-			std::chrono::duration<double> diff = rmv.get_created_time() - modi.get_created_time();
-			if (diff.count() < 0) {
-				return false;
-			}
+		if (modi && rmv < info.time_of(path_action::modified)) {
+			return false;
 		}
 		return true;
 	}
 
-	bool directory_watcher_mgr::is_save_as_txt(file_notify_info const& info, watching_group& group)
+	bool directory_watcher_mgr::is_create_only(path_state const& info)
 	{
-		auto key = info.get_path_wstring();
-		auto const& rmv = group.mFileName.get_remove().find(key);
-		if (!rmv) {
+		// **behaviour
+		// step 1. create 1.txt
+		// should not exist in others: remove, modify rename
+		if (info.has(path_action::removed) || info.has(path_action::modified)) {
 			return false;
 		}
 
-		std::chrono::duration<double> diff1 = info.get_created_time() - rmv.get_created_time();
-		if (diff1.count() < 0) {
-			return false;
-		}
+		// Make sure this is not move action: same file name removed from other path (in any shard)
+		// receive: add, delete (in the same disk)
+		// reveive: add, delete, modify (different disk)
+		return !mState->find_by_name(path_action::removed, info.get_file_name_wstring(), info.get_parent_path_wstring());
+	}
 
-		auto const& modi = group.mFileName.get_modify().find(key);
-		if (!modi) {
-			return false;
-		}
+	bool directory_watcher_mgr::is_settled(path_state_table& table, path_state const& info, path_action action)
+	{
+		auto const alive = info.alive(action);
+		auto const ownUnsettled = info.has_any(UNSETTLED_ACTIONS) ? 1 : 0;
 
-		std::chrono::duration<double> diff2 = modi.get_created_time() - info.get_created_time();
-		if (diff2.count() < 0) {
+		// a pending add that can still become the source of a rename => the full window
+		if (info.has(path_action::added) && DELAY_PROCESS > alive && SETTLE_PROCESS <= alive
+			&& may_be_renamed(table, info.mPath, info.last_time(), ownUnsettled)) {
 			return false;
 		}
-		return true;
+		return is_settled(table, info.mPath, alive, ownUnsettled);
 	}
 
-	bool directory_watcher_mgr::is_create_only(file_notify_info const& info, watching_group& group)
+	bool directory_watcher_mgr::is_settled(path_state_table& table, std::wstring const& path, size_t alive, size_t ownUnsettled) const
 	{
-		// **behaviour
-		// step 1. create 1.txt
-		// should not exist in others: remove, modify rename
-		auto key = info.get_path_wstring();
+		// 1. waited the full window
+		if (DELAY_PROCESS <= alive) {
+			return true;
+		}
 
-		auto const& rmv = group.mFileName.get_remove().find(key);
-		if (rmv) {
+		// 2. the rest of a burst may still arrive
+		if (SETTLE_PROCESS > alive) {
 			return false;
 		}
 
-		auto const& modi = group.mFileName.get_modify().find(key);
-		if (modi) {
+		// 3. complete before the window when nothing can change its meaning any more:
+		// no other remove/rename pending in the folder, no multi-event sequence in progress on it
+		auto parent = std::filesystem::path(path).parent_path().wstring();
+		if (table.unsettled_in(parent) > ownUnsettled) {
 			return false;
 		}
+		return !mEngine->involves(path);
+	}
 
-		// Make sure this is not move action
-		// this happen when move file
-		// receive: add, delete (in the same disk)
-		// reveive: add, delete, modify (different disk)
-		for (auto& w : mWatchers) {
-			auto const& found = w->mFileName.get_remove().find_if([&info](auto const& item) {
-				return info.get_file_name_wstring() == item.get_file_name_wstring()
-					&& info.get_parent_path_wstring() != item.get_parent_path_wstring();
-			});
-
-			// this is not creation, lets other function checking this item
-			if (found) {
-				return false;
-			}
+	bool directory_watcher_mgr::may_be_renamed(path_state_table& table, std::wstring const& path, path_state::time_point lastEvent, size_t ownUnsettled)
+	{
+		// A new file is complete before the window only on evidence: it has a final name,
+		// no remove/rename pending in its folder may pair with it and its writer is done
+		if (has_temporary_name(path)) {
+			return true;
 		}
 
-		return true;
+		auto parent = std::filesystem::path(path).parent_path().wstring();
+		if (table.unsettled_in(parent) > ownUnsettled) {
+			return true;
+		}
+		return !mStability.is_stable(path, lastEvent);
 	}
-}
+}
\ No newline at end of file
@@ -6,13 +6,33 @@
 #include "folder_name_watcher.h"
 #include "task_timer.h"
 #include "notify_to_server.h"
+#include "classified_event.h"
+#include "event_sender.h"
+#include "event_coalescer.h"
+#include "event_ring.h"
+#include "event_router.h"
+#include "event_store.h"
+#include "stability_tracker.h"
+#include "pipeline_latency.h"
+#include "metrics_export.h"
 
 namespace died
 {
+	// Longest wait on a file held open by another process, per event class, in milli-seconds.
+	// The event is then reported 'still open' and released.
+	struct max_wait
+	{
+		size_t mCreate{ 60000 };
+		size_t mModify{ 60000 };
+		size_t mRename{ 60000 };
+		size_t mPattern{ 60000 };
+	};
+
 	class directory_watcher_mgr : public died::TaskTimer
 	{
 		struct watching_group
 		{
+			std::wstring mDrive;
 			file_name_watcher mFileName;
 			attribute_watcher mAttr;
 			security_watcher mSecu;
@@ -20,47 +40,108 @@ namespace died
 		};
 
 	public:
-		explicit directory_watcher_mgr(unsigned long interval = 300ul);
+		// 'shards': path state and correlation split by parent folder, one worker each per timer round
+		explicit directory_watcher_mgr(unsigned long interval = 300ul, std::wstring ruleConfig = L"filter_rules.ini",
+			size_t shards = state_shards::default_count());
 		bool start(unsigned long notifyChange, bool subtree = true);
+		// Only 'folders' and what is under them, instead of every drive (benchmarks, tools)
+		bool start(unsigned long notifyChange, std::vector<std::wstring> const& folders, bool subtree = true);
 		void stop();
 
+		// Replay: groups of 'drives' without observer threads nor timer.
+		// feed() hands a file name event to the watcher of its drive, tick() runs one timer round.
+		// The busy probe never opens the files: they are reported idle.
+		bool start_manual(unsigned long notifyChange, std::vector<std::wstring> const& drives, bool subtree = true);
+		bool feed(file_notify_info info);
+		void tick();
+
+		// Any time. A speculative consumer also receives provisional events
+		void add_consumer(std::wstring name, bool speculative, notify_to_server::deliver_fn deliver);
+		// Before start(): typed events, no text is built for them. The sender is the first sink
+		void add_sink(std::shared_ptr<event_sink> sink);
+		// Any thread: typed events of some paths and kinds only, see event_router. 0 without sink
+		unsigned int subscribe(subscription sub);
+		bool unsubscribe(unsigned int id);
+		// Before start(): events also sent in frames to a local receiver, see event_sender.
+		// Kept in 'spoolDir' while the receiver is away, lost without
+		void set_event_pipe(std::wstring pipe, size_t capacity = 8192, std::wstring spoolDir = {});
+		// Before start(): events also published in a shared memory ring for local readers, see ring_reader
+		void set_event_ring(std::wstring name, size_t capacity = 4096);
+		// Before start(): raw events passing the rules kept in rotating segments of 'dir', see raw_journal.
+		// file_watcher_tools replay reads the directory
+		void set_raw_journal(std::wstring dir, size_t segmentBytes = raw_journal::SEGMENT_BYTES, size_t maxSegments = raw_journal::MAX_SEGMENTS);
+		// Before start(): repeated modify / attribute / security events of a path within 'window'
+		// reach the sinks once, with their count, see event_coalescer. Off by default
+		void set_coalescing(std::chrono::milliseconds window, size_t capacity = 4096);
+		// Before start(): the last 'maxEvents' classified events kept for queries, see event_store
+		void set_event_store(size_t maxEvents = event_store::MAX_EVENTS);
+		// Any thread: time, folder and kind queries of the kept events, null without set_event_store()
+		std::shared_ptr<event_store const> history() const;
+		void set_max_wait(max_wait limits);
+		speculation_stats speculation() const;
+
+		// Any thread: stage latencies per event class, also logged every minute
+		std::vector<latency_report> latency() const;
+
+		// Before start(): Prometheus text file rewritten every 'interval' milli-seconds, off the timer thread
+		void set_metrics_file(std::wstring path, size_t interval = 15000);
+		std::string metrics_text() const;
+
 	private:
 		TimerStatus onTimer() final;
-		void erase_all(watching_group& group, std::wstring const& key);
-		void erase_rename(watching_group& group, rename_notify_info const& info);
+		void create_groups(unsigned long notifyChange, std::vector<std::wstring> const& drives, bool subtree);
+		void checking_moves();
+		bool report_pattern(correlation_result const& result, event_batch& out);
+		classified_event& report(event_batch& out, event_kind kind, std::wstring path, std::wstring oldPath,
+			event_clock::time_point first, event_stamps const& stamps, bool stillOpen = false);
+		void publish(event_batch& batch);
+		void deliver_sinks(std::vector<classified_event> const& events);
+		bool sinks_saturated() const;
+		unsigned int group_of(std::wstring_view path) const;
+		void erase_all(path_state_table& table, std::wstring const& key, event_batch& out);
+		void erase_rename(path_state_table& table, rename_link const& link);
 
-		void checking_attribute(watching_group& group);
-		void checking_security(watching_group& group);
-		void checking_folder_remove(watching_group& group);
-		void checking_folder_move(watching_group& group);
-		void checking_rename(watching_group& group);
-		void checking_create(watching_group& group);
-		void checking_remove(watching_group& group);
-		void checking_modify(watching_group& group) ;
-		void checking_modify_without_modify_event(watching_group& group);
-		void checking_copy(watching_group& group);
-		void checking_move(watching_group& group);
+		void checking_folder_remove(watching_group& group, event_batch& out);
+		void checking_folder_move(watching_group& group, event_batch& out);
 
-	private:
-		bool is_rename_only(rename_notify_info const& info, watching_group& group);
-		bool is_rename_one_time(rename_notify_info const& info, watching_group& group);
-		
-		bool is_rename_download_auto_save(
-			watching_group& group,
-			rename_notify_info const& before, 
-			rename_notify_info const& after);
-		bool is_rename_word(
-			watching_group& group,
-			rename_notify_info const& before, 
-			rename_notify_info const& after);
+		// file events, one worker per shard, one batch per worker
+		void checking_shard(size_t shard);
+		void checking_attribute(size_t shard, event_batch& out);
+		void checking_security(size_t shard, event_batch& out);
+		void checking_rename(size_t shard, event_batch& out);
+		void checking_create(size_t shard, event_batch& out);
+		void checking_remove(size_t shard, event_batch& out);
+		void checking_modify(size_t shard, event_batch& out);
 
-		bool is_temporary_file(file_notify_info const& info, watching_group& group);
-		bool is_save_as_txt(file_notify_info const& info, watching_group& group);
-		bool is_create_only(file_notify_info const& info, watching_group& group);
+	private:
+		bool is_rename_only(rename_link const& link, path_state const& oldName, path_state const& newName);
+		bool is_rename_one_time(rename_link const& link, path_state const& oldName, path_state const& newName);
+		bool is_temporary_file(path_state const& info);
+		bool is_create_only(path_state const& info);
+		bool is_settled(path_state_table& table, path_state const& info, path_action action);
+		bool is_settled(path_state_table& table, std::wstring const& path, size_t alive, size_t ownUnsettled) const;
+		bool may_be_renamed(path_state_table& table, std::wstring const& path, path_state::time_point lastEvent, size_t ownUnsettled);
 
 	private:
 		std::vector<std::unique_ptr<watching_group>> mWatchers;
-		std::shared_ptr<fat::UnnecessaryDirectory> mRule; //++ TODO
-		notify_to_server mSender;
+		std::shared_ptr<filter_rules> mRule;
+		std::shared_ptr<correlation_shards> mEngine;
+		std::shared_ptr<state_shards> mState;
+		busy_probe mProbe;
+		stability_tracker mStability;
+		std::shared_ptr<notify_to_server> mSender;
+		std::shared_ptr<event_router> mRouter;
+		std::vector<std::shared_ptr<event_sink>> mSinks;	// mSender first, mRouter
+		std::mutex mSinkSync;		// one batch at a time, shard workers publish concurrently
+		std::shared_ptr<event_sender> mPipe;
+		std::shared_ptr<event_ring> mRing;
+		std::shared_ptr<raw_journal> mRawJournal;
+		std::shared_ptr<event_store> mStore;
+		std::shared_ptr<event_coalescer> mCoalescer;	// before the sinks when set, under mSinkSync
+		std::atomic<unsigned long long> mHeldTicks{};	// timer rounds without classification, a sink was saturated
+		max_wait mMaxWait;
+		pipeline_latency mLatency;
+		std::shared_ptr<pipeline_metrics> mMetrics;
+		metrics_export mExport;		// last: its thread reads the members above
 	};
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "event_clock.h"
+
+namespace died
+{
+	std::atomic<bool> event_clock::sVirtual{ false };
+	std::atomic<long long> event_clock::sNow{ 0 };
+
+	event_clock::time_point event_clock::now() noexcept
+	{
+		if (!sVirtual.load(std::memory_order_relaxed)) {
+			return std::chrono::steady_clock::now();
+		}
+		return time_point{ std::chrono::steady_clock::duration{ sNow.load(std::memory_order_acquire) } };
+	}
+
+	void event_clock::set_virtual(time_point start) noexcept
+	{
+		sNow.store(start.time_since_epoch().count(), std::memory_order_release);
+		sVirtual.store(true, std::memory_order_release);
+	}
+
+	void event_clock::advance_to(time_point time) noexcept
+	{
+		auto ticks = time.time_since_epoch().count();
+		auto cur = sNow.load(std::memory_order_relaxed);
+		while (cur < ticks && !sNow.compare_exchange_weak(cur, ticks, std::memory_order_acq_rel)) {
+		}
+	}
+
+	void event_clock::set_real() noexcept
+	{
+		sVirtual.store(false, std::memory_order_release);
+	}
+
+	bool event_clock::is_virtual() noexcept
+	{
+		return sVirtual.load(std::memory_order_relaxed);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+namespace died
+{
+	// Time source of the event pipeline.
+	// steady_clock, unless a virtual clock is installed: the replay tool drives the
+	// pipeline from recorded timestamps, at full speed and without real waits.
+	class event_clock
+	{
+	public:
+		using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+		static time_point now() noexcept;
+
+		// Replay only, before the pipeline runs
+		static void set_virtual(time_point start) noexcept;
+		static void advance_to(time_point time) noexcept;		// never goes back
+		static void set_real() noexcept;
+		static bool is_virtual() noexcept;
+
+	private:
+		static std::atomic<bool> sVirtual;
+		static std::atomic<long long> sNow;		// ticks of steady_clock::duration
+	};
+
+	// Stages of an event before it waits in the models
+	enum class event_stage : size_t
+	{
+		read,		// ReadDirectoryChangesW completed
+		parse,		// file_notify_info built
+		filter,		// passed the rules
+		insert		// stored in a model / the correlation engine
+	};
+	constexpr size_t EVENT_STAGE_COUNT = 4;
+
+	using event_stamps = std::array<event_clock::time_point, EVENT_STAGE_COUNT>;
+}
\ No newline at end of file
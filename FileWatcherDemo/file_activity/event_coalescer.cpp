@@ -0,0 +1,172 @@
+#include "event_coalescer.h"
+#include <algorithm>
+#include <cwctype>
+
+namespace died
+{
+	namespace
+	{
+		// kind then the folded path, like event_router and event_store
+		void key_of(event_kind kind, std::wstring_view path, std::wstring& key)
+		{
+			key.assign(1, static_cast<wchar_t>(L'0' + static_cast<int>(kind)));
+			for (auto el : path) {
+				key.push_back(static_cast<wchar_t>(std::towlower(el)));
+			}
+		}
+	}
+
+	event_coalescer::event_coalescer(forward_fn forward, std::chrono::milliseconds window, size_t capacity) :
+		mForward{ std::move(forward) },
+		mWindow{ window },
+		mCapacity{ std::max<size_t>(capacity, 1) }
+	{
+		mHeld.reserve(mCapacity);
+	}
+
+	bool event_coalescer::coalesced(event_kind kind) noexcept
+	{
+		return event_kind::modify == kind || event_kind::attribute == kind || event_kind::security == kind;
+	}
+
+	void event_coalescer::deliver(std::vector<classified_event> const& events)
+	{
+		release_due(event_clock::now());
+		for (auto const& ev : events) {
+			if (!coalesced(ev.mKind)) {
+				// 1. the held events of its paths go first
+				for (auto path : { ev.mPath, ev.mOldPath, ev.mAuxPath }) {
+					if (!path.empty()) {
+						release_path(path);
+					}
+				}
+				mOut.add(ev);
+				continue;
+			}
+
+			// 2. same kind on the same path in the window => one event
+			key_of(ev.mKind, ev.mPath, mKey);
+			auto found = mHeld.find(mKey);
+			if (std::end(mHeld) != found) {
+				auto& held = found->second.mEvent;
+				held.mCount += ev.mCount;
+				held.mLast = std::max(held.mLast, ev.mLast);
+				held.mClassified = ev.mClassified;
+				held.mStamps = ev.mStamps;
+				held.mStillOpen = ev.mStillOpen;
+				mMerged.fetch_add(ev.mCount, std::memory_order_relaxed);
+				continue;
+			}
+
+			// 3. first of its window
+			if (mHeld.size() >= mCapacity) {
+				release_oldest();
+			}
+			hold(ev);
+		}
+		forward();
+	}
+
+	void event_coalescer::flush(event_clock::time_point now)
+	{
+		release_due(now);
+		forward();
+	}
+
+	void event_coalescer::release_paths(std::vector<std::wstring> const& paths)
+	{
+		for (auto const& el : paths) {
+			release_path(el);
+		}
+		forward();
+	}
+
+	unsigned long long event_coalescer::merged() const noexcept
+	{
+		return mMerged.load(std::memory_order_relaxed);
+	}
+
+	size_t event_coalescer::held() const noexcept
+	{
+		return mHeldCount.load(std::memory_order_relaxed);
+	}
+
+	void event_coalescer::release_due(event_clock::time_point now)
+	{
+		while (!mOrder.empty()) {
+			auto found = mHeld.find(mOrder.front().second);
+			if (std::end(mHeld) == found || found->second.mId != mOrder.front().first) {
+				mOrder.pop_front();		// released early
+				continue;
+			}
+			if (now < found->second.mDue) {
+				break;
+			}
+			mOrder.pop_front();
+			release(found);
+		}
+	}
+
+	void event_coalescer::release_oldest()
+	{
+		while (!mOrder.empty()) {
+			auto order = std::move(mOrder.front());
+			mOrder.pop_front();
+			auto found = mHeld.find(order.second);
+			if (std::end(mHeld) != found && found->second.mId == order.first) {
+				release(found);
+				return;
+			}
+		}
+	}
+
+	void event_coalescer::release_path(std::wstring_view path)
+	{
+		for (auto kind : { event_kind::modify, event_kind::attribute, event_kind::security }) {
+			key_of(kind, path, mKey);
+			auto found = mHeld.find(mKey);
+			if (std::end(mHeld) != found) {
+				release(found);
+			}
+		}
+	}
+
+	void event_coalescer::release(std::unordered_map<std::wstring, held_event>::iterator it)
+	{
+		mOut.add(it->second.mEvent);
+		mHeld.erase(it);
+		mHeldCount.store(mHeld.size(), std::memory_order_relaxed);
+	}
+
+	void event_coalescer::hold(classified_event const& ev)
+	{
+		key_of(ev.mKind, ev.mPath, mKey);
+		auto it = mHeld.try_emplace(mKey).first;
+		auto& held = it->second;
+		held.mPath.assign(ev.mPath);
+		held.mEvent = ev;
+		held.mEvent.mPath = held.mPath;
+		held.mEvent.mOldPath = {};
+		held.mEvent.mAuxPath = {};
+		held.mDue = ev.mClassified + mWindow;
+		held.mId = ++mNextId;
+		mOrder.emplace_back(held.mId, mKey);
+		mHeldCount.store(mHeld.size(), std::memory_order_relaxed);
+
+		// released early events leave their order behind, dropped once it doubled the table
+		if (mOrder.size() > 2 * mCapacity) {
+			mOrder.erase(std::remove_if(std::begin(mOrder), std::end(mOrder), [this](auto const& el) {
+				auto found = mHeld.find(el.second);
+				return std::end(mHeld) == found || found->second.mId != el.first;
+			}), std::end(mOrder));
+		}
+	}
+
+	void event_coalescer::forward()
+	{
+		if (!mOut.events().empty()) {
+			mForward(mOut.events());
+		}
+		mOut.clear();
+	}
+}
\ No newline at end of file
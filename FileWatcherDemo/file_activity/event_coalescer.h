@@ -0,0 +1,69 @@
+#pragma once
+
+#include "classified_event.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace died
+{
+	// Merges the repeated events of a path before the sinks (editor autosave, build output).
+	// A modify, attribute or security event is held for 'window'; the same kind on the same path
+	// meanwhile is folded into it: mCount + 1, mLast moved on. The held event goes on when its window closes.
+	// Any other event of a path first releases the held events of its paths, so a path keeps its order.
+	// Paths are compared case insensitive, a held event keeps the case of its first one.
+	// At most 'capacity' held events, a full table releases its oldest one early.
+	// Called under the lock of the sinks, like any event_sink.
+	class event_coalescer final : public event_sink
+	{
+	public:
+		using forward_fn = std::function<void(std::vector<classified_event> const&)>;
+
+		event_coalescer(forward_fn forward, std::chrono::milliseconds window, size_t capacity = 4096);
+
+		void deliver(std::vector<classified_event> const& events) final;
+		void flush(event_clock::time_point now) final;
+
+		// The held events of 'paths' go on now, e.g. before their guesses are settled
+		void release_paths(std::vector<std::wstring> const& paths);
+
+		static bool coalesced(event_kind kind) noexcept;
+
+		unsigned long long merged() const noexcept;		// events folded into a held one
+		size_t held() const noexcept;
+
+	private:
+		struct held_event
+		{
+			std::wstring mPath;			// as first seen
+			classified_event mEvent;	// mPath views mPath
+			event_clock::time_point mDue;	// its window closes, merged events do not extend it
+			unsigned long long mId{};
+		};
+
+		void release_due(event_clock::time_point now);
+		void release_oldest();
+		void release_path(std::wstring_view path);
+		void release(std::unordered_map<std::wstring, held_event>::iterator it);
+		void hold(classified_event const& ev);
+		void forward();
+
+	private:
+		forward_fn mForward;
+		std::chrono::milliseconds mWindow;
+		size_t mCapacity;
+
+		std::unordered_map<std::wstring, held_event> mHeld;		// key: kind then path
+		std::deque<std::pair<unsigned long long, std::wstring>> mOrder;		// id and key, oldest first, stale once released
+		unsigned long long mNextId{};
+		std::wstring mKey;			// lookup buffer
+		event_batch mOut;
+
+		std::atomic<unsigned long long> mMerged{};
+		std::atomic<size_t> mHeldCount{};
+	};
+}
\ No newline at end of file
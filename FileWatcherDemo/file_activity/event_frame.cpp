@@ -0,0 +1,116 @@
+#include "event_frame.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace died
+{
+	namespace
+	{
+		uint16_t length_of(std::wstring_view text) noexcept
+		{
+			return static_cast<uint16_t>(std::min<size_t>(text.size(), std::numeric_limits<uint16_t>::max()));
+		}
+
+		void append_text(std::vector<uint8_t>& out, std::wstring_view text, uint16_t count)
+		{
+			auto at = out.size();
+			out.resize(at + count * sizeof(uint16_t));
+			for (size_t i = 0; i < count; ++i) {
+				auto unit = static_cast<uint16_t>(text[i]);
+				std::memcpy(out.data() + at + i * sizeof(uint16_t), &unit, sizeof(unit));
+			}
+		}
+
+		std::wstring read_text(uint8_t const*& at, uint16_t count)
+		{
+			std::wstring result(count, L'\0');
+			for (size_t i = 0; i < count; ++i) {
+				uint16_t unit;
+				std::memcpy(&unit, at + i * sizeof(uint16_t), sizeof(unit));
+				result[i] = static_cast<wchar_t>(unit);
+			}
+			at += count * sizeof(uint16_t);
+			return result;
+		}
+	}
+
+	int64_t wall_of(event_clock::time_point time, int64_t wallNow, event_clock::time_point clockNow) noexcept
+	{
+		if (event_clock::time_point{} == time) {
+			return 0;
+		}
+		return wallNow - std::chrono::duration_cast<std::chrono::duration<int64_t, std::ratio<1, 10000000>>>(clockNow - time).count();
+	}
+
+	void encode_event(classified_event const& ev, int64_t wallNow, event_clock::time_point clockNow, std::vector<uint8_t>& out)
+	{
+		std::wstring_view name = event_kind::pattern == ev.mKind && ev.mName ? std::wstring_view{ *ev.mName } : std::wstring_view{};
+
+		frame_record record{};
+		record.mFirst = wall_of(ev.mFirst, wallNow, clockNow);
+		record.mLast = wall_of(ev.mLast, wallNow, clockNow);
+		record.mClassified = wall_of(ev.mClassified, wallNow, clockNow);
+		record.mSource = ev.mSource;
+		record.mCount = ev.mCount;
+		record.mKind = static_cast<uint8_t>(ev.mKind);
+		record.mFlags = ev.mStillOpen ? frame_record::STILL_OPEN : 0;
+		record.mName = length_of(name);
+		record.mPath = length_of(ev.mPath);
+		record.mOldPath = length_of(ev.mOldPath);
+		record.mAuxPath = length_of(ev.mAuxPath);
+
+		auto at = out.size();
+		out.resize(at + sizeof(record));
+		std::memcpy(out.data() + at, &record, sizeof(record));
+		append_text(out, name, record.mName);
+		append_text(out, ev.mPath, record.mPath);
+		append_text(out, ev.mOldPath, record.mOldPath);
+		append_text(out, ev.mAuxPath, record.mAuxPath);
+	}
+
+	bool decode_frame(frame_header const& header, uint8_t const* data, std::vector<received_event>& out)
+	{
+		auto at = data;
+		auto end = data + header.mBytes;
+		for (uint16_t i = 0; i < header.mCount; ++i) {
+			frame_record record;
+			if (static_cast<size_t>(end - at) < sizeof(record)) {
+				return false;
+			}
+			std::memcpy(&record, at, sizeof(record));
+			at += sizeof(record);
+
+			size_t text = (static_cast<size_t>(record.mName) + record.mPath + record.mOldPath + record.mAuxPath) * sizeof(uint16_t);
+			if (static_cast<size_t>(end - at) < text || EVENT_KIND_COUNT <= record.mKind) {
+				return false;
+			}
+
+			received_event ev;
+			ev.mKind = static_cast<event_kind>(record.mKind);
+			ev.mName = read_text(at, record.mName);
+			if (ev.mName.empty()) {
+				ev.mName = name_of(ev.mKind);
+			}
+			ev.mPath = read_text(at, record.mPath);
+			ev.mOldPath = read_text(at, record.mOldPath);
+			ev.mAuxPath = read_text(at, record.mAuxPath);
+			ev.mFirst = record.mFirst;
+			ev.mLast = record.mLast;
+			ev.mClassified = record.mClassified;
+			ev.mSource = record.mSource;
+			ev.mCount = record.mCount;
+			ev.mStillOpen = 0 != (record.mFlags & frame_record::STILL_OPEN);
+			out.push_back(std::move(ev));
+		}
+		return at == end;
+	}
+
+	int64_t wall_now() noexcept
+	{
+		FILETIME wall{};
+		::GetSystemTimeAsFileTime(&wall);
+		return static_cast<int64_t>((static_cast<uint64_t>(wall.dwHighDateTime) << 32) | wall.dwLowDateTime);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "classified_event.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace died
+{
+	// Little-endian stream on the event pipe: frame_header then mBytes of records, again and again.
+	// A record is frame_record then UTF-16 name, path, old path, aux path of the given lengths.
+	struct frame_header
+	{
+		static constexpr uint32_t MAGIC = 0x31465746;	// "FWF1"
+		static constexpr uint16_t VERSION = 2;		// 2: count and last time of coalesced events
+		static constexpr uint32_t MAX_BYTES = 1 << 20;	// a receiver refuses a larger frame
+
+		uint32_t mMagic{ MAGIC };
+		uint16_t mVersion{ VERSION };
+		uint16_t mCount{};			// records
+		uint32_t mBytes{};			// records size
+		uint32_t mReserved{};
+		uint64_t mFirstSeq{};		// sequence of the first record, the receiver sees gaps
+	};
+	static_assert(sizeof(frame_header) == 24, "frame_header layout");
+
+	struct frame_record
+	{
+		static constexpr uint8_t STILL_OPEN = 1;
+
+		int64_t mFirst;			// FILETIME, first raw event of the operation
+		int64_t mLast;			// FILETIME, last raw event
+		int64_t mClassified;	// FILETIME
+		uint32_t mSource;
+		uint32_t mCount;		// merged events, 1 unless coalesced
+		uint8_t mKind;			// event_kind
+		uint8_t mFlags;
+		uint16_t mName;			// pattern name, empty for the other kinds
+		uint16_t mPath;
+		uint16_t mOldPath;
+		uint16_t mAuxPath;
+		uint16_t mReserved[3];
+	};
+	static_assert(sizeof(frame_record) == 48, "frame_record layout");
+
+	// A record read back by a receiver
+	struct received_event
+	{
+		event_kind mKind{};
+		std::wstring mName;			// name_of(mKind) unless a pattern
+		std::wstring mPath;
+		std::wstring mOldPath;
+		std::wstring mAuxPath;
+		int64_t mFirst{};
+		int64_t mLast{};
+		int64_t mClassified{};
+		unsigned int mSource{};
+		unsigned int mCount{ 1 };
+		bool mStillOpen{};
+	};
+
+	// Appends one record to 'out'. 'wallNow' and 'clockNow' are taken once per batch,
+	// event_clock times become FILETIME through them. A path is cut to 65535 UTF-16 units.
+	void encode_event(classified_event const& ev, int64_t wallNow, event_clock::time_point clockNow, std::vector<uint8_t>& out);
+
+	// The records of one frame, false on a malformed frame
+	bool decode_frame(frame_header const& header, uint8_t const* data, std::vector<received_event>& out);
+
+	// FILETIME of now, 100ns since 1601
+	int64_t wall_now() noexcept;
+
+	// FILETIME of an event_clock time through 'wallNow' and 'clockNow', 0 for an unset time
+	int64_t wall_of(event_clock::time_point time, int64_t wallNow, event_clock::time_point clockNow) noexcept;
+}
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "event_journal.h"
+#include "event_clock.h"
+#include "mpsc_queue.h"
+#include "std_filesystem.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace died
+{
+	namespace
+	{
+		constexpr size_t WRITE_CHUNK = 256;		// records per file write
+		constexpr auto WRITE_INTERVAL = std::chrono::milliseconds(20);
+
+		struct journal_state
+		{
+			std::mutex mSync;		// start / stop
+			std::unique_ptr<mpsc_queue<journal_record>> mQueue;
+
+			std::atomic<unsigned long long> mWritten{};
+			std::atomic<unsigned long long> mDropped{};
+
+			std::ofstream mFile;
+			std::thread mWriter;
+			std::atomic<bool> mStop{};
+		};
+
+		journal_state& state()
+		{
+			// never destroyed: a watcher thread may still write during static destruction
+			static auto* sState = new journal_state;
+			return *sState;
+		}
+
+		// tail of a text which does not fit
+		size_t copy_text(uint16_t* to, std::wstring_view text, size_t room, uint8_t& flags) noexcept
+		{
+			auto count = std::min(text.size(), room);
+			if (count < text.size()) {
+				flags |= journal_record::TRUNCATED;
+			}
+			auto from = text.data() + (text.size() - count);
+			for (size_t i = 0; i < count; ++i) {
+				to[i] = static_cast<uint16_t>(from[i]);
+			}
+			return count;
+		}
+
+		void write_loop(journal_state& st)
+		{
+			std::vector<journal_record> chunk;
+			chunk.reserve(WRITE_CHUNK);
+			auto take = [&chunk](journal_record const& record) { chunk.push_back(record); };
+			auto reported = st.mDropped.load(std::memory_order_relaxed);
+
+			for (;;) {
+				auto stopping = st.mStop.load(std::memory_order_acquire);
+
+				// 1. everything queued so far
+				for (;;) {
+					chunk.clear();
+					while (chunk.size() < WRITE_CHUNK && st.mQueue->pop(take)) {
+					}
+					if (chunk.empty()) {
+						break;
+					}
+					st.mFile.write(reinterpret_cast<char const*>(chunk.data()), chunk.size() * sizeof(journal_record));
+					st.mWritten.fetch_add(chunk.size(), std::memory_order_relaxed);
+				}
+
+				// 2. the decoder shows where records are missing
+				auto dropped = st.mDropped.load(std::memory_order_relaxed);
+				if (dropped != reported) {
+					reported = dropped;
+					journal_record lost{};
+					lost.mTime = event_clock::now().time_since_epoch().count();
+					lost.mValue = dropped;
+					lost.mThread = ::GetCurrentThreadId();
+					lost.mCode = static_cast<uint16_t>(journal_code::dropped);
+					lost.mLevel = static_cast<uint8_t>(journal_level::info);
+					st.mFile.write(reinterpret_cast<char const*>(&lost), sizeof(lost));
+				}
+				st.mFile.flush();
+
+				if (stopping) {
+					return;
+				}
+				std::this_thread::sleep_for(WRITE_INTERVAL);
+			}
+		}
+	}
+
+	std::atomic<bool> event_journal::sEnabled{ false };
+
+	bool event_journal::start(std::wstring const& path, size_t capacity)
+	{
+		auto& st = state();
+		std::lock_guard<std::mutex> lk(st.mSync);
+		if (st.mWriter.joinable()) {
+			return false;
+		}
+
+		// 1. queue, once: a late writer may still use it after stop()
+		if (!st.mQueue) {
+			st.mQueue = std::make_unique<mpsc_queue<journal_record>>(capacity);
+			static bool sAtExit = (std::atexit(&event_journal::stop), true);
+			(void)sAtExit;
+		}
+
+		// 2. header
+		st.mFile.open(std::filesystem::path(path), std::ios::binary | std::ios::trunc);
+		if (!st.mFile.is_open()) {
+			return false;
+		}
+		FILETIME wall{};
+		::GetSystemTimeAsFileTime(&wall);
+		journal_header header;
+		header.mRecordSize = sizeof(journal_record);
+		header.mClockOrigin = event_clock::now().time_since_epoch().count();
+		header.mWallOrigin = static_cast<int64_t>((static_cast<uint64_t>(wall.dwHighDateTime) << 32) | wall.dwLowDateTime);
+		header.mTickNum = event_clock::time_point::period::num;
+		header.mTickDen = event_clock::time_point::period::den;
+		st.mFile.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+		st.mStop.store(false, std::memory_order_relaxed);
+		st.mWriter = std::thread(write_loop, std::ref(st));
+		sEnabled.store(true, std::memory_order_release);
+		return true;
+	}
+
+	void event_journal::stop()
+	{
+		auto& st = state();
+		std::lock_guard<std::mutex> lk(st.mSync);
+		sEnabled.store(false, std::memory_order_release);
+		if (!st.mWriter.joinable()) {
+			return;
+		}
+		st.mStop.store(true, std::memory_order_release);
+		st.mWriter.join();
+		st.mFile.close();
+	}
+
+	void event_journal::write(journal_level level, journal_code code, uint64_t value, std::wstring_view first, std::wstring_view second, std::wstring_view third) noexcept
+	{
+		// acquire: the queue is published by start()
+		if (!sEnabled.load(std::memory_order_acquire)) {
+			return;
+		}
+		auto& st = state();
+
+		// the paths get the room the first text leaves
+		auto fill = [&](journal_record& record) noexcept {
+			record.mTime = event_clock::now().time_since_epoch().count();
+			record.mValue = value;
+			record.mThread = ::GetCurrentThreadId();
+			record.mCode = static_cast<uint16_t>(code);
+			record.mLevel = static_cast<uint8_t>(level);
+			record.mFlags = 0;
+			record.mReserved = 0;
+			auto firstRoom = second.empty() ? journal_record::TEXT : journal_record::FIRST_MAX;
+			record.mFirst = static_cast<uint16_t>(copy_text(record.mText, first, firstRoom, record.mFlags));
+			auto room = journal_record::TEXT - record.mFirst;
+			auto thirdRoom = third.empty() ? 0 : std::min(third.size(), room / 2);
+			record.mSecond = static_cast<uint16_t>(copy_text(record.mText + record.mFirst, second, room - thirdRoom, record.mFlags));
+			record.mThird = static_cast<uint16_t>(copy_text(record.mText + record.mFirst + record.mSecond, third, room - record.mSecond, record.mFlags));
+		};
+
+		// drop when the writer is behind
+		if (!st.mQueue->push(fill)) {
+			st.mDropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	unsigned long long event_journal::written() noexcept
+	{
+		return state().mWritten.load(std::memory_order_relaxed);
+	}
+
+	unsigned long long event_journal::dropped() noexcept
+	{
+		return state().mDropped.load(std::memory_order_relaxed);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Levels removed at compile time, like SPDLOG_ACTIVE_LEVEL
+#define JOURNAL_LEVEL_DEBUG	0
+#define JOURNAL_LEVEL_INFO	1
+#define JOURNAL_LEVEL_OFF	2
+
+#ifndef JOURNAL_ACTIVE_LEVEL
+#ifdef _DEBUG
+#define JOURNAL_ACTIVE_LEVEL JOURNAL_LEVEL_DEBUG
+#else
+#define JOURNAL_ACTIVE_LEVEL JOURNAL_LEVEL_INFO
+#endif
+#endif
+
+namespace died
+{
+	enum class journal_level : uint8_t { debug = JOURNAL_LEVEL_DEBUG, info = JOURNAL_LEVEL_INFO };
+
+	// What a record is, the decoder formats it (file_watcher_tools journal)
+	enum class journal_code : uint16_t
+	{
+		file_name,			// value: action, first: path
+		attribute,
+		attribute_ignored,
+		security,
+		security_ignored,
+		folder_name,
+		provisional,		// value: seq, first: action, second: subject
+		sent,				// value: 1 still open, first: action, second: path, third: old / other path
+		retracted,			// value: seq, first: action, second: subject
+		dropped,			// value: records dropped so far, written by the journal itself
+		erased,				// first: path, its pending changes processed
+		rename_erased		// first: old name, second: new name
+	};
+
+	// Little-endian file: journal_header then journal_record until the end
+	struct journal_header
+	{
+		static constexpr uint32_t MAGIC = 0x314a5746;	// "FWJ1"
+		static constexpr uint32_t VERSION = 1;
+
+		uint32_t mMagic{ MAGIC };
+		uint32_t mVersion{ VERSION };
+		uint32_t mRecordSize{};
+		uint32_t mReserved{};
+		int64_t mClockOrigin{};		// event_clock ticks when opened
+		int64_t mWallOrigin{};		// FILETIME when opened, 100ns since 1601
+		int64_t mTickNum{};			// tick = mTickNum / mTickDen seconds
+		int64_t mTickDen{};
+	};
+	static_assert(sizeof(journal_header) == 48, "journal_header layout");
+
+	struct journal_record
+	{
+		static constexpr size_t TEXT = 240;			// UTF-16 units of first + second + third
+		static constexpr size_t FIRST_MAX = 64;		// a longer first text leaves the room to the path
+		static constexpr uint8_t TRUNCATED = 1;		// the head of a text was cut, its tail kept
+
+		int64_t mTime;			// event_clock ticks
+		uint64_t mValue;
+		uint32_t mThread;
+		uint16_t mCode;
+		uint8_t mLevel;
+		uint8_t mFlags;
+		uint16_t mFirst;		// length of first, second then third follow it
+		uint16_t mSecond;
+		uint16_t mThird;
+		uint16_t mReserved;
+		uint16_t mText[TEXT];
+	};
+	static_assert(sizeof(journal_record) == 512, "journal_record layout");
+
+	// Binary journal of the per-event logs.
+	// A record is copied into a bounded lock-free queue, nothing is formatted on the calling thread;
+	// a full queue drops the record and counts it, never blocks an I/O completion.
+	// One writer thread appends the queue to the file.
+	class event_journal
+	{
+	public:
+		static bool start(std::wstring const& path, size_t capacity = 4096);	// records in the queue
+		static void stop();		// drains the queue, also at exit
+
+		static bool enabled() noexcept
+		{
+			return sEnabled.load(std::memory_order_relaxed);
+		}
+
+		static void write(journal_level level, journal_code code, uint64_t value, std::wstring_view first, std::wstring_view second = {}, std::wstring_view third = {}) noexcept;
+
+		static unsigned long long written() noexcept;
+		static unsigned long long dropped() noexcept;
+
+	private:
+		static std::atomic<bool> sEnabled;
+	};
+}
+
+#define JOURNAL_WRITE_(level, code, value, ...) \
+	do { if (died::event_journal::enabled()) died::event_journal::write(died::journal_level::level, died::journal_code::code, value, __VA_ARGS__); } while (0)
+
+#if JOURNAL_ACTIVE_LEVEL <= JOURNAL_LEVEL_DEBUG
+#define JOURNAL_DEBUG(code, value, ...)	JOURNAL_WRITE_(debug, code, value, __VA_ARGS__)
+#else
+#define JOURNAL_DEBUG(code, value, ...)	(void)0
+#endif
+
+#if JOURNAL_ACTIVE_LEVEL <= JOURNAL_LEVEL_INFO
+#define JOURNAL_INFO(code, value, ...)	JOURNAL_WRITE_(info, code, value, __VA_ARGS__)
+#else
+#define JOURNAL_INFO(code, value, ...)	(void)0
+#endif
\ No newline at end of file
@@ -0,0 +1,18 @@
+#include "event_probes.h"
+#include <mutex>
+
+// {6e40738b-b01b-5ea1-d981-889bb06c0b14}
+TRACELOGGING_DEFINE_PROVIDER(gFileWatcherProvider, "FileWatcher-Pipeline",
+	(0x6e40738b, 0xb01b, 0x5ea1, 0xd9, 0x81, 0x88, 0x9b, 0xb0, 0x6c, 0x0b, 0x14));
+
+namespace died
+{
+	void register_probes() noexcept
+	{
+		// not unregistered: ETW cleans up at process exit, a late probe stays harmless
+		static std::once_flag sOnce;
+		std::call_once(sOnce, [] {
+			TraceLoggingRegister(gFileWatcherProvider);
+		});
+	}
+}
\ No newline at end of file
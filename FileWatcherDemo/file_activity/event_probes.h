@@ -0,0 +1,92 @@
+#pragma once
+
+#include "file_notify_info.h"
+#include <Windows.h>
+#include <TraceLoggingProvider.h>
+#include <string>
+#include <string_view>
+
+// Static probes of the pipeline, ETW TraceLogging provider "FileWatcher-Pipeline"
+// {6e40738b-b01b-5ea1-d981-889bb06c0b14} (GUID hashed from the name, like EventSource).
+// A probe is a test of the provider's enable mask when no session listens: the fields are not even evaluated.
+// e.g.  tracelog -start fw -guid #6e40738b-b01b-5ea1-d981-889bb06c0b14 -f fw.etl,  PerfView /OnlyProviders=*FileWatcher-Pipeline collect
+TRACELOGGING_DECLARE_PROVIDER(gFileWatcherProvider);
+
+namespace died
+{
+	// Registered with the first directory_watcher_mgr, for the life of the process
+	void register_probes() noexcept;
+
+	enum class evict_reason : unsigned char
+	{
+		handled,	// erased once classified
+		overflow	// oldest pending entry dropped, the queue is full
+	};
+
+	// A ReadDirectoryChangesW buffer is parsed, bytes == 0 => the kernel buffer overflowed
+	inline void probe_buffer(std::wstring const& directory, unsigned long bytes, unsigned long entries) noexcept
+	{
+		TraceLoggingWrite(gFileWatcherProvider, "BufferArrival",
+			TraceLoggingWideString(directory.c_str(), "directory"),
+			TraceLoggingUInt32(bytes, "bytes"),
+			TraceLoggingUInt32(entries, "entries"));
+	}
+
+	// rule: 0 accepted, else the UnnecessaryDirectory::Rule which rejected it
+	inline void probe_filter(file_notify_info const& info, size_t watcher, size_t rule) noexcept
+	{
+		// the path is built only for a listening session
+		if (!TraceLoggingProviderEnabled(gFileWatcherProvider, 0, 0)) {
+			return;
+		}
+		auto path = info.get_path_wstring();
+		if (!rule) {
+			TraceLoggingWrite(gFileWatcherProvider, "FilterAccept",
+				TraceLoggingWideString(path.c_str(), "path"),
+				TraceLoggingUInt32(info.get_action(), "action"),
+				TraceLoggingUInt32(static_cast<UINT32>(watcher), "watcher"));
+		}
+		else {
+			TraceLoggingWrite(gFileWatcherProvider, "FilterReject",
+				TraceLoggingWideString(path.c_str(), "path"),
+				TraceLoggingUInt32(info.get_action(), "action"),
+				TraceLoggingUInt32(static_cast<UINT32>(watcher), "watcher"),
+				TraceLoggingUInt32(static_cast<UINT32>(rule), "rule"));
+		}
+	}
+
+	// pending: the path_action bits of the path
+	inline void probe_insert(std::wstring const& path, unsigned int pending) noexcept
+	{
+		TraceLoggingWrite(gFileWatcherProvider, "ModelInsert",
+			TraceLoggingWideString(path.c_str(), "path"),
+			TraceLoggingHexUInt32(pending, "pending"));
+	}
+
+	inline void probe_evict(std::wstring const& path, unsigned int pending, evict_reason reason) noexcept
+	{
+		TraceLoggingWrite(gFileWatcherProvider, "ModelEvict",
+			TraceLoggingWideString(path.c_str(), "path"),
+			TraceLoggingHexUInt32(pending, "pending"),
+			TraceLoggingUInt8(static_cast<UINT8>(reason), "reason"));
+	}
+
+	// waitMicro: stored in the model => classified
+	inline void probe_classify(std::wstring const& type, std::wstring_view path, unsigned long long waitMicro) noexcept
+	{
+		TraceLoggingWrite(gFileWatcherProvider, "Classify",
+			TraceLoggingWideString(type.c_str(), "type"),
+			TraceLoggingCountedWideString(path.data(), static_cast<USHORT>(path.size()), "path"),
+			TraceLoggingUInt64(waitMicro, "wait_us"));
+	}
+
+	// seq: the provisional guess resolved by this event, 0 if none
+	inline void probe_send(std::wstring const& action, std::wstring_view path, bool stillOpen, unsigned long long seq) noexcept
+	{
+		TraceLoggingWrite(gFileWatcherProvider, "Send",
+			TraceLoggingWideString(action.c_str(), "action"),
+			TraceLoggingCountedWideString(path.data(), static_cast<USHORT>(path.size()), "path"),
+			TraceLoggingBoolean(stillOpen, "still_open"),
+			TraceLoggingUInt64(seq, "seq"));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include "event_ring.h"
+#include "event_frame.h"
+#include "spdlog_header.h"
+#include <Windows.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace died
+{
+	namespace
+	{
+		constexpr size_t NAME_MAX_LENGTH = 64;		// pattern names, the rest of mText is for the paths
+
+		size_t ring_capacity(size_t capacity) noexcept
+		{
+			size_t result = 64;
+			while (result < capacity) {
+				result <<= 1;
+			}
+			return result;
+		}
+
+		size_t mapping_size(size_t capacity) noexcept
+		{
+			return sizeof(ring_header) + capacity * sizeof(ring_record);
+		}
+
+		bool same_layout(ring_header const& header, size_t capacity) noexcept
+		{
+			return ring_header::MAGIC == header.mMagic.load(std::memory_order_acquire) && ring_header::VERSION == header.mVersion
+				&& sizeof(ring_record) == header.mRecordSize && (!capacity || capacity == header.mCapacity);
+		}
+
+		// still running, or not ours to check
+		bool process_alive(uint32_t id) noexcept
+		{
+			auto process = ::OpenProcess(SYNCHRONIZE, FALSE, id);
+			if (!process) {
+				return ERROR_ACCESS_DENIED == ::GetLastError();
+			}
+			auto alive = WAIT_TIMEOUT == ::WaitForSingleObject(process, 0);
+			::CloseHandle(process);
+			return alive;
+		}
+
+		// slots of crashed readers: taken again unless a new reader took them meanwhile
+		void reclaim(ring_header& header) noexcept
+		{
+			for (auto& el : header.mConsumers) {
+				auto id = el.mProcess.load(std::memory_order_acquire);
+				if (id && !process_alive(id)) {
+					el.mProcess.compare_exchange_strong(id, 0, std::memory_order_acq_rel);
+				}
+			}
+		}
+	}
+
+	event_ring::event_ring(std::wstring name, size_t capacity) :
+		mName{ std::move(name) },
+		mCapacity{ ring_capacity(capacity) }
+	{
+	}
+
+	event_ring::~event_ring()
+	{
+		close();
+	}
+
+	bool event_ring::open()
+	{
+		if (mHeader) {
+			return true;
+		}
+
+		auto size = static_cast<unsigned long long>(mapping_size(mCapacity));
+		mMapping = ::CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), mName.c_str());
+		if (!mMapping) {
+			SPDLOG_WARN(L"Can't create event ring {}, error: {}", mName, ::GetLastError());
+			return false;
+		}
+		bool existed = ERROR_ALREADY_EXISTS == ::GetLastError();
+		mHeader = static_cast<ring_header*>(::MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<size_t>(size)));
+		if (!mHeader) {
+			SPDLOG_WARN(L"Can't map event ring {}, error: {}", mName, ::GetLastError());
+			close();
+			return false;
+		}
+		mRecords = reinterpret_cast<ring_record*>(mHeader + 1);
+
+		// kept by its readers since the last run => go on at its head, the readers do not notice
+		if (existed) {
+			if (!same_layout(*mHeader, mCapacity)) {
+				SPDLOG_WARN(L"Event ring {} exists with another layout", mName);
+				close();
+				return false;
+			}
+			SPDLOG_INFO(L"Event ring {} taken over at {}", mName, mHeader->mHead.load(std::memory_order_relaxed));
+			return true;
+		}
+
+		// the pages of a new mapping are zeroed: head, stamps and slots start at 0
+		mHeader->mVersion = ring_header::VERSION;
+		mHeader->mRecordSize = sizeof(ring_record);
+		mHeader->mCapacity = static_cast<uint32_t>(mCapacity);
+		mHeader->mMagic.store(ring_header::MAGIC, std::memory_order_release);
+		return true;
+	}
+
+	void event_ring::close()
+	{
+		if (mHeader) {
+			::UnmapViewOfFile(mHeader);
+		}
+		if (mMapping) {
+			::CloseHandle(mMapping);
+		}
+		mMapping = nullptr;
+		mHeader = nullptr;
+		mRecords = nullptr;
+	}
+
+	void event_ring::deliver(std::vector<classified_event> const& events)
+	{
+		if (!mHeader || events.empty()) {
+			return;
+		}
+
+		auto wallNow = wall_now();
+		auto clockNow = event_clock::now();
+		auto head = mHeader->mHead.load(std::memory_order_relaxed);
+		for (auto const& ev : events) {
+			write(mRecords[head & (mCapacity - 1)], head, ev, wallNow, clockNow);
+			++head;
+		}
+
+		// one store per batch publishes its records
+		mHeader->mHead.store(head, std::memory_order_release);
+		mWritten.fetch_add(events.size(), std::memory_order_relaxed);
+	}
+
+	ring_stats event_ring::stats() const noexcept
+	{
+		ring_stats result;
+		result.mWritten = mWritten.load(std::memory_order_relaxed);
+		result.mTruncated = mTruncated.load(std::memory_order_relaxed);
+		if (!mHeader) {
+			return result;
+		}
+
+		reclaim(*mHeader);
+		auto head = mHeader->mHead.load(std::memory_order_relaxed);
+		for (auto const& el : mHeader->mConsumers) {
+			if (!el.mProcess.load(std::memory_order_acquire)) {
+				continue;
+			}
+			auto cursor = el.mCursor.load(std::memory_order_relaxed);
+			++result.mConsumers;
+			result.mMaxLag = std::max<unsigned long long>(result.mMaxLag, head > cursor ? head - cursor : 0);
+			result.mOverruns += el.mOverruns.load(std::memory_order_relaxed);
+		}
+		return result;
+	}
+
+	void event_ring::write(ring_record& record, uint64_t seq, classified_event const& ev, int64_t wallNow, event_clock::time_point clockNow) noexcept
+	{
+		// 1. readers see the record is being written
+		record.mStamp.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		// 2. the texts share mText: the shortest paths whole, the longest ones keep their tail
+		std::wstring_view name = event_kind::pattern == ev.mKind && ev.mName ? std::wstring_view{ *ev.mName } : std::wstring_view{};
+		name = name.substr(0, NAME_MAX_LENGTH);
+		std::array<std::wstring_view, 3> paths{ ev.mPath, ev.mOldPath, ev.mAuxPath };
+		std::array<size_t, 3> order{ 0, 1, 2 };
+		std::sort(std::begin(order), std::end(order), [&paths](size_t l, size_t r) { return paths[l].size() < paths[r].size(); });
+		size_t room = ring_record::TEXT - name.size();
+		bool truncated = false;
+		for (size_t i = 0; i < order.size(); ++i) {
+			auto& path = paths[order[i]];
+			auto length = std::min(path.size(), room / (order.size() - i));
+			truncated |= length < path.size();
+			path = path.substr(path.size() - length);
+			room -= length;
+		}
+
+		record.mFirst = wall_of(ev.mFirst, wallNow, clockNow);
+		record.mLast = wall_of(ev.mLast, wallNow, clockNow);
+		record.mClassified = wall_of(ev.mClassified, wallNow, clockNow);
+		record.mSource = ev.mSource;
+		record.mCount = ev.mCount;
+		record.mKind = static_cast<uint8_t>(ev.mKind);
+		record.mFlags = (ev.mStillOpen ? ring_record::STILL_OPEN : 0) | (truncated ? ring_record::TRUNCATED : 0);
+		record.mName = static_cast<uint16_t>(name.size());
+		record.mPath = static_cast<uint16_t>(paths[0].size());
+		record.mOldPath = static_cast<uint16_t>(paths[1].size());
+		record.mAuxPath = static_cast<uint16_t>(paths[2].size());
+		auto text = record.mText;
+		for (auto el : { name, paths[0], paths[1], paths[2] }) {
+			if (!el.empty()) {
+				std::memcpy(text, el.data(), el.size() * sizeof(wchar_t));
+				text += el.size();
+			}
+		}
+		if (truncated) {
+			mTruncated.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// 3. complete
+		record.mStamp.store(seq + 1, std::memory_order_release);
+	}
+
+	ring_reader::ring_reader(std::wstring name) :
+		mName{ std::move(name) }
+	{
+	}
+
+	ring_reader::~ring_reader()
+	{
+		close();
+	}
+
+	bool ring_reader::open()
+	{
+		if (mHeader) {
+			return true;
+		}
+
+		mMapping = ::OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, mName.c_str());
+		if (!mMapping) {
+			return false;
+		}
+		mHeader = static_cast<ring_header*>(::MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+		if (!mHeader || !same_layout(*mHeader, 0)) {
+			close();
+			return false;
+		}
+		mRecords = reinterpret_cast<ring_record*>(mHeader + 1);
+
+		// a free slot publishes the cursor of this reader to the writer
+		reclaim(*mHeader);
+		uint32_t self = ::GetCurrentProcessId();
+		for (auto& el : mHeader->mConsumers) {
+			uint32_t expected = 0;
+			if (el.mProcess.compare_exchange_strong(expected, self, std::memory_order_acq_rel)) {
+				mSlot = &el;
+				break;
+			}
+		}
+		if (!mSlot) {
+			close();
+			return false;
+		}
+		mSlot->mOverruns.store(0, std::memory_order_relaxed);
+		mCursor = mHeader->mHead.load(std::memory_order_acquire);
+		mSlot->mCursor.store(mCursor, std::memory_order_release);
+		return true;
+	}
+
+	void ring_reader::close()
+	{
+		if (mSlot) {
+			mSlot->mProcess.store(0, std::memory_order_release);
+		}
+		if (mHeader) {
+			::UnmapViewOfFile(mHeader);
+		}
+		if (mMapping) {
+			::CloseHandle(mMapping);
+		}
+		mSlot = nullptr;
+		mMapping = nullptr;
+		mHeader = nullptr;
+		mRecords = nullptr;
+	}
+
+	bool ring_reader::valid(ring_event const& ev) const noexcept
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		auto const& record = mRecords[ev.mSeq & (mHeader->mCapacity - 1)];
+		return ev.mSeq + 1 == record.mStamp.load(std::memory_order_relaxed);
+	}
+
+	uint64_t ring_reader::lag() const noexcept
+	{
+		return mHeader ? mHeader->mHead.load(std::memory_order_relaxed) - mCursor : 0;
+	}
+
+	uint64_t ring_reader::overruns() const noexcept
+	{
+		return mSlot ? mSlot->mOverruns.load(std::memory_order_relaxed) : 0;
+	}
+
+	void ring_reader::skip_overrun(uint64_t head) noexcept
+	{
+		if (head - mCursor > mHeader->mCapacity) {
+			lose(head - mHeader->mCapacity - mCursor);
+			mCursor = head - mHeader->mCapacity;
+		}
+	}
+
+	bool ring_reader::view(uint64_t seq, ring_event& ev) const noexcept
+	{
+		auto const& record = mRecords[seq & (mHeader->mCapacity - 1)];
+		if (seq + 1 != record.mStamp.load(std::memory_order_acquire)) {
+			return false;
+		}
+		if (static_cast<size_t>(record.mName) + record.mPath + record.mOldPath + record.mAuxPath > ring_record::TEXT || EVENT_KIND_COUNT <= record.mKind) {
+			return false;
+		}
+
+		ev.mSeq = seq;
+		ev.mKind = static_cast<event_kind>(record.mKind);
+		auto text = record.mText;
+		ev.mName = { text, record.mName };
+		ev.mPath = { text += record.mName, record.mPath };
+		ev.mOldPath = { text += record.mPath, record.mOldPath };
+		ev.mAuxPath = { text += record.mOldPath, record.mAuxPath };
+		if (ev.mName.empty()) {
+			ev.mName = name_of(ev.mKind);
+		}
+		ev.mFirst = record.mFirst;
+		ev.mLast = record.mLast;
+		ev.mClassified = record.mClassified;
+		ev.mSource = record.mSource;
+		ev.mCount = record.mCount;
+		ev.mStillOpen = 0 != (record.mFlags & ring_record::STILL_OPEN);
+		ev.mTruncated = 0 != (record.mFlags & ring_record::TRUNCATED);
+		return true;
+	}
+
+	void ring_reader::lose(uint64_t count) noexcept
+	{
+		mSlot->mOverruns.fetch_add(count, std::memory_order_relaxed);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "classified_event.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace died
+{
+	// Shared memory of an event_ring: ring_header then mCapacity ring_record, one writer, readers in other processes.
+	// Same host and build only: the texts are wchar_t, the counters std::atomic.
+	struct ring_consumer
+	{
+		std::atomic<uint32_t> mProcess;		// id of the process of its ring_reader, 0: free
+		uint32_t mPadding;
+		std::atomic<uint64_t> mCursor;		// next sequence the reader reads
+		std::atomic<uint64_t> mOverruns;	// records overwritten before the reader got them
+		uint64_t mReserved;
+	};
+	static_assert(sizeof(ring_consumer) == 32, "ring_consumer layout");
+
+	struct ring_header
+	{
+		static constexpr uint32_t MAGIC = 0x31525746;	// "FWR1"
+		static constexpr uint32_t VERSION = 2;		// 2: a slot is taken by the process id of its reader
+		static constexpr size_t CONSUMERS = 16;
+
+		std::atomic<uint32_t> mMagic;		// written last, once the ring is set up
+		uint32_t mVersion;
+		uint32_t mRecordSize;
+		uint32_t mCapacity;					// records, a power of two
+		alignas(64) std::atomic<uint64_t> mHead;	// records written, the sequence of the next one
+		alignas(64) ring_consumer mConsumers[CONSUMERS];
+	};
+
+	// Fixed size record, the texts inline: name (patterns only), path, old path, aux path
+	struct ring_record
+	{
+		static constexpr size_t SIZE = 1024;
+		static constexpr size_t TEXT = (SIZE - 56) / sizeof(wchar_t);
+		static constexpr uint8_t STILL_OPEN = 1;
+		static constexpr uint8_t TRUNCATED = 2;		// a path did not fit, its head was cut
+
+		std::atomic<uint64_t> mStamp;	// sequence + 1 once written, 0 while written
+		int64_t mFirst;					// FILETIME
+		int64_t mLast;
+		int64_t mClassified;
+		uint32_t mSource;
+		uint32_t mCount;
+		uint8_t mKind;					// event_kind
+		uint8_t mFlags;
+		uint16_t mName;					// lengths in mText, in this order
+		uint16_t mPath;
+		uint16_t mOldPath;
+		uint16_t mAuxPath;
+		uint16_t mReserved[3];
+		wchar_t mText[TEXT];
+	};
+	static_assert(sizeof(ring_record) == ring_record::SIZE, "ring_record layout");
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared counters must be lock-free");
+
+	struct ring_stats
+	{
+		unsigned long long mWritten{};
+		unsigned long long mTruncated{};	// records with a cut path
+		unsigned long long mConsumers{};	// readers attached
+		unsigned long long mMaxLag{};		// records the slowest reader is behind
+		unsigned long long mOverruns{};		// records lost by the attached readers
+	};
+
+	// Publishes the classified events in a named shared memory ring for local readers (indexer, scanner, backup).
+	// The writer never waits: a reader too far behind finds its records overwritten and counts them, see ring_reader.
+	// No system call per event, the head is published once per batch.
+	// One writer per name: a second watcher takes the ring over and goes on at its head.
+	// The slot of a reader whose process ended without close() is freed by stats() and by the next ring_reader::open().
+	class event_ring final : public event_sink
+	{
+	public:
+		static constexpr wchar_t const* DEFAULT_NAME = L"Local\\file_watcher_events";
+
+		explicit event_ring(std::wstring name = DEFAULT_NAME, size_t capacity = 4096);
+		~event_ring() override;
+
+		bool open();
+		void close();
+
+		void deliver(std::vector<classified_event> const& events) final;
+
+		ring_stats stats() const noexcept;
+
+	private:
+		void write(ring_record& record, uint64_t seq, classified_event const& ev, int64_t wallNow, event_clock::time_point clockNow) noexcept;
+
+	private:
+		std::wstring mName;
+		size_t mCapacity;
+		void* mMapping{};
+		ring_header* mHeader{};
+		ring_record* mRecords{};
+		std::atomic<unsigned long long> mWritten{};
+		std::atomic<unsigned long long> mTruncated{};
+	};
+
+	// A record seen in place: the views point into the shared memory, valid during the visit only
+	struct ring_event
+	{
+		uint64_t mSeq{};
+		event_kind mKind{};
+		std::wstring_view mName;
+		std::wstring_view mPath;
+		std::wstring_view mOldPath;
+		std::wstring_view mAuxPath;
+		int64_t mFirst{};
+		int64_t mLast{};
+		int64_t mClassified{};
+		unsigned int mSource{};
+		unsigned int mCount{};
+		bool mStillOpen{};
+		bool mTruncated{};
+	};
+
+	// Reader of an event_ring in another process, one consumer slot of the ring.
+	// poll() visits the records written since the last poll in place: no copy, no system call.
+	// Records overwritten before they were visited are skipped and counted in overruns(), as is a record
+	// overwritten during its visit: a reader keeping data out of a visit copies it then checks valid().
+	class ring_reader
+	{
+	public:
+		explicit ring_reader(std::wstring name = event_ring::DEFAULT_NAME);
+		~ring_reader();
+
+		bool open();		// false without writer or without free slot, starts at the head
+		void close();
+
+		template <typename Visit>
+		size_t poll(Visit&& visit, size_t max = SIZE_MAX)
+		{
+			size_t visited = 0;
+			if (!mHeader) {
+				return visited;
+			}
+			auto head = mHeader->mHead.load(std::memory_order_acquire);
+			skip_overrun(head);
+
+			ring_event ev;
+			for (; mCursor < head && visited < max; ++mCursor) {
+				if (!view(mCursor, ev)) {
+					lose(1);
+					continue;
+				}
+				visit(static_cast<ring_event const&>(ev));
+				if (!valid(ev)) {
+					lose(1);
+				}
+				++visited;
+			}
+			mSlot->mCursor.store(mCursor, std::memory_order_release);
+			return visited;
+		}
+
+		bool valid(ring_event const& ev) const noexcept;	// its record not overwritten yet
+
+		uint64_t lag() const noexcept;
+		uint64_t overruns() const noexcept;
+
+	private:
+		void skip_overrun(uint64_t head) noexcept;
+		bool view(uint64_t seq, ring_event& ev) const noexcept;
+		void lose(uint64_t count) noexcept;
+
+	private:
+		std::wstring mName;
+		void* mMapping{};
+		ring_header* mHeader{};
+		ring_record* mRecords{};
+		ring_consumer* mSlot{};
+		uint64_t mCursor{};
+	};
+}
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include "event_router.h"
+#include "spdlog_header.h"
+#include <algorithm>
+#include <cwctype>
+
+namespace died
+{
+	namespace
+	{
+		void fold(std::wstring_view text, std::wstring& out)
+		{
+			out.assign(text);
+			for (auto& el : out) {
+				el = static_cast<wchar_t>(std::towlower(el));
+			}
+		}
+
+		bool has_wildcard(std::wstring_view component) noexcept
+		{
+			return std::wstring_view::npos != component.find_first_of(L"*?");
+		}
+
+		size_t skip_separators(std::wstring_view path, size_t pos) noexcept
+		{
+			while (pos < path.size() && L'\\' == path[pos]) {
+				++pos;
+			}
+			return pos;
+		}
+
+		size_t component_end(std::wstring_view path, size_t pos) noexcept
+		{
+			return std::min(path.find(L'\\', pos), path.size());
+		}
+	}
+
+	unsigned int event_router::subscribe(subscription sub)
+	{
+		if (!sub.mSink) {
+			return 0;
+		}
+
+		auto added = std::make_shared<target>();
+		added->mSub = std::move(sub);
+		std::vector<std::shared_ptr<target>> targets;
+		unsigned long long version{};
+		{
+			std::lock_guard<std::mutex> lk(mSync);
+			added->mId = ++mNextId;
+			mTargets.push_back(added);
+			targets = mTargets;
+			version = ++mVersion;
+		}
+
+		SPDLOG_INFO(L"Subscription {} of {}: {} paths, kinds {:#x}", added->mId, added->mSub.mName, added->mSub.mPaths.size(), added->mSub.mKinds);
+		publish(compile(std::move(targets)), version);
+		return added->mId;
+	}
+
+	bool event_router::unsubscribe(unsigned int id)
+	{
+		std::vector<std::shared_ptr<target>> targets;
+		unsigned long long version{};
+		{
+			std::lock_guard<std::mutex> lk(mSync);
+			auto found = std::find_if(std::begin(mTargets), std::end(mTargets), [id](auto const& el) { return id == el->mId; });
+			if (std::end(mTargets) == found) {
+				return false;
+			}
+			mTargets.erase(found);
+			targets = mTargets;
+			version = ++mVersion;
+		}
+
+		publish(compile(std::move(targets)), version);
+		return true;
+	}
+
+	void event_router::deliver(std::vector<classified_event> const& events)
+	{
+		auto routes = table();
+		if (!routes || routes->mTargets.empty() || events.empty()) {
+			return;
+		}
+
+		// only the targets reached by the batch are visited and reset
+		auto count = routes->mTargets.size();
+		if (mOut.size() < count) {
+			mSeen.resize(count);
+			mOut.resize(count);
+		}
+		mEvents = &events;
+		for (size_t i = 0; i < events.size(); ++i) {
+			for (auto path : { events[i].mPath, events[i].mOldPath, events[i].mAuxPath }) {
+				route(*routes, path, i);
+			}
+		}
+		mEvents = nullptr;
+
+		// subscription order
+		std::sort(std::begin(mTouched), std::end(mTouched));
+		for (auto i : mTouched) {
+			auto& el = *routes->mTargets[i];
+			el.mSub.mSink->deliver(mOut[i]);
+			el.mDelivered.fetch_add(mOut[i].size(), std::memory_order_relaxed);
+			mOut[i].clear();
+			mSeen[i] = 0;
+		}
+		mTouched.clear();
+	}
+
+	bool event_router::saturated() const noexcept
+	{
+		auto routes = table();
+		return routes && std::any_of(std::begin(routes->mTargets), std::end(routes->mTargets), [](auto const& el) {
+			return el->mSub.mSink->saturated();
+		});
+	}
+
+	void event_router::flush(event_clock::time_point now)
+	{
+		auto routes = table();
+		if (routes) {
+			for (auto const& el : routes->mTargets) {
+				el->mSub.mSink->flush(now);
+			}
+		}
+	}
+
+	std::vector<route_stats> event_router::stats() const
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		std::vector<route_stats> result;
+		for (auto const& el : mTargets) {
+			result.push_back({ el->mId, el->mSub.mName, el->mDelivered.load(std::memory_order_relaxed) });
+		}
+		return result;
+	}
+
+	bool event_router::glob_match(std::wstring_view pattern, std::wstring_view text) noexcept
+	{
+		size_t t = 0;
+		for (size_t p = 0; p < pattern.size(); ++p, ++t) {
+			if (L'*' == pattern[p]) {
+				// "**" crosses folders, "**\" also matches no folder
+				bool any = p + 1 < pattern.size() && L'*' == pattern[p + 1];
+				auto rest = pattern.substr(p + (any ? 2 : 1));
+				if (any && !rest.empty() && L'\\' == rest.front() && glob_match(rest.substr(1), text.substr(t))) {
+					return true;
+				}
+				for (auto i = t; ; ++i) {
+					if (glob_match(rest, text.substr(i))) {
+						return true;
+					}
+					if (text.size() == i || (!any && L'\\' == text[i])) {
+						return false;
+					}
+				}
+			}
+			if (text.size() == t || (L'?' == pattern[p] ? L'\\' == text[t] : pattern[p] != text[t])) {
+				return false;
+			}
+		}
+		return text.size() == t;
+	}
+
+	std::shared_ptr<const event_router::route_table> event_router::compile(std::vector<std::shared_ptr<target>> targets)
+	{
+		auto result = std::make_shared<route_table>();
+		result->mTargets = std::move(targets);
+		auto& nodes = result->mNodes;
+		nodes.emplace_back();
+
+		auto child = [&nodes](size_t parent, std::wstring_view component) {
+			auto& children = nodes[parent].mChildren;
+			auto found = std::lower_bound(std::begin(children), std::end(children), component, [](auto const& el, std::wstring_view key) {
+				return el.first < key;
+			});
+			if (std::end(children) != found && found->first == component) {
+				return found->second;
+			}
+			children.emplace(found, std::wstring(component), nodes.size());
+			nodes.emplace_back();
+			return nodes.size() - 1;
+		};
+
+		std::wstring folded;
+		for (size_t t = 0; t < result->mTargets.size(); ++t) {
+			auto const& paths = result->mTargets[t]->mSub.mPaths;
+			if (paths.empty()) {
+				nodes.front().mTargets.push_back(t);
+				continue;
+			}
+
+			for (auto const& el : paths) {
+				// literal components down the trie, the rest from the first wildcard is a glob
+				fold(el, folded);
+				std::wstring_view path{ folded };
+				size_t at = 0;
+				bool glob = false;
+				for (auto pos = skip_separators(path, 0); pos < path.size(); pos = skip_separators(path, pos)) {
+					auto end = component_end(path, pos);
+					if (has_wildcard(path.substr(pos, end - pos))) {
+						nodes[at].mGlobs.emplace_back(t, std::wstring(path.substr(pos)));
+						glob = true;
+						break;
+					}
+					at = child(at, path.substr(pos, end - pos));
+					pos = end;
+				}
+				if (!glob) {
+					nodes[at].mTargets.push_back(t);
+				}
+			}
+		}
+		return result;
+	}
+
+	std::shared_ptr<const event_router::route_table> event_router::table() const
+	{
+		std::lock_guard<std::mutex> lk(mTableSync);
+		return mTable;
+	}
+
+	void event_router::publish(std::shared_ptr<const route_table> table, unsigned long long version)
+	{
+		// the replaced table is released outside the lock
+		{
+			std::lock_guard<std::mutex> lk(mTableSync);
+			if (version < mTableVersion) {
+				return;
+			}
+			mTableVersion = version;
+			mTable.swap(table);
+		}
+	}
+
+	void event_router::route(route_table const& table, std::wstring_view path, size_t event)
+	{
+		if (path.empty()) {
+			return;
+		}
+		fold(path, mFolded);
+		std::wstring_view folded{ mFolded };
+
+		// every subscription met on the walk of the path, from the root down
+		size_t at = 0;
+		for (auto pos = skip_separators(folded, 0); ; pos = skip_separators(folded, pos)) {
+			auto const& current = table.mNodes[at];
+			for (auto el : current.mTargets) {
+				add(table, el, event);
+			}
+			for (auto const& el : current.mGlobs) {
+				if (glob_match(el.second, folded.substr(pos))) {
+					add(table, el.first, event);
+				}
+			}
+			if (folded.size() <= pos) {
+				break;
+			}
+
+			auto end = component_end(folded, pos);
+			auto component = folded.substr(pos, end - pos);
+			auto found = std::lower_bound(std::begin(current.mChildren), std::end(current.mChildren), component, [](auto const& el, std::wstring_view key) {
+				return el.first < key;
+			});
+			if (std::end(current.mChildren) == found || found->first != component) {
+				break;
+			}
+			at = found->second;
+			pos = end;
+		}
+	}
+
+	void event_router::add(route_table const& table, size_t target, size_t event)
+	{
+		auto const& ev = (*mEvents)[event];
+		if (mSeen[target] == event + 1 || !(table.mTargets[target]->mSub.mKinds & kind_bit(ev.mKind))) {
+			return;
+		}
+		if (0 == mSeen[target]) {
+			mTouched.push_back(target);
+		}
+		mSeen[target] = event + 1;
+		mOut[target].push_back(ev);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "classified_event.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace died
+{
+	// What a consumer wants from the classified stream
+	struct subscription
+	{
+		std::wstring mName;						// tenant, for the logs and metrics
+		// Folders: the folder and everything under it, D:\work\src.
+		// Globs: '?' one character, '*' within a name, "**" across folders, D:\work\**\*.docx.
+		// Case insensitive. An event matches through its path, old path or aux path. Empty: every path
+		std::vector<std::wstring> mPaths;
+		unsigned int mKinds{ ALL_KINDS };		// kind_bit() of the wanted kinds
+		std::shared_ptr<event_sink> mSink;
+	};
+
+	struct route_stats
+	{
+		unsigned int mId{};
+		std::wstring mName;
+		unsigned long long mDelivered{};		// events routed to it
+	};
+
+	// Routes each classified event to the subscriptions matching its paths and kind.
+	// The subscriptions are compiled in a trie of path components: an event walks its own path, from the
+	// drive down, and meets only the subscriptions on that walk. The cost follows the depth of the path and
+	// the matching subscribers, not the number of subscriptions. A glob is hung at the node of its literal head.
+	// subscribe() / unsubscribe() from any thread compile a new table outside the locks and swap it in:
+	// deliver() only waits for that pointer swap, never for a compile or a log line.
+	// Routing one batch costs its events and the subscriptions they reach, not the number of subscriptions.
+	// A subscriber receives one batch per delivered batch with events for it, its own events only.
+	class event_router final : public event_sink
+	{
+	public:
+		unsigned int subscribe(subscription sub);		// id, 0 without sink
+		bool unsubscribe(unsigned int id);
+
+		void deliver(std::vector<classified_event> const& events) final;
+		bool saturated() const noexcept final;
+		void flush(event_clock::time_point now) final;
+
+		std::vector<route_stats> stats() const;
+
+		static bool glob_match(std::wstring_view pattern, std::wstring_view text) noexcept;	// folded texts
+
+	private:
+		struct target
+		{
+			unsigned int mId{};
+			subscription mSub;
+			std::atomic<unsigned long long> mDelivered{};
+		};
+
+		struct node
+		{
+			std::vector<std::pair<std::wstring, size_t>> mChildren;		// folded component, node; sorted
+			std::vector<size_t> mTargets;								// subscribed to this folder
+			std::vector<std::pair<size_t, std::wstring>> mGlobs;		// target, folded glob of the rest of the path
+		};
+
+		struct route_table
+		{
+			std::vector<std::shared_ptr<target>> mTargets;
+			std::vector<node> mNodes;		// root first
+		};
+
+		static std::shared_ptr<const route_table> compile(std::vector<std::shared_ptr<target>> targets);
+		std::shared_ptr<const route_table> table() const;
+		void publish(std::shared_ptr<const route_table> table, unsigned long long version);
+		void route(route_table const& table, std::wstring_view path, size_t event);
+		void add(route_table const& table, size_t target, size_t event);
+
+	private:
+		mutable std::mutex mSync;							// subscribe / unsubscribe
+		std::vector<std::shared_ptr<target>> mTargets;		// under mSync
+		unsigned int mNextId{};
+		unsigned long long mVersion{};						// under mSync: one per change of mTargets
+
+		mutable std::mutex mTableSync;						// the swap of mTable only
+		std::shared_ptr<const route_table> mTable;			// under mTableSync
+		unsigned long long mTableVersion{};					// under mTableSync: an older compile never replaces a newer one
+
+		// deliver() only
+		std::wstring mFolded;
+		std::vector<size_t> mSeen;								// per target: last event routed + 1, 0 between batches
+		std::vector<std::vector<classified_event>> mOut;		// per target
+		std::vector<size_t> mTouched;							// targets with events in this batch
+		std::vector<classified_event> const* mEvents{};
+	};
+}
\ No newline at end of file
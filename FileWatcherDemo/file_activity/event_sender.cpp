@@ -0,0 +1,325 @@
+#include "event_sender.h"
+#include "event_frame.h"
+#include "spdlog_header.h"
+#include <Windows.h>
+#include <cstring>
+
+namespace died
+{
+	namespace
+	{
+		constexpr size_t FRAME_BYTES = 64 * 1024;		// a frame is cut past this size
+		constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(5);
+		constexpr auto IDLE_WAIT = std::chrono::milliseconds(100);
+		constexpr auto RECONNECT_INTERVAL = std::chrono::seconds(1);
+		constexpr auto SYNC_INTERVAL = std::chrono::milliseconds(50);	// spooled events lost on power failure, at most
+		constexpr DWORD WRITE_TIMEOUT = 5000;		// ms, a receiver taking nothing that long is dropped
+		constexpr DWORD STOP_WRITE_TIMEOUT = 500;	// ms, once stopping
+	}
+
+	event_sender::event_sender(std::wstring pipe, size_t capacity, std::wstring spoolDir) :
+		mPipe{ std::move(pipe) },
+		mQueue{ capacity },
+		mHighWater{ mQueue.capacity() / 4 * 3 },
+		mHandle{ INVALID_HANDLE_VALUE },
+		mWritten{ ::CreateEventW(nullptr, TRUE, FALSE, nullptr) },
+		mStopping{ ::CreateEventW(nullptr, TRUE, FALSE, nullptr) }
+	{
+		if (!spoolDir.empty()) {
+			mSpool = std::make_unique<event_spool>(std::move(spoolDir));
+		}
+	}
+
+	event_sender::~event_sender()
+	{
+		stop();
+		for (auto el : { mWritten, mStopping }) {
+			if (el) {
+				::CloseHandle(el);
+			}
+		}
+	}
+
+	bool event_sender::start()
+	{
+		if (mThread.joinable()) {
+			return false;
+		}
+
+		// without its spool the sender still runs, the events are lost while nobody listens
+		if (mSpool && !mSpool->open()) {
+			SPDLOG_ERROR(L"Can't open the spool, events are not kept");
+			mSpool.reset();
+		}
+		mSpooled.store(mSpool ? mSpool->stats().mBacklog : 0, std::memory_order_relaxed);
+		mStop.store(false, std::memory_order_relaxed);
+		if (mStopping) {
+			::ResetEvent(mStopping);
+		}
+		mThread = std::thread(&event_sender::send_loop, this);
+		return true;
+	}
+
+	void event_sender::stop()
+	{
+		if (!mThread.joinable()) {
+			return;
+		}
+		mStop.store(true, std::memory_order_release);
+		if (mStopping) {
+			::SetEvent(mStopping);
+		}
+		{
+			std::lock_guard<std::mutex> lk(mWakeSync);
+			mSignaled = true;
+		}
+		mWake.notify_one();
+		mThread.join();
+		if (mSpool) {
+			mSpool->close();
+		}
+	}
+
+	void event_sender::deliver(std::vector<classified_event> const& events)
+	{
+		// one clock pair per batch, the records carry wall times
+		auto wallNow = wall_now();
+		auto clockNow = event_clock::now();
+		for (auto const& ev : events) {
+			auto queued = mQueue.push([&](std::vector<uint8_t>& record) {
+				record.clear();
+				encode_event(ev, wallNow, clockNow, record);
+			});
+			if (!queued) {
+				mDropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(mWakeSync);
+			mSignaled = true;
+		}
+		mWake.notify_one();
+	}
+
+	bool event_sender::saturated() const noexcept
+	{
+		return mQueue.size() >= mHighWater;
+	}
+
+	size_t event_sender::depth() const noexcept
+	{
+		return mQueue.size();
+	}
+
+	sender_stats event_sender::stats() const noexcept
+	{
+		sender_stats result;
+		result.mSent = mSent.load(std::memory_order_relaxed);
+		result.mFrames = mFrames.load(std::memory_order_relaxed);
+		result.mBytes = mBytes.load(std::memory_order_relaxed);
+		result.mDropped = mDropped.load(std::memory_order_relaxed);
+		result.mConnects = mConnects.load(std::memory_order_relaxed);
+		result.mSpooled = mSpooled.load(std::memory_order_relaxed);
+		return result;
+	}
+
+	void event_sender::send_loop()
+	{
+		std::vector<uint8_t> frame;
+		frame.reserve(FRAME_BYTES + sizeof(frame_header));
+		frame.resize(sizeof(frame_header));
+		std::vector<uint8_t> record;
+		uint16_t count = 0;
+		auto firstQueued = std::chrono::steady_clock::now();
+		auto lastConnect = firstQueued - RECONNECT_INTERVAL;
+		auto lastSync = firstQueued;
+		auto append = [&frame](std::vector<uint8_t> const& el) {
+			frame.insert(std::end(frame), std::begin(el), std::end(el));
+		};
+		auto spool = [this](std::vector<uint8_t> const& el) {
+			if (!mSpool->append(el.data(), el.size())) {
+				mDropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		};
+
+		for (;;) {
+			auto stopping = mStop.load(std::memory_order_acquire);
+			auto now = std::chrono::steady_clock::now();
+
+			// 1. spooled: the queue goes to disk first, made durable in batches
+			if (mSpool) {
+				while (mQueue.pop(spool)) {
+				}
+				if (stopping || now - lastSync >= SYNC_INTERVAL) {
+					lastSync = now;
+					mSpool->sync();
+				}
+				mSpooled.store(mSpool->stats().mBacklog, std::memory_order_relaxed);
+
+				// the rest is sent by the next run
+				if (stopping) {
+					disconnect();
+					return;
+				}
+			}
+
+			// 2. nobody listens => the events are lost, or kept in the spool
+			if (INVALID_HANDLE_VALUE == mHandle) {
+				if (now - lastConnect >= RECONNECT_INTERVAL) {
+					lastConnect = now;
+					connect();
+				}
+				if (INVALID_HANDLE_VALUE == mHandle) {
+					if (!mSpool) {
+						mDropped.fetch_add(discard(), std::memory_order_relaxed);
+					}
+					if (stopping) {
+						return;
+					}
+					std::unique_lock<std::mutex> lk(mWakeSync);
+					mWake.wait_for(lk, mSpool ? IDLE_WAIT : RECONNECT_INTERVAL, [this] { return mSignaled; });
+					mSignaled = false;
+					continue;
+				}
+			}
+
+			// 3. fill the frame up to its size
+			while (frame.size() < FRAME_BYTES + sizeof(frame_header) && UINT16_MAX > count) {
+				if (mSpool) {
+					if (!mSpool->read(record)) {
+						break;
+					}
+					append(record);
+				}
+				else if (!mQueue.pop(append)) {
+					break;
+				}
+				if (!count++) {
+					firstQueued = now;
+				}
+			}
+
+			// 4. full, or the first event waited enough
+			auto full = frame.size() >= FRAME_BYTES + sizeof(frame_header) || UINT16_MAX == count;
+			if (count && (full || stopping || now - firstQueued >= FLUSH_INTERVAL)) {
+				if (mSpool) {
+					mNextSeq = mSpool->committed();
+				}
+				if (write(frame, count)) {
+					if (mSpool) {
+						mSpool->commit();
+					}
+				}
+				else {
+					if (mSpool) {
+						mSpool->rewind();
+					}
+					else {
+						mDropped.fetch_add(count, std::memory_order_relaxed);
+					}
+					disconnect();
+				}
+				frame.resize(sizeof(frame_header));
+				count = 0;
+				continue;
+			}
+			if (stopping) {
+				disconnect();
+				return;
+			}
+
+			std::unique_lock<std::mutex> lk(mWakeSync);
+			mWake.wait_for(lk, count ? FLUSH_INTERVAL : IDLE_WAIT, [this] { return mSignaled; });
+			mSignaled = false;
+		}
+	}
+
+	bool event_sender::connect()
+	{
+		if (!mWritten || !mStopping) {
+			return false;
+		}
+		mHandle = ::CreateFileW(mPipe.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+		if (INVALID_HANDLE_VALUE == mHandle) {
+			return false;
+		}
+		mConnects.fetch_add(1, std::memory_order_relaxed);
+		SPDLOG_INFO(L"Connected to {}", mPipe);
+		return true;
+	}
+
+	void event_sender::disconnect()
+	{
+		if (INVALID_HANDLE_VALUE != mHandle) {
+			::CloseHandle(mHandle);
+			mHandle = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	bool event_sender::write(std::vector<uint8_t>& frame, uint16_t count)
+	{
+		frame_header header;
+		header.mCount = count;
+		header.mBytes = static_cast<uint32_t>(frame.size() - sizeof(header));
+		header.mFirstSeq = mNextSeq;
+		std::memcpy(frame.data(), &header, sizeof(header));
+		mNextSeq += count;
+
+		size_t done = 0;
+		while (done < frame.size()) {
+			size_t written = 0;
+			if (!write_some(frame.data() + done, frame.size() - done, written)) {
+				return false;
+			}
+			done += written;
+		}
+		mSent.fetch_add(count, std::memory_order_relaxed);
+		mFrames.fetch_add(1, std::memory_order_relaxed);
+		mBytes.fetch_add(frame.size(), std::memory_order_relaxed);
+		return true;
+	}
+
+	bool event_sender::write_some(uint8_t const* data, size_t size, size_t& written)
+	{
+		OVERLAPPED ov{};
+		ov.hEvent = mWritten;
+		if (!::WriteFile(mHandle, data, static_cast<DWORD>(size), nullptr, &ov) && ERROR_IO_PENDING != ::GetLastError()) {
+			SPDLOG_WARN(L"Receiver gone: {}, error: {}", mPipe, ::GetLastError());
+			return false;
+		}
+
+		// 1. the receiver reads, or stop() comes: the write gets a last short wait
+		HANDLE waits[] = { mWritten, mStopping };
+		auto stopping = mStop.load(std::memory_order_acquire);
+		auto waited = ::WaitForMultipleObjects(stopping ? 1 : 2, waits, FALSE, stopping ? STOP_WRITE_TIMEOUT : WRITE_TIMEOUT);
+		if (WAIT_OBJECT_0 + 1 == waited) {
+			waited = ::WaitForSingleObject(mWritten, STOP_WRITE_TIMEOUT);
+		}
+
+		// 2. still pending => cancelled, 'ov' is on this stack: wait for the cancellation itself
+		DWORD done = 0;
+		if (WAIT_OBJECT_0 != waited) {
+			::CancelIoEx(mHandle, &ov);
+			::GetOverlappedResult(mHandle, &ov, &done, TRUE);
+			SPDLOG_WARN(L"Receiver stalled: {}, the pipe is closed", mPipe);
+			return false;
+		}
+		if (!::GetOverlappedResult(mHandle, &ov, &done, FALSE)) {
+			SPDLOG_WARN(L"Receiver gone: {}, error: {}", mPipe, ::GetLastError());
+			return false;
+		}
+		written = done;
+		return true;
+	}
+
+	size_t event_sender::discard()
+	{
+		size_t count = 0;
+		while (mQueue.pop([](std::vector<uint8_t> const&) {})) {
+			++count;
+		}
+		mNextSeq += count;
+		return count;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "classified_event.h"
+#include "event_spool.h"
+#include "mpsc_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace died
+{
+	struct sender_stats
+	{
+		unsigned long long mSent{};			// events written to the pipe
+		unsigned long long mFrames{};
+		unsigned long long mBytes{};
+		unsigned long long mDropped{};		// queue full, no receiver or write failed; spooled: queue full or no disk
+		unsigned long long mConnects{};
+		unsigned long long mSpooled{};		// waiting in the spool
+	};
+
+	// Sends the classified events to a local receiver over a named pipe, see event_frame.h.
+	// deliver() encodes the events into a bounded queue and returns, it never waits on the pipe.
+	// One sender thread cuts frames by size, or once the first event waited FLUSH_INTERVAL, and writes them.
+	// Without receiver the queued events are dropped and counted, the pipe is tried again every second.
+	// With a spool directory they go to an event_spool first and are sent from it: kept while nobody
+	// listens and across restarts, a frame is committed once written, delivery is at-least-once.
+	// A queue 3/4 full is saturated(): the correlation holds its events until the sender caught up.
+	// Writes are overlapped: one the receiver does not take in time is cancelled and the pipe closed,
+	// so a stalled receiver never holds the sender thread nor stop().
+	class event_sender final : public event_sink
+	{
+	public:
+		static constexpr wchar_t const* DEFAULT_PIPE = L"\\\\.\\pipe\\file_watcher_events";
+
+		// 'capacity' events in the queue, no spool when 'spoolDir' is empty
+		explicit event_sender(std::wstring pipe = DEFAULT_PIPE, size_t capacity = 8192, std::wstring spoolDir = {});
+		~event_sender() override;
+
+		bool start();
+		void stop();		// the queued events are sent first when connected, a stalled write is cut short
+
+		void deliver(std::vector<classified_event> const& events) final;
+		bool saturated() const noexcept final;
+
+		size_t depth() const noexcept;
+		sender_stats stats() const noexcept;
+
+	private:
+		void send_loop();
+		bool connect();
+		void disconnect();
+		bool write(std::vector<uint8_t>& frame, uint16_t count);
+		bool write_some(uint8_t const* data, size_t size, size_t& written);
+		size_t discard();
+
+	private:
+		std::wstring mPipe;
+		mpsc_queue<std::vector<uint8_t>> mQueue;	// one encoded record per slot, its buffer is reused
+		size_t mHighWater{};
+
+		std::thread mThread;
+		std::atomic<bool> mStop{};
+		std::mutex mWakeSync;
+		std::condition_variable mWake;
+		bool mSignaled{};
+
+		void* mHandle{};			// sender thread only, overlapped
+		void* mWritten{};			// completion of the pending write
+		void* mStopping{};			// set by stop()
+		unsigned long long mNextSeq{};
+		std::unique_ptr<event_spool> mSpool;	// sender thread only, after start()
+
+		std::atomic<unsigned long long> mSent{};
+		std::atomic<unsigned long long> mFrames{};
+		std::atomic<unsigned long long> mBytes{};
+		std::atomic<unsigned long long> mDropped{};
+		std::atomic<unsigned long long> mConnects{};
+		std::atomic<unsigned long long> mSpooled{};
+	};
+}
\ No newline at end of file
@@ -0,0 +1,475 @@
+#include "event_spool.h"
+#include "std_filesystem.h"
+#include "spdlog_header.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <cwchar>
+
+namespace died
+{
+	namespace
+	{
+		constexpr uint32_t SEGMENT_MAGIC = 0x31535746;	// "FWS1"
+		constexpr uint32_t CURSOR_MAGIC = 0x31435746;	// "FWC1"
+		constexpr uint32_t VERSION = 2;					// 2: records of frame_record version 2, older segments are dropped
+		constexpr uint32_t NEXT_SEGMENT = UINT32_MAX;	// record length: the records go on in the next segment
+		constexpr size_t MAX_FREE = 2;					// recycled segments kept, the others are deleted
+
+		struct segment_header
+		{
+			uint32_t mMagic;
+			uint32_t mVersion;
+			uint64_t mId;
+			uint64_t mSize;
+			uint64_t mReserved;
+		};
+		static_assert(sizeof(segment_header) == 32, "segment_header layout");
+
+		// then mLength bytes, padded to 8; a zero length ends the records
+		struct record_header
+		{
+			uint32_t mLength;
+			uint32_t mCheck;
+		};
+
+		struct cursor_record
+		{
+			uint32_t mMagic;
+			uint32_t mCheck;
+			uint64_t mSegment;
+			uint64_t mOffset;
+			uint64_t mSeq;
+		};
+		static_assert(sizeof(cursor_record) == 32, "cursor_record layout");
+
+		// FNV-1a seeded by the segment: a stale record of a recycled segment never matches
+		uint32_t checksum(uint64_t seed, uint8_t const* data, size_t size) noexcept
+		{
+			uint32_t hash = 2166136261u ^ static_cast<uint32_t>(seed) ^ static_cast<uint32_t>(seed >> 32);
+			for (size_t i = 0; i < size; ++i) {
+				hash = (hash ^ data[i]) * 16777619u;
+			}
+			return hash;
+		}
+
+		uint32_t checksum(cursor_record const& cursor) noexcept
+		{
+			return checksum(CURSOR_MAGIC, reinterpret_cast<uint8_t const*>(&cursor.mSegment), sizeof(cursor) - offsetof(cursor_record, mSegment));
+		}
+
+		size_t aligned(size_t size) noexcept
+		{
+			return (size + 7) & ~size_t(7);
+		}
+
+		bool valid(void* handle) noexcept
+		{
+			return handle && INVALID_HANDLE_VALUE != handle;
+		}
+	}
+
+	event_spool::event_spool(std::wstring dir, size_t segmentSize) :
+		mDir{ std::move(dir) },
+		mSegmentSize{ aligned(segmentSize) }
+	{
+	}
+
+	event_spool::~event_spool()
+	{
+		close();
+	}
+
+	bool event_spool::open()
+	{
+		if (mOpen) {
+			return true;
+		}
+		if (!recover()) {
+			close();
+			return false;
+		}
+		mOpen = true;
+		SPDLOG_INFO(L"Spool {}: {} records to send", mDir, mStats.mBacklog);
+		return true;
+	}
+
+	void event_spool::close()
+	{
+		if (mOpen) {
+			sync();
+		}
+		mOpen = false;
+		for (auto& el : mSegments) {
+			release(el);
+		}
+		for (auto& el : mFree) {
+			release(el);
+		}
+		release(mCursorFile);
+		mSegments.clear();
+		mFree.clear();
+	}
+
+	bool event_spool::append(uint8_t const* data, size_t size)
+	{
+		auto need = sizeof(record_header) + aligned(size);
+		if (!mOpen || sizeof(segment_header) + need + sizeof(record_header) > mSegmentSize) {
+			return false;
+		}
+
+		// 1. no room => seal this segment, the reader goes on in the next one
+		if (mWrite.mOffset + need + sizeof(record_header) > mSegmentSize) {
+			auto sealed = mWrite;
+			if (!add_segment()) {
+				return false;
+			}
+			auto& seg = *find(sealed.mSegment);
+			record_header next{ NEXT_SEGMENT, 0 };
+			std::memcpy(view_of(seg) + sealed.mOffset, &next, sizeof(next));
+			::FlushViewOfFile(seg.mView, 0);
+			seg.mUnflushed = true;
+			if (mRead.mSegment != seg.mId) {
+				unmap(seg);
+			}
+		}
+
+		// 2. payload, end mark after it, then the header publishes the record
+		auto& seg = mSegments.back();
+		auto at = seg.mView + mWrite.mOffset;
+		std::memcpy(at + sizeof(record_header), data, size);
+		std::memset(at + need, 0, sizeof(record_header));
+		record_header header{ static_cast<uint32_t>(size), checksum(seg.mId, data, size) };
+		std::memcpy(at, &header, sizeof(header));
+
+		mWrite.mOffset += need;
+		++mStats.mAppended;
+		++mStats.mBacklog;
+		mDirty = true;
+		return true;
+	}
+
+	bool event_spool::read(std::vector<uint8_t>& record)
+	{
+		if (!mOpen) {
+			return false;
+		}
+		for (;;) {
+			if (mRead.mSegment == mWrite.mSegment && mRead.mOffset == mWrite.mOffset) {
+				return false;
+			}
+			auto seg = find(mRead.mSegment);
+			auto view = seg ? view_of(*seg) : nullptr;
+			if (!view) {
+				return false;
+			}
+
+			record_header header;
+			std::memcpy(&header, view + mRead.mOffset, sizeof(header));
+			if (NEXT_SEGMENT == header.mLength) {
+				auto next = std::find_if(std::begin(mSegments), std::end(mSegments), [this](auto const& el) { return el.mId > mRead.mSegment; });
+				if (std::end(mSegments) == next) {
+					return false;
+				}
+				if (mWrite.mSegment != seg->mId) {
+					unmap(*seg);
+				}
+				mRead = { next->mId, sizeof(segment_header) };
+				continue;
+			}
+
+			auto at = view + mRead.mOffset + sizeof(header);
+			record.assign(at, at + header.mLength);
+			mRead.mOffset += sizeof(header) + aligned(header.mLength);
+			++mReadCount;
+			return true;
+		}
+	}
+
+	void event_spool::commit()
+	{
+		if (!mOpen || !mReadCount) {
+			return;
+		}
+		mCursor = mRead;
+		mSeq += mReadCount;
+		mStats.mCommitted = mSeq;
+		mStats.mBacklog -= mReadCount;
+		mReadCount = 0;
+		write_cursor();
+		mDirty = true;
+
+		// fully read segments
+		while (mSegments.front().mId < mCursor.mSegment) {
+			auto seg = mSegments.front();
+			mSegments.pop_front();
+			unmap(seg);
+			if (mFree.size() < MAX_FREE) {
+				mFree.push_back(seg);
+			}
+			else {
+				release(seg);
+				::DeleteFileW(seg.mPath.c_str());
+			}
+		}
+	}
+
+	void event_spool::rewind()
+	{
+		mRead = mCursor;
+		mReadCount = 0;
+	}
+
+	void event_spool::sync()
+	{
+		if (!mOpen || !mDirty) {
+			return;
+		}
+		auto& seg = mSegments.back();
+		::FlushViewOfFile(seg.mView, 0);
+		::FlushFileBuffers(seg.mFile);
+		for (auto& el : mSegments) {
+			if (el.mUnflushed) {
+				::FlushFileBuffers(el.mFile);
+				el.mUnflushed = false;
+			}
+		}
+		::FlushViewOfFile(mCursorFile.mView, 0);
+		::FlushFileBuffers(mCursorFile.mFile);
+		mDirty = false;
+		++mStats.mSyncs;
+	}
+
+	unsigned long long event_spool::committed() const noexcept
+	{
+		return mSeq;
+	}
+
+	spool_stats event_spool::stats() const noexcept
+	{
+		return mStats;
+	}
+
+	bool event_spool::recover()
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(std::filesystem::path(mDir), ec);
+
+		// 1. cursor of the last run
+		mCursorFile.mPath = mDir + L"\\cursor";
+		mCursorFile.mSize = sizeof(cursor_record);
+		if (!open_file(mCursorFile) || !view_of(mCursorFile)) {
+			SPDLOG_ERROR(L"Can't open spool cursor: {}", mCursorFile.mPath);
+			return false;
+		}
+		cursor_record saved;
+		std::memcpy(&saved, mCursorFile.mView, sizeof(saved));
+		bool hasCursor = CURSOR_MAGIC == saved.mMagic && checksum(saved) == saved.mCheck;
+
+		// 2. segments by id, the ones behind the cursor are free
+		for (auto const& entry : std::filesystem::directory_iterator(std::filesystem::path(mDir), ec)) {
+			if (L".seg" != entry.path().extension().wstring()) {
+				continue;
+			}
+			segment seg;
+			seg.mPath = entry.path().wstring();
+			seg.mSize = mSegmentSize;
+			mNextFile = std::max<uint64_t>(mNextFile, std::wcstoull(entry.path().stem().wstring().c_str(), nullptr, 16) + 1);
+			if (!open_file(seg) || !view_of(seg)) {
+				release(seg);
+				continue;
+			}
+			segment_header header;
+			std::memcpy(&header, seg.mView, sizeof(header));
+			unmap(seg);
+			if (SEGMENT_MAGIC != header.mMagic || VERSION != header.mVersion || mSegmentSize != header.mSize) {
+				release(seg);
+				::DeleteFileW(seg.mPath.c_str());
+				continue;
+			}
+			seg.mId = header.mId;
+			if (hasCursor && seg.mId < saved.mSegment) {
+				mFree.push_back(seg);
+			}
+			else {
+				mSegments.push_back(seg);
+			}
+		}
+		std::sort(std::begin(mSegments), std::end(mSegments), [](auto const& a, auto const& b) { return a.mId < b.mId; });
+		while (MAX_FREE < mFree.size()) {
+			release(mFree.back());
+			::DeleteFileW(mFree.back().mPath.c_str());
+			mFree.pop_back();
+		}
+
+		// 3. the cursor, or the oldest record when it is lost
+		mSeq = hasCursor ? saved.mSeq : 0;
+		if (mSegments.empty()) {
+			mCursor = { hasCursor ? saved.mSegment : 1, sizeof(segment_header) };
+			if (!add_segment()) {
+				return false;
+			}
+		}
+		else if (hasCursor && mSegments.front().mId == saved.mSegment && saved.mOffset < mSegmentSize) {
+			mCursor = { saved.mSegment, saved.mOffset };
+		}
+		else {
+			mCursor = { mSegments.front().mId, sizeof(segment_header) };
+		}
+
+		// 4. the write end: the first record which is not whole, or the end mark
+		auto pos = mCursor;
+		unsigned long long backlog = 0;
+		for (;;) {
+			auto& seg = *find(pos.mSegment);
+			auto view = view_of(seg);
+			if (!view) {
+				return false;
+			}
+			record_header header{};
+			if (pos.mOffset + sizeof(header) <= mSegmentSize) {
+				std::memcpy(&header, view + pos.mOffset, sizeof(header));
+			}
+			if (NEXT_SEGMENT == header.mLength) {
+				auto next = std::find_if(std::begin(mSegments), std::end(mSegments), [&seg](auto const& el) { return el.mId > seg.mId; });
+				if (std::end(mSegments) != next) {
+					unmap(seg);
+					pos = { next->mId, sizeof(segment_header) };
+					continue;
+				}
+				// the next segment was never created => written over
+			}
+			auto end = pos.mOffset + sizeof(header) + aligned(header.mLength) + sizeof(header);
+			if (!header.mLength || NEXT_SEGMENT == header.mLength || end > mSegmentSize
+				|| checksum(seg.mId, view + pos.mOffset + sizeof(header), header.mLength) != header.mCheck) {
+				std::memset(view + pos.mOffset, 0, std::min(sizeof(header), mSegmentSize - pos.mOffset));
+				break;
+			}
+			pos.mOffset += sizeof(header) + aligned(header.mLength);
+			++backlog;
+		}
+		mWrite = pos;
+
+		// records after a torn one are not trusted
+		while (mSegments.back().mId != mWrite.mSegment) {
+			auto seg = mSegments.back();
+			mSegments.pop_back();
+			release(seg);
+			::DeleteFileW(seg.mPath.c_str());
+		}
+		if (mCursor.mSegment != mWrite.mSegment) {
+			unmap(*find(mCursor.mSegment));
+		}
+
+		mRead = mCursor;
+		mStats.mBacklog = backlog;
+		mStats.mCommitted = mSeq;
+		write_cursor();
+		mDirty = true;
+		return true;
+	}
+
+	bool event_spool::add_segment()
+	{
+		// a recycled file first, its stale records do not match the new id
+		segment seg;
+		if (!mFree.empty()) {
+			seg = mFree.back();
+			mFree.pop_back();
+			++mStats.mRecycled;
+		}
+		else {
+			wchar_t name[32]{};
+			std::swprintf(name, 32, L"\\%016llx.seg", static_cast<unsigned long long>(mNextFile++));
+			seg.mPath = mDir + name;
+			seg.mSize = mSegmentSize;
+			if (!open_file(seg)) {
+				return false;
+			}
+		}
+		if (!view_of(seg)) {
+			release(seg);
+			return false;
+		}
+
+		seg.mId = mSegments.empty() ? std::max<uint64_t>(mCursor.mSegment, 1) : mSegments.back().mId + 1;
+		segment_header header{ SEGMENT_MAGIC, VERSION, seg.mId, mSegmentSize, 0 };
+		std::memcpy(seg.mView, &header, sizeof(header));
+		std::memset(seg.mView + sizeof(header), 0, sizeof(record_header));
+		mSegments.push_back(seg);
+		mWrite = { seg.mId, sizeof(segment_header) };
+		return true;
+	}
+
+	bool event_spool::open_file(segment& seg)
+	{
+		seg.mFile = ::CreateFileW(seg.mPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (!valid(seg.mFile)) {
+			seg.mFile = nullptr;
+			return false;
+		}
+		LARGE_INTEGER size{};
+		if (!::GetFileSizeEx(seg.mFile, &size) || static_cast<uint64_t>(size.QuadPart) < seg.mSize) {
+			size.QuadPart = static_cast<LONGLONG>(seg.mSize);
+			if (!::SetFilePointerEx(seg.mFile, size, nullptr, FILE_BEGIN) || !::SetEndOfFile(seg.mFile)) {
+				SPDLOG_ERROR(L"Can't size spool file: {}, error: {}", seg.mPath, ::GetLastError());
+				release(seg);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint8_t* event_spool::view_of(segment& seg)
+	{
+		if (seg.mView) {
+			return seg.mView;
+		}
+		auto size = static_cast<uint64_t>(seg.mSize);
+		seg.mMapping = ::CreateFileMappingW(seg.mFile, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+		if (!seg.mMapping) {
+			return nullptr;
+		}
+		seg.mView = static_cast<uint8_t*>(::MapViewOfFile(seg.mMapping, FILE_MAP_ALL_ACCESS, 0, 0, seg.mSize));
+		if (!seg.mView) {
+			::CloseHandle(seg.mMapping);
+			seg.mMapping = nullptr;
+		}
+		return seg.mView;
+	}
+
+	void event_spool::unmap(segment& seg)
+	{
+		if (seg.mView) {
+			::UnmapViewOfFile(seg.mView);
+			seg.mView = nullptr;
+		}
+		if (seg.mMapping) {
+			::CloseHandle(seg.mMapping);
+			seg.mMapping = nullptr;
+		}
+	}
+
+	void event_spool::release(segment& seg)
+	{
+		unmap(seg);
+		if (valid(seg.mFile)) {
+			::CloseHandle(seg.mFile);
+		}
+		seg.mFile = nullptr;
+	}
+
+	event_spool::segment* event_spool::find(uint64_t id)
+	{
+		auto found = std::find_if(std::begin(mSegments), std::end(mSegments), [id](auto const& el) { return el.mId == id; });
+		return std::end(mSegments) == found ? nullptr : &*found;
+	}
+
+	void event_spool::write_cursor()
+	{
+		cursor_record cursor{ CURSOR_MAGIC, 0, mCursor.mSegment, mCursor.mOffset, mSeq };
+		cursor.mCheck = checksum(cursor);
+		std::memcpy(mCursorFile.mView, &cursor, sizeof(cursor));
+	}
+}
\ No newline at end of file
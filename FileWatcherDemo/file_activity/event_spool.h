@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace died
+{
+	struct spool_stats
+	{
+		unsigned long long mAppended{};
+		unsigned long long mCommitted{};	// since the spool directory was created
+		unsigned long long mBacklog{};		// appended, not committed
+		unsigned long long mSyncs{};
+		unsigned long long mRecycled{};		// segments reused
+	};
+
+	// Durable FIFO of records in memory-mapped segment files, with a consumer cursor.
+	// append() copies a record into the mapped segment and read() walks the records after the cursor;
+	// commit() moves the cursor past the records read. Records read but not committed are read again
+	// after rewind() or a restart: delivery is at-least-once.
+	// sync() makes the appended records and the cursor durable, the owner calls it in batches.
+	// A segment behind the cursor is recycled for new records instead of a new file.
+	// One thread only.
+	class event_spool
+	{
+		struct segment
+		{
+			uint64_t mId{};
+			std::wstring mPath;
+			size_t mSize{};
+			void* mFile{};
+			void* mMapping{};
+			uint8_t* mView{};
+			bool mUnflushed{};		// sealed, its file not flushed yet
+		};
+
+		struct position
+		{
+			uint64_t mSegment{};
+			uint64_t mOffset{};
+		};
+
+	public:
+		static constexpr size_t SEGMENT_SIZE = 16 << 20;
+
+		explicit event_spool(std::wstring dir, size_t segmentSize = SEGMENT_SIZE);
+		~event_spool();
+
+		bool open();		// the records of the last run after its cursor are read first
+		void close();		// synced
+
+		bool append(uint8_t const* data, size_t size);	// false: larger than a segment or no disk space
+		bool read(std::vector<uint8_t>& record);		// next record, false when all are read
+		void commit();
+		void rewind();
+		void sync();
+
+		unsigned long long committed() const noexcept;	// sequence of the record after the cursor
+		spool_stats stats() const noexcept;
+
+	private:
+		bool recover();
+		bool add_segment();
+		bool open_file(segment& seg);
+		uint8_t* view_of(segment& seg);
+		void unmap(segment& seg);
+		void release(segment& seg);
+		segment* find(uint64_t id);
+		void write_cursor();
+
+	private:
+		std::wstring mDir;
+		size_t mSegmentSize;
+		std::deque<segment> mSegments;		// cursor segment ... write segment
+		std::vector<segment> mFree;			// behind the cursor, reused before a new file
+		uint64_t mNextFile{};
+
+		position mWrite;
+		position mRead;
+		position mCursor;
+		unsigned long long mSeq{};			// of the record at the cursor
+		unsigned long long mReadCount{};	// since the cursor
+
+		segment mCursorFile;
+		bool mDirty{};
+		bool mOpen{};
+		spool_stats mStats;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,329 @@
+#include "event_store.h"
+#include "event_frame.h"
+#include "varint.h"
+#include <algorithm>
+#include <cwctype>
+
+namespace died
+{
+	namespace
+	{
+		constexpr unsigned int KIND_BITS = 4;
+
+		// dictionary key: the folder id in two units, then the folded name
+		void key_of(uint32_t parent, std::wstring_view name, std::wstring& out)
+		{
+			out.clear();
+			out.push_back(static_cast<wchar_t>(parent & 0xffff));
+			out.push_back(static_cast<wchar_t>(parent >> 16));
+			for (auto el : name) {
+				out.push_back(static_cast<wchar_t>(std::towlower(el)));
+			}
+		}
+
+		// visit(component) for each non empty component of a path
+		template<typename Visit>
+		bool for_each_component(std::wstring_view path, Visit&& visit)
+		{
+			size_t pos = 0;
+			while (pos < path.size()) {
+				auto end = std::min(path.find(L'\\', pos), path.size());
+				if (end > pos && !visit(path.substr(pos, end - pos))) {
+					return false;
+				}
+				pos = end + 1;
+			}
+			return true;
+		}
+	}
+
+	event_store::event_store(size_t maxEvents) :
+		mMaxEvents{ std::max(maxEvents, BLOCK_EVENTS) }
+	{
+		mOpen.reserve(BLOCK_EVENTS);
+	}
+
+	void event_store::deliver(std::vector<classified_event> const& events)
+	{
+		auto wallNow = wall_now();
+		auto clockNow = event_clock::now();
+		std::lock_guard<std::mutex> lk(mSync);
+		for (auto const& el : events) {
+			stored_event row;
+			row.mTime = wall_of(event_clock::time_point{} != el.mLast ? el.mLast : el.mClassified, wallNow, clockNow);
+			row.mKind = el.mKind;
+			row.mPath = intern(el.mPath);
+			row.mParent = parent_of(row.mPath);
+			row.mCount = el.mCount;
+			mOpen.push_back(row);
+			++mEvents;
+			if (mOpen.size() >= BLOCK_EVENTS) {
+				seal();
+			}
+		}
+	}
+
+	std::wstring event_store::path_of(uint32_t id) const
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		std::vector<path_entry const*> chain;
+		while (id) {
+			auto found = mPaths.find(id);
+			if (std::end(mPaths) == found) {
+				return {};		// evicted
+			}
+			chain.push_back(&found->second);
+			id = found->second.mParent;
+		}
+		std::wstring path;
+		for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+			if (!path.empty()) {
+				path.push_back(L'\\');
+			}
+			path += (*it)->mName;
+		}
+		return path;
+	}
+
+	store_stats event_store::stats() const
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		store_stats result;
+		result.mEvents = mEvents;
+		result.mBlocks = mBlocks.size();
+		result.mBytes = mBytes;
+		result.mPaths = mPaths.size();
+		result.mEvicted = mEvicted;
+		return result;
+	}
+
+	bool event_store::prepare(store_query const& query, snapshot& snap) const
+	{
+		if (query.mTo < query.mFrom || !(query.mKinds & ALL_KINDS)) {
+			return false;
+		}
+
+		// sealed blocks are shared, never changed, and decoded without the dictionary: only the open events are filtered here
+		std::lock_guard<std::mutex> lk(mSync);
+		if (!find(query.mFolder, snap.mFolder)) {
+			return false;		// never seen, nothing under it
+		}
+		snap.mBlocks.assign(std::begin(mBlocks), std::end(mBlocks));
+		for (auto const& el : mOpen) {
+			if (matches(el, query) && under(el.mPath, snap.mFolder)) {
+				snap.mOpen.push_back(el);
+			}
+		}
+		return true;
+	}
+
+	bool event_store::skip(block const& blk, store_query const& query, snapshot const& snap) noexcept
+	{
+		return blk.mMaxTime < query.mFrom || query.mTo < blk.mMinTime
+			|| !(blk.mKinds & query.mKinds)
+			|| (snap.mFolder && !std::binary_search(std::begin(blk.mFolders), std::end(blk.mFolders), snap.mFolder));
+	}
+
+	bool event_store::matches(stored_event const& ev, store_query const& query) noexcept
+	{
+		return query.mFrom <= ev.mTime && ev.mTime <= query.mTo && (query.mKinds & kind_bit(ev.mKind));
+	}
+
+	void event_store::decode(block const& blk, uint32_t folder, std::vector<stored_event>& out, std::vector<uint8_t>& under)
+	{
+		auto const& folders = blk.mFolders;
+		auto index_of = [&folders](uint32_t id) {
+			return static_cast<size_t>(std::lower_bound(std::begin(folders), std::end(folders), id) - std::begin(folders));
+		};
+
+		// 1. its ids under 'folder': a folder id is lower than the ids under it, so its flag is set first
+		if (folder) {
+			under.assign(folders.size(), 0);
+			for (size_t i = 0; i < folders.size(); ++i) {
+				under[i] = folder == folders[i] || (blk.mParents[i] && under[index_of(blk.mParents[i])]);
+			}
+		}
+
+		// 2. one column after the other
+		out.resize(blk.mRows);
+		auto data = blk.mData.data();
+		auto end = data + blk.mData.size();
+		uint64_t value = 0;
+
+		auto at = data;
+		int64_t time = blk.mMinTime;
+		for (auto& el : out) {
+			get_varint(at, end, value);
+			time += unzigzag(value);
+			el.mTime = time;
+		}
+		at = data + blk.mKindsAt;
+		for (auto& el : out) {
+			get_varint(at, end, value);
+			el.mKind = static_cast<event_kind>(value & ((1u << KIND_BITS) - 1));
+			el.mCount = static_cast<uint32_t>(value >> KIND_BITS);
+		}
+		at = data + blk.mPathsAt;
+		int64_t path = 0;
+		for (auto& el : out) {
+			get_varint(at, end, value);
+			path += unzigzag(value);
+			el.mPath = static_cast<uint32_t>(path);
+			el.mParent = blk.mParents[index_of(el.mPath)];
+		}
+		if (folder) {
+			out.erase(std::remove_if(std::begin(out), std::end(out), [&](stored_event const& el) { return !under[index_of(el.mPath)]; }), std::end(out));
+		}
+	}
+
+	uint32_t event_store::intern(std::wstring_view path)
+	{
+		auto child = [this](uint32_t parent, std::wstring_view name) {
+			key_of(parent, name, mKey);
+			auto found = mIds.find(mKey);
+			if (std::end(mIds) != found) {
+				return found->second;
+			}
+			auto id = mNextId++;
+			mPaths.emplace(id, path_entry{ parent, 0, std::wstring{ name } });
+			mIds.emplace(mKey, id);
+			return id;
+		};
+
+		// 1. same folder as the last event => only its name is looked up
+		auto slash = path.rfind(L'\\');
+		auto folder = std::wstring_view::npos == slash ? std::wstring_view{} : path.substr(0, slash);
+		auto name = std::wstring_view::npos == slash ? path : path.substr(slash + 1);
+		if (folder != mLastFolder) {
+			uint32_t parent = 0;
+			for_each_component(folder, [&](std::wstring_view component) {
+				parent = child(parent, component);
+				return true;
+			});
+			mLastFolder.assign(folder);
+			mLastFolderId = parent;
+		}
+		return name.empty() ? mLastFolderId : child(mLastFolderId, name);
+	}
+
+	bool event_store::find(std::wstring_view path, uint32_t& id) const
+	{
+		std::wstring key;
+		id = 0;
+		return for_each_component(path, [&](std::wstring_view component) {
+			key_of(id, component, key);
+			auto found = mIds.find(key);
+			if (std::end(mIds) == found) {
+				return false;
+			}
+			id = found->second;
+			return true;
+		});
+	}
+
+	uint32_t event_store::parent_of(uint32_t id) const
+	{
+		auto found = mPaths.find(id);
+		return std::end(mPaths) == found ? 0 : found->second.mParent;
+	}
+
+	bool event_store::under(uint32_t id, uint32_t folder) const
+	{
+		if (!folder) {
+			return true;
+		}
+		for (; id >= folder; id = parent_of(id)) {
+			if (folder == id) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void event_store::seal()
+	{
+		if (mOpen.empty()) {
+			return;
+		}
+		auto blk = std::make_shared<block>();
+		blk->mRows = static_cast<uint32_t>(mOpen.size());
+
+		// 1. index: time range, kinds, the paths and all their folders
+		blk->mMinTime = std::numeric_limits<int64_t>::max();
+		blk->mMaxTime = std::numeric_limits<int64_t>::min();
+		std::vector<uint32_t> paths;
+		paths.reserve(mOpen.size());
+		for (auto const& el : mOpen) {
+			blk->mMinTime = std::min(blk->mMinTime, el.mTime);
+			blk->mMaxTime = std::max(blk->mMaxTime, el.mTime);
+			blk->mKinds |= kind_bit(el.mKind);
+			paths.push_back(el.mPath);
+		}
+		std::sort(std::begin(paths), std::end(paths));
+		paths.erase(std::unique(std::begin(paths), std::end(paths)), std::end(paths));
+		for (auto el : paths) {
+			for (auto id = el; id; id = parent_of(id)) {
+				blk->mFolders.push_back(id);
+			}
+		}
+		std::sort(std::begin(blk->mFolders), std::end(blk->mFolders));
+		blk->mFolders.erase(std::unique(std::begin(blk->mFolders), std::end(blk->mFolders)), std::end(blk->mFolders));
+		blk->mFolders.shrink_to_fit();
+		blk->mParents.reserve(blk->mFolders.size());
+		for (auto el : blk->mFolders) {
+			auto& entry = mPaths[el];
+			blk->mParents.push_back(entry.mParent);
+			++entry.mBlocks;
+		}
+
+		// 2. columns: times, kind and count, paths
+		auto& data = blk->mData;
+		data.reserve(mOpen.size() * 4);
+		int64_t time = blk->mMinTime;
+		for (auto const& el : mOpen) {
+			put_varint(data, zigzag(el.mTime - time));
+			time = el.mTime;
+		}
+		blk->mKindsAt = data.size();
+		for (auto const& el : mOpen) {
+			put_varint(data, (static_cast<uint64_t>(el.mCount) << KIND_BITS) | static_cast<uint64_t>(el.mKind));
+		}
+		blk->mPathsAt = data.size();
+		int64_t path = 0;
+		for (auto const& el : mOpen) {
+			put_varint(data, zigzag(static_cast<int64_t>(el.mPath) - path));
+			path = el.mPath;
+		}
+		data.shrink_to_fit();
+
+		mBytes += data.size();
+		mBlocks.push_back(std::move(blk));
+		mOpen.clear();
+
+		// 3. the oldest blocks past the limit
+		while (mEvents > mMaxEvents && !mBlocks.empty()) {
+			evict(*mBlocks.front());
+			mBlocks.pop_front();
+		}
+	}
+
+	void event_store::evict(block const& blk)
+	{
+		mEvents -= blk.mRows;
+		mEvicted += blk.mRows;
+		mBytes -= blk.mData.size();
+
+		// entries no kept block uses: the open block is empty here, an id is never given again
+		for (auto el : blk.mFolders) {
+			auto found = mPaths.find(el);
+			if (std::end(mPaths) == found || --found->second.mBlocks) {
+				continue;
+			}
+			key_of(found->second.mParent, found->second.mName, mKey);
+			mIds.erase(mKey);
+			mPaths.erase(found);
+		}
+		mLastFolder.clear();
+		mLastFolderId = 0;
+	}
+}
\ No newline at end of file
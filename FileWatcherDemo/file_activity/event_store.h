@@ -0,0 +1,164 @@
+#pragma once
+
+#include "classified_event.h"
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace died
+{
+	// A classified event as the store keeps it
+	struct stored_event
+	{
+		int64_t mTime{};			// FILETIME of its last raw event
+		event_kind mKind{};
+		uint32_t mPath{};			// path id, see event_store::path_of(), never reused
+		uint32_t mParent{};			// its folder, a path id too
+		uint32_t mCount{};			// events merged into it, see event_coalescer
+	};
+
+	struct store_query
+	{
+		int64_t mFrom{};			// FILETIME, both included
+		int64_t mTo{ std::numeric_limits<int64_t>::max() };
+		std::wstring mFolder;		// the folder and everything under it, case insensitive. Empty: every path
+		unsigned int mKinds{ ALL_KINDS };
+	};
+
+	struct scan_stats
+	{
+		unsigned long long mScanned{};		// blocks decoded
+		unsigned long long mSkipped{};		// blocks out of the query by their index
+		unsigned long long mMatched{};		// events visited
+	};
+
+	struct store_stats
+	{
+		unsigned long long mEvents{};		// kept
+		unsigned long long mBlocks{};		// sealed
+		unsigned long long mBytes{};		// encoded columns of the sealed blocks
+		unsigned long long mPaths{};		// dictionary entries of the kept events, folders included
+		unsigned long long mEvicted{};		// oldest events dropped past the limit
+	};
+
+	// Columnar history of the classified events, in memory: "what changed under D:\x in the last hour".
+	// Events are appended to an open block; a full block is sealed and encoded column by column, LEB128 varints:
+	// times as zigzag deltas, kind and count in one value, path ids as zigzag deltas.
+	// Paths are a dictionary of components, an id is (folder id, name): a path already seen costs its id only.
+	// A sealed block keeps its time range, its kinds, the sorted ids of its paths and all their folders, and their
+	// parents: a query skips the blocks out of its range, kinds or folder undecoded, and decodes the others without
+	// the dictionary. The oldest blocks go past 'maxEvents' with the dictionary entries no kept block uses.
+	// deliver() and the queries from any thread; a query holds the lock to take the blocks and the matching open events.
+	class event_store final : public event_sink
+	{
+		struct block
+		{
+			int64_t mMinTime{};
+			int64_t mMaxTime{};
+			unsigned int mKinds{};
+			uint32_t mRows{};
+			size_t mKindsAt{};				// columns in mData: times, kinds, paths
+			size_t mPathsAt{};
+			std::vector<uint32_t> mFolders;	// sorted, a folder before the ids under it
+			std::vector<uint32_t> mParents;	// of each mFolders id
+			std::vector<uint8_t> mData;
+		};
+
+		struct snapshot
+		{
+			std::vector<std::shared_ptr<const block>> mBlocks;
+			std::vector<stored_event> mOpen;	// the matching ones
+			uint32_t mFolder{};
+		};
+
+		struct path_entry
+		{
+			uint32_t mParent{};
+			uint32_t mBlocks{};				// kept blocks using it
+			std::wstring mName;				// as first seen
+		};
+
+	public:
+		static constexpr size_t BLOCK_EVENTS = 4096;
+		static constexpr size_t MAX_EVENTS = 16 << 20;
+
+		explicit event_store(size_t maxEvents = MAX_EVENTS);
+
+		void deliver(std::vector<classified_event> const& events) final;
+
+		// The events of 'query', in delivery order: visit(stored_event const&)
+		template<typename Visit>
+		scan_stats scan(store_query const& query, Visit&& visit) const;
+
+		std::wstring path_of(uint32_t id) const;		// empty once no kept event uses it
+		store_stats stats() const;
+
+	private:
+		bool prepare(store_query const& query, snapshot& snap) const;		// false: nothing can match
+		static bool skip(block const& blk, store_query const& query, snapshot const& snap) noexcept;
+		static bool matches(stored_event const& ev, store_query const& query) noexcept;
+		static void decode(block const& blk, uint32_t folder, std::vector<stored_event>& out, std::vector<uint8_t>& under);
+
+		uint32_t intern(std::wstring_view path);
+		bool find(std::wstring_view path, uint32_t& id) const;
+		uint32_t parent_of(uint32_t id) const;
+		bool under(uint32_t id, uint32_t folder) const;
+		void seal();
+		void evict(block const& blk);
+
+	private:
+		size_t mMaxEvents;
+		mutable std::mutex mSync;
+
+		// under mSync
+		std::deque<std::shared_ptr<const block>> mBlocks;
+		std::vector<stored_event> mOpen;
+		std::unordered_map<uint32_t, path_entry> mPaths;	// the root 0 is not in it
+		std::unordered_map<std::wstring, uint32_t> mIds;	// folder id and folded name
+		uint32_t mNextId{ 1 };
+		std::wstring mKey;
+		std::wstring mLastFolder;				// folder of the last interned path, as given
+		uint32_t mLastFolderId{};
+		unsigned long long mEvents{};
+		unsigned long long mBytes{};
+		unsigned long long mEvicted{};
+	};
+
+	template<typename Visit>
+	scan_stats event_store::scan(store_query const& query, Visit&& visit) const
+	{
+		scan_stats result;
+		snapshot snap;
+		if (!prepare(query, snap)) {
+			return result;
+		}
+
+		std::vector<stored_event> rows;
+		std::vector<uint8_t> under;
+		for (auto const& el : snap.mBlocks) {
+			if (skip(*el, query, snap)) {
+				++result.mSkipped;
+				continue;
+			}
+			++result.mScanned;
+			decode(*el, snap.mFolder, rows, under);
+			for (auto const& row : rows) {
+				if (matches(row, query)) {
+					++result.mMatched;
+					visit(row);
+				}
+			}
+		}
+		for (auto const& el : snap.mOpen) {
+			++result.mMatched;
+			visit(el);
+		}
+		return result;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "event_tracer.h"
+#include "std_filesystem.h"
+#include <Windows.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace died
+{
+	namespace
+	{
+		// fields are atomic: the exporter reads a slot the owner thread may be writing
+		struct trace_record
+		{
+			std::atomic<char const*> mName{};
+			std::atomic<long long> mTime{};		// steady_clock ticks
+			std::atomic<char> mPhase{};
+		};
+
+		// written by one thread only
+		struct thread_ring
+		{
+			unsigned long mThreadId{};
+			bool mFree{};						// owner exited, guarded by ring_registry::mSync
+			std::atomic<size_t> mNext{};		// records written so far
+			std::array<trace_record, event_tracer::RING_SIZE> mRecords;
+		};
+
+		struct ring_registry
+		{
+			std::mutex mSync;
+			std::vector<std::unique_ptr<thread_ring>> mRings;	// kept after the thread exits, reused by the next one
+		};
+
+		ring_registry& registry()
+		{
+			// never destroyed: a pool thread may still record during static destruction
+			static auto* sRegistry = new ring_registry;
+			return *sRegistry;
+		}
+
+		// records of an exited thread stay exported until another thread takes its ring
+		thread_ring* claim_ring()
+		{
+			auto& reg = registry();
+			std::lock_guard<std::mutex> lk(reg.mSync);
+			auto found = std::find_if(std::begin(reg.mRings), std::end(reg.mRings), [](auto const& el) { return el->mFree; });
+			if (std::end(reg.mRings) == found) {
+				reg.mRings.push_back(std::make_unique<thread_ring>());
+				found = std::prev(std::end(reg.mRings));
+			}
+			auto* ring = found->get();
+			ring->mFree = false;
+			ring->mThreadId = ::GetCurrentThreadId();
+			ring->mNext.store(0, std::memory_order_relaxed);
+			return ring;
+		}
+
+		// gives the ring back when the thread exits
+		struct ring_owner
+		{
+			thread_ring* mRing{};
+
+			~ring_owner()
+			{
+				if (mRing) {
+					auto& reg = registry();
+					std::lock_guard<std::mutex> lk(reg.mSync);
+					mRing->mFree = true;
+					mRing = nullptr;
+				}
+			}
+		};
+
+		thread_ring& local_ring()
+		{
+			thread_local ring_owner tOwner;
+			if (!tOwner.mRing) {
+				tOwner.mRing = claim_ring();
+			}
+			return *tOwner.mRing;
+		}
+
+		struct exported_record
+		{
+			char const* mName;
+			long long mTime;
+			char mPhase;
+		};
+
+		void write_name(std::ostringstream& out, char const* name)
+		{
+			for (; *name; ++name) {
+				if ('"' == *name || '\\' == *name) {
+					out << '\\';
+				}
+				out << *name;
+			}
+		}
+	}
+
+	std::atomic<bool> event_tracer::sEnabled{ false };
+	std::atomic<long long> event_tracer::sSince{ 0 };
+
+	void event_tracer::enable(bool on) noexcept
+	{
+		sEnabled.store(on, std::memory_order_relaxed);
+	}
+
+	void event_tracer::record(phase ph, char const* name) noexcept
+	{
+		auto& ring = local_ring();
+		auto next = ring.mNext.load(std::memory_order_relaxed);
+		auto& el = ring.mRecords[next % RING_SIZE];
+		el.mName.store(name, std::memory_order_relaxed);
+		el.mTime.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+		el.mPhase.store(static_cast<char>(ph), std::memory_order_relaxed);
+		ring.mNext.store(next + 1, std::memory_order_release);
+	}
+
+	std::string event_tracer::chrome_json()
+	{
+		using namespace std::chrono;
+		auto since = sSince.load(std::memory_order_relaxed);
+		auto pid = ::GetCurrentProcessId();
+
+		std::ostringstream out;
+		out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+
+		auto& reg = registry();
+		std::lock_guard<std::mutex> lk(reg.mSync);
+		for (auto const& ring : reg.mRings) {
+			// 1. copy what the ring holds
+			auto end = ring->mNext.load(std::memory_order_acquire);
+			auto begin = end > RING_SIZE ? end - RING_SIZE : 0;
+			std::vector<exported_record> records;
+			records.reserve(end - begin);
+			for (auto i = begin; i < end; ++i) {
+				auto const& el = ring->mRecords[i % RING_SIZE];
+				records.push_back({ el.mName.load(std::memory_order_relaxed), el.mTime.load(std::memory_order_relaxed), el.mPhase.load(std::memory_order_relaxed) });
+			}
+
+			// 2. slots overwritten during the copy are dropped, the next one may be half written
+			auto now = ring->mNext.load(std::memory_order_acquire) + 1;
+			auto valid = now > RING_SIZE ? now - RING_SIZE : 0;
+			for (auto i = std::max(begin, valid); i < end; ++i) {
+				auto const& el = records[i - begin];
+				if (!el.mName || el.mTime < since) {
+					continue;
+				}
+				auto micro = duration_cast<duration<double, std::micro>>(steady_clock::duration{ el.mTime }).count();
+				out << (first ? "" : ",") << "\n{\"name\":\"";
+				write_name(out, el.mName);
+				out << "\",\"ph\":\"" << el.mPhase << "\",\"ts\":" << std::fixed << micro
+					<< ",\"pid\":" << pid << ",\"tid\":" << ring->mThreadId;
+				if (static_cast<char>(phase::instant) == el.mPhase) {
+					out << ",\"s\":\"t\"";
+				}
+				out << "}";
+				first = false;
+			}
+		}
+		out << "\n]}\n";
+		return out.str();
+	}
+
+	bool event_tracer::write_chrome_json(std::wstring const& path)
+	{
+		auto text = chrome_json();
+		std::ofstream file{ std::filesystem::path(path), std::ios::binary | std::ios::trunc };
+		return file.is_open() && file.write(text.data(), text.size());
+	}
+
+	size_t event_tracer::ring_count()
+	{
+		auto& reg = registry();
+		std::lock_guard<std::mutex> lk(reg.mSync);
+		return reg.mRings.size();
+	}
+
+	void event_tracer::clear() noexcept
+	{
+		sSince.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+namespace died
+{
+	// In-process timeline of the watcher internals, exported as Chrome trace JSON
+	// (chrome://tracing, ui.perfetto.dev).
+	// Each thread appends begin/end/instant records to its own ring, no lock and no allocation;
+	// when disabled a record costs one relaxed load. The oldest records of a thread are overwritten.
+	class event_tracer
+	{
+	public:
+		static constexpr size_t RING_SIZE = 8192;	// records per thread
+
+		enum class phase : char { begin = 'B', end = 'E', instant = 'i' };
+
+		static void enable(bool on) noexcept;
+		static bool enabled() noexcept
+		{
+			return sEnabled.load(std::memory_order_relaxed);
+		}
+
+		// 'name' must outlive the tracer (string literal)
+		static void record(phase ph, char const* name) noexcept;
+
+		// Records kept since the last clear(), all threads.
+		// A thread recording while exporting may lose its oldest records, not corrupt the file.
+		static std::string chrome_json();
+		static bool write_chrome_json(std::wstring const& path);
+
+		// Older records are not exported any more
+		static void clear() noexcept;
+
+		// Rings allocated so far; the ring of an exited thread goes to the next new thread
+		static size_t ring_count();
+
+	private:
+		static std::atomic<bool> sEnabled;
+		static std::atomic<long long> sSince;
+	};
+
+	// begin on construction, end on destruction
+	class trace_scope
+	{
+	public:
+		explicit trace_scope(char const* name) noexcept :
+			mName{ event_tracer::enabled() ? name : nullptr }
+		{
+			if (mName) {
+				event_tracer::record(event_tracer::phase::begin, mName);
+			}
+		}
+
+		~trace_scope()
+		{
+			if (mName) {
+				event_tracer::record(event_tracer::phase::end, mName);
+			}
+		}
+
+		trace_scope(trace_scope const&) = delete;
+		trace_scope& operator=(trace_scope const&) = delete;
+
+	private:
+		char const* mName;
+	};
+}
+
+#define TRACE_CONCAT_(a, b)	a##b
+#define TRACE_CONCAT(a, b)	TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name)	died::trace_scope TRACE_CONCAT(traceScope, __LINE__){ name }
+#define TRACE_INSTANT(name)	do { if (died::event_tracer::enabled()) died::event_tracer::record(died::event_tracer::phase::instant, name); } while (0)
\ No newline at end of file
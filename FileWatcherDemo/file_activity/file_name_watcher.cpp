@@ -1,5 +1,6 @@
 #include "file_name_watcher.h"
-#include "spdlog_header.h"
+#include "event_journal.h"
+#include "gsl\gsl_assert"
 
 namespace died
 {
@@ -9,25 +10,33 @@ namespace died
 			//SPDLOG_INFO(L"Ignore directory");
 			return;
 		}
-		SPDLOG_INFO(L"{} - {}", info.get_action(), info.get_path_wstring());
+		JOURNAL_INFO(file_name, info.get_action(), info.get_path_wstring());
+		if (mEngine) {
+			mEngine->post(info.get_action(), info.get_path_wstring(), info.get_created_time(), mSource, info.get_stamps());
+		}
 
+		Ensures(mState);
 		switch (info.get_action())
 		{
 		case FILE_ACTION_ADDED:
-			mAdd.push(std::move(info));
+			mState->push(path_action::added, info);
+			// speculative consumers get a 'create' now, resolved when the correlation window closes
+			if (mSender) {
+				mSender->provisional(L"Create only", info.get_path_wstring(), info.get_created_time());
+			}
 			break;
 
 		case FILE_ACTION_REMOVED:
-			mRemove.push(std::move(info));
+			mState->push(path_action::removed, info);
 			break;
 
 		case FILE_ACTION_MODIFIED:
-			mModify.push(std::move(info));
+			mState->push(path_action::modified, info);
 			break;
 
 		case FILE_ACTION_RENAMED_OLD_NAME:
 		case FILE_ACTION_RENAMED_NEW_NAME:
-			mRename.push(std::move(info));
+			pair_rename(std::move(info));
 			break;
 
 		default:
@@ -35,28 +44,40 @@ namespace died
 		}
 	}
 
-	model_rename& file_name_watcher::get_rename()
+	void file_name_watcher::pair_rename(file_notify_info&& info)
 	{
-		return mRename;
-	}
+		if (FILE_ACTION_RENAMED_OLD_NAME == info.get_action()) {
+			mOldName = std::move(info);
+			return;
+		}
 
-	model_file_info& file_name_watcher::get_add()
-	{
-		return mAdd;
+		// valid data: a pair in the same folder
+		if (!mOldName || mOldName.get_parent_path_wstring() != info.get_parent_path_wstring()) {
+			return;
+		}
+
+		rename_link link;
+		link.mOldName = mOldName.get_path_wstring();
+		link.mNewName = info.get_path_wstring();
+		link.mTime = info.get_created_time();
+		link.mStamps = info.get_stamps();
+		mOldName = file_notify_info{};
+		mState->push_rename(std::move(link));
 	}
 
-	model_file_info& file_name_watcher::get_remove()
+	void file_name_watcher::set_state(std::shared_ptr<state_shards> shards)
 	{
-		return mRemove;
+		mState = std::move(shards);
 	}
 
-	model_file_info& file_name_watcher::get_modify()
+	void file_name_watcher::set_correlation(std::shared_ptr<correlation_shards> engine, unsigned int source)
 	{
-		return mModify;
+		mEngine = std::move(engine);
+		mSource = source;
 	}
 
-	bool file_name_watcher::exist_in_rename_any(std::wstring const& key) const
+	void file_name_watcher::set_sender(std::shared_ptr<notify_to_server> sender)
 	{
-		return mRename.get_number_family(key) > 0;
+		mSender = std::move(sender);
 	}
 }
\ No newline at end of file
@@ -1,27 +1,28 @@
 #pragma once
 
 #include "directory_watcher_base.h"
-#include "model_rename.h"
-#include "model_file_info.h"
+#include "state_shards.h"
+#include "correlation_shards.h"
+#include "notify_to_server.h"
 
 namespace died
 {
 	class file_name_watcher : public directory_watcher_base
 	{
 	public:
-		model_file_info& get_add();
-		model_file_info& get_remove();
-		model_file_info& get_modify();
-		model_rename& get_rename();
-		bool exist_in_rename_any(std::wstring const& key) const;
+		void set_state(std::shared_ptr<state_shards> shards);
+		void set_correlation(std::shared_ptr<correlation_shards> engine, unsigned int source);
+		void set_sender(std::shared_ptr<notify_to_server> sender);
 
 	private:
 		void do_notify(file_notify_info info) final;
+		void pair_rename(file_notify_info&& info);
 
 	private:
-		model_file_info mAdd;
-		model_file_info mRemove;
-		model_file_info mModify;
-		model_rename mRename;
+		std::shared_ptr<state_shards> mState;
+		file_notify_info mOldName;		// waiting for its new name
+		std::shared_ptr<correlation_shards> mEngine;
+		unsigned int mSource{};
+		std::shared_ptr<notify_to_server> mSender;	// provisional events
 	};
 }
\ No newline at end of file
@@ -27,6 +27,11 @@ namespace died
 		return mPath.wstring();
 	}
 
+	std::filesystem::path const& file_notify_info::get_path() const noexcept
+	{
+		return mPath;
+	}
+
 	std::wstring file_notify_info::get_file_name_wstring() const
 	{
 		return mPath.filename().wstring();
@@ -44,7 +49,7 @@ namespace died
 
 	size_t file_notify_info::alive() const
 	{
-		std::chrono::duration<double, std::milli> diff = std::chrono::steady_clock::now() - mCreatedTime;
+		std::chrono::duration<double, std::milli> diff = event_clock::now() - mCreatedTime;
 		return static_cast<size_t>(diff.count());
 	}
 
@@ -52,4 +57,14 @@ namespace died
 	{
 		return mCreatedTime;
 	}
+
+	void file_notify_info::stamp(event_stage stage, event_clock::time_point time) noexcept
+	{
+		mStamps[static_cast<size_t>(stage)] = time;
+	}
+
+	event_stamps const& file_notify_info::get_stamps() const noexcept
+	{
+		return mStamps;
+	}
 }
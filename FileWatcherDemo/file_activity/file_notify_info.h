@@ -1,6 +1,7 @@
 #pragma once
 
 #include "std_filesystem.h"
+#include "event_clock.h"
 #include <chrono>
 
 namespace died
@@ -18,6 +19,7 @@ namespace died
 		unsigned long get_action() const noexcept;
 		unsigned long get_size() const noexcept;
 		std::wstring get_path_wstring() const;
+		std::filesystem::path const& get_path() const noexcept;		// no copy
 		std::wstring get_file_name_wstring() const;
 		std::wstring get_parent_path_wstring() const;
 		bool is_directory() const;
@@ -25,6 +27,10 @@ namespace died
 		size_t alive() const; // in milli-seconds
 		std::chrono::time_point<std::chrono::steady_clock> get_created_time() const;
 
+		// pipeline latency, every stage starts at the creation time
+		void stamp(event_stage stage, event_clock::time_point time) noexcept;
+		event_stamps const& get_stamps() const noexcept;
+
 		friend bool operator==(file_notify_info const&, file_notify_info const&);
 
 	private:
@@ -32,6 +38,7 @@ namespace died
 		unsigned long mAction{};
 		unsigned long mSize{};
 		std::chrono::time_point<std::chrono::steady_clock> mCreatedTime;
+		event_stamps mStamps{};
 	};
 
 	bool operator==(file_notify_info const& lhs, file_notify_info const& rhs);
@@ -41,7 +48,9 @@ namespace died
 		mPath{ std::forward<StringAble>(s) },
 		mAction{ action },
 		mSize{ size },
-		mCreatedTime{ (std::chrono::steady_clock::now()) }
-	{}
+		mCreatedTime{ (event_clock::now()) }
+	{
+		mStamps.fill(mCreatedTime);
+	}
 }
 
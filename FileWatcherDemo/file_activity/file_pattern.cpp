@@ -0,0 +1,140 @@
+#include "file_pattern.h"
+#include <Windows.h>
+
+namespace died
+{
+	namespace
+	{
+		constexpr size_t STEP_WINDOW = 1000;		// milli-second
+		constexpr size_t CHANGE_WINDOW = 3000;		// milli-second
+		constexpr size_t DOWNLOAD_WINDOW = 3600000;	// milli-second, download may take long
+
+		constexpr unsigned long ADDED = FILE_ACTION_ADDED;
+		constexpr unsigned long REMOVED = FILE_ACTION_REMOVED;
+		constexpr unsigned long MODIFIED = FILE_ACTION_MODIFIED;
+
+		using rel = path_relation;
+		using side = path_ref::side;
+	}
+
+	std::vector<file_pattern> const& default_patterns()
+	{
+		static const std::vector<file_pattern> PATTERNS{
+			// Word save-as
+			//step 1: create - D:\test\8.docx
+			//step 2: rename - D:\test\8.docx => D:\test\8.docx~RF1994986.TMP
+			//step 3: rename - D:\test\~.tmp => D:\test\8.docx
+			//step 4: remove - D:\test\8.docx~RF1994986.TMP
+			{
+				L"Create Word save-as",
+				{ { ADDED, rel::none }, { ACTION_RENAMED, rel::same_path, CHANGE_WINDOW }, { ACTION_RENAMED, rel::rename_to_anchor, STEP_WINDOW } },
+				{ { 2, side::path }, { 2, side::old_name }, { 1, side::path } },
+				action_bit(ADDED) | action_bit(REMOVED) | action_bit(MODIFIED),
+				0,
+				3000,
+				500,
+				true
+			},
+			// Word save
+			//step 1: rename - D:\test\8.docx => D:\test\8.docx~RF1994986.TMP
+			//step 2: rename - D:\test\~.tmp => D:\test\8.docx
+			//step 3: remove - D:\test\8.docx~RF1994986.TMP
+			{
+				L"Modify Word save",
+				{ { ACTION_RENAMED, rel::none }, { ACTION_RENAMED, rel::rename_to_anchor, STEP_WINDOW } },
+				{ { 1, side::path }, { 1, side::old_name }, { 0, side::path } },
+				action_bit(ADDED) | action_bit(REMOVED) | action_bit(MODIFIED),
+				0,
+				3000,
+				500,
+				true
+			},
+			// Brower download file auto-save
+			//step 1: rename - D:\test\9be830ee.tmp => D:\test\1.jpg.crdownload
+			//step 2: modify - D:\test\1.jpg.crdownload
+			//step 3: rename - D:\test\1.jpg.crdownload => D:\test\1.jpg
+			//step 4: modify - D:\test\1.jpg
+			{
+				L"Create download auto-save",
+				{ { ACTION_RENAMED, rel::none }, { ACTION_RENAMED, rel::rename_from_last, DOWNLOAD_WINDOW } },
+				{ { 1, side::path }, { 1, side::old_name }, { 0, side::old_name } },
+				action_bit(MODIFIED),
+				0,
+				3000,
+				500,
+				true
+			},
+			// Excel save-as => save
+			// Actually, there is more 2 rename events, assume it is create
+			{
+				L"Create excel save-as",
+				{ { ACTION_RENAMED, rel::none }, { ACTION_RENAMED, rel::rename_family, STEP_WINDOW } },
+				{ { 0, side::path }, { 0, side::old_name } },
+				action_bit(ADDED) | action_bit(REMOVED) | action_bit(MODIFIED) | action_bit(ACTION_RENAMED),
+				0,
+				3000,
+				1000,
+				true
+			},
+			// Notepad, mspaint save-as
+			// receive: add -> remove -> add -> modify (-> modify)
+			{
+				L"Create by save-as",
+				{ { ADDED, rel::none }, { REMOVED, rel::same_path, STEP_WINDOW }, { ADDED, rel::same_path, STEP_WINDOW }, { MODIFIED, rel::same_path, STEP_WINDOW } },
+				{ { 0, side::path } },
+				action_bit(MODIFIED),
+				0,
+				3000,
+				300,
+				true
+			},
+			// Move, the parent path must differnt
+			// receive: add, delete (in the same disk)
+			// reveive: add, delete, modify (different disk)
+			{
+				L"Move",
+				{ { ADDED, rel::none }, { REMOVED, rel::same_name_other_dir, CHANGE_WINDOW } },
+				{ { 1, side::path }, { 0, side::path } },
+				action_bit(MODIFIED),
+				0,
+				3000,
+				300,
+				true
+			},
+			{
+				L"Move",
+				{ { REMOVED, rel::none }, { ADDED, rel::same_name_other_dir, CHANGE_WINDOW } },
+				{ { 0, side::path }, { 1, side::path } },
+				action_bit(MODIFIED),
+				0,
+				3000,
+				300,
+				true
+			},
+			// Edit image by mspaint
+			// receive: remove -> add
+			{
+				L"Modify without modify event",
+				{ { REMOVED, rel::none }, { ADDED, rel::same_path, STEP_WINDOW } },
+				{ { 1, side::path } },
+				action_bit(MODIFIED),
+				0,
+				3000,
+				300,
+				true
+			},
+			// Copy: add -> modify, never removed in between
+			{
+				L"Copy",
+				{ { ADDED, rel::none }, { MODIFIED, rel::same_path, CHANGE_WINDOW } },
+				{ { 0, side::path } },
+				action_bit(MODIFIED),
+				action_bit(REMOVED) | action_bit(ACTION_RENAMED),
+				3000,
+				1000,		// early only when no rename can follow, see directory_watcher_mgr::may_be_renamed
+				true
+			}
+		};
+		return PATTERNS;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace died
+{
+	// Synthetic action of a paired rename (old name + new name)
+	constexpr unsigned long ACTION_RENAMED = 0x10ul;
+
+	constexpr unsigned long action_bit(unsigned long action) noexcept
+	{
+		return 1ul << (action & 0x1F);
+	}
+
+	// How an event must relate to the events already matched by a pattern
+	enum class path_relation
+	{
+		none,					// first step
+		same_path,				// path (old name of a rename) equals the anchor path
+		rename_to_anchor,		// rename back to the anchor: new name == anchor, old name != last new name
+		rename_from_last,		// chained rename: old name == last new name, new name != anchor
+		rename_family,			// rename shares a name with the anchor rename
+		same_name_other_dir		// same file name in another parent path (any group)
+	};
+
+	struct pattern_step
+	{
+		unsigned long mAction{};
+		path_relation mRelation{ path_relation::none };
+		size_t mWindow{};		// milli-seconds since the previous step
+	};
+
+	// Which path of a matched step is reported
+	struct path_ref
+	{
+		enum class side { path, old_name };
+		size_t mStep{};
+		side mSide{ side::path };
+	};
+
+	// One recognizable file-operation sequence.
+	// Patterns are listed from the most specific one; when two completed matches
+	// share an event, the one declared first wins.
+	struct file_pattern
+	{
+		std::wstring mName;					// classification sent to server
+		std::vector<pattern_step> mSteps;
+		std::vector<path_ref> mReport;		// paths of the classification message
+		unsigned long mAbsorb{};			// actions on matched paths that keep a complete match
+		unsigned long mCancel{};			// actions on the anchor path that drop an incomplete match
+		size_t mQuiet{ 3000 };				// milli-seconds without new event before emitting
+		size_t mSettle{ 3000 };				// same, when no other match can still claim the events
+		bool mWaitStable{};					// report path must not be opened by other process
+	};
+
+	std::vector<file_pattern> const& default_patterns();
+}
@@ -0,0 +1,168 @@
+#include "filter_rules.h"
+#include "spdlog_header.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+
+namespace died
+{
+	namespace
+	{
+		std::string trim(std::string const& s)
+		{
+			auto first = s.find_first_not_of(" \t\r\n");
+			if (std::string::npos == first) {
+				return {};
+			}
+			auto last = s.find_last_not_of(" \t\r\n");
+			return s.substr(first, last - first + 1);
+		}
+
+		bool to_bool(std::string val)
+		{
+			std::transform(std::begin(val), std::end(val), std::begin(val), ::tolower);
+			return val == "1" || val == "true" || val == "yes" || val == "on";
+		}
+	}
+
+	filter_rules::filter_rules(std::wstring configPath, unsigned long interval) :
+		TaskTimer(interval),
+		mConfigPath{ std::move(configPath) }
+	{
+		// Always have a valid rule set, even before start()
+		publish(default_rules());
+	}
+
+	filter_rules::~filter_rules() noexcept
+	{
+		stop();
+	}
+
+	std::shared_ptr<const fat::UnnecessaryDirectory> filter_rules::current() const noexcept
+	{
+		return std::atomic_load_explicit(&mCurrent, std::memory_order_acquire);
+	}
+
+	unsigned int filter_rules::version() const noexcept
+	{
+		return mVersion.load(std::memory_order_relaxed);
+	}
+
+	void filter_rules::start()
+	{
+		reload();
+		startTimer();
+	}
+
+	void filter_rules::stop()
+	{
+		stopTimer();
+	}
+
+	TimerStatus filter_rules::onTimer()
+	{
+		std::error_code ec;
+		auto exist = std::filesystem::exists(mConfigPath, ec);
+		if (!exist) {
+			// File is removed => back to built-in rules once
+			if (mHasConfig) {
+				reload();
+			}
+			return TimerStatus::TIMER_CONTINUE;
+		}
+
+		auto writeTime = std::filesystem::last_write_time(mConfigPath, ec);
+		if (!ec && (!mHasConfig || writeTime != mLastWriteTime)) {
+			reload();
+		}
+		return TimerStatus::TIMER_CONTINUE;
+	}
+
+	bool filter_rules::reload()
+	{
+		std::error_code ec;
+		if (!std::filesystem::exists(mConfigPath, ec)) {
+			SPDLOG_INFO(L"Rule file not found, use default rules: {}", mConfigPath);
+			mHasConfig = false;
+			publish(default_rules());
+			return false;
+		}
+
+		mLastWriteTime = std::filesystem::last_write_time(mConfigPath, ec);
+		auto rule = compile(mConfigPath);
+		if (!rule) {
+			SPDLOG_WARN(L"Can't compile rule file, keep version {}: {}", version(), mConfigPath);
+			return false;
+		}
+
+		mHasConfig = true;
+		publish(std::move(rule));
+		SPDLOG_INFO(L"Published rule version {}: {}", version(), mConfigPath);
+		return true;
+	}
+
+	void filter_rules::publish(std::shared_ptr<const fat::UnnecessaryDirectory> rule)
+	{
+		// Old version may still be read by a watcher => freed by its last reader
+		std::lock_guard<std::mutex> lk(mSyncPublish);
+		std::atomic_store_explicit(&mCurrent, std::move(rule), std::memory_order_release);
+		++mVersion;
+	}
+
+	std::unique_ptr<fat::UnnecessaryDirectory> filter_rules::compile(std::wstring const& configPath)
+	{
+		// **format (UTF-8)
+		// # comment
+		// appdata = true
+		// exclude = C:\Program Files
+		std::ifstream file(std::filesystem::path{ configPath });
+		if (!file) {
+			return nullptr;
+		}
+
+		auto rule = std::make_unique<fat::UnnecessaryDirectory>();
+		std::string line;
+		unsigned int lineNo = 0;
+		while (std::getline(file, line)) {
+			++lineNo;
+			line = trim(line);
+			if (line.empty() || '#' == line[0] || ';' == line[0]) {
+				continue;
+			}
+
+			auto pos = line.find('=');
+			if (std::string::npos == pos) {
+				SPDLOG_WARN("Invalid rule at line {}", lineNo);
+				return nullptr;
+			}
+
+			auto key = trim(line.substr(0, pos));
+			auto val = trim(line.substr(pos + 1));
+			if ("exclude" == key && !val.empty()) {
+				rule->addUserDefinePath(std::filesystem::u8path(val).wstring());
+			}
+			else if ("appdata" == key) {
+				rule->setAppDataDir(to_bool(val));
+			}
+			else {
+				SPDLOG_WARN("Unknown rule '{}' at line {}", key, lineNo);
+				return nullptr;
+			}
+		}
+		return rule;
+	}
+
+	std::unique_ptr<fat::UnnecessaryDirectory> filter_rules::default_rules()
+	{
+		auto rule = std::make_unique<fat::UnnecessaryDirectory>();
+		rule->setAppDataDir(true);
+		rule->addUserDefinePath(L"C:\\Windows\\");
+		rule->addUserDefinePath(L"C:\\ProgramData\\");
+		rule->addUserDefinePath(L"C:\\project\\");
+		rule->addUserDefinePath(L"D:\\work\\");
+		rule->addUserDefinePath(L"D:\\share\\");
+		rule->addUserDefinePath(L"C:\\Program Files (x86)\\");
+		rule->addUserDefinePath(L"C:\\Program Files\\");
+		return rule;
+	}
+}
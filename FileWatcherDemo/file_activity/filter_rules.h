@@ -0,0 +1,55 @@
+#pragma once
+
+#include "unnecessary_directory.h"
+#include "task_timer.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace died
+{
+	// Published, versioned set of exclusion rules.
+	// A watcher calls current() once per notification buffer and holds the version for all of its entries.
+	// std::atomic_load of a shared_ptr is not lock-free (MSVC takes a global spin lock) and touches the
+	// shared reference count, so it is kept off the per-event path.
+	// The version a reader took stays alive until it drops it, however long it holds it.
+	// The rule file is polled on the timer thread; a changed file is compiled there
+	// and swapped in, so watchers pick up the new version on their next event.
+	class filter_rules final : public died::TaskTimer
+	{
+	public:
+		explicit filter_rules(std::wstring configPath, unsigned long interval = 2000ul);
+		~filter_rules() noexcept;
+
+		filter_rules(filter_rules const&) = delete;
+		filter_rules& operator=(filter_rules const&) = delete;
+
+		std::shared_ptr<const fat::UnnecessaryDirectory> current() const noexcept;
+		unsigned int version() const noexcept;
+
+		// Load the config file now. Fall back to built-in rules when it is missing.
+		bool reload();
+
+		void start();
+		void stop();
+
+		static std::unique_ptr<fat::UnnecessaryDirectory> compile(std::wstring const& configPath);
+		static std::unique_ptr<fat::UnnecessaryDirectory> default_rules();
+
+	private:
+		TimerStatus onTimer() final;
+		void publish(std::shared_ptr<const fat::UnnecessaryDirectory> rule);
+
+	private:
+		std::wstring mConfigPath;
+		std::shared_ptr<const fat::UnnecessaryDirectory> mCurrent;	// std::atomic_load / atomic_store only
+		std::atomic_uint mVersion{};
+
+		// Writer side only
+		std::mutex mSyncPublish;
+		std::filesystem::file_time_type mLastWriteTime{};
+		bool mHasConfig{};
+	};
+}
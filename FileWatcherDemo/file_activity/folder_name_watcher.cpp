@@ -1,11 +1,12 @@
 #include "folder_name_watcher.h"
-#include "spdlog_header.h"
+#include "event_journal.h"
 
 namespace died
 {
 	void folder_name_watcher::do_notify(file_notify_info info)
 	{
-		SPDLOG_DEBUG(L"{} - {}", info.get_action(), info.get_path_wstring());
+		JOURNAL_DEBUG(folder_name, info.get_action(), info.get_path_wstring());
+		info.stamp(event_stage::insert, event_clock::now());
 		switch (info.get_action())
 		{
 		case FILE_ACTION_ADDED:
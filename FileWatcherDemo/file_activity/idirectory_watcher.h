@@ -2,6 +2,7 @@
 
 #include "file_notify_info.h"
 #include <memory>
+#include <vector>
 
 namespace died
 {
@@ -10,12 +11,20 @@ namespace died
 	public:
 		virtual ~idirectory_watcher() noexcept = default;
 
+		// One buffer of ReadDirectoryChangesW: the per-buffer state is taken once for all of its entries
+		void notify(std::vector<file_notify_info>& infos)
+		{
+			filter_notify(infos);
+		}
+
 		void notify(file_notify_info&& info)
 		{
-			filter_notify(std::move(info));
+			std::vector<file_notify_info> infos;
+			infos.push_back(std::move(info));
+			filter_notify(infos);
 		}
 
 	private:
-		virtual void filter_notify(file_notify_info info) = 0;
+		virtual void filter_notify(std::vector<file_notify_info>& infos) = 0;
 	};
 }
\ No newline at end of file
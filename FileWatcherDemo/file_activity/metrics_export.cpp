@@ -0,0 +1,54 @@
+#include "metrics_export.h"
+#include "pipeline_metrics.h"
+#include "spdlog_header.h"
+
+namespace died
+{
+	metrics_export::metrics_export(lines_fn latency, size_t dumpInterval, unsigned long interval) :
+		TaskTimer(interval),
+		mLatency{ std::move(latency) },
+		mDumpInterval{ dumpInterval },
+		mLastDump{ event_clock::now() }
+	{}
+
+	metrics_export::~metrics_export() noexcept
+	{
+		stop();
+	}
+
+	void metrics_export::set_file(std::wstring path, size_t interval, text_fn text)
+	{
+		mFile = std::move(path);
+		mFileInterval = interval;
+		mText = std::move(text);
+	}
+
+	void metrics_export::start()
+	{
+		startTimer();
+	}
+
+	void metrics_export::stop()
+	{
+		stopTimer();
+	}
+
+	TimerStatus metrics_export::onTimer()
+	{
+		auto now = event_clock::now();
+		if (!mFile.empty() && now - mLastFile >= std::chrono::milliseconds(mFileInterval)) {
+			mLastFile = now;
+			if (!pipeline_metrics::write_file(mFile, mText())) {
+				SPDLOG_WARN(L"Can't write metrics file: {}", mFile);
+			}
+		}
+
+		if (mLatency && now - mLastDump >= std::chrono::milliseconds(mDumpInterval)) {
+			mLastDump = now;
+			for (auto const& el : mLatency()) {
+				SPDLOG_INFO(el);
+			}
+		}
+		return TimerStatus::TIMER_CONTINUE;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "event_clock.h"
+#include "task_timer.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace died
+{
+	// Periodic exports of directory_watcher_mgr on their own timer thread: the Prometheus text file
+	// and the stage latency log. Collecting the text takes the model locks and the file is written
+	// then moved, so a slow disk or log never delays a classification round.
+	class metrics_export final : public died::TaskTimer
+	{
+	public:
+		using text_fn = std::function<std::string()>;
+		using lines_fn = std::function<std::vector<std::wstring>()>;
+
+		static constexpr size_t LATENCY_DUMP = 60000;	// milli-second
+
+		explicit metrics_export(lines_fn latency, size_t dumpInterval = LATENCY_DUMP, unsigned long interval = 1000ul);
+		~metrics_export() noexcept;
+
+		metrics_export(metrics_export const&) = delete;
+		metrics_export& operator=(metrics_export const&) = delete;
+
+		// Before start(): 'text' rewritten in 'path' every 'interval' milli-seconds
+		void set_file(std::wstring path, size_t interval, text_fn text);
+
+		void start();
+		void stop();
+
+	private:
+		TimerStatus onTimer() final;
+
+	private:
+		lines_fn mLatency;
+		size_t mDumpInterval{};
+		event_clock::time_point mLastDump;		// timer thread only
+
+		std::wstring mFile;
+		size_t mFileInterval{};
+		text_fn mText;
+		event_clock::time_point mLastFile;		// timer thread only
+	};
+}
\ No newline at end of file
@@ -27,4 +27,18 @@ namespace died
 	{
 		return mData.next_available_item();
 	}
+
+	unsigned int model_file_info::size() const
+	{
+		unsigned int count = 0;
+		mData.loop_all([&count](auto const&) {
+			++count;
+		});
+		return count;
+	}
+
+	unsigned long long model_file_info::overwrites() const noexcept
+	{
+		return mData.overwrites();
+	}
 }
\ No newline at end of file
@@ -23,6 +23,10 @@ namespace died
 		void erase(std::wstring const& key);
 		unsigned int next_available_item();
 
+		// metrics
+		unsigned int size() const;
+		unsigned long long overwrites() const noexcept;
+
 	private:
 		file_info_map mData;
 	};
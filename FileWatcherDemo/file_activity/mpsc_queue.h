@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace died
+{
+	// Bounded lock-free queue, any thread pushes, one thread pops.
+	// A slot is free for the producer at position p when its sequence is p,
+	// readable by the consumer when it is p + 1. A full queue refuses the push, never blocks.
+	template<class T>
+	class mpsc_queue final
+	{
+		struct slot
+		{
+			std::atomic<size_t> mSeq{};
+			T mValue{};
+		};
+
+	public:
+		explicit mpsc_queue(size_t capacity)		// rounded up to a power of two, at least 64
+		{
+			size_t size = 64;
+			while (size < capacity) {
+				size <<= 1;
+			}
+			mSlots = std::make_unique<slot[]>(size);
+			for (size_t i = 0; i < size; ++i) {
+				mSlots[i].mSeq.store(i, std::memory_order_relaxed);
+			}
+			mMask = size - 1;
+		}
+
+		// fill(T&) writes the claimed slot, its old value is there to reuse
+		template<class Fill>
+		bool push(Fill&& fill)
+		{
+			auto pos = mTail.load(std::memory_order_relaxed);
+			slot* claimed = nullptr;
+			for (;;) {
+				claimed = &mSlots[pos & mMask];
+				auto seq = claimed->mSeq.load(std::memory_order_acquire);
+				auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+				if (!diff) {
+					if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (diff < 0) {
+					return false;
+				}
+				else {
+					pos = mTail.load(std::memory_order_relaxed);
+				}
+			}
+			fill(claimed->mValue);
+			claimed->mSeq.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// consumer thread only: read(T&) gets the front value, the slot is released after it
+		template<class Read>
+		bool pop(Read&& read)
+		{
+			auto head = mHead.load(std::memory_order_relaxed);
+			auto& front = mSlots[head & mMask];
+			if (front.mSeq.load(std::memory_order_acquire) != head + 1) {
+				return false;
+			}
+			read(front.mValue);
+			front.mSeq.store(head + mMask + 1, std::memory_order_release);
+			mHead.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		size_t capacity() const noexcept
+		{
+			return mMask + 1;
+		}
+
+		// claimed and not popped yet, any thread
+		size_t size() const noexcept
+		{
+			auto head = mHead.load(std::memory_order_acquire);
+			auto tail = mTail.load(std::memory_order_relaxed);
+			return tail > head ? tail - head : 0;
+		}
+
+	private:
+		std::unique_ptr<slot[]> mSlots;
+		size_t mMask{};
+		std::atomic<size_t> mTail{};
+		std::atomic<size_t> mHead{};	// written by the consumer only
+	};
+}
\ No newline at end of file
@@ -1,10 +1,294 @@
 #include "notify_to_server.h"
+#include "event_journal.h"
+#include "event_probes.h"
+#include "event_tracer.h"
 #include "spdlog_header.h"
+#include <exception>
 
 namespace died
 {
-	void notify_to_server::send(const std::wstring& action, const std::wstring& path) const
+	namespace
 	{
-		SPDLOG_INFO(L"{} - {}", action, path);
+		// The path text the consumers received before classified_event
+		std::wstring legacy_path(classified_event const& ev)
+		{
+			std::wstring result;
+			switch (ev.mKind)
+			{
+			case event_kind::rename_only:
+			case event_kind::folder_move:
+				result.append(ev.mOldPath).append(L", ").append(ev.mPath);
+				break;
+			case event_kind::create_rename:
+				result.append(ev.mPath).append(L", ").append(ev.mOldPath);
+				break;
+			case event_kind::pattern:
+				result.append(ev.mPath);
+				for (auto el : { ev.mOldPath, ev.mAuxPath }) {
+					if (!el.empty()) {
+						result.append(L", ").append(el);
+					}
+				}
+				break;
+			default:
+				result.append(ev.mPath);
+				break;
+			}
+			return result;
+		}
+	}
+
+	std::wstring notify_message::path() const
+	{
+		return mEvent ? legacy_path(*mEvent) : std::wstring{ mSubject };
+	}
+
+	double speculation_stats::retraction_rate() const noexcept
+	{
+		auto resolved = mConfirmed + mRetracted + mReplaced;
+		return resolved ? static_cast<double>(mRetracted + mReplaced) / resolved : 0.0;
+	}
+
+	void notify_to_server::add_consumer(std::wstring name, bool speculative, deliver_fn deliver)
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		// a post() in progress keeps delivering to the list it took
+		auto consumers = mConsumers ? std::make_shared<std::vector<consumer>>(*mConsumers) : std::make_shared<std::vector<consumer>>();
+		consumers->push_back({ std::move(name), speculative, std::move(deliver) });
+		mConsumers = std::move(consumers);
+		mHasConsumers = true;
+		if (speculative) {
+			mSpeculative = true;
+		}
+	}
+
+	bool notify_to_server::speculative() const noexcept
+	{
+		return mSpeculative.load(std::memory_order_relaxed);
+	}
+
+	unsigned long long notify_to_server::provisional(const std::wstring& action, const std::wstring& subject, time_point time)
+	{
+		if (!speculative()) {
+			return 0;
+		}
+
+		unsigned long long seq{};
+		{
+			std::lock_guard<std::mutex> lk(mSync);
+
+			// already guessed => same sequence, no new message
+			auto found = mGuesses.find(subject);
+			if (std::end(mGuesses) != found) {
+				return found->second.mSeq;
+			}
+
+			seq = ++mNextSeq;
+			mGuesses.emplace(subject, guess{ seq, action, time });
+			++mStats.mProvisional;
+			TRACE_INSTANT("provisional");
+			JOURNAL_DEBUG(provisional, seq, action, subject);
+			dispatch({ notify_kind::provisional, seq, audience::speculative, nullptr, action, subject });
+		}
+		post();
+		return seq;
+	}
+
+	void notify_to_server::deliver(std::vector<classified_event> const& events)
+	{
+		TRACE_SCOPE("send");
+		for (auto const& ev : events) {
+			// decoded like the legacy text: source first for a rename or a move
+			auto sourceFirst = event_kind::rename_only == ev.mKind || event_kind::folder_move == ev.mKind;
+			JOURNAL_INFO(sent, ev.mStillOpen ? 1 : 0, *ev.mName, sourceFirst ? ev.mOldPath : ev.mPath, sourceFirst ? ev.mPath : ev.mOldPath);
+		}
+		if (!mHasConsumers) {
+			for (auto const& ev : events) {
+				probe_send(*ev.mName, ev.mPath, ev.mStillOpen, 0);
+			}
+			return;
+		}
+
+		// one owning copy, outside the lock: the consumers may get the events after this call
+		auto held = std::make_unique<event_batch>();
+		for (auto const& ev : events) {
+			held->add(ev);
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(mSync);
+			for (auto const& ev : held->events()) {
+				resolve(ev);
+			}
+			mHeld.push_back(std::move(held));
+		}
+		post();
+	}
+
+	void notify_to_server::resolve(classified_event const& ev)
+	{
+		// 1. the first guess on the reported paths is resolved by this event
+		auto found = std::end(mGuesses);
+		if (!mGuesses.empty()) {
+			for (auto el : { ev.mPath, ev.mOldPath, ev.mAuxPath }) {
+				if (!el.empty() && std::end(mGuesses) != (found = mGuesses.find(std::wstring{ el }))) {
+					break;
+				}
+			}
+		}
+		if (std::end(mGuesses) == found) {
+			probe_send(*ev.mName, ev.mPath, ev.mStillOpen, 0);
+			dispatch({ notify_kind::final, 0, audience::all, &ev });
+			return;
+		}
+
+		auto seq = found->second.mSeq;
+		probe_send(*ev.mName, ev.mPath, ev.mStillOpen, seq);
+		dispatch({ notify_kind::final, seq, audience::plain, &ev });
+		if (found->second.mAction == *ev.mName) {
+			++mStats.mConfirmed;
+			dispatch({ notify_kind::confirm, seq, audience::speculative, &ev });
+		}
+		else {
+			++mStats.mReplaced;
+			dispatch({ notify_kind::replace, seq, audience::speculative, &ev });
+		}
+		mGuesses.erase(found);
+
+		// 2. other guesses on the same event were wrong
+		for (auto el : { ev.mPath, ev.mOldPath, ev.mAuxPath }) {
+			if (el.empty() || mGuesses.empty()) {
+				continue;
+			}
+			auto other = mGuesses.find(std::wstring{ el });
+			if (std::end(mGuesses) != other) {
+				retract(other);
+			}
+		}
+	}
+
+	void notify_to_server::settle(const std::wstring& subject)
+	{
+		if (!speculative()) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(mSync);
+			auto found = mGuesses.find(subject);
+			if (std::end(mGuesses) != found) {
+				retract(found);
+			}
+		}
+		post();
+	}
+
+	void notify_to_server::expire(time_point now, size_t maxAge)
+	{
+		if (!speculative()) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(mSync);
+			for (auto it = std::begin(mGuesses); it != std::end(mGuesses);) {
+				auto cur = it++;
+				if (now - cur->second.mTime > std::chrono::milliseconds(maxAge)) {
+					retract(cur);
+				}
+			}
+		}
+		post();
+	}
+
+	speculation_stats notify_to_server::stats() const
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		return mStats;
+	}
+
+	size_t notify_to_server::pending() const
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		return mGuesses.size();
+	}
+
+	unsigned long long notify_to_server::failures() const noexcept
+	{
+		return mFailures.load(std::memory_order_relaxed);
+	}
+
+	void notify_to_server::dispatch(outgoing&& item)
+	{
+		if (mConsumers) {
+			mOutbox.push_back(std::move(item));
+		}
+	}
+
+	void notify_to_server::post()
+	{
+		if (!mHasConsumers) {
+			return;
+		}
+
+		// the thread finding the outbox free delivers it, the others leave their messages to it: one at a time, in order
+		std::vector<outgoing> batch;
+		std::vector<std::unique_ptr<event_batch>> held;
+		std::shared_ptr<const std::vector<consumer>> consumers;
+		for (;;) {
+			{
+				std::lock_guard<std::mutex> lk(mSync);
+				if (!batch.empty()) {
+					mPosting = false;		// delivered by this thread
+					batch.clear();
+					held.clear();
+				}
+				if (mPosting || mOutbox.empty()) {
+					return;
+				}
+				mPosting = true;
+				batch.swap(mOutbox);
+				held.swap(mHeld);
+				consumers = mConsumers;
+			}
+
+			for (auto const& item : batch) {
+				notify_message msg{ item.mKind, item.mSeq };
+				if (item.mEvent) {
+					msg.mAction = *item.mEvent->mName;
+					msg.mEvent = item.mEvent;
+					msg.mStillOpen = item.mEvent->mStillOpen;
+				}
+				else {
+					msg.mAction = item.mAction;
+					msg.mSubject = item.mSubject;
+				}
+				for (auto const& el : *consumers) {
+					if ((audience::speculative == item.mTo && !el.mSpeculative) || (audience::plain == item.mTo && el.mSpeculative)) {
+						continue;
+					}
+					// a failing consumer must not stop the delivery: mPosting is reset by this loop only
+					try {
+						el.mDeliver(msg);
+					}
+					catch (std::exception const& e) {
+						++mFailures;
+						SPDLOG_ERROR("Consumer failed. seq: {}, error: {}", msg.mSeq, e.what());
+					}
+					catch (...) {
+						++mFailures;
+						SPDLOG_ERROR("Consumer failed. seq: {}", msg.mSeq);
+					}
+				}
+			}
+		}
+	}
+
+	void notify_to_server::retract(std::unordered_map<std::wstring, guess>::iterator it)
+	{
+		++mStats.mRetracted;
+		JOURNAL_DEBUG(retracted, it->second.mSeq, it->second.mAction, it->first);
+		dispatch({ notify_kind::retract, it->second.mSeq, audience::speculative, nullptr, it->second.mAction, it->first });
+		mGuesses.erase(it);
 	}
 }
\ No newline at end of file
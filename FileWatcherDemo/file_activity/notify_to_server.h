@@ -1,11 +1,122 @@
 #pragma once
+#include "classified_event.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace died
 {
-	class notify_to_server
+	enum class notify_kind
 	{
+		final,			// classified event
+		provisional,	// early guess, resolved later by confirm / retract / replace of the same sequence
+		confirm,
+		retract,
+		replace			// the guess was wrong, mAction and mPath are the final classification
+	};
+
+	// One message to a consumer, valid during the call only: a consumer copies what it keeps.
+	// A final event comes typed, its text is rendered on the consumer side by path().
+	struct notify_message
+	{
+		notify_kind mKind{ notify_kind::final };
+		unsigned long long mSeq{};		// sequence of the provisional event, 0 if none
+		std::wstring_view mAction;		// classification, the guessed one for provisional / retract
+		classified_event const* mEvent{};	// final, confirm, replace
+		std::wstring_view mSubject;		// provisional, retract: the guessed file
+		bool mStillOpen{};				// reported after the longest wait, the file is still opened by other process
+
+		std::wstring path() const;		// text of the legacy message: "old, new" for a rename...
+	};
+
+	struct speculation_stats
+	{
+		unsigned long long mProvisional{};
+		unsigned long long mConfirmed{};
+		unsigned long long mRetracted{};
+		unsigned long long mReplaced{};
+
+		double retraction_rate() const noexcept;	// wrong guesses over resolved guesses
+	};
+
+	// Sends the classified events to the consumers.
+	// A speculative consumer also receives a provisional event as soon as a file
+	// is created, then its confirm, retract or replace once the correlation window closes.
+	// The others only receive final events.
+	// As an event_sink, the batch is copied once for the consumers, no text is built for them here.
+	class notify_to_server : public event_sink
+	{
+		using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+		struct consumer
+		{
+			std::wstring mName;
+			bool mSpeculative{};
+			std::function<void(notify_message const&)> mDeliver;
+		};
+
+		enum class audience { all, speculative, plain };
+
+		struct guess
+		{
+			unsigned long long mSeq{};
+			std::wstring mAction;
+			time_point mTime;
+		};
+
+		struct outgoing
+		{
+			notify_kind mKind{};
+			unsigned long long mSeq{};
+			audience mTo{};
+			classified_event const* mEvent{};	// in mHeld
+			std::wstring mAction;				// guess
+			std::wstring mSubject;
+		};
+
 	public:
-		void send(const std::wstring& action, const std::wstring& path) const;
+		using deliver_fn = std::function<void(notify_message const&)>;
+
+		// Any time, usually before watching. 'deliver' is called from the observer and correlation threads,
+		// one at a time, in order and without the lock held: it may call stats() or pending().
+		// An exception out of 'deliver' is counted and logged, the other messages are still delivered
+		void add_consumer(std::wstring name, bool speculative, deliver_fn deliver);
+		bool speculative() const noexcept;
+
+		// Observer threads: early guess on 'subject', 0 when no consumer wants it
+		unsigned long long provisional(const std::wstring& action, const std::wstring& subject, time_point time);
+
+		// Correlation workers
+		void settle(const std::wstring& subject);		// processed without report => retract its guess
+		void expire(time_point now, size_t maxAge);		// guesses of events never processed
+		void deliver(std::vector<classified_event> const& events) final;	// one lock for the batch
+		speculation_stats stats() const;
+		size_t pending() const;		// provisional events waiting for their final classification
+		unsigned long long failures() const noexcept;	// exceptions thrown by the consumers
+
+	private:
+		void resolve(classified_event const& ev);
+		void dispatch(outgoing&& item);		// under mSync, sent by post()
+		void post();
+		void retract(std::unordered_map<std::wstring, guess>::iterator it);
+
+	private:
+		mutable std::mutex mSync;
+		std::shared_ptr<const std::vector<consumer>> mConsumers;	// under mSync, replaced by add_consumer()
+		std::atomic<bool> mHasConsumers{};
+		std::atomic<unsigned long long> mFailures{};
+		std::vector<outgoing> mOutbox;						// under mSync
+		std::vector<std::unique_ptr<event_batch>> mHeld;	// under mSync: the events of mOutbox
+		bool mPosting{};									// under mSync: one thread delivers the outbox
+		std::atomic<bool> mSpeculative{};
+		std::unordered_map<std::wstring, guess> mGuesses;	// subject => pending guess
+		unsigned long long mNextSeq{};
+		speculation_stats mStats;
 	};
-}
+}
\ No newline at end of file
@@ -0,0 +1,432 @@
+#include "path_state_table.h"
+#include "event_probes.h"
+#include <algorithm>
+#include <Windows.h>
+
+namespace died
+{
+	namespace
+	{
+		size_t elapsed_ms(std::chrono::time_point<std::chrono::steady_clock> from)
+		{
+			std::chrono::duration<double, std::milli> diff = event_clock::now() - from;
+			return static_cast<size_t>(diff.count());
+		}
+
+		size_t index_of(path_action action) noexcept
+		{
+			return static_cast<size_t>(action);
+		}
+
+		// a pending remove / rename may still change the meaning of the other events of its folder
+		constexpr unsigned int UNSETTLED = pending_bit(path_action::removed) | pending_bit(path_action::renamed);
+	}
+
+	path_state::operator bool() const noexcept
+	{
+		return !mPath.empty() && mPending > 0;
+	}
+
+	bool path_state::has(path_action action) const noexcept
+	{
+		return has_any(pending_bit(action));
+	}
+
+	bool path_state::has_any(unsigned int mask) const noexcept
+	{
+		return (mPending & mask) != 0;
+	}
+
+	path_state::time_point path_state::time_of(path_action action) const noexcept
+	{
+		return mTime[index_of(action)];
+	}
+
+	path_state::time_point path_state::since(path_action action) const noexcept
+	{
+		return mSince[index_of(action)];
+	}
+
+	path_state::time_point path_state::last_time() const noexcept
+	{
+		return *std::max_element(std::begin(mTime), std::end(mTime));
+	}
+
+	size_t path_state::alive(path_action action) const
+	{
+		return elapsed_ms(time_of(action));
+	}
+
+	size_t path_state::waiting(path_action action) const
+	{
+		return elapsed_ms(mSince[index_of(action)]);
+	}
+
+	std::wstring path_state::get_file_name_wstring() const
+	{
+		return std::filesystem::path(mPath).filename().wstring();
+	}
+
+	std::wstring path_state::get_parent_path_wstring() const
+	{
+		return std::filesystem::path(mPath).parent_path().wstring();
+	}
+
+	rename_link::operator bool() const noexcept
+	{
+		return !mOldName.empty() && !mNewName.empty();
+	}
+
+	size_t rename_link::alive() const
+	{
+		return elapsed_ms(mTime);
+	}
+
+	unsigned int rename_family(rename_link const& link, path_state const& oldName, path_state const& newName)
+	{
+		// renames touching the old name
+		auto family = static_cast<unsigned int>(oldName.mRenamedTo.size() + oldName.mRenamedFrom.size());
+
+		// plus renames touching the new name, except the ones already counted
+		for (auto const& el : newName.mRenamedTo) {
+			if (el != link.mOldName) {
+				++family;
+			}
+		}
+		for (auto const& el : newName.mRenamedFrom) {
+			if (el != link.mOldName) {
+				++family;
+			}
+		}
+		return family;
+	}
+
+	/************************************************************************************************/
+
+	path_state_table::path_state_table(size_t capacity) :
+		mCapacity{ std::max<size_t>(capacity, 8) }
+	{}
+
+	void path_state_table::push(path_action action, file_notify_info const& info)
+	{
+		auto key = info.get_path_wstring();
+		auto bit = pending_bit(action);
+
+		std::lock_guard<std::mutex> lk(mSync);
+		auto& item = get_entry(key);
+		if (!item.mState.has(action)) {
+			item.mState.mSince[index_of(action)] = info.get_created_time();
+		}
+		set_pending(item.mState, item.mState.mPending | bit);
+		item.mState.mTime[index_of(action)] = info.get_created_time();
+		item.mState.mStamps = info.get_stamps();
+		item.mState.mStamps[static_cast<size_t>(event_stage::insert)] = event_clock::now();
+		probe_insert(key, item.mState.mPending);
+
+		// Already queued => keep its position, like an update of the old model
+		if (item.mQueued & bit) {
+			return;
+		}
+		item.mQueued |= bit;
+
+		auto& queue = mQueues[index_of(action)];
+		queue.push_back(std::move(key));
+
+		// Too many pending paths => drop the oldest one
+		if (queue.size() > mCapacity) {
+			mDropped.fetch_add(1, std::memory_order_relaxed);
+			auto oldest = std::move(queue.front());
+			queue.pop_front();
+			probe_evict(oldest, bit, evict_reason::overflow);
+			auto found = mEntries.find(oldest);
+			if (std::end(mEntries) != found) {
+				found->second.mQueued &= ~bit;
+			}
+			clear_bits(oldest, bit);
+		}
+	}
+
+	void path_state_table::push_rename(rename_link link)
+	{
+		auto bit = pending_bit(path_action::renamed);
+		std::lock_guard<std::mutex> lk(mSync);
+		link.mStamps[static_cast<size_t>(event_stage::insert)] = event_clock::now();
+
+		// Same rename again => refresh its time only
+		auto found = std::find_if(std::begin(mRenames), std::end(mRenames), [&link](auto const& item) {
+			return item.mOldName == link.mOldName && item.mNewName == link.mNewName;
+		});
+		if (std::end(mRenames) != found) {
+			if (is_linked(*found)) {
+				found->mTime = link.mTime;
+				return;
+			}
+			mRenames.erase(found);
+		}
+
+		auto& from = get_entry(link.mOldName).mState;
+		if (!from.has(path_action::renamed)) {
+			from.mSince[index_of(path_action::renamed)] = link.mTime;
+		}
+		set_pending(from, from.mPending | bit);
+		from.mTime[index_of(path_action::renamed)] = link.mTime;
+		from.mStamps = link.mStamps;
+		from.mRenamedTo.push_back(link.mNewName);
+
+		auto& to = get_entry(link.mNewName).mState;
+		if (!to.has(path_action::renamed)) {
+			to.mSince[index_of(path_action::renamed)] = link.mTime;
+		}
+		set_pending(to, to.mPending | bit);
+		to.mTime[index_of(path_action::renamed)] = link.mTime;
+		to.mStamps = link.mStamps;
+		to.mRenamedFrom.push_back(link.mOldName);
+		probe_insert(link.mOldName, from.mPending);
+		probe_insert(link.mNewName, to.mPending);
+
+		mRenames.push_back(std::move(link));
+
+		// Too many pending renames => drop the oldest one
+		if (mRenames.size() > mCapacity) {
+			mDropped.fetch_add(1, std::memory_order_relaxed);
+			auto oldest = std::move(mRenames.front());
+			mRenames.pop_front();
+			probe_evict(oldest.mOldName, bit, evict_reason::overflow);
+			probe_evict(oldest.mNewName, bit, evict_reason::overflow);
+			unlink_internal(oldest.mOldName, oldest.mNewName);
+		}
+	}
+
+	path_state path_state_table::find(std::wstring const& key) const
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		auto found = mEntries.find(key);
+		return (std::end(mEntries) != found) ? found->second.mState : path_state{};
+	}
+
+	path_state path_state_table::find_by_name(path_action action, std::wstring const& fileName, std::wstring const& otherThanParent) const
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		auto range = mNames.equal_range(fileName);
+		for (auto it = range.first; it != range.second; ++it) {
+			auto found = mEntries.find(it->second);
+			if (std::end(mEntries) == found) {
+				continue;
+			}
+			auto const& state = found->second.mState;
+			if (state.has(action) && state.get_parent_path_wstring() != otherThanParent) {
+				return state;
+			}
+		}
+		return path_state{};
+	}
+
+	path_state path_state_table::front(path_action action)
+	{
+		auto bit = pending_bit(action);
+		auto& queue = mQueues[index_of(action)];
+
+		std::lock_guard<std::mutex> lk(mSync);
+		while (!queue.empty()) {
+			auto found = mEntries.find(queue.front());
+			if (std::end(mEntries) != found && found->second.mState.has(action)) {
+				return found->second.mState;
+			}
+
+			// erased meanwhile => drop from the queue
+			queue.pop_front();
+			if (std::end(mEntries) != found) {
+				found->second.mQueued &= ~bit;
+				release(found);
+			}
+		}
+		return path_state{};
+	}
+
+	void path_state_table::next(path_action action)
+	{
+		auto bit = pending_bit(action);
+		auto& queue = mQueues[index_of(action)];
+
+		std::lock_guard<std::mutex> lk(mSync);
+		if (queue.empty()) {
+			return;
+		}
+
+		// still pending => visit it again after the others
+		auto key = std::move(queue.front());
+		queue.pop_front();
+		auto found = mEntries.find(key);
+		if (std::end(mEntries) == found) {
+			return;
+		}
+		if (found->second.mState.has(action)) {
+			queue.push_back(std::move(key));
+		}
+		else {
+			found->second.mQueued &= ~bit;
+			release(found);
+		}
+	}
+
+	rename_link path_state_table::front_rename()
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		while (!mRenames.empty()) {
+			if (is_linked(mRenames.front())) {
+				return mRenames.front();
+			}
+			mRenames.pop_front();
+		}
+		return rename_link{};
+	}
+
+	void path_state_table::next_rename()
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		if (mRenames.empty()) {
+			return;
+		}
+
+		auto link = std::move(mRenames.front());
+		mRenames.pop_front();
+		if (is_linked(link)) {
+			mRenames.push_back(std::move(link));
+		}
+	}
+
+	void path_state_table::erase(std::wstring const& key, unsigned int mask)
+	{
+		// rename links are only removed by unlink()
+		std::lock_guard<std::mutex> lk(mSync);
+		probe_evict(key, mask & ~pending_bit(path_action::renamed), evict_reason::handled);
+		clear_bits(key, mask & ~pending_bit(path_action::renamed));
+	}
+
+	void path_state_table::unlink(std::wstring const& oldName, std::wstring const& newName)
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		probe_evict(oldName, pending_bit(path_action::renamed), evict_reason::handled);
+		probe_evict(newName, pending_bit(path_action::renamed), evict_reason::handled);
+		unlink_internal(oldName, newName);
+	}
+
+	size_t path_state_table::size() const
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		return mEntries.size();
+	}
+
+	size_t path_state_table::unsettled_in(std::wstring const& parent) const
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		auto found = mUnsettled.find(parent);
+		return (std::end(mUnsettled) != found) ? found->second : 0;
+	}
+
+	size_t path_state_table::depth(path_action action) const
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		return (path_action::renamed == action) ? mRenames.size() : mQueues[index_of(action)].size();
+	}
+
+	unsigned long long path_state_table::dropped() const noexcept
+	{
+		return mDropped.load(std::memory_order_relaxed);
+	}
+
+	path_state_table::entry& path_state_table::get_entry(std::wstring const& key)
+	{
+		auto found = mEntries.find(key);
+		if (std::end(mEntries) != found) {
+			return found->second;
+		}
+
+		auto& item = mEntries[key];
+		item.mState.mPath = key;
+		mNames.emplace(item.mState.get_file_name_wstring(), key);
+		return item;
+	}
+
+	void path_state_table::release(std::unordered_map<std::wstring, entry>::iterator it)
+	{
+		// Still referenced by a queue => the queue drops it later
+		auto const& state = it->second.mState;
+		if (state.mPending || it->second.mQueued) {
+			return;
+		}
+
+		auto range = mNames.equal_range(state.get_file_name_wstring());
+		for (auto name = range.first; name != range.second; ++name) {
+			if (name->second == state.mPath) {
+				mNames.erase(name);
+				break;
+			}
+		}
+		mEntries.erase(it);
+	}
+
+	void path_state_table::clear_bits(std::wstring const& key, unsigned int mask)
+	{
+		auto found = mEntries.find(key);
+		if (std::end(mEntries) == found) {
+			return;
+		}
+		set_pending(found->second.mState, found->second.mState.mPending & ~mask);
+		release(found);
+	}
+
+	void path_state_table::set_pending(path_state& state, unsigned int pending)
+	{
+		bool was = state.has_any(UNSETTLED);
+		state.mPending = pending;
+		bool is = state.has_any(UNSETTLED);
+		if (was == is) {
+			return;
+		}
+
+		auto parent = state.get_parent_path_wstring();
+		if (is) {
+			++mUnsettled[parent];
+		}
+		else if (0 == --mUnsettled[parent]) {
+			mUnsettled.erase(parent);
+		}
+	}
+
+	bool path_state_table::unlink_internal(std::wstring const& oldName, std::wstring const& newName)
+	{
+		auto drop = [this](std::wstring const& key, std::vector<std::wstring> path_state::* links, std::wstring const& other) {
+			auto found = mEntries.find(key);
+			if (std::end(mEntries) == found) {
+				return false;
+			}
+			auto& state = found->second.mState;
+			auto& vec = state.*links;
+			auto link = std::find(std::begin(vec), std::end(vec), other);
+			if (std::end(vec) == link) {
+				return false;
+			}
+			vec.erase(link);
+			if (state.mRenamedTo.empty() && state.mRenamedFrom.empty()) {
+				set_pending(state, state.mPending & ~pending_bit(path_action::renamed));
+				release(found);
+			}
+			return true;
+		};
+
+		bool linked = drop(oldName, &path_state::mRenamedTo, newName);
+		drop(newName, &path_state::mRenamedFrom, oldName);
+		return linked;
+	}
+
+	bool path_state_table::is_linked(rename_link const& link) const
+	{
+		auto found = mEntries.find(link.mOldName);
+		if (std::end(mEntries) == found) {
+			return false;
+		}
+		auto const& to = found->second.mState.mRenamedTo;
+		return std::end(to) != std::find(std::begin(to), std::end(to), link.mNewName);
+	}
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "file_notify_info.h"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace died
+{
+	// Pending actions of a path, one bit each
+	enum class path_action : unsigned int
+	{
+		added,
+		removed,
+		modified,
+		renamed,		// part of a pending rename (old or new name)
+		attribute,
+		security
+	};
+	constexpr size_t PATH_ACTION_COUNT = 6;
+
+	constexpr unsigned int pending_bit(path_action action) noexcept
+	{
+		return 1u << static_cast<unsigned int>(action);
+	}
+
+	// add, remove, modify, attribute, security => everything except the rename links
+	constexpr unsigned int PENDING_CHANGES = pending_bit(path_action::added)
+		| pending_bit(path_action::removed)
+		| pending_bit(path_action::modified)
+		| pending_bit(path_action::attribute)
+		| pending_bit(path_action::security);
+
+	// Snapshot of the pending state of one path
+	struct path_state
+	{
+		using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+		std::wstring mPath;
+		unsigned int mPending{};
+		std::array<time_point, PATH_ACTION_COUNT> mTime{};	// last event of each action
+		std::array<time_point, PATH_ACTION_COUNT> mSince{};	// first event of each action since it is pending
+		std::vector<std::wstring> mRenamedTo;				// this path is the old name
+		std::vector<std::wstring> mRenamedFrom;				// this path is the new name
+		event_stamps mStamps{};								// pipeline stages of the last event
+
+		explicit operator bool() const noexcept;
+		bool has(path_action action) const noexcept;
+		bool has_any(unsigned int mask) const noexcept;
+		time_point time_of(path_action action) const noexcept;
+		time_point since(path_action action) const noexcept;	// first event of a pending action
+		size_t alive(path_action action) const;	// in milli-seconds
+		size_t waiting(path_action action) const;	// in milli-seconds, pending for
+		time_point last_time() const noexcept;	// last event of any action
+		std::wstring get_file_name_wstring() const;
+		std::wstring get_parent_path_wstring() const;
+	};
+
+	struct rename_link
+	{
+		using time_point = path_state::time_point;
+
+		std::wstring mOldName;
+		std::wstring mNewName;
+		time_point mTime;
+		event_stamps mStamps{};		// new name event
+
+		explicit operator bool() const noexcept;
+		size_t alive() const;	// in milli-seconds
+	};
+
+	// Number of pending renames sharing a name with the rename 'link'
+	unsigned int rename_family(rename_link const& link, path_state const& oldName, path_state const& newName);
+
+	/************************************************************************************************/
+
+	// One path-keyed table for the pending file events of a shard, see state_shards.
+	// A lookup of "is this path also added/removed/renamed..." is one probe,
+	// erasing a processed path is one entry update.
+	// Every action keeps a FIFO of its paths, walked by front() / next() like the old models.
+	// Pushed from the observer threads, consumed by one correlation worker at a time.
+	class path_state_table
+	{
+		using time_point = path_state::time_point;
+
+		struct entry
+		{
+			path_state mState;
+			unsigned int mQueued{};		// actions whose queue holds this path
+		};
+
+	public:
+		explicit path_state_table(size_t capacity = 4096);
+
+		path_state_table(path_state_table const&) = delete;
+		path_state_table& operator=(path_state_table const&) = delete;
+
+		// Observer threads
+		void push(path_action action, file_notify_info const& info);
+		void push_rename(rename_link link);
+
+		// Correlation worker
+		path_state find(std::wstring const& key) const;
+		path_state find_by_name(path_action action, std::wstring const& fileName, std::wstring const& otherThanParent) const;
+		path_state front(path_action action);
+		void next(path_action action);
+		rename_link front_rename();
+		void next_rename();
+
+		void erase(std::wstring const& key, unsigned int mask);
+		void unlink(std::wstring const& oldName, std::wstring const& newName);
+		size_t size() const;
+		size_t unsettled_in(std::wstring const& parent) const;	// paths of the folder with a pending remove / rename
+		size_t depth(path_action action) const;		// queued paths of 'action', pending renames for 'renamed'
+		unsigned long long dropped() const noexcept;	// oldest paths dropped on a full queue
+
+	private:
+		entry& get_entry(std::wstring const& key);
+		void release(std::unordered_map<std::wstring, entry>::iterator it);
+		void clear_bits(std::wstring const& key, unsigned int mask);
+		void set_pending(path_state& state, unsigned int pending);
+		bool unlink_internal(std::wstring const& oldName, std::wstring const& newName);
+		bool is_linked(rename_link const& link) const;
+
+	private:
+		const size_t mCapacity;
+		mutable std::mutex mSync;
+		std::unordered_map<std::wstring, entry> mEntries;
+		std::unordered_multimap<std::wstring, std::wstring> mNames;	// file name => path
+		std::array<std::deque<std::wstring>, PATH_ACTION_COUNT> mQueues;
+		std::deque<rename_link> mRenames;
+		std::unordered_map<std::wstring, size_t> mUnsettled;		// parent folder => paths removed / renamed
+		std::atomic<unsigned long long> mDropped{};
+	};
+}
@@ -0,0 +1,180 @@
+#include "pipeline_latency.h"
+#include <algorithm>
+#include <cwchar>
+
+namespace died
+{
+	namespace
+	{
+		size_t msb(unsigned long long value) noexcept
+		{
+			size_t bit = 0;
+			while (value >>= 1) {
+				++bit;
+			}
+			return bit;
+		}
+
+		unsigned long long micro_between(event_clock::time_point from, event_clock::time_point to) noexcept
+		{
+			// a stage stamped before the previous one (other clock) counts as 0
+			if (to <= from) {
+				return 0;
+			}
+			return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+		}
+
+		size_t at(event_stage stage) noexcept
+		{
+			return static_cast<size_t>(stage);
+		}
+
+		size_t at(latency_stage stage) noexcept
+		{
+			return static_cast<size_t>(stage);
+		}
+
+		const std::wstring OTHER = L"Other";
+	}
+
+	size_t latency_histogram::bucket_of(unsigned long long micro) noexcept
+	{
+		// 1. exact below two sub-bucket ranges
+		if (micro < 2 * SUB_BUCKETS) {
+			return static_cast<size_t>(micro);
+		}
+
+		// 2. SUB_BUCKETS steps per power of two
+		auto bit = std::min(msb(micro), MAX_BITS - 1);
+		auto shift = bit - SUB_BUCKET_BITS;
+		auto sub = std::min<unsigned long long>(micro >> shift, 2 * SUB_BUCKETS - 1) - SUB_BUCKETS;
+		return (bit - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + static_cast<size_t>(sub);
+	}
+
+	unsigned long long latency_histogram::value_of(size_t bucket) noexcept
+	{
+		if (bucket < 2 * SUB_BUCKETS) {
+			return bucket;
+		}
+		auto shift = bucket / SUB_BUCKETS - 1;
+		auto low = static_cast<unsigned long long>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+		return low + ((1ull << shift) >> 1);
+	}
+
+	void latency_histogram::record(unsigned long long micro) noexcept
+	{
+		mCounts[bucket_of(micro)].fetch_add(1, std::memory_order_relaxed);
+
+		auto max = mMax.load(std::memory_order_relaxed);
+		while (micro > max && !mMax.compare_exchange_weak(max, micro, std::memory_order_relaxed)) {
+		}
+	}
+
+	latency_snapshot latency_histogram::snapshot() const
+	{
+		// counters move while reading => a snapshot is consistent per bucket only
+		std::array<unsigned long long, BUCKETS> counts;
+		latency_snapshot result;
+		for (size_t i = 0; i < BUCKETS; ++i) {
+			counts[i] = mCounts[i].load(std::memory_order_relaxed);
+			result.mCount += counts[i];
+		}
+		result.mMax = mMax.load(std::memory_order_relaxed);
+		if (!result.mCount) {
+			return result;
+		}
+
+		auto percentile = [&counts, &result](double p) {
+			auto rank = std::max<unsigned long long>(static_cast<unsigned long long>(p * result.mCount / 100.0 + 0.5), 1);
+			unsigned long long seen = 0;
+			for (size_t i = 0; i < BUCKETS; ++i) {
+				seen += counts[i];
+				if (seen >= rank) {
+					return std::min(value_of(i), result.mMax);
+				}
+			}
+			return result.mMax;
+		};
+		result.mP50 = percentile(50);
+		result.mP90 = percentile(90);
+		result.mP99 = percentile(99);
+		result.mP999 = percentile(99.9);
+		return result;
+	}
+
+	/************************************************************************************************/
+
+	pipeline_latency::pipeline_latency(std::vector<std::wstring> classes) :
+		mClasses{ std::move(classes) }
+	{
+		mClasses.erase(std::remove(std::begin(mClasses), std::end(mClasses), OTHER), std::end(mClasses));
+		mClasses.push_back(OTHER);
+		for (size_t i = 0; i < mClasses.size(); ++i) {
+			mIndex.emplace(mClasses[i], i);
+		}
+		mHistograms = std::make_unique<stage_histograms[]>(mClasses.size());
+	}
+
+	void pipeline_latency::record(std::wstring const& eventClass, event_stamps const& stamps, event_clock::time_point classified, event_clock::time_point sent) noexcept
+	{
+		// not stamped (unit tests, models filled by hand)
+		if (event_clock::time_point{} == stamps[at(event_stage::read)]) {
+			return;
+		}
+
+		auto found = mIndex.find(eventClass);
+		auto& histograms = mHistograms[std::end(mIndex) != found ? found->second : mClasses.size() - 1];
+
+		histograms[at(latency_stage::parse)].record(micro_between(stamps[at(event_stage::read)], stamps[at(event_stage::parse)]));
+		histograms[at(latency_stage::filter)].record(micro_between(stamps[at(event_stage::parse)], stamps[at(event_stage::filter)]));
+		histograms[at(latency_stage::insert)].record(micro_between(stamps[at(event_stage::filter)], stamps[at(event_stage::insert)]));
+		histograms[at(latency_stage::classify)].record(micro_between(stamps[at(event_stage::insert)], classified));
+		histograms[at(latency_stage::send)].record(micro_between(classified, sent));
+		histograms[at(latency_stage::end_to_end)].record(micro_between(stamps[at(event_stage::read)], sent));
+	}
+
+	std::vector<latency_report> pipeline_latency::snapshot() const
+	{
+		std::vector<latency_report> result;
+		for (size_t i = 0; i < mClasses.size(); ++i) {
+			latency_report report;
+			report.mClass = mClasses[i];
+			for (size_t stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+				report.mStages[stage] = mHistograms[i][stage].snapshot();
+			}
+			if (report.mStages[at(latency_stage::end_to_end)].mCount) {
+				result.push_back(std::move(report));
+			}
+		}
+		return result;
+	}
+
+	std::vector<std::wstring> pipeline_latency::dump() const
+	{
+		std::vector<std::wstring> lines;
+		for (auto const& report : snapshot()) {
+			for (size_t stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+				auto const& el = report.mStages[stage];
+				wchar_t buf[256]{};
+				swprintf(buf, 256, L"%ls/%ls count: %llu, p50: %lluus, p90: %lluus, p99: %lluus, p99.9: %lluus, max: %lluus",
+					report.mClass.c_str(), name_of(static_cast<latency_stage>(stage)), el.mCount, el.mP50, el.mP90, el.mP99, el.mP999, el.mMax);
+				lines.push_back(buf);
+			}
+		}
+		return lines;
+	}
+
+	wchar_t const* pipeline_latency::name_of(latency_stage stage) noexcept
+	{
+		switch (stage)
+		{
+		case latency_stage::parse:		return L"parse";
+		case latency_stage::filter:		return L"filter";
+		case latency_stage::insert:		return L"insert";
+		case latency_stage::classify:	return L"classify";
+		case latency_stage::send:		return L"send";
+		case latency_stage::end_to_end:	return L"end-to-end";
+		default:						return L"?";
+		}
+	}
+}
\ No newline at end of file
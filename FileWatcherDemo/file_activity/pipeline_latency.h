@@ -0,0 +1,89 @@
+#pragma once
+
+#include "event_clock.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace died
+{
+	struct latency_snapshot
+	{
+		unsigned long long mCount{};
+		unsigned long long mP50{};		// micro-seconds
+		unsigned long long mP90{};
+		unsigned long long mP99{};
+		unsigned long long mP999{};
+		unsigned long long mMax{};
+	};
+
+	// Lock-free log-linear histogram (HDR style) of micro-seconds.
+	// 16 sub-buckets per power of two => about 3% relative error, up to ~71 minutes.
+	class latency_histogram
+	{
+	public:
+		static constexpr size_t SUB_BUCKET_BITS = 4;
+		static constexpr size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+		static constexpr size_t MAX_BITS = 32;
+		static constexpr size_t BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+		// Any thread, one relaxed increment
+		void record(unsigned long long micro) noexcept;
+		latency_snapshot snapshot() const;
+
+		static size_t bucket_of(unsigned long long micro) noexcept;
+		static unsigned long long value_of(size_t bucket) noexcept;		// middle of the bucket
+
+	private:
+		std::array<std::atomic<unsigned long long>, BUCKETS> mCounts{};
+		std::atomic<unsigned long long> mMax{};
+	};
+
+	// Measured intervals of an event, each one from the previous stage
+	enum class latency_stage : size_t
+	{
+		parse,			// kernel read => file_notify_info
+		filter,			// => passed the rules
+		insert,			// => stored in a model
+		classify,		// => classified by a checker / pattern
+		send,			// => notify_to_server::send returned
+		end_to_end		// kernel read => send returned
+	};
+	constexpr size_t LATENCY_STAGE_COUNT = 6;
+
+	struct latency_report
+	{
+		std::wstring mClass;
+		std::array<latency_snapshot, LATENCY_STAGE_COUNT> mStages;
+	};
+
+	// Stage latencies of the classified events, per event class (Create only, Modify, Move...).
+	// The classes are fixed at construction, an unknown one is counted as "Other".
+	class pipeline_latency
+	{
+		using stage_histograms = std::array<latency_histogram, LATENCY_STAGE_COUNT>;
+
+	public:
+		explicit pipeline_latency(std::vector<std::wstring> classes);
+
+		pipeline_latency(pipeline_latency const&) = delete;
+		pipeline_latency& operator=(pipeline_latency const&) = delete;
+
+		// Any thread, no lock
+		void record(std::wstring const& eventClass, event_stamps const& stamps, event_clock::time_point classified, event_clock::time_point sent) noexcept;
+
+		// Classes with at least one event
+		std::vector<latency_report> snapshot() const;
+		std::vector<std::wstring> dump() const;		// one line per class and stage
+
+		static wchar_t const* name_of(latency_stage stage) noexcept;
+
+	private:
+		std::vector<std::wstring> mClasses;
+		std::unordered_map<std::wstring, size_t> mIndex;	// read-only after construction
+		std::unique_ptr<stage_histograms[]> mHistograms;	// one per class
+	};
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "pipeline_metrics.h"
+#include "std_filesystem.h"
+#include <Windows.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace died
+{
+	namespace
+	{
+		const std::wstring OTHER = L"Other";
+
+		std::string escape(std::wstring const& value)
+		{
+			// label value: backslash, double-quote and line feed are escaped
+			std::string result;
+			for (auto c : std::filesystem::path(value).u8string()) {
+				switch (c)
+				{
+				case '\\':	result += "\\\\"; break;
+				case '"':	result += "\\\""; break;
+				case '\n':	result += "\\n"; break;
+				default:	result += c; break;
+				}
+			}
+			return result;
+		}
+
+		template<size_t N>
+		metric_family counters_of(std::string name, std::string help, std::string label, std::array<sharded_counter, N> const& counters, std::array<wchar_t const*, N> const& names)
+		{
+			metric_family family{ std::move(name), std::move(help), "counter", std::move(label) };
+			for (size_t i = 0; i < N; ++i) {
+				family.mSamples.emplace_back(names[i], counters[i].value());
+			}
+			return family;
+		}
+
+		void write_family(std::ostringstream& out, metric_family const& family)
+		{
+			out << "# HELP " << family.mName << " " << family.mHelp << "\n";
+			out << "# TYPE " << family.mName << " " << family.mType << "\n";
+			for (auto const& el : family.mSamples) {
+				out << family.mName;
+				if (!family.mLabel.empty()) {
+					out << "{" << family.mLabel << "=\"" << escape(el.first) << "\"}";
+				}
+				out << " " << el.second << "\n";
+			}
+		}
+	}
+
+	void sharded_counter::add(unsigned long long n) noexcept
+	{
+		mSlots[thread_slot()].mValue.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	unsigned long long sharded_counter::value() const noexcept
+	{
+		unsigned long long sum = 0;
+		for (auto const& el : mSlots) {
+			sum += el.mValue.load(std::memory_order_relaxed);
+		}
+		return sum;
+	}
+
+	size_t sharded_counter::thread_slot() noexcept
+	{
+		// threads take the lines in turn, on first use: the 17th shares the line of the first
+		static std::atomic<size_t> sNext{};
+		thread_local size_t tSlot = sNext.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+		return tSlot;
+	}
+
+	/************************************************************************************************/
+
+	pipeline_metrics::pipeline_metrics(std::vector<std::wstring> classes) :
+		mClasses{ std::move(classes) }
+	{
+		mClasses.erase(std::remove(std::begin(mClasses), std::end(mClasses), OTHER), std::end(mClasses));
+		mClasses.push_back(OTHER);
+		for (size_t i = 0; i < mClasses.size(); ++i) {
+			mIndex.emplace(mClasses[i], i);
+		}
+		mClassified = std::make_unique<sharded_counter[]>(mClasses.size());
+	}
+
+	void pipeline_metrics::received(watcher_kind kind) noexcept
+	{
+		mReceived[static_cast<size_t>(kind)].add();
+	}
+
+	void pipeline_metrics::filtered(rule by) noexcept
+	{
+		if (rule::none != by) {
+			mFiltered[static_cast<size_t>(by) - 1].add();
+		}
+	}
+
+	void pipeline_metrics::classified(std::wstring const& type) noexcept
+	{
+		auto found = mIndex.find(type);
+		mClassified[std::end(mIndex) != found ? found->second : mClasses.size() - 1].add();
+	}
+
+	void pipeline_metrics::probed(probe_outcome outcome) noexcept
+	{
+		mProbes[static_cast<size_t>(outcome)].add();
+	}
+
+	std::string pipeline_metrics::prometheus_text(std::vector<metric_family> const& extra) const
+	{
+		std::vector<metric_family> families;
+		families.push_back(counters_of("file_watcher_events_received_total", "Events read from ReadDirectoryChangesW, per watcher.", "watcher",
+			mReceived, { L"file_name", L"attribute", L"security", L"folder_name" }));
+		families.push_back(counters_of("file_watcher_events_filtered_total", "Events dropped by UnnecessaryDirectory, per rule.", "rule",
+			mFiltered, { L"app_data", L"default_path", L"user_define" }));
+		families.push_back(counters_of("file_watcher_busy_probes_total", "fileIsProcessing queries of busy_probe, per result.", "result",
+			mProbes, { L"busy", L"idle", L"cached", L"deferred" }));
+
+		metric_family classified{ "file_watcher_classifications_total", "Events sent to the server, per classification.", "counter", "type" };
+		for (size_t i = 0; i < mClasses.size(); ++i) {
+			classified.mSamples.emplace_back(mClasses[i], mClassified[i].value());
+		}
+		families.push_back(std::move(classified));
+		families.insert(std::end(families), std::begin(extra), std::end(extra));
+
+		std::ostringstream out;
+		for (auto const& el : families) {
+			write_family(out, el);
+		}
+		return out.str();
+	}
+
+	bool pipeline_metrics::write_file(std::wstring const& path, std::string const& text)
+	{
+		auto temp = path + L".tmp";
+		{
+			std::ofstream file{ std::filesystem::path(temp), std::ios::binary | std::ios::trunc };
+			if (!file || !file.write(text.data(), text.size())) {
+				return false;
+			}
+		}
+		return ::MoveFileExW(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "unnecessary_directory.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace died
+{
+	// Counter split over cache lines, a thread always increments the same one.
+	// Lines are taken in turn: the first SHARDS threads have their own, past that observer threads,
+	// shard workers and probe threads rarely share one => little contention, the sum stays exact.
+	class sharded_counter
+	{
+	public:
+		static constexpr size_t SHARDS = 16;
+
+		void add(unsigned long long n = 1) noexcept;
+		unsigned long long value() const noexcept;
+
+	private:
+		struct alignas(64) slot
+		{
+			std::atomic<unsigned long long> mValue{};
+		};
+
+		static size_t thread_slot() noexcept;
+
+	private:
+		std::array<slot, SHARDS> mSlots{};
+	};
+
+	enum class watcher_kind : size_t { file_name, attribute, security, folder_name };
+	constexpr size_t WATCHER_KIND_COUNT = 4;
+
+	enum class probe_outcome : size_t
+	{
+		busy,		// fileIsProcessing() true
+		idle,		// fileIsProcessing() false
+		cached,		// answered from a recent probe
+		deferred	// too many probes in flight, asked again later
+	};
+	constexpr size_t PROBE_OUTCOME_COUNT = 4;
+
+	// One metric of the text exposition format, with one label
+	struct metric_family
+	{
+		std::string mName;
+		std::string mHelp;
+		std::string mType;		// counter, gauge
+		std::string mLabel;		// empty => one sample without label
+		std::vector<std::pair<std::wstring, unsigned long long>> mSamples;
+	};
+
+	// Counters of the pipeline, exported in the Prometheus text format.
+	// Counting is a relaxed increment on a per-thread line; depths and totals
+	// owned by other objects are read when exporting (see directory_watcher_mgr).
+	class pipeline_metrics
+	{
+		using rule = fat::UnnecessaryDirectory::Rule;
+
+	public:
+		// The classification types are fixed at construction, an unknown one is counted as "Other"
+		explicit pipeline_metrics(std::vector<std::wstring> classes);
+
+		pipeline_metrics(pipeline_metrics const&) = delete;
+		pipeline_metrics& operator=(pipeline_metrics const&) = delete;
+
+		// Any thread
+		void received(watcher_kind kind) noexcept;
+		void filtered(rule by) noexcept;
+		void classified(std::wstring const& type) noexcept;
+		void probed(probe_outcome outcome) noexcept;
+
+		// Own counters plus 'extra' families
+		std::string prometheus_text(std::vector<metric_family> const& extra = {}) const;
+
+		// Written next to 'path' then swapped in, a scraper never reads half a file
+		static bool write_file(std::wstring const& path, std::string const& text);
+
+	private:
+		std::array<sharded_counter, WATCHER_KIND_COUNT> mReceived;
+		std::array<sharded_counter, fat::UnnecessaryDirectory::RULE_COUNT> mFiltered;
+		std::array<sharded_counter, PROBE_OUTCOME_COUNT> mProbes;
+
+		std::vector<std::wstring> mClasses;
+		std::unordered_map<std::wstring, size_t> mIndex;	// read-only after construction
+		std::unique_ptr<sharded_counter[]> mClassified;		// one per class
+	};
+}
\ No newline at end of file
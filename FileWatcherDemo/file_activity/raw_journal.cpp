@@ -0,0 +1,321 @@
+#include "raw_journal.h"
+#include "event_frame.h"
+#include "spdlog_header.h"
+#include "varint.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+namespace died
+{
+	namespace
+	{
+		constexpr size_t WRITE_BYTES = 1 << 20;		// the buffer goes to the file past this size
+		constexpr auto WRITE_INTERVAL = std::chrono::milliseconds(20);
+		constexpr size_t MAX_PATHS = 1 << 20;		// a segment rotates once its path table is this large
+		constexpr uint8_t NEW_PATH = 4;
+
+		std::filesystem::path segment_path(std::wstring const& dir, uint64_t number)
+		{
+			wchar_t name[32]{};
+			std::swprintf(name, 32, L"%016llx.fwr", static_cast<unsigned long long>(number));
+			return std::filesystem::path(dir) / name;
+		}
+
+		bool load_index(std::wstring const& dir, std::vector<raw_index_entry>& entries)
+		{
+			std::ifstream in{ std::filesystem::path(dir) / L"index", std::ios::binary };
+			raw_index_header header;
+			if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+				|| raw_index_header::MAGIC != header.mMagic || raw_index_header::VERSION != header.mVersion) {
+				return false;
+			}
+			entries.resize(static_cast<size_t>(header.mCount));
+			return entries.empty() || in.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(raw_index_entry));
+		}
+
+		// records of one segment, up to the last whole one
+		bool decode_segment(std::vector<uint8_t> const& data, std::vector<raw_event>& out, int64_t from, int64_t to)
+		{
+			raw_segment_header header;
+			if (data.size() < sizeof(header)) {
+				return false;
+			}
+			std::memcpy(&header, data.data(), sizeof(header));
+			if (raw_segment_header::MAGIC != header.mMagic || raw_segment_header::VERSION != header.mVersion) {
+				return false;
+			}
+
+			std::vector<std::wstring> paths;
+			int64_t micros = 0;
+			auto at = data.data() + sizeof(header);
+			auto end = data.data() + data.size();
+			while (at < end) {
+				uint64_t head = 0, delta = 0, value = 0;
+				if (!get_varint(at, end, head) || !get_varint(at, end, delta) || !get_varint(at, end, value)) {
+					break;
+				}
+				if (head & NEW_PATH) {
+					if (static_cast<uint64_t>(end - at) < value * sizeof(uint16_t)) {
+						break;
+					}
+					std::wstring path(static_cast<size_t>(value), L'\0');
+					for (auto& el : path) {
+						el = static_cast<wchar_t>(at[0] | (at[1] << 8));
+						at += sizeof(uint16_t);
+					}
+					value = paths.size();
+					paths.push_back(std::move(path));
+				}
+				if (paths.size() <= value || WATCHER_KIND_COUNT <= (head & 3)) {
+					break;
+				}
+
+				micros += unzigzag(delta);
+				raw_event ev;
+				ev.mTime = header.mWallOrigin + micros * 10;
+				if (ev.mTime < from || to < ev.mTime) {
+					continue;
+				}
+				ev.mKind = static_cast<watcher_kind>(head & 3);
+				ev.mAction = static_cast<unsigned long>(head >> 3);
+				ev.mPath = paths[static_cast<size_t>(value)];
+				out.push_back(std::move(ev));
+			}
+			return true;
+		}
+	}
+
+	raw_journal::raw_journal(std::wstring dir, size_t capacity, size_t segmentBytes, size_t maxSegments) :
+		mDir{ std::move(dir) },
+		mSegmentBytes{ segmentBytes },
+		mMaxSegments{ std::max<size_t>(maxSegments, 1) },
+		mQueue{ capacity }
+	{
+	}
+
+	raw_journal::~raw_journal()
+	{
+		stop();
+	}
+
+	bool raw_journal::start()
+	{
+		if (mWriter.joinable()) {
+			return false;
+		}
+
+		// the segments of the last runs stay in the rotation
+		std::error_code ec;
+		std::filesystem::create_directories(mDir, ec);
+		mIndex.clear();
+		load_index(mDir, mIndex);
+		mHeader.mNumber = mIndex.empty() ? 0 : mIndex.back().mNumber;
+		if (!open_segment()) {
+			SPDLOG_WARN(L"Can't open raw journal in {}", mDir);
+			return false;
+		}
+
+		mStop.store(false, std::memory_order_relaxed);
+		mWriter = std::thread(&raw_journal::write_loop, this);
+		mRunning.store(true, std::memory_order_release);
+		return true;
+	}
+
+	void raw_journal::stop()
+	{
+		mRunning.store(false, std::memory_order_release);
+		if (!mWriter.joinable()) {
+			return;
+		}
+		mStop.store(true, std::memory_order_release);
+		mWriter.join();
+		close_segment();
+	}
+
+	void raw_journal::write(watcher_kind kind, file_notify_info const& info) noexcept
+	{
+		if (!mRunning.load(std::memory_order_acquire)) {
+			return;
+		}
+
+		// a copy of the path, into the buffer the slot already has
+		auto fill = [&](queued& record) noexcept {
+			auto const& native = info.get_path().native();
+			record.mTime = info.get_created_time().time_since_epoch().count();
+			record.mAction = info.get_action();
+			record.mKind = kind;
+			record.mPath.assign(std::begin(native), std::end(native));
+		};
+		if (!mQueue.push(fill)) {
+			mDropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	raw_journal_stats raw_journal::stats() const noexcept
+	{
+		raw_journal_stats result;
+		result.mWritten = mWritten.load(std::memory_order_relaxed);
+		result.mDropped = mDropped.load(std::memory_order_relaxed);
+		result.mBytes = mBytes.load(std::memory_order_relaxed);
+		result.mSegments = mSegments.load(std::memory_order_relaxed);
+		return result;
+	}
+
+	void raw_journal::write_loop()
+	{
+		auto take = [this](queued const& ev) { encode(ev); };
+		for (;;) {
+			auto stopping = mStop.load(std::memory_order_acquire);
+			while (mQueue.pop(take)) {
+				if (mBuffer.size() >= WRITE_BYTES) {
+					flush_buffer();
+				}
+			}
+			flush_buffer();
+			mFile.flush();
+
+			if (stopping) {
+				return;
+			}
+			std::this_thread::sleep_for(WRITE_INTERVAL);
+		}
+	}
+
+	void raw_journal::encode(queued const& ev)
+	{
+		// 1. full segment => the next one, with an empty path table
+		if (mSegmentSize + mBuffer.size() >= mSegmentBytes || mPaths.size() >= MAX_PATHS) {
+			close_segment();
+			if (!open_segment()) {
+				mDropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+
+		// 2. head, time delta, path or its id
+		auto found = mPaths.find(ev.mPath);
+		bool added = std::end(mPaths) == found;
+		auto micros = std::chrono::duration_cast<std::chrono::microseconds>(event_clock::time_point::duration(ev.mTime - mHeader.mClockOrigin)).count();
+		put_varint(mBuffer, (static_cast<uint64_t>(ev.mAction) << 3) | (added ? NEW_PATH : 0) | static_cast<uint64_t>(ev.mKind));
+		put_varint(mBuffer, zigzag(micros - mPrevious));
+		mPrevious = micros;
+		if (!added) {
+			put_varint(mBuffer, found->second);
+		}
+		else {
+			put_varint(mBuffer, ev.mPath.size());
+			auto at = mBuffer.size();
+			mBuffer.resize(at + ev.mPath.size() * sizeof(uint16_t));
+			for (auto el : ev.mPath) {
+				mBuffer[at++] = static_cast<uint8_t>(el);
+				mBuffer[at++] = static_cast<uint8_t>(static_cast<uint16_t>(el) >> 8);
+			}
+			mPaths.emplace(ev.mPath, mPaths.size());
+		}
+		++mSegmentRecords;
+		mWritten.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void raw_journal::flush_buffer()
+	{
+		if (mBuffer.empty()) {
+			return;
+		}
+		mFile.write(reinterpret_cast<char const*>(mBuffer.data()), mBuffer.size());
+		mSegmentSize += mBuffer.size();
+		mBytes.fetch_add(mBuffer.size(), std::memory_order_relaxed);
+		mBuffer.clear();
+	}
+
+	bool raw_journal::open_segment()
+	{
+		mHeader.mNumber += 1;
+		mHeader.mClockOrigin = event_clock::now().time_since_epoch().count();
+		mHeader.mWallOrigin = wall_now();
+		mFile.open(segment_path(mDir, mHeader.mNumber), std::ios::binary | std::ios::trunc);
+		if (!mFile.is_open()) {
+			return false;
+		}
+		mFile.write(reinterpret_cast<char const*>(&mHeader), sizeof(mHeader));
+		mSegmentSize = sizeof(mHeader);
+		mSegmentRecords = 0;
+		mPrevious = 0;
+		mPaths.clear();
+		mSegments.fetch_add(1, std::memory_order_relaxed);
+
+		// rotation: the oldest segments go
+		mIndex.push_back({ mHeader.mNumber, mHeader.mWallOrigin, 0, 0, 0 });
+		while (mIndex.size() > mMaxSegments) {
+			std::error_code ec;
+			std::filesystem::remove(segment_path(mDir, mIndex.front().mNumber), ec);
+			mIndex.erase(std::begin(mIndex));
+		}
+		write_index();
+		return true;
+	}
+
+	void raw_journal::close_segment()
+	{
+		if (!mFile.is_open()) {
+			return;
+		}
+		flush_buffer();
+		mFile.close();
+		auto& entry = mIndex.back();
+		entry.mLast = wall_now();
+		entry.mRecords = mSegmentRecords;
+		entry.mBytes = mSegmentSize;
+		write_index();
+	}
+
+	void raw_journal::write_index()
+	{
+		// written aside then renamed: a reader never sees half an index
+		auto dir = std::filesystem::path(mDir);
+		{
+			std::ofstream out{ dir / L"index.tmp", std::ios::binary | std::ios::trunc };
+			raw_index_header header;
+			header.mCount = mIndex.size();
+			out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+			out.write(reinterpret_cast<char const*>(mIndex.data()), mIndex.size() * sizeof(raw_index_entry));
+		}
+		std::error_code ec;
+		std::filesystem::rename(dir / L"index.tmp", dir / L"index", ec);
+		if (ec) {
+			SPDLOG_WARN(L"Can't write raw journal index in {}", mDir);
+		}
+	}
+
+	bool read_raw_journal(std::wstring const& dir, std::vector<raw_event>& out, std::wstring& error, int64_t from, int64_t to)
+	{
+		std::vector<raw_index_entry> entries;
+		if (!load_index(dir, entries)) {
+			error = L"no raw journal index";
+			return false;
+		}
+
+		std::vector<uint8_t> data;
+		for (size_t i = 0; i < entries.size(); ++i) {
+			// a segment still written ends where the next one starts, or never
+			auto const& entry = entries[i];
+			auto last = entry.mLast ? entry.mLast : i + 1 < entries.size() ? entries[i + 1].mFirst : std::numeric_limits<int64_t>::max();
+			if (last < from || to < entry.mFirst) {
+				continue;
+			}
+
+			std::ifstream in{ segment_path(dir, entry.mNumber), std::ios::binary };
+			if (!in) {
+				continue;		// rotated out meanwhile
+			}
+			data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+			if (!decode_segment(data, out, from, to)) {
+				error = L"not a raw journal segment: " + segment_path(dir, entry.mNumber).wstring();
+				return false;
+			}
+		}
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "file_notify_info.h"
+#include "mpsc_queue.h"
+#include "pipeline_metrics.h"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace died
+{
+	// A directory of rotating segments, <number>.fwr with 16 hex digits, and their 'index'.
+	// A segment decodes alone: raw_segment_header then records until the end, its path table starts empty.
+	// Record, LEB128 varints:
+	//   head	action << 3 | new path << 2 | watcher_kind
+	//   time	zigzag microseconds since the previous record, since mClockOrigin for the first one
+	//   path	new path: UTF-16 length then its units, 2 bytes each, it takes the next path id; else the path id
+	struct raw_segment_header
+	{
+		static constexpr uint32_t MAGIC = 0x31415746;	// "FWA1"
+		static constexpr uint32_t VERSION = 1;
+
+		uint32_t mMagic{ MAGIC };
+		uint32_t mVersion{ VERSION };
+		uint64_t mNumber{};
+		int64_t mClockOrigin{};		// event_clock ticks when opened, time 0 of the records
+		int64_t mWallOrigin{};		// FILETIME of time 0
+	};
+	static_assert(sizeof(raw_segment_header) == 32, "raw_segment_header layout");
+
+	// 'index': raw_index_header then one entry per kept segment, oldest first
+	struct raw_index_header
+	{
+		static constexpr uint32_t MAGIC = 0x31495746;	// "FWI1"
+		static constexpr uint32_t VERSION = 1;
+
+		uint32_t mMagic{ MAGIC };
+		uint32_t mVersion{ VERSION };
+		uint64_t mCount{};
+	};
+
+	struct raw_index_entry
+	{
+		uint64_t mNumber;
+		int64_t mFirst;			// FILETIME when opened
+		int64_t mLast;			// FILETIME when closed, 0 while written
+		uint64_t mRecords;		// when closed
+		uint64_t mBytes;
+	};
+	static_assert(sizeof(raw_index_entry) == 40, "raw_index_entry layout");
+
+	// A raw event read back
+	struct raw_event
+	{
+		watcher_kind mKind{};
+		unsigned long mAction{};
+		std::wstring mPath;
+		int64_t mTime{};			// FILETIME
+	};
+
+	struct raw_journal_stats
+	{
+		unsigned long long mWritten{};
+		unsigned long long mDropped{};		// queue full
+		unsigned long long mBytes{};		// encoded, all segments
+		unsigned long long mSegments{};		// opened
+	};
+
+	// Journal of the raw events passing the rules, before any correlation, for incident analysis and replay.
+	// write() copies the path into a bounded queue, a full queue drops and counts the event.
+	// One writer thread interns the paths, encodes times as deltas and everything as varints:
+	// a repeated path costs a few bytes. Segments rotate by size, the oldest beyond 'maxSegments' are deleted.
+	class raw_journal
+	{
+		struct queued
+		{
+			int64_t mTime{};		// event_clock ticks
+			unsigned long mAction{};
+			watcher_kind mKind{};
+			std::wstring mPath;		// buffer reused
+		};
+
+	public:
+		static constexpr size_t SEGMENT_BYTES = 64 << 20;
+		static constexpr size_t MAX_SEGMENTS = 16;
+
+		explicit raw_journal(std::wstring dir, size_t capacity = 16384, size_t segmentBytes = SEGMENT_BYTES, size_t maxSegments = MAX_SEGMENTS);
+		~raw_journal();
+
+		bool start();
+		void stop();		// drains the queue
+
+		void write(watcher_kind kind, file_notify_info const& info) noexcept;		// any thread
+
+		raw_journal_stats stats() const noexcept;
+
+	private:
+		void write_loop();
+		void encode(queued const& ev);
+		void flush_buffer();
+		bool open_segment();
+		void close_segment();
+		void write_index();
+
+	private:
+		std::wstring mDir;
+		size_t mSegmentBytes;
+		size_t mMaxSegments;
+		mpsc_queue<queued> mQueue;
+
+		std::thread mWriter;
+		std::atomic<bool> mStop{};
+		std::atomic<bool> mRunning{};
+
+		// writer thread only
+		std::ofstream mFile;
+		std::vector<uint8_t> mBuffer;
+		std::unordered_map<std::wstring, uint64_t> mPaths;		// of the open segment
+		int64_t mPrevious{};		// microseconds since mClockOrigin
+		raw_segment_header mHeader;
+		uint64_t mSegmentSize{};
+		uint64_t mSegmentRecords{};
+		std::vector<raw_index_entry> mIndex;
+
+		std::atomic<unsigned long long> mWritten{};
+		std::atomic<unsigned long long> mDropped{};
+		std::atomic<unsigned long long> mBytes{};
+		std::atomic<unsigned long long> mSegments{};
+	};
+
+	// The events of a journal directory between 'from' and 'to' (FILETIME), in order.
+	// The index skips the segments out of range; a segment cut by a crash is read up to its last whole record.
+	bool read_raw_journal(std::wstring const& dir, std::vector<raw_event>& out, std::wstring& error,
+		int64_t from = 0, int64_t to = std::numeric_limits<int64_t>::max());
+}
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "iobserver.h"
 #include "idirectory_watcher.h"
 #include "spdlog_header.h"
+#include "event_probes.h"
+#include "event_tracer.h"
 #include "gsl/assert"
 
 #include <shlwapi.h>
@@ -91,9 +93,11 @@ namespace died
 			&notification_completion);           // completion routine
 	}
 
-	void request_impl::process_notification()
+	void request_impl::process_notification(event_clock::time_point readTime, DWORD bytes)
 	{
+		TRACE_SCOPE("process_notification");
 		BYTE* pBase = mBackupBuffer.data();
+		unsigned long entries = 0;
 
 		for (;;) {
 			FILE_NOTIFY_INFORMATION& fni = (FILE_NOTIFY_INFORMATION&)*pBase;
@@ -121,17 +125,23 @@ namespace died
 					wsFileName = wbuf;
 				}
 			}
-			get_observer()->get_watcher()->notify(file_notify_info{ wsFileName, fni.Action });
+			mInfos.emplace_back(wsFileName, fni.Action);
+			mInfos.back().stamp(event_stage::read, readTime);
+			++entries;
 
 			if (!fni.NextEntryOffset) {
 				break;
 			}
 			pBase += fni.NextEntryOffset;
 		}
+		get_observer()->get_watcher()->notify(mInfos);
+		mInfos.clear();
+		probe_buffer(mParam.mInfo.mDirectory, bytes, entries);
 	}
 
 	VOID CALLBACK request_impl::notification_completion(DWORD dwErrorCode, DWORD dwNumberOfBytesTransfered, LPOVERLAPPED lpOverlapped)
 	{
+		auto readTime = event_clock::now();
 		request_impl* pBlock = (request_impl*)lpOverlapped->hEvent;
 		_ASSERTE(pBlock);
 
@@ -166,6 +176,6 @@ namespace died
 		}
 
 		// start processing
-		pBlock->process_notification();
+		pBlock->process_notification(readTime, dwNumberOfBytesTransfered);
 	}
 }
\ No newline at end of file
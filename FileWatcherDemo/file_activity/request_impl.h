@@ -2,6 +2,8 @@
 
 #include "irequest.h"
 #include "watching_setting.h"
+#include "event_clock.h"
+#include "file_notify_info.h"
 #include <vector>
 #include <Windows.h>
 
@@ -23,7 +25,7 @@ namespace died
 		request_impl(request_impl const&) = delete;
 		request_impl& operator=(request_impl const&) = delete;
 
-		void process_notification();
+		void process_notification(event_clock::time_point readTime, DWORD bytes);
 		void backup_buffer(DWORD dwSize);
 
 	private:
@@ -56,5 +58,8 @@ namespace died
 		// Double buffer strategy so that we can issue a new read
 		// request_impl before we process the current buffer.
 		std::vector<BYTE> mBackupBuffer;
+
+		// Entries of the buffer being processed, handed to the watcher at once
+		std::vector<file_notify_info> mInfos;
 	};
 }
\ No newline at end of file
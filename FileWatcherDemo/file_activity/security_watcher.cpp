@@ -1,5 +1,6 @@
 #include "security_watcher.h"
-#include "spdlog_header.h"
+#include "event_journal.h"
+#include "gsl\gsl_assert"
 
 namespace died
 {
@@ -8,18 +9,19 @@ namespace died
 		switch (info.get_action())
 		{
 		case FILE_ACTION_MODIFIED:
-			SPDLOG_DEBUG(L"{} - {}", info.get_action(), info.get_path_wstring());
-			mModel.push(std::move(info));
+			JOURNAL_DEBUG(security, info.get_action(), info.get_path_wstring());
+			Ensures(mState);
+			mState->push(path_action::security, info);
 			break;
 
 		default:
-			SPDLOG_DEBUG(L"Ignore: {} - {}", info.get_action(), info.get_path_wstring());
+			JOURNAL_DEBUG(security_ignored, info.get_action(), info.get_path_wstring());
 			break;
 		}
 	}
 
-	model_file_info& security_watcher::get_model()
+	void security_watcher::set_state(std::shared_ptr<state_shards> shards)
 	{
-		return mModel;
+		mState = std::move(shards);
 	}
 }
\ No newline at end of file
@@ -1,19 +1,19 @@
 #pragma once
 
 #include "directory_watcher_base.h"
-#include "model_file_info.h"
+#include "state_shards.h"
 
 namespace died
 {
 	class security_watcher : public directory_watcher_base
 	{
 	public:
-		model_file_info& get_model();
+		void set_state(std::shared_ptr<state_shards> shards);
 
 	private:
 		void do_notify(file_notify_info info) final;
 
 	private:
-		model_file_info mModel;
+		std::shared_ptr<state_shards> mState;
 	};
 }
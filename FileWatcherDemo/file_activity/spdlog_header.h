@@ -24,7 +24,7 @@ namespace died
 		auto stdout_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt >();
 		auto rotating_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>("logger.log", 1024 * 1024 * 10, 10);
 		std::vector<spdlog::sink_ptr> sinks{ stdout_sink, rotating_sink };
-		auto asynLog = std::make_shared<spdlog::async_logger>("saigon", sinks.begin(), sinks.end(), spdlog::thread_pool(), spdlog::async_overflow_policy::block);
+		auto asynLog = std::make_shared<spdlog::async_logger>("saigon", sinks.begin(), sinks.end(), spdlog::thread_pool(), spdlog::async_overflow_policy::overrun_oldest);
 		asynLog->set_pattern("[%Y-%m-%d_%H:%M:%S %e] [%^%l%$] [thread %t] [%!:%#] %v");
 		spdlog::set_default_logger(asynLog);
 		spdlog::flush_every(std::chrono::seconds(10));
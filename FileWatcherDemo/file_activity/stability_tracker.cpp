@@ -0,0 +1,112 @@
+#include "stability_tracker.h"
+#include <algorithm>
+
+namespace died
+{
+	namespace
+	{
+		constexpr size_t MAX_TRACKED = 4096;
+		constexpr std::chrono::seconds FORGET_AFTER{ 60 };
+	}
+
+	stability_tracker::stability_tracker(busy_probe& probe, size_t quiet, size_t firstSample, size_t maxSample) :
+		mProbe{ probe },
+		mQuiet{ quiet },
+		mFirstSample{ firstSample },
+		mMaxSample{ std::max(firstSample, maxSample) }
+	{}
+
+	stability_tracker::verdict stability_tracker::check(std::wstring const& path, time_point lastEvent)
+	{
+		auto now = event_clock::now();
+
+		std::unique_lock<std::mutex> lk(mSync);
+		if (mFiles.size() > MAX_TRACKED) {
+			sweep(now);
+		}
+
+		auto inserted = mFiles.try_emplace(path);
+		auto& item = inserted.first->second;
+		if (inserted.second) {
+			item.mLastChange = lastEvent;
+			item.mInterval = mFirstSample;
+		}
+
+		// New event on the file => it is written again, sample it soon
+		if (lastEvent > item.mLastChange) {
+			item.mLastChange = lastEvent;
+			item.mVerdict = verdict::changing;
+			item.mInterval = mFirstSample;
+			item.mNextSample = now;
+		}
+
+		if (now < item.mNextSample) {
+			return item.mVerdict;
+		}
+		lk.unlock();
+
+		// A result from before the previous sample is no news
+		auto probed = mProbe.query_info(path, mFirstSample);
+
+		lk.lock();
+		auto found = mFiles.find(path);
+		if (std::end(mFiles) == found) {
+			return verdict::unknown;
+		}
+		auto& sampled = found->second;
+		if (busy_probe::result::pending == probed.mResult || probed.mTime <= sampled.mSampled) {
+			return sampled.mVerdict;
+		}
+
+		// the first sample is the baseline, only an exclusive open is a change
+		bool baseline = time_point{} == sampled.mSampled;
+		sampled.mSampled = probed.mTime;
+		bool changed = busy_probe::result::busy == probed.mResult
+			|| (!baseline && (probed.mSize != sampled.mSize || probed.mWriteTime != sampled.mWriteTime));
+		sampled.mSize = probed.mSize;
+		sampled.mWriteTime = probed.mWriteTime;
+
+		if (changed) {
+			sampled.mLastChange = std::max(sampled.mLastChange, probed.mTime);
+			sampled.mVerdict = verdict::changing;
+
+			// still written => back off
+			sampled.mNextSample = now + sampled.mInterval;
+			sampled.mInterval = std::min(sampled.mInterval * 2, mMaxSample);
+		}
+		else if (probed.mTime - sampled.mLastChange >= mQuiet) {
+			sampled.mVerdict = verdict::stable;
+			sampled.mInterval = mFirstSample;
+			sampled.mNextSample = now + mFirstSample;
+		}
+		else {
+			// quiet but not long enough => check again when the quiet period ends
+			sampled.mVerdict = verdict::changing;
+			sampled.mNextSample = sampled.mLastChange + mQuiet;
+		}
+		return sampled.mVerdict;
+	}
+
+	bool stability_tracker::is_stable(std::wstring const& path, time_point lastEvent)
+	{
+		return verdict::stable == check(path, lastEvent);
+	}
+
+	void stability_tracker::forget(std::wstring const& path)
+	{
+		std::lock_guard<std::mutex> lk(mSync);
+		mFiles.erase(path);
+	}
+
+	void stability_tracker::sweep(time_point now)
+	{
+		for (auto it = std::begin(mFiles); it != std::end(mFiles);) {
+			if (now - it->second.mLastChange > FORGET_AFTER) {
+				it = mFiles.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "busy_probe.h"
+
+namespace died
+{
+	// Per-file "is the writer done" decision.
+	// Windows has no close-write notification, so a file is stable when it is not
+	// opened exclusively and its size and last write time stay the same for a quiet
+	// period after the last event seen on it. A file still changing is sampled again
+	// with an exponential backoff, so a busy file costs less and less and never
+	// delays the decision about other files.
+	class stability_tracker
+	{
+		using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+	public:
+		enum class verdict { unknown, changing, stable };
+
+		explicit stability_tracker(busy_probe& probe, size_t quiet = 1000, size_t firstSample = 250, size_t maxSample = 8000);
+
+		stability_tracker(stability_tracker const&) = delete;
+		stability_tracker& operator=(stability_tracker const&) = delete;
+
+		// Any thread. 'lastEvent' is the last notification on the file
+		verdict check(std::wstring const& path, time_point lastEvent);
+		bool is_stable(std::wstring const& path, time_point lastEvent);
+		void forget(std::wstring const& path);
+
+	private:
+		struct file
+		{
+			verdict mVerdict{ verdict::unknown };
+			unsigned long long mSize{};
+			unsigned long long mWriteTime{};
+			time_point mSampled;		// last probe used
+			time_point mLastChange;		// last event or size/time change
+			time_point mNextSample;
+			std::chrono::milliseconds mInterval{};
+		};
+
+		void sweep(time_point now);
+
+	private:
+		busy_probe& mProbe;
+		const std::chrono::milliseconds mQuiet;
+		const std::chrono::milliseconds mFirstSample;
+		const std::chrono::milliseconds mMaxSample;
+
+		std::mutex mSync;
+		std::unordered_map<std::wstring, file> mFiles;
+	};
+}
@@ -0,0 +1,72 @@
+#include "state_shards.h"
+#include <algorithm>
+#include <thread>
+
+namespace died
+{
+	state_shards::state_shards(size_t count)
+	{
+		count = std::max<size_t>(count, 1);
+		mShards.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			mShards.push_back(std::make_unique<path_state_table>());
+		}
+	}
+
+	size_t state_shards::default_count()
+	{
+		// one shard per core, a few are enough for the timer interval
+		constexpr size_t MAX_SHARDS = 16;
+		auto cores = static_cast<size_t>(std::thread::hardware_concurrency());
+		return std::clamp<size_t>(cores, 1, MAX_SHARDS);
+	}
+
+	void state_shards::push(path_action action, file_notify_info const& info)
+	{
+		of(info.get_path_wstring()).push(action, info);
+	}
+
+	void state_shards::push_rename(rename_link link)
+	{
+		auto& shard = of(link.mNewName);
+		shard.push_rename(std::move(link));
+	}
+
+	size_t state_shards::size() const noexcept
+	{
+		return mShards.size();
+	}
+
+	size_t state_shards::shard_of(std::wstring const& path) const
+	{
+		return shard_index(path, mShards.size());
+	}
+
+	size_t state_shards::shard_index(std::wstring const& path, size_t count)
+	{
+		auto parent = std::filesystem::path(path).parent_path().wstring();
+		return std::hash<std::wstring>{}(parent) % count;
+	}
+
+	path_state_table& state_shards::at(size_t index)
+	{
+		return *mShards.at(index);
+	}
+
+	path_state_table& state_shards::of(std::wstring const& path)
+	{
+		return *mShards[shard_of(path)];
+	}
+
+	path_state state_shards::find_by_name(path_action action, std::wstring const& fileName, std::wstring const& otherThanParent) const
+	{
+		// one name-index probe per shard
+		for (auto const& el : mShards) {
+			auto found = el->find_by_name(action, fileName, otherThanParent);
+			if (found) {
+				return found;
+			}
+		}
+		return path_state{};
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "path_state_table.h"
+#include <memory>
+
+namespace died
+{
+	// Pending file events spread over path_state_table shards by parent directory.
+	// A path always lands in the same shard, so one worker per shard keeps the
+	// per-path order. Renames stay in one folder => in one shard.
+	// Only moves (same file name, other folder) look across shards, via find_by_name().
+	class state_shards
+	{
+	public:
+		explicit state_shards(size_t count = default_count());
+
+		state_shards(state_shards const&) = delete;
+		state_shards& operator=(state_shards const&) = delete;
+
+		// Observer threads
+		void push(path_action action, file_notify_info const& info);
+		void push_rename(rename_link link);
+
+		size_t size() const noexcept;
+		size_t shard_of(std::wstring const& path) const;
+		path_state_table& at(size_t index);
+		path_state_table& of(std::wstring const& path);
+
+		// Cross-shard channel of the move matching
+		path_state find_by_name(path_action action, std::wstring const& fileName, std::wstring const& otherThanParent) const;
+
+		static size_t default_count();
+		static size_t shard_index(std::wstring const& path, size_t count);	// by parent directory, correlation_shards too
+
+	private:
+		std::vector<std::unique_ptr<path_state_table>> mShards;
+	};
+}
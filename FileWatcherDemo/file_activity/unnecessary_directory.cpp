@@ -27,20 +27,25 @@ namespace died
 		}
 
 		bool UnnecessaryDirectory::contains(file_notify_info const& info) const
+		{
+			return Rule::none != match(info);
+		}
+
+		UnnecessaryDirectory::Rule UnnecessaryDirectory::match(file_notify_info const& info) const
 		{
 			if (isAppDataPath(info)) {
-				return true;
+				return Rule::appData;
 			}
 
 			if (isDefaultPath(info)) {
-				return true;
+				return Rule::defaultPath;
 			}
 
 			if (isUserDefinePath(info)) {
-				return true;
+				return Rule::userDefine;
 			}
 
-			return false;
+			return Rule::none;
 		}
 
 		bool UnnecessaryDirectory::isAppDataPath(file_notify_info const& info) const
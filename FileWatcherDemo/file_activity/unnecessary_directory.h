@@ -11,10 +11,15 @@ namespace died
 		class UnnecessaryDirectory
 		{
 		public:
+			// Which rule excluded a path
+			enum class Rule : size_t { none, appData, defaultPath, userDefine };
+			static constexpr size_t RULE_COUNT = 3;
+
 			UnnecessaryDirectory();
 			void addUserDefinePath(std::wstring path);
 			void setAppDataDir(bool enable);
 			bool contains(file_notify_info const& info) const;
+			Rule match(file_notify_info const& info) const;
 
 		private:
 			bool isDefaultPath(file_notify_info const& info) const;
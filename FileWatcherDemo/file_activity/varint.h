@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace died
+{
+	// LEB128: 7 bits per byte, low first, the high bit set on all but the last byte
+	inline void put_varint(std::vector<uint8_t>& out, uint64_t value)
+	{
+		while (value >= 0x80) {
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	// false: cut before its last byte
+	inline bool get_varint(uint8_t const*& at, uint8_t const* end, uint64_t& value) noexcept
+	{
+		value = 0;
+		for (unsigned int shift = 0; at < end && shift < 64; shift += 7) {
+			auto byte = *at++;
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// small negative deltas stay small: 0, -1, 1, -2... => 0, 1, 2, 3...
+	inline uint64_t zigzag(int64_t value) noexcept
+	{
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+
+	inline int64_t unzigzag(uint64_t value) noexcept
+	{
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,715 @@
+#include "bench.h"
+#include "directory_watcher_mgr.h"
+#include "event_tracer.h"
+#include "filter_rules.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cmath>
+#include <cwctype>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace died
+{
+	namespace
+	{
+		using clock_type = std::chrono::steady_clock;
+
+		constexpr size_t SETUP_QUIET = 5000;	// milli-seconds without classification after a setup, longest delay included
+		constexpr size_t POLL = 100;			// milli-seconds
+
+		// One operation of a workload and the classifications it may end with
+		struct expectation
+		{
+			std::vector<std::wstring> mSubjects;	// any of them in the reported paths
+			std::vector<std::wstring> mActions;
+			clock_type::time_point mIssued;			// last syscall of the operation
+		};
+
+		struct received
+		{
+			clock_type::time_point mTime;
+			std::wstring mAction;
+			std::wstring mPath;
+		};
+
+		std::wstring lower(std::wstring s)
+		{
+			std::transform(std::begin(s), std::end(s), std::begin(s), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+			return s;
+		}
+
+		// Final events under the bench folder, stamped when notify_to_server delivers them
+		class collector
+		{
+		public:
+			explicit collector(std::wstring root) :
+				mRoot{ lower(std::move(root)) }
+			{}
+
+			void deliver(notify_message const& msg)
+			{
+				if (notify_kind::final != msg.mKind) {
+					return;
+				}
+				auto path = msg.path();
+				if (0 != lower(path).compare(0, mRoot.size(), mRoot)) {
+					return;
+				}
+				auto now = clock_type::now();
+				std::lock_guard<std::mutex> lk(mSync);
+				mReceived.push_back({ now, std::wstring{ msg.mAction }, std::move(path) });
+				mLast = now;
+			}
+
+			std::vector<received> take()
+			{
+				std::lock_guard<std::mutex> lk(mSync);
+				return std::move(mReceived);
+			}
+
+			size_t size() const
+			{
+				std::lock_guard<std::mutex> lk(mSync);
+				return mReceived.size();
+			}
+
+			clock_type::time_point last() const
+			{
+				std::lock_guard<std::mutex> lk(mSync);
+				return mLast;
+			}
+
+		private:
+			std::wstring mRoot;
+			mutable std::mutex mSync;
+			std::vector<received> mReceived;
+			clock_type::time_point mLast;
+		};
+
+		// Win32 file system calls of the generator, counted
+		class workload_fs
+		{
+		public:
+			explicit workload_fs(std::mt19937& rng) :
+				mData(64 * 1024)
+			{
+				std::uniform_int_distribution<int> byte(0, 255);
+				for (auto& el : mData) {
+					el = static_cast<char>(byte(rng));
+				}
+			}
+
+			bool write(std::wstring const& path, size_t size, bool append)
+			{
+				++mSyscalls;
+				auto file = CreateFileW(path.c_str(), append ? FILE_APPEND_DATA : GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+					nullptr, append ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (INVALID_HANDLE_VALUE == file) {
+					return false;
+				}
+
+				bool ok = true;
+				for (size_t done = 0; ok && done < size;) {
+					auto chunk = static_cast<DWORD>(std::min(size - done, mData.size()));
+					DWORD written{};
+					++mSyscalls;
+					ok = WriteFile(file, mData.data(), chunk, &written, nullptr) && written == chunk;
+					done += chunk;
+				}
+				++mSyscalls;
+				CloseHandle(file);
+				return ok;
+			}
+
+			bool rename(std::wstring const& from, std::wstring const& to)
+			{
+				++mSyscalls;
+				return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+			}
+
+			bool remove(std::wstring const& path)
+			{
+				++mSyscalls;
+				return DeleteFileW(path.c_str()) != 0;
+			}
+
+			bool remove_folder(std::wstring const& path)
+			{
+				++mSyscalls;
+				return RemoveDirectoryW(path.c_str()) != 0;
+			}
+
+			size_t syscalls() const noexcept
+			{
+				return mSyscalls;
+			}
+
+			void reset() noexcept
+			{
+				mSyscalls = 0;
+			}
+
+		private:
+			std::vector<char> mData;
+			size_t mSyscalls{};
+		};
+
+		struct workload_context
+		{
+			std::wstring mRoot;			// own folder of the workload
+			size_t mCount{};
+			std::mt19937 mRng;
+			workload_fs mFs;
+			std::vector<expectation> mExpected;
+			std::vector<std::wstring> mFiles;	// prepared by the setup
+			std::vector<std::wstring> mFolders;
+
+			workload_context(std::wstring root, size_t count, unsigned int seed) :
+				mRoot{ std::move(root) },
+				mCount{ count },
+				mRng{ seed },
+				mFs{ mRng }
+			{}
+
+			std::wstring path(std::wstring const& name) const
+			{
+				return mRoot + L"\\" + name;
+			}
+
+			std::wstring name(wchar_t const* format, size_t i)
+			{
+				wchar_t buf[64]{};
+				swprintf(buf, 64, format, static_cast<unsigned int>(i), static_cast<unsigned int>(mRng()));
+				return buf;
+			}
+
+			size_t size(size_t low, size_t high)
+			{
+				return std::uniform_int_distribution<size_t>(low, high)(mRng);
+			}
+
+			void expect(std::vector<std::wstring> subjects, std::vector<std::wstring> actions, clock_type::time_point issued)
+			{
+				mExpected.push_back({ std::move(subjects), std::move(actions), issued });
+			}
+		};
+
+		struct workload
+		{
+			wchar_t const* mName;
+			std::function<void(workload_context&)> mSetup;
+			std::function<void(workload_context&)> mRun;
+		};
+
+		void make_folder(std::wstring const& path)
+		{
+			std::error_code ec;
+			std::filesystem::create_directories(path, ec);
+		}
+
+		// **case: many new files
+		void run_bulk_create(workload_context& ctx)
+		{
+			for (size_t i = 0; i < ctx.mCount; ++i) {
+				auto file = ctx.path(ctx.name(L"f_%05u_%08x.txt", i));
+				auto issued = clock_type::now();
+				ctx.mFs.write(file, ctx.size(0, 4096), false);
+				ctx.expect({ file }, { L"Create only", L"Copy" }, issued);
+			}
+		}
+
+		// **case: many appends on few files
+		void setup_write_storm(workload_context& ctx)
+		{
+			for (size_t i = 0; i < std::max<size_t>(ctx.mCount / 10, 1); ++i) {
+				auto file = ctx.path(ctx.name(L"w_%05u_%08x.log", i));
+				ctx.mFs.write(file, 1024, false);
+				ctx.mFiles.push_back(file);
+			}
+		}
+
+		void run_write_storm(workload_context& ctx)
+		{
+			std::vector<clock_type::time_point> last(ctx.mFiles.size());
+			std::vector<bool> touched(ctx.mFiles.size());
+			for (size_t i = 0; i < ctx.mCount; ++i) {
+				auto pick = ctx.size(0, ctx.mFiles.size() - 1);
+				last[pick] = clock_type::now();
+				touched[pick] = true;
+				ctx.mFs.write(ctx.mFiles[pick], ctx.size(64, 4096), true);
+			}
+			for (size_t i = 0; i < ctx.mFiles.size(); ++i) {
+				if (touched[i]) {
+					ctx.expect({ ctx.mFiles[i] }, { L"Modify" }, last[i]);
+				}
+			}
+		}
+
+		// **case: Word save
+		//step 1: create - D:\test\~WRL0001.tmp
+		//step 2: rename - D:\test\8.docx => D:\test\8.docx~RF1994986.TMP
+		//step 3: rename - D:\test\~WRL0001.tmp => D:\test\8.docx
+		//step 4: remove - D:\test\8.docx~RF1994986.TMP
+		void setup_documents(workload_context& ctx, wchar_t const* format)
+		{
+			for (size_t i = 0; i < ctx.mCount; ++i) {
+				auto file = ctx.path(ctx.name(format, i));
+				ctx.mFs.write(file, 8192, false);
+				ctx.mFiles.push_back(file);
+			}
+		}
+
+		void run_word_save(workload_context& ctx)
+		{
+			for (size_t i = 0; i < ctx.mFiles.size(); ++i) {
+				auto const& doc = ctx.mFiles[i];
+				auto owner = ctx.path(ctx.name(L"~WRL%04u.tmp", i));
+				auto backup = doc + ctx.name(L"~RF%u%07x.TMP", i);
+				ctx.mFs.write(owner, ctx.size(4096, 16384), false);
+				ctx.mFs.rename(doc, backup);
+				ctx.mFs.rename(owner, doc);
+				auto issued = clock_type::now();
+				ctx.mFs.remove(backup);
+				ctx.expect({ doc }, { L"Modify Word save" }, issued);
+			}
+		}
+
+		// **case: Word save-as
+		//step 1: create - D:\test\8.docx
+		//step 2: rename - D:\test\8.docx => D:\test\8.docx~RF1994986.TMP
+		//step 3: rename - D:\test\~WRL0001.tmp => D:\test\8.docx
+		//step 4: remove - D:\test\8.docx~RF1994986.TMP
+		void run_word_save_as(workload_context& ctx)
+		{
+			for (size_t i = 0; i < ctx.mCount; ++i) {
+				auto doc = ctx.path(ctx.name(L"new_%05u_%08x.docx", i));
+				auto owner = ctx.path(ctx.name(L"~WRL%04u.tmp", i));
+				auto backup = doc + ctx.name(L"~RF%u%07x.TMP", i);
+				ctx.mFs.write(doc, 0, false);
+				ctx.mFs.write(owner, ctx.size(4096, 16384), false);
+				ctx.mFs.rename(doc, backup);
+				ctx.mFs.rename(owner, doc);
+				auto issued = clock_type::now();
+				ctx.mFs.remove(backup);
+				ctx.expect({ doc }, { L"Create Word save-as" }, issued);
+			}
+		}
+
+		// **case: Excel save, renames of the same family
+		//step 1: create - D:\test\5E1F3A20
+		//step 2: rename - D:\test\1.xlsx => D:\test\9A2B4C6D.tmp
+		//step 3: rename - D:\test\5E1F3A20 => D:\test\1.xlsx
+		//step 4: remove - D:\test\9A2B4C6D.tmp
+		void run_excel_save(workload_context& ctx)
+		{
+			for (size_t i = 0; i < ctx.mFiles.size(); ++i) {
+				auto const& book = ctx.mFiles[i];
+				auto owner = ctx.path(ctx.name(L"%04u%04X", i).substr(0, 8));
+				auto backup = ctx.path(ctx.name(L"%04u%08X.tmp", i));
+				ctx.mFs.write(owner, ctx.size(4096, 16384), false);
+				ctx.mFs.rename(book, backup);
+				ctx.mFs.rename(owner, book);
+				auto issued = clock_type::now();
+				ctx.mFs.remove(backup);
+				ctx.expect({ book, backup, owner }, { L"Create excel save-as", L"Modify Word save" }, issued);
+			}
+		}
+
+		// **case: browser download
+		//step 1: rename - D:\test\9be830ee.tmp => D:\test\1.jpg.crdownload
+		//step 2: modify - D:\test\1.jpg.crdownload
+		//step 3: rename - D:\test\1.jpg.crdownload => D:\test\1.jpg
+		void run_download(workload_context& ctx)
+		{
+			for (size_t i = 0; i < ctx.mCount; ++i) {
+				auto temp = ctx.path(ctx.name(L"%04u%04x.tmp", i));
+				auto file = ctx.path(ctx.name(L"image_%05u_%08x.jpg", i));
+				auto partial = file + L".crdownload";
+				ctx.mFs.write(temp, 0, false);
+				ctx.mFs.rename(temp, partial);
+				for (size_t chunk = 0; chunk < 3; ++chunk) {
+					ctx.mFs.write(partial, 16384, true);
+				}
+				auto issued = clock_type::now();
+				ctx.mFs.rename(partial, file);
+				ctx.expect({ file, partial }, { L"Create download auto-save" }, issued);
+			}
+		}
+
+		// **case: move to another folder of the same drive
+		void setup_move(workload_context& ctx)
+		{
+			make_folder(ctx.path(L"from"));
+			make_folder(ctx.path(L"to"));
+			for (size_t i = 0; i < ctx.mCount; ++i) {
+				auto file = ctx.path(L"from\\" + ctx.name(L"m_%05u_%08x.dat", i));
+				ctx.mFs.write(file, ctx.size(0, 4096), false);
+				ctx.mFiles.push_back(file);
+			}
+		}
+
+		void run_move(workload_context& ctx)
+		{
+			for (auto const& el : ctx.mFiles) {
+				auto to = ctx.path(L"to\\" + std::filesystem::path(el).filename().wstring());
+				auto issued = clock_type::now();
+				ctx.mFs.rename(el, to);
+				ctx.expect({ to, el }, { L"Move" }, issued);
+			}
+		}
+
+		// **case: delete a deep tree, files then folders
+		void setup_tree(workload_context& ctx)
+		{
+			constexpr size_t DEPTH = 4;
+			constexpr size_t FAN_OUT = 3;
+
+			std::vector<std::wstring> level{ ctx.path(L"tree") };
+			make_folder(level.front());
+			ctx.mFolders = level;
+			for (size_t depth = 1; depth < DEPTH; ++depth) {
+				std::vector<std::wstring> next;
+				for (auto const& parent : level) {
+					for (size_t i = 0; i < FAN_OUT; ++i) {
+						auto folder = parent + L"\\" + ctx.name(L"d%u_%08x", i);
+						make_folder(folder);
+						next.push_back(folder);
+					}
+				}
+				ctx.mFolders.insert(std::end(ctx.mFolders), std::begin(next), std::end(next));
+				level = std::move(next);
+			}
+
+			for (size_t i = 0; i < ctx.mCount; ++i) {
+				auto const& parent = ctx.mFolders[i % ctx.mFolders.size()];
+				auto file = parent + L"\\" + ctx.name(L"t_%05u_%08x.txt", i);
+				ctx.mFs.write(file, ctx.size(0, 1024), false);
+				ctx.mFiles.push_back(file);
+			}
+		}
+
+		void run_tree_delete(workload_context& ctx)
+		{
+			for (auto const& el : ctx.mFiles) {
+				auto issued = clock_type::now();
+				ctx.mFs.remove(el);
+				ctx.expect({ el }, { L"Remove" }, issued);
+			}
+			// deepest first
+			for (auto it = ctx.mFolders.rbegin(); it != ctx.mFolders.rend(); ++it) {
+				auto issued = clock_type::now();
+				ctx.mFs.remove_folder(*it);
+				ctx.expect({ *it }, { L"Folder remove" }, issued);
+			}
+		}
+
+		std::vector<workload> const& all_workloads()
+		{
+			static const std::vector<workload> WORKLOADS{
+				{ L"bulk_create", nullptr, run_bulk_create },
+				{ L"write_storm", setup_write_storm, run_write_storm },
+				{ L"word_save", [](workload_context& ctx) { setup_documents(ctx, L"doc_%05u_%08x.docx"); }, run_word_save },
+				{ L"word_save_as", nullptr, run_word_save_as },
+				{ L"excel_save", [](workload_context& ctx) { setup_documents(ctx, L"book_%05u_%08x.xlsx"); }, run_excel_save },
+				{ L"download", nullptr, run_download },
+				{ L"move", setup_move, run_move },
+				{ L"tree_delete", setup_tree, run_tree_delete }
+			};
+			return WORKLOADS;
+		}
+
+		std::vector<std::wstring> split_paths(std::wstring const& paths)
+		{
+			std::vector<std::wstring> result;
+			size_t start = 0;
+			for (auto sep = paths.find(L", "); std::wstring::npos != sep; sep = paths.find(L", ", start)) {
+				result.push_back(paths.substr(start, sep - start));
+				start = sep + 2;
+			}
+			result.push_back(paths.substr(start));
+			return result;
+		}
+
+		double cpu_ms(HANDLE process)
+		{
+			FILETIME creation{}, exit{}, kernel{}, user{};
+			GetProcessTimes(process, &creation, &exit, &kernel, &user);
+			auto ticks = [](FILETIME const& ft) {
+				return (static_cast<unsigned long long>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+			};
+			return (ticks(kernel) + ticks(user)) / 10000.0;
+		}
+
+		double thread_cpu_ms()
+		{
+			FILETIME creation{}, exit{}, kernel{}, user{};
+			GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+			auto ticks = [](FILETIME const& ft) {
+				return (static_cast<unsigned long long>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+			};
+			return (ticks(kernel) + ticks(user)) / 10000.0;
+		}
+
+		// nearest rank
+		double percentile(std::vector<double> const& sorted, double p)
+		{
+			if (sorted.empty()) {
+				return 0.0;
+			}
+			auto rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+			return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+		}
+
+		// Wait until every expectation is received or nothing came for 'quiet'
+		void wait_quiet(collector const& sink, size_t expected, clock_type::time_point since, size_t quiet)
+		{
+			while (true) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(POLL));
+				auto last = std::max(since, sink.last());
+				if ((expected && sink.size() >= expected) || clock_type::now() - last > std::chrono::milliseconds(quiet)) {
+					return;
+				}
+			}
+		}
+
+		bench_result measure(workload const& load, workload_context& ctx, collector& sink, bench_options const& options)
+		{
+			// 1. setup, its own events are classified then dropped
+			make_folder(ctx.mRoot);
+			if (load.mSetup) {
+				load.mSetup(ctx);
+				wait_quiet(sink, 0, clock_type::now(), SETUP_QUIET);
+			}
+			sink.take();
+			ctx.mFs.reset();
+
+			// 2. measured part: generator CPU is not watcher CPU
+			auto process = GetCurrentProcess();
+			auto cpuStart = cpu_ms(process) - thread_cpu_ms();
+			auto wallStart = clock_type::now();
+			load.mRun(ctx);
+			auto generated = thread_cpu_ms();
+			wait_quiet(sink, ctx.mExpected.size(), clock_type::now(), options.mDrain);
+			auto cpu = cpu_ms(process) - generated - cpuStart;
+
+			bench_result result;
+			result.mWorkload = load.mName;
+			result.mOperations = ctx.mExpected.size();
+			result.mSyscalls = ctx.mFs.syscalls();
+			result.mSeconds = std::chrono::duration<double>(clock_type::now() - wallStart).count();
+			result.mCpuPer1k = result.mSyscalls ? cpu * 1000.0 / result.mSyscalls : 0.0;
+
+			// 3. the first classification reporting a subject resolves its operation
+			std::unordered_map<std::wstring, size_t> bySubject;
+			for (size_t i = 0; i < ctx.mExpected.size(); ++i) {
+				for (auto const& el : ctx.mExpected[i].mSubjects) {
+					bySubject.emplace(lower(el), i);
+				}
+			}
+
+			std::vector<bool> resolved(ctx.mExpected.size());
+			std::vector<double> latencies;
+			for (auto const& msg : sink.take()) {
+				for (auto const& el : split_paths(msg.mPath)) {
+					auto found = bySubject.find(lower(el));
+					if (std::end(bySubject) == found || resolved[found->second]) {
+						continue;
+					}
+
+					auto const& want = ctx.mExpected[found->second];
+					resolved[found->second] = true;
+					if (std::end(want.mActions) == std::find(std::begin(want.mActions), std::end(want.mActions), msg.mAction)) {
+						++result.mMisclassified;
+						break;
+					}
+					++result.mClassified;
+					latencies.push_back(std::chrono::duration<double, std::milli>(msg.mTime - want.mIssued).count());
+					break;
+				}
+			}
+			result.mLost = result.mOperations - result.mClassified - result.mMisclassified;
+
+			std::sort(std::begin(latencies), std::end(latencies));
+			result.mP50 = percentile(latencies, 50);
+			result.mP90 = percentile(latencies, 90);
+			result.mP99 = percentile(latencies, 99);
+			result.mMax = latencies.empty() ? 0.0 : latencies.back();
+			return result;
+		}
+
+		std::string build_name()
+		{
+			std::ostringstream out;
+#if defined(_MSC_VER)
+			out << "msvc " << _MSC_VER;
+#else
+			out << "unknown";
+#endif
+#if defined(NDEBUG)
+			out << " release";
+#else
+			out << " debug";
+#endif
+			out << " " << __DATE__ << " " << __TIME__;
+			return out.str();
+		}
+
+		std::string to_utf8(std::wstring const& s)
+		{
+			return std::filesystem::path(s).u8string();
+		}
+	}
+
+	std::vector<std::wstring> const& bench_workloads()
+	{
+		static const std::vector<std::wstring> NAMES = [] {
+			std::vector<std::wstring> names;
+			for (auto const& el : all_workloads()) {
+				names.push_back(el.mName);
+			}
+			return names;
+		}();
+		return NAMES;
+	}
+
+	std::vector<bench_result> bench(bench_options const& options)
+	{
+		std::vector<bench_result> results;
+		auto root = std::filesystem::absolute(options.mDir).wstring();
+		while (!root.empty() && (L'\\' == root.back() || L'/' == root.back())) {
+			root.pop_back();
+		}
+
+		// the watcher drops excluded paths, nothing would be measured
+		if (filter_rules::default_rules()->contains(file_notify_info{ root + L"\\bench.txt", FILE_ACTION_ADDED })) {
+			std::wcerr << L"excluded by the default rules: " << root << std::endl;
+			return results;
+		}
+
+		// 1. clean folder before watching
+		std::error_code ec;
+		std::filesystem::remove_all(root, ec);
+		make_folder(root);
+
+		collector sink{ root + L"\\" };
+		directory_watcher_mgr mgr{ options.mInterval, L"" };
+		mgr.add_consumer(L"bench", false, [&sink](notify_message const& msg) {
+			sink.deliver(msg);
+		});
+		// the bench folder only: activity elsewhere on the machine would add to the measures
+		mgr.start(FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_DIR_NAME, std::vector<std::wstring>{ root });
+
+		// 2. one folder and the same seed per workload => same operations on every run
+		for (auto const& el : all_workloads()) {
+			if (!options.mWorkloads.empty()
+				&& std::end(options.mWorkloads) == std::find(std::begin(options.mWorkloads), std::end(options.mWorkloads), el.mName)) {
+				continue;
+			}
+			workload_context ctx{ root + L"\\" + el.mName, options.mCount, options.mSeed };
+			results.push_back(measure(el, ctx, sink, options));
+		}
+
+		mgr.stop();
+		std::filesystem::remove_all(root, ec);
+		return results;
+	}
+
+	std::string to_json(bench_result const& result, bench_options const& options)
+	{
+		std::ostringstream out;
+		out.setf(std::ios::fixed);
+		out.precision(3);
+		out << "{\"workload\":\"" << to_utf8(result.mWorkload) << "\""
+			<< ",\"build\":\"" << build_name() << "\""
+			<< ",\"seed\":" << options.mSeed
+			<< ",\"count\":" << options.mCount
+			<< ",\"interval_ms\":" << options.mInterval
+			<< ",\"operations\":" << result.mOperations
+			<< ",\"syscalls\":" << result.mSyscalls
+			<< ",\"classified\":" << result.mClassified
+			<< ",\"misclassified\":" << result.mMisclassified
+			<< ",\"lost\":" << result.mLost
+			<< ",\"latency_ms\":{\"p50\":" << result.mP50 << ",\"p90\":" << result.mP90 << ",\"p99\":" << result.mP99 << ",\"max\":" << result.mMax << "}"
+			<< ",\"cpu_ms_per_1k_events\":" << result.mCpuPer1k
+			<< ",\"seconds\":" << result.mSeconds
+			<< "}";
+		return out.str();
+	}
+
+	int run_bench(std::vector<std::wstring> const& args)
+	{
+		bench_options options;
+		std::wstring output;
+		std::wstring trace;
+		for (size_t i = 0; i < args.size(); ++i) {
+			bool hasValue = i + 1 < args.size();
+			if (L"--workload" == args[i] && hasValue) {
+				options.mWorkloads.push_back(args[++i]);
+			}
+			else if (L"--count" == args[i] && hasValue) {
+				options.mCount = std::stoul(args[++i]);
+			}
+			else if (L"--seed" == args[i] && hasValue) {
+				options.mSeed = std::stoul(args[++i]);
+			}
+			else if (L"--drain" == args[i] && hasValue) {
+				options.mDrain = std::stoul(args[++i]);
+			}
+			else if (L"--interval" == args[i] && hasValue) {
+				options.mInterval = std::stoul(args[++i]);
+			}
+			else if (L"--out" == args[i] && hasValue) {
+				output = args[++i];
+			}
+			else if (L"--trace" == args[i] && hasValue) {
+				trace = args[++i];
+			}
+			else {
+				options.mDir = args[i];
+			}
+		}
+
+		auto const& names = bench_workloads();
+		for (auto const& el : options.mWorkloads) {
+			if (std::end(names) == std::find(std::begin(names), std::end(names), el)) {
+				std::wcerr << L"unknown workload: " << el << std::endl;
+				return 2;
+			}
+		}
+		if (options.mDir.empty()) {
+			std::wcerr << L"usage: bench <dir> [--workload <name>]... [--count <n>] [--seed <n>] [--drain <ms>] [--interval <ms>] [--out <file>] [--trace <file>]" << std::endl;
+			return 2;
+		}
+
+		event_tracer::enable(!trace.empty());
+		auto results = bench(options);
+		event_tracer::enable(false);
+		if (!trace.empty() && !event_tracer::write_chrome_json(trace)) {
+			std::wcerr << L"cannot write " << trace << std::endl;
+		}
+		if (results.empty()) {
+			return 1;
+		}
+
+		// JSON lines, appended => one file collects the runs of several builds
+		std::ofstream file;
+		if (!output.empty()) {
+			file.open(std::filesystem::path(output), std::ios::app | std::ios::binary);
+		}
+		for (auto const& el : results) {
+			auto line = to_json(el, options);
+			std::cout << line << std::endl;
+			if (file.is_open()) {
+				file << line << "\n";
+			}
+		}
+		return 0;
+	}
+}
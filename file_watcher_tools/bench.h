@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace died
+{
+	struct bench_options
+	{
+		std::wstring mDir;						// working directory, a RAM disk keeps the disk out of the numbers
+		std::vector<std::wstring> mWorkloads;	// empty => all of them
+		size_t mCount{ 500 };					// operations per workload
+		unsigned int mSeed{ 1 };
+		size_t mDrain{ 15000 };					// milli-seconds without classification that ends a workload
+		unsigned long mInterval{ 300 };			// timer round of directory_watcher_mgr, milli-seconds
+	};
+
+	struct bench_result
+	{
+		std::wstring mWorkload;
+		size_t mOperations{};		// expected classifications
+		size_t mSyscalls{};			// file system calls of the measured part
+		size_t mClassified{};		// expected classification received
+		size_t mMisclassified{};	// received with another classification
+		size_t mLost{};				// never received
+		double mP50{};				// milli-seconds, last syscall of an operation => notify_to_server::send
+		double mP90{};
+		double mP99{};
+		double mMax{};
+		double mCpuPer1k{};			// milli-seconds of watcher CPU per 1000 syscalls
+		double mSeconds{};			// wall time of the measured part
+	};
+
+	// Names of the built-in workloads, in run order
+	std::vector<std::wstring> const& bench_workloads();
+
+	// Run the workloads on the real file system against a started directory_watcher_mgr
+	std::vector<bench_result> bench(bench_options const& options);
+
+	// One JSON object per line, stable keys to compare builds
+	std::string to_json(bench_result const& result, bench_options const& options);
+
+	// bench <dir> [--workload <name>]... [--count <n>] [--seed <n>] [--drain <ms>] [--interval <ms>] [--out <file>]
+	int run_bench(std::vector<std::wstring> const& args);
+}
@@ -0,0 +1,188 @@
+#include "journal.h"
+#include "event_journal.h"
+#include "raw_journal.h"
+#include "std_filesystem.h"
+#include <Windows.h>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace died
+{
+	namespace
+	{
+		std::string to_utf8(std::wstring const& s)
+		{
+			return std::filesystem::path(s).u8string();
+		}
+
+		std::wstring text_of(uint16_t const* text, size_t count)
+		{
+			std::wstring result;
+			result.reserve(count);
+			for (size_t i = 0; i < count; ++i) {
+				result.push_back(static_cast<wchar_t>(text[i]));
+			}
+			return result;
+		}
+
+		std::string time_of(journal_header const& header, int64_t time)
+		{
+			auto elapsed = static_cast<long double>(time - header.mClockOrigin) * header.mTickNum / header.mTickDen;
+			return wall_time_text(header.mWallOrigin + static_cast<int64_t>(elapsed * 10000000));
+		}
+
+		// source and message, as logged before the journal
+		std::string message_of(journal_record const& record)
+		{
+			auto first = to_utf8(text_of(record.mText, record.mFirst));
+			auto second = to_utf8(text_of(record.mText + record.mFirst, record.mSecond));
+			auto third = to_utf8(text_of(record.mText + record.mFirst + record.mSecond, record.mThird));
+			if (record.mFlags & journal_record::TRUNCATED) {
+				(record.mSecond ? second : first).insert(0, "...");
+			}
+			auto value = std::to_string(record.mValue);
+
+			switch (static_cast<journal_code>(record.mCode))
+			{
+			case journal_code::file_name:			return "[died::file_name_watcher::do_notify] " + value + " - " + first;
+			case journal_code::attribute:			return "[died::attribute_watcher::do_notify] " + value + " - " + first;
+			case journal_code::attribute_ignored:	return "[died::attribute_watcher::do_notify] Ignore: " + value + " - " + first;
+			case journal_code::security:			return "[died::security_watcher::do_notify] " + value + " - " + first;
+			case journal_code::security_ignored:	return "[died::security_watcher::do_notify] Ignore: " + value + " - " + first;
+			case journal_code::folder_name:			return "[died::folder_name_watcher::do_notify] " + value + " - " + first;
+			case journal_code::provisional:			return "[died::notify_to_server::provisional] provisional " + value + " " + first + " - " + second;
+			case journal_code::sent:				return "[died::notify_to_server::send] " + first + " - " + second + (third.empty() ? "" : ", " + third) + (record.mValue ? " (still open)" : "");
+			case journal_code::retracted:			return "[died::notify_to_server::retract] retract " + value + " " + first + " - " + second;
+			case journal_code::dropped:				return "[died::event_journal] " + value + " records dropped so far";
+			case journal_code::erased:				return "[died::directory_watcher_mgr::erase_all] " + first;
+			case journal_code::rename_erased:		return "[died::directory_watcher_mgr::erase_rename] " + first + " - " + second;
+			default:								return "[died::event_journal] unknown code " + std::to_string(record.mCode);
+			}
+		}
+
+		// do_notify line of a raw event, as spdlog logged it
+		std::string raw_line(raw_event const& ev)
+		{
+			static const char* const SOURCES[WATCHER_KIND_COUNT]{ "file_name_watcher", "attribute_watcher", "security_watcher", "folder_name_watcher" };
+			return wall_time_text(ev.mTime) + " [raw] [died::" + SOURCES[static_cast<size_t>(ev.mKind)] + "::do_notify] "
+				+ std::to_string(ev.mAction) + " - " + to_utf8(ev.mPath);
+		}
+	}
+
+	std::string wall_time_text(int64_t fileTime)
+	{
+		auto wall = static_cast<uint64_t>(fileTime);
+		FILETIME file{ static_cast<DWORD>(wall), static_cast<DWORD>(wall >> 32) };
+		SYSTEMTIME utc{}, local{};
+		if (!::FileTimeToSystemTime(&file, &utc) || !::SystemTimeToTzSpecificLocalTime(nullptr, &utc, &local)) {
+			return "[?]";
+		}
+		char buf[64]{};
+		std::snprintf(buf, sizeof(buf), "[%04u-%02u-%02u_%02u:%02u:%02u %03u]", local.wYear, local.wMonth, local.wDay,
+			local.wHour, local.wMinute, local.wSecond, local.wMilliseconds);
+		return buf;
+	}
+
+	bool decode_journal(std::istream& in, std::ostream& out, std::wstring& error)
+	{
+		journal_header header;
+		if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || journal_header::MAGIC != header.mMagic) {
+			error = L"not an event journal";
+			return false;
+		}
+		if (journal_header::VERSION != header.mVersion || sizeof(journal_record) != header.mRecordSize || !header.mTickDen) {
+			error = L"unsupported journal version " + std::to_wstring(header.mVersion);
+			return false;
+		}
+
+		journal_record record;
+		while (in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+			if (static_cast<size_t>(record.mFirst) + record.mSecond + record.mThird > journal_record::TEXT) {
+				out << time_of(header, record.mTime) << " [error] corrupted record\n";
+				continue;
+			}
+			out << time_of(header, record.mTime)
+				<< (static_cast<uint8_t>(journal_level::debug) == record.mLevel ? " [debug]" : " [info]")
+				<< " [thread " << record.mThread << "] "
+				<< message_of(record) << "\n";
+		}
+		return true;
+	}
+
+	int run_journal(std::vector<std::wstring> const& args)
+	{
+		std::wstring file;
+		std::wstring output;
+		for (size_t i = 0; i < args.size(); ++i) {
+			if (L"--out" == args[i] && i + 1 < args.size()) {
+				output = args[++i];
+			}
+			else {
+				file = args[i];
+			}
+		}
+		if (file.empty()) {
+			std::wcerr << L"usage: journal <file> [--out <file>]" << std::endl;
+			return 2;
+		}
+
+		std::ifstream in{ std::filesystem::path(file), std::ios::binary };
+		if (!in) {
+			std::wcerr << L"cannot open " << file << std::endl;
+			return 2;
+		}
+		std::ofstream out;
+		if (!output.empty()) {
+			out.open(std::filesystem::path(output), std::ios::binary | std::ios::trunc);
+			if (!out.is_open()) {
+				std::wcerr << L"cannot write " << output << std::endl;
+				return 2;
+			}
+		}
+
+		std::wstring error;
+		if (!decode_journal(in, output.empty() ? std::cout : out, error)) {
+			std::wcerr << file << L": " << error << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	int run_raw(std::vector<std::wstring> const& args)
+	{
+		std::wstring dir;
+		std::wstring output;
+		for (size_t i = 0; i < args.size(); ++i) {
+			if (L"--out" == args[i] && i + 1 < args.size()) {
+				output = args[++i];
+			}
+			else {
+				dir = args[i];
+			}
+		}
+		if (dir.empty()) {
+			std::wcerr << L"usage: raw <dir> [--out <file>]" << std::endl;
+			return 2;
+		}
+
+		std::vector<raw_event> events;
+		std::wstring error;
+		if (!read_raw_journal(dir, events, error)) {
+			std::wcerr << dir << L": " << error << std::endl;
+			return 1;
+		}
+		std::ofstream out;
+		if (!output.empty()) {
+			out.open(std::filesystem::path(output), std::ios::binary | std::ios::trunc);
+			if (!out.is_open()) {
+				std::wcerr << L"cannot write " << output << std::endl;
+				return 2;
+			}
+		}
+		for (auto const& el : events) {
+			(output.empty() ? std::cout : out) << raw_line(el) << "\n";
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace died
+{
+	// [2020-12-28_08:34:41 343] of a FILETIME, local time like the spdlog pattern
+	std::string wall_time_text(int64_t fileTime);
+
+	// Decode an event journal (event_journal.h) into the text lines spdlog used to write, UTF-8.
+	// The file_name_watcher lines are a recorded log for replay.
+	// false: not a journal, 'error' says why; a truncated last record is ignored
+	bool decode_journal(std::istream& in, std::ostream& out, std::wstring& error);
+
+	// journal <file> [--out <file>]
+	int run_journal(std::vector<std::wstring> const& args);
+
+	// Decode a raw journal directory (raw_journal.h) into do_notify lines like data_analyze.txt, replay reads them.
+	// raw <dir> [--out <file>]
+	int run_raw(std::vector<std::wstring> const& args);
+}
@@ -0,0 +1,50 @@
+#include "bench.h"
+#include "journal.h"
+#include "receive.h"
+#include "replay.h"
+#include "ring.h"
+#include "spdlog_header.h"
+#include <iostream>
+
+// Headless tools of the file watcher, one sub-command each
+int wmain(int argc, wchar_t* argv[])
+{
+	std::vector<std::wstring> args(argv + 1, argv + argc);
+	if (args.empty()) {
+		std::wcerr << L"usage: file_watcher_tools <command> ...\n"
+			<< L"  replay <log | raw journal dir> [--golden <file>] [--update] [--interval <ms>] [--timed] [--shards <n>] [--trace <file>]\n"
+			<< L"  bench <dir> [--workload <name>]... [--count <n>] [--seed <n>] [--drain <ms>] [--interval <ms>] [--out <file>] [--trace <file>]\n"
+			<< L"  journal <file> [--out <file>]\n"
+			<< L"  raw <dir> [--out <file>]\n"
+			<< L"  receive [--pipe <name>] [--count <n>] [--out <file>]\n"
+			<< L"  ring [--name <name>] [--count <n>] [--out <file>]" << std::endl;
+		return 2;
+	}
+
+	// the pipeline logs every event, keep the console for the results
+	spdlog::set_level(spdlog::level::warn);
+
+	auto command = args.front();
+	args.erase(std::begin(args));
+	if (L"replay" == command) {
+		return died::run_replay(args);
+	}
+	if (L"bench" == command) {
+		return died::run_bench(args);
+	}
+	if (L"journal" == command) {
+		return died::run_journal(args);
+	}
+	if (L"raw" == command) {
+		return died::run_raw(args);
+	}
+	if (L"receive" == command) {
+		return died::run_receive(args);
+	}
+	if (L"ring" == command) {
+		return died::run_ring(args);
+	}
+
+	std::wcerr << L"unknown command: " << command << std::endl;
+	return 2;
+}
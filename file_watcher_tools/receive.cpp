@@ -0,0 +1,143 @@
+#include "receive.h"
+#include "event_sender.h"
+#include "journal.h"
+#include "std_filesystem.h"
+#include <Windows.h>
+#include <fstream>
+#include <iostream>
+
+namespace died
+{
+	namespace
+	{
+		bool read_exact(HANDLE pipe, void* data, size_t size)
+		{
+			auto at = static_cast<char*>(data);
+			while (size) {
+				DWORD read = 0;
+				if (!::ReadFile(pipe, at, static_cast<DWORD>(size), &read, nullptr) || !read) {
+					return false;
+				}
+				at += read;
+				size -= read;
+			}
+			return true;
+		}
+
+		// events of one connected sender, until it closes the pipe or 'count' events
+		size_t serve(HANDLE pipe, std::ostream& out, size_t count)
+		{
+			size_t received = 0;
+			unsigned long long expected = 0;
+			bool first = true;
+			std::vector<uint8_t> body;
+			std::vector<received_event> events;
+
+			frame_header header;
+			while (received < count && read_exact(pipe, &header, sizeof(header))) {
+				if (frame_header::MAGIC != header.mMagic || frame_header::VERSION != header.mVersion || frame_header::MAX_BYTES < header.mBytes) {
+					std::wcerr << L"not an event frame, closing" << std::endl;
+					break;
+				}
+				body.resize(header.mBytes);
+				events.clear();
+				if (!read_exact(pipe, body.data(), body.size()) || !decode_frame(header, body.data(), events)) {
+					std::wcerr << L"malformed frame, closing" << std::endl;
+					break;
+				}
+
+				// the sender numbers every event, lost ones included
+				if (!first && header.mFirstSeq != expected) {
+					std::wcerr << header.mFirstSeq - expected << L" events lost" << std::endl;
+				}
+				first = false;
+				expected = header.mFirstSeq + header.mCount;
+
+				for (auto const& ev : events) {
+					out << to_line(ev) << "\n";
+				}
+				out.flush();
+				received += events.size();
+			}
+			return received;
+		}
+	}
+
+	std::string to_line(received_event const& ev)
+	{
+		std::wstring paths;
+		switch (ev.mKind)
+		{
+		case event_kind::rename_only:
+		case event_kind::folder_move:
+			paths = ev.mOldPath + L", " + ev.mPath;
+			break;
+		default:
+			paths = ev.mPath;
+			for (auto const* el : { &ev.mOldPath, &ev.mAuxPath }) {
+				if (!el->empty()) {
+					paths += L", " + *el;
+				}
+			}
+			break;
+		}
+		auto line = ev.mName + L" - " + paths + (ev.mStillOpen ? L" (still open)" : L"");
+		if (1 < ev.mCount) {
+			line += L" (x" + std::to_wstring(ev.mCount) + L")";
+		}
+		return wall_time_text(ev.mClassified) + " [" + std::to_string(ev.mSource) + "] " + std::filesystem::path(line).u8string();
+	}
+
+	int run_receive(std::vector<std::wstring> const& args)
+	{
+		std::wstring name = event_sender::DEFAULT_PIPE;
+		size_t count = SIZE_MAX;
+		std::wstring output;
+		for (size_t i = 0; i < args.size(); ++i) {
+			bool hasValue = i + 1 < args.size();
+			if (L"--pipe" == args[i] && hasValue) {
+				name = args[++i];
+			}
+			else if (L"--count" == args[i] && hasValue) {
+				count = std::stoul(args[++i]);
+			}
+			else if (L"--out" == args[i] && hasValue) {
+				output = args[++i];
+			}
+			else {
+				std::wcerr << L"usage: receive [--pipe <name>] [--count <n>] [--out <file>]" << std::endl;
+				return 2;
+			}
+		}
+
+		std::ofstream out;
+		if (!output.empty()) {
+			out.open(std::filesystem::path(output), std::ios::binary | std::ios::trunc);
+			if (!out.is_open()) {
+				std::wcerr << L"cannot write " << output << std::endl;
+				return 2;
+			}
+		}
+
+		HANDLE pipe = ::CreateNamedPipeW(name.c_str(), PIPE_ACCESS_INBOUND, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+			1, 0, frame_header::MAX_BYTES, 0, nullptr);
+		if (INVALID_HANDLE_VALUE == pipe) {
+			std::wcerr << L"cannot create " << name << L", error: " << ::GetLastError() << std::endl;
+			return 1;
+		}
+
+		// one sender after the other
+		size_t received = 0;
+		while (received < count) {
+			if (!::ConnectNamedPipe(pipe, nullptr) && ERROR_PIPE_CONNECTED != ::GetLastError()) {
+				std::wcerr << L"cannot accept on " << name << L", error: " << ::GetLastError() << std::endl;
+				::CloseHandle(pipe);
+				return 1;
+			}
+			received += serve(pipe, output.empty() ? std::cout : out, count - received);
+			::DisconnectNamedPipe(pipe);
+		}
+		::CloseHandle(pipe);
+		return 0;
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "event_frame.h"
+#include <string>
+#include <vector>
+
+namespace died
+{
+	// One UTF-8 line per event: time, source group, classification - paths, like the legacy messages
+	std::string to_line(received_event const& ev);
+
+	// Reference receiver of event_sender: serves the pipe, one sender at a time, and prints its events.
+	// receive [--pipe <name>] [--count <n>] [--out <file>]
+	int run_receive(std::vector<std::wstring> const& args);
+}
@@ -0,0 +1,296 @@
+#include "replay.h"
+#include "directory_watcher_mgr.h"
+#include "event_clock.h"
+#include "event_tracer.h"
+#include "raw_journal.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+
+namespace died
+{
+	namespace
+	{
+		// days since 1970-01-01 of a civil date
+		long long days_from_civil(int y, unsigned m, unsigned d)
+		{
+			y -= m <= 2;
+			const long long era = (y >= 0 ? y : y - 399) / 400;
+			const unsigned yoe = static_cast<unsigned>(y - era * 400);
+			const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+			const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+			return era * 146097 + static_cast<long long>(doe) - 719468;
+		}
+
+		// [2020-12-28_08:34:41 343] [info] [thread 9356] [died::file_name_watcher::do_notify:12] 1 - D:\test\1.txt
+		bool parse_event_line(std::string const& line, replay_event& ev)
+		{
+			int year{}, month{}, day{}, hour{}, minute{}, second{}, milli{};
+			if (7 != std::sscanf(line.c_str(), "[%d-%d-%d_%d:%d:%d %d]", &year, &month, &day, &hour, &minute, &second, &milli)) {
+				return false;
+			}
+
+			auto body = line.rfind("] ");
+			if (std::string::npos == body) {
+				return false;
+			}
+			auto sep = line.find(" - ", body);
+			if (std::string::npos == sep) {
+				return false;
+			}
+
+			ev.mAction = std::stoul(line.substr(body + 2, sep - body - 2));
+			ev.mPath = std::filesystem::u8path(line.substr(sep + 3)).wstring();
+			ev.mTime = ((days_from_civil(year, month, day) * 24 + hour) * 60 + minute) * 60000LL + second * 1000LL + milli;
+			return true;
+		}
+
+		std::vector<std::wstring> drives_of(std::vector<replay_event> const& events)
+		{
+			std::set<std::wstring> drives;
+			for (auto const& el : events) {
+				// D:\ as enumerate_drives() names it
+				if (el.mPath.size() > 2 && L':' == el.mPath[1]) {
+					drives.insert(el.mPath.substr(0, 3));
+				}
+			}
+			return { std::begin(drives), std::end(drives) };
+		}
+
+		std::string to_utf8(std::wstring const& s)
+		{
+			return std::filesystem::path(s).u8string();
+		}
+
+		std::vector<std::wstring> read_lines(std::wstring const& file)
+		{
+			std::vector<std::wstring> lines;
+			std::ifstream in{ std::filesystem::path(file) };
+			std::string line;
+			while (std::getline(in, line)) {
+				if (!line.empty() && '\r' == line.back()) {
+					line.pop_back();
+				}
+				lines.push_back(std::filesystem::u8path(line).wstring());
+			}
+			return lines;
+		}
+	}
+
+	std::vector<replay_event> parse_event_log(std::istream& in)
+	{
+		std::vector<replay_event> events;
+		std::wstring scenario;
+		std::string line;
+		while (std::getline(in, line)) {
+			if (!line.empty() && '\r' == line.back()) {
+				line.pop_back();
+			}
+			if (line.empty()) {
+				continue;
+			}
+
+			replay_event ev;
+			if (std::string::npos != line.find("] [died::")) {
+				// other sources of a decoded journal (attribute, send...) are not replayed
+				if (std::string::npos != line.find("[died::file_name_watcher::do_notify") && parse_event_line(line, ev)) {
+					ev.mScenario = scenario;
+					events.push_back(std::move(ev));
+				}
+				continue;
+			}
+
+			// title of the next scenario
+			auto first = line.find_first_not_of('*');
+			scenario = std::filesystem::u8path(std::string::npos == first ? line : line.substr(first)).wstring();
+		}
+		return events;
+	}
+
+	replay_result replay(std::vector<replay_event> const& events, replay_options const& options)
+	{
+		using std::chrono::milliseconds;
+
+		replay_result result;
+		result.mEvents = events.size();
+
+		// 1. virtual clock: recorded times are mapped on one increasing timeline
+		auto origin = std::chrono::steady_clock::time_point{} + std::chrono::hours(1);
+		event_clock::set_virtual(origin);
+
+		std::mutex sync;
+		std::vector<std::wstring> round;
+		directory_watcher_mgr mgr{ options.mInterval, L"", 0 != options.mShards ? options.mShards : state_shards::default_count() };
+		mgr.add_consumer(L"replay", false, [&sync, &round](notify_message const& msg) {
+			std::lock_guard<std::mutex> lk(sync);
+			round.push_back(std::wstring{ msg.mAction } + L" - " + msg.path() + (msg.mStillOpen ? L" (still open)" : L""));
+		});
+		mgr.start_manual(FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE, drives_of(events));
+
+		long long nextTick = options.mInterval;
+		long long lastEvent = 0;
+		long long offset = 0;
+		long long lastRecorded = 0;
+		bool first = true;
+		std::wstring scenario;
+
+		auto tick = [&]() {
+			event_clock::advance_to(origin + milliseconds(nextTick));
+			mgr.tick();
+			auto delay = L"  [+" + std::to_wstring(nextTick - lastEvent) + L" ms] ";
+			nextTick += options.mInterval;
+
+			// shards run in parallel => one order per round
+			std::lock_guard<std::mutex> lk(sync);
+			std::sort(std::begin(round), std::end(round));
+			for (auto& el : round) {
+				result.mLines.push_back((options.mTimed ? delay : L"  ") + std::move(el));
+			}
+			result.mClassifications += round.size();
+			round.clear();
+		};
+		auto drain = [&]() {
+			while (nextTick <= lastEvent + options.mDrain) {
+				tick();
+			}
+		};
+
+		auto wallStart = std::chrono::steady_clock::now();
+		for (auto const& ev : events) {
+			// 2. new scenario, clock going back or long pause => close every window first
+			bool restart = first || ev.mScenario != scenario || ev.mTime < lastRecorded || ev.mTime - lastRecorded > options.mDrain;
+			if (restart) {
+				if (!first) {
+					drain();
+				}
+				offset = nextTick - ev.mTime;
+				first = false;
+			}
+			if (ev.mScenario != scenario || result.mLines.empty()) {
+				scenario = ev.mScenario;
+				result.mLines.push_back(L"*** " + scenario);
+			}
+			lastRecorded = ev.mTime;
+
+			// 3. timer rounds due before the event, then the event itself
+			auto at = ev.mTime + offset;
+			while (nextTick <= at) {
+				tick();
+			}
+			event_clock::advance_to(origin + milliseconds(at));
+			mgr.feed(file_notify_info{ ev.mPath, ev.mAction });
+			lastEvent = at;
+		}
+		drain();
+		result.mSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+		mgr.stop();
+		event_clock::set_real();
+		return result;
+	}
+
+	int run_replay(std::vector<std::wstring> const& args)
+	{
+		std::wstring log;
+		std::wstring golden;
+		std::wstring trace;
+		bool update{};
+		replay_options options;
+		for (size_t i = 0; i < args.size(); ++i) {
+			if (L"--golden" == args[i] && i + 1 < args.size()) {
+				golden = args[++i];
+			}
+			else if (L"--update" == args[i]) {
+				update = true;
+			}
+			else if (L"--interval" == args[i] && i + 1 < args.size()) {
+				options.mInterval = std::stoul(args[++i]);
+			}
+			else if (L"--timed" == args[i]) {
+				options.mTimed = true;
+			}
+			else if (L"--shards" == args[i] && i + 1 < args.size()) {
+				options.mShards = std::stoul(args[++i]);
+			}
+			else if (L"--trace" == args[i] && i + 1 < args.size()) {
+				trace = args[++i];
+			}
+			else {
+				log = args[i];
+			}
+		}
+		if (log.empty()) {
+			std::wcerr << L"usage: replay <log | raw journal dir> [--golden <file>] [--update] [--interval <ms>] [--timed] [--shards <n>] [--trace <file>]" << std::endl;
+			return 2;
+		}
+
+		std::vector<replay_event> events;
+		if (std::filesystem::is_directory(std::filesystem::path(log))) {
+			// raw_journal segments: the file name events, nothing parsed from text
+			std::vector<raw_event> raw;
+			std::wstring error;
+			if (!read_raw_journal(log, raw, error)) {
+				std::wcerr << log << L": " << error << std::endl;
+				return 2;
+			}
+			for (auto& el : raw) {
+				if (watcher_kind::file_name == el.mKind) {
+					events.push_back(replay_event{ L"raw journal", el.mTime / 10000, el.mAction, std::move(el.mPath) });
+				}
+			}
+		}
+		else {
+			std::ifstream in{ std::filesystem::path(log) };
+			if (!in) {
+				std::wcerr << L"cannot open " << log << std::endl;
+				return 2;
+			}
+			events = parse_event_log(in);
+		}
+		event_tracer::enable(!trace.empty());
+		auto result = replay(events, options);
+		event_tracer::enable(false);
+		if (!trace.empty() && !event_tracer::write_chrome_json(trace)) {
+			std::wcerr << L"cannot write " << trace << std::endl;
+		}
+
+		std::wcout << L"events: " << result.mEvents
+			<< L", classifications: " << result.mClassifications
+			<< L", seconds: " << result.mSeconds
+			<< L", events/s: " << (result.mSeconds > 0 ? result.mEvents / result.mSeconds : 0)
+			<< L", classifications/s: " << (result.mSeconds > 0 ? result.mClassifications / result.mSeconds : 0)
+			<< std::endl;
+
+		if (golden.empty()) {
+			for (auto const& el : result.mLines) {
+				std::wcout << el << std::endl;
+			}
+			return 0;
+		}
+
+		if (update) {
+			std::ofstream out{ std::filesystem::path(golden), std::ios::binary };
+			for (auto const& el : result.mLines) {
+				out << to_utf8(el) << "\n";
+			}
+			return 0;
+		}
+
+		// first difference only, enough to locate the regression
+		auto expected = read_lines(golden);
+		auto count = std::max(expected.size(), result.mLines.size());
+		for (size_t i = 0; i < count; ++i) {
+			auto const& want = i < expected.size() ? expected[i] : std::wstring{ L"<end>" };
+			auto const& got = i < result.mLines.size() ? result.mLines[i] : std::wstring{ L"<end>" };
+			if (want != got) {
+				std::wcerr << L"line " << i + 1 << L"\n  expected: " << want << L"\n  actual:   " << got << std::endl;
+				return 1;
+			}
+		}
+		std::wcout << L"golden output matches" << std::endl;
+		return 0;
+	}
+}
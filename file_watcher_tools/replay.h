@@ -0,0 +1,42 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace died
+{
+	// One raw file name event of a recorded log (data_analyze.txt)
+	struct replay_event
+	{
+		std::wstring mScenario;		// last title line before the event
+		long long mTime{};			// milli-seconds, recorded clock
+		unsigned long mAction{};	// FILE_ACTION_*
+		std::wstring mPath;
+	};
+
+	struct replay_options
+	{
+		unsigned long mInterval{ 300 };		// timer round of directory_watcher_mgr, milli-seconds
+		long long mDrain{ 70000 };			// quiet time that closes every window, longest max wait included
+		bool mTimed{};						// prefix a classification with its delay after the last event
+		size_t mShards{};					// state and correlation shards, 0: default count. Same output for any count
+	};
+
+	struct replay_result
+	{
+		std::vector<std::wstring> mLines;	// scenario titles and classifications, the golden output
+		size_t mEvents{};
+		size_t mClassifications{};
+		double mSeconds{};					// wall time
+	};
+
+	// Parse the log lines of file_name_watcher::do_notify (spdlog or a decoded event journal), other lines are scenario titles
+	std::vector<replay_event> parse_event_log(std::istream& in);
+
+	// Feed the events through the rules and directory_watcher_mgr on a virtual clock
+	replay_result replay(std::vector<replay_event> const& events, replay_options const& options);
+
+	// replay <log> [--golden <file>] [--update] [--interval <ms>] [--timed] [--shards <n>]
+	int run_replay(std::vector<std::wstring> const& args);
+}
@@ -0,0 +1,94 @@
+#include "ring.h"
+#include "event_ring.h"
+#include "receive.h"
+#include "std_filesystem.h"
+#include <Windows.h>
+#include <fstream>
+#include <iostream>
+
+namespace died
+{
+	namespace
+	{
+		constexpr DWORD POLL_INTERVAL = 10;		// ms, nothing to read
+		constexpr DWORD ATTACH_INTERVAL = 1000;	// ms, no writer yet
+
+		received_event copy_of(ring_event const& ev)
+		{
+			received_event result;
+			result.mKind = ev.mKind;
+			result.mName = ev.mName;
+			result.mPath = ev.mPath;
+			result.mOldPath = ev.mOldPath;
+			result.mAuxPath = ev.mAuxPath;
+			result.mFirst = ev.mFirst;
+			result.mLast = ev.mLast;
+			result.mClassified = ev.mClassified;
+			result.mSource = ev.mSource;
+			result.mCount = ev.mCount;
+			result.mStillOpen = ev.mStillOpen;
+			return result;
+		}
+	}
+
+	int run_ring(std::vector<std::wstring> const& args)
+	{
+		std::wstring name = event_ring::DEFAULT_NAME;
+		size_t count = SIZE_MAX;
+		std::wstring output;
+		for (size_t i = 0; i < args.size(); ++i) {
+			bool hasValue = i + 1 < args.size();
+			if (L"--name" == args[i] && hasValue) {
+				name = args[++i];
+			}
+			else if (L"--count" == args[i] && hasValue) {
+				count = std::stoul(args[++i]);
+			}
+			else if (L"--out" == args[i] && hasValue) {
+				output = args[++i];
+			}
+			else {
+				std::wcerr << L"usage: ring [--name <name>] [--count <n>] [--out <file>]" << std::endl;
+				return 2;
+			}
+		}
+
+		std::ofstream file;
+		if (!output.empty()) {
+			file.open(std::filesystem::path(output), std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				std::wcerr << L"cannot write " << output << std::endl;
+				return 2;
+			}
+		}
+		std::ostream& out = output.empty() ? std::cout : file;
+
+		ring_reader reader{ name };
+		while (!reader.open()) {
+			::Sleep(ATTACH_INTERVAL);
+		}
+
+		// the views are copied to be printed, a record overwritten meanwhile is not printed
+		size_t received = 0;
+		uint64_t lost = 0;
+		while (received < count) {
+			auto visited = reader.poll([&](ring_event const& ev) {
+				auto line = to_line(copy_of(ev));
+				if (reader.valid(ev)) {
+					out << line << (ev.mTruncated ? " (truncated)" : "") << "\n";
+					++received;
+				}
+			}, count - received);
+			if (reader.overruns() != lost) {
+				std::wcerr << reader.overruns() - lost << L" events lost" << std::endl;
+				lost = reader.overruns();
+			}
+			if (!visited) {
+				out.flush();
+				::Sleep(POLL_INTERVAL);
+			}
+		}
+		out.flush();
+		return 0;
+	}
+}
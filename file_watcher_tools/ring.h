@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace died
+{
+	// Reference reader of event_ring: attaches to the shared memory ring and prints its events like receive.
+	// ring [--name <name>] [--count <n>] [--out <file>]
+	int run_ring(std::vector<std::wstring> const& args);
+}
@@ -0,0 +1,145 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <memory>
+#include <string>
+#include <Windows.h>
+#include "busy_probe.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace
+{
+	// Virtual event_clock for one test, real again after it
+	struct virtual_clock
+	{
+		died::event_clock::time_point mStart{ std::chrono::steady_clock::time_point{} + std::chrono::hours(1) };
+
+		virtual_clock()
+		{
+			died::event_clock::set_virtual(mStart);
+		}
+
+		~virtual_clock()
+		{
+			died::event_clock::set_real();
+		}
+
+		void at(int ms)
+		{
+			died::event_clock::advance_to(mStart + std::chrono::milliseconds(ms));
+		}
+	};
+
+	// Synchronous probe answering 'result', counting the probes
+	struct fake_probe
+	{
+		died::busy_probe mProbe;
+		std::shared_ptr<died::pipeline_metrics> mMetrics{ std::make_shared<died::pipeline_metrics>(std::vector<std::wstring>{}) };
+		died::busy_probe::result mResult{ died::busy_probe::result::idle };
+		int mProbes{};
+
+		explicit fake_probe(size_t maxInFlight = 64) :
+			mProbe{ 1, maxInFlight }
+		{
+			mProbe.set_synchronous(true);
+			mProbe.set_metrics(mMetrics);
+			mProbe.set_prober([this](std::wstring const&) {
+				++mProbes;
+				died::busy_probe::info probed;
+				probed.mResult = mResult;
+				probed.mTime = died::event_clock::now();
+				return probed;
+			});
+		}
+
+		unsigned long long outcome(std::string const& result) const
+		{
+			auto text = mMetrics->prometheus_text({});
+			auto line = "file_watcher_busy_probes_total{result=\"" + result + "\"} ";
+			auto pos = text.find(line);
+			return std::string::npos == pos ? 0 : std::stoull(text.substr(pos + line.size()));
+		}
+	};
+}
+
+namespace test_file_watcher
+{
+	TEST_CLASS(test_busy_probe)
+	{
+	public:
+
+		TEST_METHOD(synchronous_probe_answers_at_once)
+		{
+			virtual_clock clock;
+			fake_probe fake;
+			Assert::IsTrue(died::busy_probe::result::idle == fake.mProbe.query(L"D:\\test\\1.txt"));
+
+			fake.mResult = died::busy_probe::result::busy;
+			Assert::IsTrue(died::busy_probe::result::busy == fake.mProbe.query(L"D:\\test\\2.txt"));
+			Assert::AreEqual(fake.mProbes, 2);
+			Assert::AreEqual(fake.outcome("idle"), 1ull);
+			Assert::AreEqual(fake.outcome("busy"), 1ull);
+		}
+
+		TEST_METHOD(recent_result_is_cached)
+		{
+			virtual_clock clock;
+			fake_probe fake;
+			fake.mProbe.query(L"D:\\test\\1.txt");
+
+			// the checkers of all shards share one probe within the ttl
+			clock.at(999);
+			fake.mResult = died::busy_probe::result::busy;
+			Assert::IsTrue(died::busy_probe::result::idle == fake.mProbe.query(L"D:\\test\\1.txt"));
+			Assert::AreEqual(fake.mProbes, 1);
+			Assert::AreEqual(fake.outcome("cached"), 1ull);
+
+			clock.at(1000);
+			Assert::IsTrue(died::busy_probe::result::busy == fake.mProbe.query(L"D:\\test\\1.txt"));
+			Assert::AreEqual(fake.mProbes, 2);
+		}
+
+		TEST_METHOD(max_age_shortens_the_cache)
+		{
+			virtual_clock clock;
+			fake_probe fake;
+			fake.mProbe.query_info(L"D:\\test\\1.txt", std::chrono::milliseconds(250));
+
+			clock.at(200);
+			fake.mProbe.query_info(L"D:\\test\\1.txt", std::chrono::milliseconds(250));
+			Assert::AreEqual(fake.mProbes, 1);
+
+			clock.at(250);
+			auto probed = fake.mProbe.query_info(L"D:\\test\\1.txt", std::chrono::milliseconds(250));
+			Assert::AreEqual(fake.mProbes, 2);
+			Assert::IsTrue(died::event_clock::now() == probed.mTime);
+		}
+
+		TEST_METHOD(deferred_when_too_many_in_flight)
+		{
+			virtual_clock clock;
+			fake_probe fake{ 1 };
+
+			// a probe still on the way => the next path waits for a later tick
+			died::busy_probe::info nested;
+			fake.mProbe.set_prober([&fake, &nested](std::wstring const& path) {
+				++fake.mProbes;
+				if (L"D:\\test\\1.txt" == path) {
+					nested = fake.mProbe.query_info(L"D:\\test\\2.txt", std::chrono::milliseconds(1000));
+				}
+				died::busy_probe::info probed;
+				probed.mResult = died::busy_probe::result::idle;
+				probed.mTime = died::event_clock::now();
+				return probed;
+			});
+			fake.mProbe.query(L"D:\\test\\1.txt");
+			Assert::IsTrue(died::busy_probe::result::pending == nested.mResult);
+			Assert::AreEqual(fake.outcome("deferred"), 1ull);
+			Assert::AreEqual(fake.mProbes, 1);
+
+			// nothing kept for the deferred path
+			Assert::IsTrue(died::busy_probe::result::idle == fake.mProbe.query(L"D:\\test\\2.txt"));
+			Assert::AreEqual(fake.mProbes, 2);
+		}
+	};
+}
@@ -0,0 +1,220 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <algorithm>
+#include <string>
+#include <Windows.h>
+#include "correlation_engine.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace
+{
+	using time_point = died::correlation_event::time_point;
+
+	struct collected
+	{
+		std::wstring mName;
+		std::vector<std::wstring> mPaths;
+		bool mEarly{};
+	};
+
+	// 'early': accept the results settled before their quiet time, the watcher declines them when a rename can follow
+	std::vector<collected> process(died::correlation_engine& engine, time_point now, bool early = true)
+	{
+		std::vector<collected> results;
+		engine.process(now, [&results, early](died::correlation_result const& res) {
+			if (res.mEarly && !early) {
+				return false;
+			}
+			results.push_back({ *res.mName, res.mPaths, res.mEarly });
+			return true;
+		});
+		return results;
+	}
+
+	time_point at(time_point t0, int ms)
+	{
+		return t0 + std::chrono::milliseconds(ms);
+	}
+}
+
+namespace test_file_watcher
+{
+	TEST_CLASS(test_correlation_engine)
+	{
+	public:
+
+		TEST_METHOD(word_save)
+		{
+			died::correlation_engine engine;
+			auto t0 = std::chrono::steady_clock::now();
+			engine.post(FILE_ACTION_RENAMED_OLD_NAME, L"D:\\test\\8.docx", at(t0, 0), 0);
+			engine.post(FILE_ACTION_RENAMED_NEW_NAME, L"D:\\test\\8.docx~RF1994986.TMP", at(t0, 0), 0);
+			engine.post(FILE_ACTION_RENAMED_OLD_NAME, L"D:\\test\\~.tmp", at(t0, 10), 0);
+			engine.post(FILE_ACTION_RENAMED_NEW_NAME, L"D:\\test\\8.docx", at(t0, 10), 0);
+			engine.post(FILE_ACTION_REMOVED, L"D:\\test\\8.docx~RF1994986.TMP", at(t0, 20), 0);
+
+			// not settled yet
+			Assert::IsTrue(process(engine, at(t0, 100)).empty());
+
+			auto res = process(engine, at(t0, 5000));
+			Assert::AreEqual(res.size(), size_t(1));
+			Assert::AreEqual(res[0].mName, std::wstring(L"Modify Word save"));
+			Assert::AreEqual(res[0].mPaths[0], std::wstring(L"D:\\test\\8.docx"));
+			Assert::AreEqual(res[0].mPaths[1], std::wstring(L"D:\\test\\~.tmp"));
+			Assert::AreEqual(res[0].mPaths[2], std::wstring(L"D:\\test\\8.docx~RF1994986.TMP"));
+			Assert::AreEqual(engine.active(), size_t(0));
+		}
+
+		TEST_METHOD(download_auto_save)
+		{
+			died::correlation_engine engine;
+			auto t0 = std::chrono::steady_clock::now();
+			engine.post(FILE_ACTION_ADDED, L"D:\\test\\9be830ee.tmp", at(t0, 0), 0);
+			engine.post(FILE_ACTION_RENAMED_OLD_NAME, L"D:\\test\\9be830ee.tmp", at(t0, 5), 0);
+			engine.post(FILE_ACTION_RENAMED_NEW_NAME, L"D:\\test\\1.jpg.crdownload", at(t0, 5), 0);
+			engine.post(FILE_ACTION_MODIFIED, L"D:\\test\\1.jpg.crdownload", at(t0, 10), 0);
+			engine.post(FILE_ACTION_RENAMED_OLD_NAME, L"D:\\test\\1.jpg.crdownload", at(t0, 60000), 0);
+			engine.post(FILE_ACTION_RENAMED_NEW_NAME, L"D:\\test\\1.jpg", at(t0, 60000), 0);
+			engine.post(FILE_ACTION_MODIFIED, L"D:\\test\\1.jpg", at(t0, 60010), 0);
+
+			auto res = process(engine, at(t0, 64000));
+			Assert::AreEqual(res.size(), size_t(1));
+			Assert::AreEqual(res[0].mName, std::wstring(L"Create download auto-save"));
+			Assert::AreEqual(res[0].mPaths[0], std::wstring(L"D:\\test\\1.jpg"));
+		}
+
+		TEST_METHOD(notepad_save_as_wins_over_copy_and_paint)
+		{
+			died::correlation_engine engine;
+			auto t0 = std::chrono::steady_clock::now();
+			engine.post(FILE_ACTION_ADDED, L"D:\\test\\1.txt", at(t0, 0), 0);
+			engine.post(FILE_ACTION_REMOVED, L"D:\\test\\1.txt", at(t0, 1), 0);
+			engine.post(FILE_ACTION_ADDED, L"D:\\test\\1.txt", at(t0, 90), 0);
+			engine.post(FILE_ACTION_MODIFIED, L"D:\\test\\1.txt", at(t0, 92), 0);
+
+			auto res = process(engine, at(t0, 4000));
+			Assert::AreEqual(res.size(), size_t(1));
+			Assert::AreEqual(res[0].mName, std::wstring(L"Create by save-as"));
+		}
+
+		TEST_METHOD(paint_edit)
+		{
+			died::correlation_engine engine;
+			auto t0 = std::chrono::steady_clock::now();
+			engine.post(FILE_ACTION_REMOVED, L"C:\\tmp\\1.png", at(t0, 0), 0);
+			engine.post(FILE_ACTION_ADDED, L"C:\\tmp\\1.png", at(t0, 2), 0);
+
+			auto res = process(engine, at(t0, 4000));
+			Assert::AreEqual(res.size(), size_t(1));
+			Assert::AreEqual(res[0].mName, std::wstring(L"Modify without modify event"));
+		}
+
+		TEST_METHOD(copy_cancelled_by_rename)
+		{
+			died::correlation_engine engine;
+			auto t0 = std::chrono::steady_clock::now();
+			engine.post(FILE_ACTION_ADDED, L"D:\\test\\New Rich Text Document.rtf", at(t0, 0), 0);
+			engine.post(FILE_ACTION_MODIFIED, L"D:\\test\\New Rich Text Document.rtf", at(t0, 1), 0);
+			Assert::AreEqual(process(engine, at(t0, 4000))[0].mName, std::wstring(L"Copy"));
+
+			engine.post(FILE_ACTION_ADDED, L"D:\\test\\New Rich Text Document (3).rtf", at(t0, 5000), 0);
+			engine.post(FILE_ACTION_MODIFIED, L"D:\\test\\New Rich Text Document (3).rtf", at(t0, 5001), 0);
+			engine.post(FILE_ACTION_RENAMED_OLD_NAME, L"D:\\test\\New Rich Text Document (3).rtf", at(t0, 7500), 0);
+			engine.post(FILE_ACTION_RENAMED_NEW_NAME, L"D:\\test\\1.rtf", at(t0, 7501), 0);
+			Assert::IsTrue(process(engine, at(t0, 12000)).empty());
+		}
+
+		TEST_METHOD(copy_settles_before_its_quiet_time)
+		{
+			died::correlation_engine engine;
+			auto t0 = std::chrono::steady_clock::now();
+			engine.post(FILE_ACTION_ADDED, L"D:\\test\\photo.jpg", at(t0, 0), 0);
+			engine.post(FILE_ACTION_MODIFIED, L"D:\\test\\photo.jpg", at(t0, 36), 0);
+			Assert::IsTrue(process(engine, at(t0, 500)).empty());
+
+			auto res = process(engine, at(t0, 1500));
+			Assert::AreEqual(res.size(), size_t(1));
+			Assert::AreEqual(res[0].mName, std::wstring(L"Copy"));
+			Assert::IsTrue(res[0].mEarly);
+		}
+
+		TEST_METHOD(declined_copy_waits_for_a_late_rename)
+		{
+			// download auto-save: the temporary file is renamed 2.3 s after it is written
+			died::correlation_engine engine;
+			auto t0 = std::chrono::steady_clock::now();
+			engine.post(FILE_ACTION_ADDED, L"D:\\test\\3e610cb3.tmp", at(t0, 0), 0);
+			engine.post(FILE_ACTION_MODIFIED, L"D:\\test\\3e610cb3.tmp", at(t0, 36), 0);
+			Assert::IsTrue(process(engine, at(t0, 1500), false).empty());
+
+			engine.post(FILE_ACTION_RENAMED_OLD_NAME, L"D:\\test\\3e610cb3.tmp", at(t0, 2313), 0);
+			engine.post(FILE_ACTION_RENAMED_NEW_NAME, L"D:\\test\\1.jpg", at(t0, 2314), 0);
+			auto res = process(engine, at(t0, 8000), false);
+			Assert::IsTrue(std::none_of(std::begin(res), std::end(res), [](collected const& el) { return L"Copy" == el.mName; }));
+		}
+
+		TEST_METHOD(move_between_groups)
+		{
+			died::correlation_engine engine;
+			auto t0 = std::chrono::steady_clock::now();
+			engine.post(FILE_ACTION_REMOVED, L"C:\\tmp\\1.zip", at(t0, 0), 0);
+			engine.post(FILE_ACTION_ADDED, L"D:\\test\\1.zip", at(t0, 3), 1);
+			engine.post(FILE_ACTION_MODIFIED, L"D:\\test\\1.zip", at(t0, 5), 1);
+
+			auto res = process(engine, at(t0, 4000));
+			Assert::AreEqual(res.size(), size_t(1));
+			Assert::AreEqual(res[0].mName, std::wstring(L"Move"));
+			Assert::AreEqual(res[0].mPaths[0], std::wstring(L"C:\\tmp\\1.zip"));
+			Assert::AreEqual(res[0].mPaths[1], std::wstring(L"D:\\test\\1.zip"));
+		}
+
+		TEST_METHOD(unambiguous_match_settles_early)
+		{
+			died::correlation_engine engine;
+			auto t0 = std::chrono::steady_clock::now();
+			engine.post(FILE_ACTION_REMOVED, L"C:\\tmp\\1.png", at(t0, 0), 0);
+			engine.post(FILE_ACTION_ADDED, L"C:\\tmp\\1.png", at(t0, 2), 0);
+			Assert::IsTrue(process(engine, at(t0, 100)).empty());
+			Assert::IsTrue(engine.involves(L"C:\\tmp\\1.png"));
+
+			// nothing else on these events => no full quiet time
+			auto res = process(engine, at(t0, 500));
+			Assert::AreEqual(res.size(), size_t(1));
+			Assert::AreEqual(res[0].mName, std::wstring(L"Modify without modify event"));
+		}
+
+		TEST_METHOD(ambiguous_match_waits)
+		{
+			died::correlation_engine engine;
+			auto t0 = std::chrono::steady_clock::now();
+			engine.post(FILE_ACTION_ADDED, L"D:\\test\\1.txt", at(t0, 0), 0);
+			engine.post(FILE_ACTION_REMOVED, L"D:\\test\\1.txt", at(t0, 1), 0);
+			engine.post(FILE_ACTION_ADDED, L"D:\\test\\1.txt", at(t0, 90), 0);
+
+			// remove -> add is complete, but the save-as is still in progress on the same events
+			Assert::IsTrue(process(engine, at(t0, 500)).empty());
+
+			engine.post(FILE_ACTION_MODIFIED, L"D:\\test\\1.txt", at(t0, 600), 0);
+			auto res = process(engine, at(t0, 1000));
+			Assert::AreEqual(res.size(), size_t(1));
+			Assert::AreEqual(res[0].mName, std::wstring(L"Create by save-as"));
+		}
+
+		TEST_METHOD(rejected_result_is_kept)
+		{
+			died::correlation_engine engine;
+			auto t0 = std::chrono::steady_clock::now();
+			engine.post(FILE_ACTION_REMOVED, L"C:\\tmp\\1.png", at(t0, 0), 0);
+			engine.post(FILE_ACTION_ADDED, L"C:\\tmp\\1.png", at(t0, 2), 0);
+
+			int calls = 0;
+			engine.process(at(t0, 4000), [&calls](died::correlation_result const&) {
+				++calls;
+				return false;
+			});
+			Assert::AreEqual(process(engine, at(t0, 5000)).size(), size_t(1));
+			Assert::AreEqual(calls, 1);
+		}
+	};
+}
@@ -0,0 +1,159 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <algorithm>
+#include <string>
+#include <Windows.h>
+#include "correlation_shards.h"
+#include "state_shards.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace
+{
+	using time_point = died::correlation_event::time_point;
+
+	struct collected
+	{
+		std::wstring mName;
+		std::vector<std::wstring> mPaths;
+	};
+
+	// One timer round of directory_watcher_mgr, the workers one after the other
+	std::vector<collected> process(died::correlation_shards& shards, time_point now)
+	{
+		std::vector<collected> results;
+		auto sink = [&results](died::correlation_result const& res) {
+			results.push_back({ *res.mName, res.mPaths });
+			return true;
+		};
+		for (size_t i = 0; i < shards.size(); ++i) {
+			shards.consume(i);
+		}
+		shards.process_moves(now, sink);
+		for (size_t i = 0; i < shards.size(); ++i) {
+			shards.process(i, now, sink);
+		}
+		shards.settle();
+		return results;
+	}
+
+	time_point at(time_point t0, int ms)
+	{
+		return t0 + std::chrono::milliseconds(ms);
+	}
+
+	// A folder of another shard than 'folder'
+	std::wstring other_shard(std::wstring const& folder, size_t count)
+	{
+		auto own = died::state_shards::shard_index(folder + L"\\1.txt", count);
+		for (int i = 0; ; ++i) {
+			auto other = L"D:\\test\\" + std::to_wstring(i);
+			if (own != died::state_shards::shard_index(other + L"\\1.txt", count)) {
+				return other;
+			}
+		}
+	}
+}
+
+namespace test_file_watcher
+{
+	TEST_CLASS(test_correlation_shards)
+	{
+	public:
+
+		TEST_METHOD(move_across_shards)
+		{
+			died::correlation_shards shards{ 8 };
+			auto target = other_shard(L"C:\\tmp", shards.size());
+			auto t0 = std::chrono::steady_clock::now();
+			shards.post(FILE_ACTION_REMOVED, L"C:\\tmp\\1.zip", at(t0, 0), 0);
+			shards.post(FILE_ACTION_ADDED, target + L"\\1.zip", at(t0, 3), 1);
+			shards.post(FILE_ACTION_MODIFIED, target + L"\\1.zip", at(t0, 5), 1);
+			Assert::IsTrue(process(shards, at(t0, 100)).empty());
+			Assert::IsTrue(shards.involves(L"C:\\tmp\\1.zip"));
+
+			auto res = process(shards, at(t0, 4000));
+			Assert::AreEqual(res.size(), size_t(1));
+			Assert::AreEqual(res[0].mName, std::wstring(L"Move"));
+			Assert::AreEqual(res[0].mPaths[0], std::wstring(L"C:\\tmp\\1.zip"));
+			Assert::AreEqual(res[0].mPaths[1], target + L"\\1.zip");
+			Assert::AreEqual(shards.active(), size_t(0));
+		}
+
+		TEST_METHOD(pattern_inside_a_folder)
+		{
+			died::correlation_shards shards{ 8 };
+			auto t0 = std::chrono::steady_clock::now();
+			shards.post(FILE_ACTION_REMOVED, L"C:\\tmp\\1.png", at(t0, 0), 0);
+			shards.post(FILE_ACTION_ADDED, L"C:\\tmp\\1.png", at(t0, 2), 0);
+
+			auto res = process(shards, at(t0, 4000));
+			Assert::AreEqual(res.size(), size_t(1));
+			Assert::AreEqual(res[0].mName, std::wstring(L"Modify without modify event"));
+			Assert::IsFalse(shards.involves(L"C:\\tmp\\1.png"));
+		}
+
+		TEST_METHOD(rename_in_the_target_folder_drops_the_move)
+		{
+			died::correlation_shards shards{ 8 };
+			auto target = other_shard(L"D:\\moves", shards.size());
+			auto t0 = std::chrono::steady_clock::now();
+			shards.post(FILE_ACTION_REMOVED, L"D:\\moves\\draft.docx", at(t0, 0), 0);
+			shards.post(FILE_ACTION_ADDED, target + L"\\draft.docx", at(t0, 10), 0);
+			Assert::IsTrue(process(shards, at(t0, 100)).empty());
+
+			// the rename reaches the cross-folder engine: the added file is not moved any more,
+			// the watcher reports the create, the rename and the remove
+			shards.post(FILE_ACTION_RENAMED_OLD_NAME, target + L"\\draft.docx", at(t0, 500), 0);
+			shards.post(FILE_ACTION_RENAMED_NEW_NAME, target + L"\\final.docx", at(t0, 501), 0);
+			Assert::IsTrue(process(shards, at(t0, 5000)).empty());
+			Assert::IsFalse(shards.involves(target + L"\\draft.docx"));
+		}
+
+		TEST_METHOD(move_wins_over_an_edit_on_the_same_remove)
+		{
+			died::correlation_shards shards{ 8 };
+			auto target = other_shard(L"D:\\moves", shards.size());
+			auto t0 = std::chrono::steady_clock::now();
+			shards.post(FILE_ACTION_REMOVED, L"D:\\moves\\photo.jpg", at(t0, 0), 0);
+			shards.post(FILE_ACTION_ADDED, L"D:\\moves\\photo.jpg", at(t0, 20), 0);
+			shards.post(FILE_ACTION_ADDED, target + L"\\photo.jpg", at(t0, 30), 0);
+
+			auto res = process(shards, at(t0, 5000));
+			Assert::AreEqual(res.size(), size_t(1));
+			Assert::AreEqual(res[0].mName, std::wstring(L"Move"));
+			Assert::AreEqual(res[0].mPaths[1], target + L"\\photo.jpg");
+		}
+
+		TEST_METHOD(same_results_for_any_count)
+		{
+			auto t0 = std::chrono::steady_clock::now();
+			auto run = [t0](size_t count) {
+				died::correlation_shards shards{ count };
+				shards.post(FILE_ACTION_ADDED, L"D:\\test\\1.txt", at(t0, 0), 0);
+				shards.post(FILE_ACTION_REMOVED, L"D:\\test\\1.txt", at(t0, 1), 0);
+				shards.post(FILE_ACTION_ADDED, L"D:\\test\\1.txt", at(t0, 90), 0);
+				shards.post(FILE_ACTION_MODIFIED, L"D:\\test\\1.txt", at(t0, 92), 0);
+				shards.post(FILE_ACTION_REMOVED, L"C:\\tmp\\1.zip", at(t0, 100), 0);
+				shards.post(FILE_ACTION_ADDED, L"D:\\test\\0\\1.zip", at(t0, 103), 1);
+				shards.post(FILE_ACTION_RENAMED_OLD_NAME, L"D:\\test\\8.docx", at(t0, 200), 0);
+				shards.post(FILE_ACTION_RENAMED_NEW_NAME, L"D:\\test\\8.docx~RF1994986.TMP", at(t0, 200), 0);
+				shards.post(FILE_ACTION_RENAMED_OLD_NAME, L"D:\\test\\~.tmp", at(t0, 210), 0);
+				shards.post(FILE_ACTION_RENAMED_NEW_NAME, L"D:\\test\\8.docx", at(t0, 210), 0);
+				shards.post(FILE_ACTION_REMOVED, L"D:\\test\\8.docx~RF1994986.TMP", at(t0, 220), 0);
+
+				std::vector<std::wstring> names;
+				for (auto const& el : process(shards, at(t0, 6000))) {
+					names.push_back(el.mName + L" - " + el.mPaths[0]);
+				}
+				std::sort(std::begin(names), std::end(names));
+				return names;
+			};
+
+			auto one = run(1);
+			Assert::AreEqual(one.size(), size_t(3));
+			Assert::IsTrue(one == run(2));
+			Assert::IsTrue(one == run(8));
+		}
+	};
+}
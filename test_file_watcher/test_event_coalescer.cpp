@@ -0,0 +1,101 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <string>
+#include <vector>
+#include "event_coalescer.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	TEST_CLASS(test_event_coalescer)
+	{
+	public:
+
+		struct forwarded
+		{
+			std::wstring mName;
+			std::wstring mPath;
+			unsigned int mCount;
+		};
+
+		TEST_METHOD(repeats_in_window_are_merged)
+		{
+			std::vector<forwarded> out;
+			died::event_coalescer coalescer([&out](std::vector<died::classified_event> const& events) {
+				for (auto const& el : events) {
+					out.push_back({ *el.mName, std::wstring(el.mPath), el.mCount });
+				}
+			}, std::chrono::milliseconds(1000));
+
+			// autosave: the same file modified again and again
+			for (int i = 0; i < 5; ++i) {
+				died::event_batch batch;
+				batch.add(died::event_kind::modify, L"D:\\test\\1.docx");
+				coalescer.deliver(batch.events());
+			}
+			Assert::IsTrue(out.empty());
+			Assert::AreEqual(coalescer.held(), size_t(1));
+			Assert::AreEqual(coalescer.merged(), 4ull);
+
+			coalescer.flush(died::event_clock::now() + std::chrono::milliseconds(1000));
+			Assert::AreEqual(out.size(), size_t(1));
+			Assert::AreEqual(out[0].mPath, std::wstring(L"D:\\test\\1.docx"));
+			Assert::AreEqual(out[0].mCount, 5u);
+			Assert::AreEqual(coalescer.held(), size_t(0));
+		}
+
+		TEST_METHOD(other_event_of_path_keeps_order)
+		{
+			std::vector<forwarded> out;
+			died::event_coalescer coalescer([&out](std::vector<died::classified_event> const& events) {
+				for (auto const& el : events) {
+					out.push_back({ *el.mName, std::wstring(el.mPath), el.mCount });
+				}
+			}, std::chrono::milliseconds(1000), 2);
+
+			died::event_batch batch;
+			batch.add(died::event_kind::modify, L"D:\\test\\1.txt");
+			batch.add(died::event_kind::attribute, L"D:\\test\\2.txt");
+			batch.add(died::event_kind::modify, L"D:\\test\\1.txt");
+			batch.add(died::event_kind::rename_only, L"D:\\test\\3.txt", L"D:\\test\\1.txt");
+			batch.add(died::event_kind::security, L"D:\\test\\4.txt");
+			batch.add(died::event_kind::security, L"D:\\test\\5.txt");
+			coalescer.deliver(batch.events());
+
+			// held modify of the renamed file first, then the oldest one out of a full table
+			Assert::AreEqual(out.size(), size_t(3));
+			Assert::AreEqual(out[0].mName, std::wstring(L"Modify"));
+			Assert::AreEqual(out[0].mCount, 2u);
+			Assert::AreEqual(out[1].mName, std::wstring(L"Rename only"));
+			Assert::AreEqual(out[2].mPath, std::wstring(L"D:\\test\\2.txt"));
+
+			coalescer.flush(died::event_clock::time_point::max());
+			Assert::AreEqual(out.size(), size_t(5));
+			Assert::AreEqual(out[3].mPath, std::wstring(L"D:\\test\\4.txt"));
+			Assert::AreEqual(out[4].mPath, std::wstring(L"D:\\test\\5.txt"));
+		}
+
+		TEST_METHOD(case_of_path_is_ignored)
+		{
+			std::vector<forwarded> out;
+			died::event_coalescer coalescer([&out](std::vector<died::classified_event> const& events) {
+				for (auto const& el : events) {
+					out.push_back({ *el.mName, std::wstring(el.mPath), el.mCount });
+				}
+			}, std::chrono::milliseconds(1000));
+
+			died::event_batch batch;
+			batch.add(died::event_kind::modify, L"D:\\Test\\Report.docx");
+			batch.add(died::event_kind::modify, L"d:\\test\\report.DOCX");
+			coalescer.deliver(batch.events());
+			Assert::AreEqual(coalescer.held(), size_t(1));
+
+			// released before its path is settled, with the case of its first event
+			coalescer.release_paths({ L"D:\\TEST\\REPORT.DOCX" });
+			Assert::AreEqual(out.size(), size_t(1));
+			Assert::AreEqual(out[0].mPath, std::wstring(L"D:\\Test\\Report.docx"));
+			Assert::AreEqual(out[0].mCount, 2u);
+		}
+	};
+}
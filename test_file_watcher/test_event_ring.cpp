@@ -0,0 +1,103 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <string>
+#include <Windows.h>
+#include "event_frame.h"
+#include "event_ring.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	TEST_CLASS(test_event_ring)
+	{
+	public:
+
+		TEST_METHOD(reader_sees_events_in_place)
+		{
+			static const std::wstring NAME{ L"Save as" };
+			static const std::wstring RING{ L"Local\\test_event_ring_read" };
+			died::event_ring ring{ RING, 64 };
+			Assert::IsTrue(ring.open());
+			died::ring_reader reader{ RING };
+			Assert::IsTrue(reader.open());
+
+			died::event_batch batch;
+			batch.add(died::event_kind::modify, L"D:\\test\\1.txt").mCount = 3;
+			auto& pattern = batch.add(died::event_kind::pattern, L"D:\\test\\1.docx", L"D:\\test\\~WRL0001.tmp", L"D:\\test\\~$1.docx");
+			pattern.mName = &NAME;
+			batch.add(died::event_kind::modify, L"D:\\" + std::wstring(2000, L'a') + L"\\tail.txt");
+			ring.deliver(batch.events());
+			Assert::AreEqual(reader.lag(), 3ull);
+
+			std::vector<died::received_event> events;
+			std::vector<bool> truncated;
+			auto visited = reader.poll([&](died::ring_event const& ev) {
+				died::received_event copy;
+				copy.mName = ev.mName;
+				copy.mPath = ev.mPath;
+				copy.mAuxPath = ev.mAuxPath;
+				copy.mCount = ev.mCount;
+				events.push_back(copy);
+				truncated.push_back(ev.mTruncated);
+			});
+			Assert::AreEqual(visited, size_t(3));
+			Assert::AreEqual(events[0].mName, std::wstring(L"Modify"));
+			Assert::AreEqual(events[0].mCount, 3u);
+			Assert::AreEqual(events[1].mName, NAME);
+			Assert::AreEqual(events[1].mAuxPath, std::wstring(L"D:\\test\\~$1.docx"));
+			Assert::IsTrue(truncated[2]);
+			Assert::IsTrue(events[2].mPath.size() < 2000 && L"\\tail.txt" == events[2].mPath.substr(events[2].mPath.size() - 9));
+			Assert::AreEqual(reader.lag(), 0ull);
+			Assert::AreEqual(ring.stats().mConsumers, 1ull);
+		}
+
+		TEST_METHOD(slow_reader_counts_overruns)
+		{
+			static const std::wstring RING{ L"Local\\test_event_ring_overrun" };
+			died::event_ring ring{ RING, 64 };
+			Assert::IsTrue(ring.open());
+			died::ring_reader reader{ RING };
+			Assert::IsTrue(reader.open());
+
+			for (int i = 0; i < 100; ++i) {
+				died::event_batch batch;
+				batch.add(died::event_kind::modify, L"D:\\test\\" + std::to_wstring(i) + L".txt");
+				ring.deliver(batch.events());
+			}
+			Assert::AreEqual(ring.stats().mMaxLag, 100ull);
+
+			// the oldest 36 were overwritten, the reader goes on with the 64 left
+			std::wstring first;
+			auto visited = reader.poll([&first](died::ring_event const& ev) {
+				if (first.empty()) {
+					first = ev.mPath;
+				}
+			});
+			Assert::AreEqual(visited, size_t(64));
+			Assert::AreEqual(reader.overruns(), 36ull);
+			Assert::AreEqual(first, std::wstring(L"D:\\test\\36.txt"));
+			Assert::AreEqual(ring.stats().mOverruns, 36ull);
+		}
+
+		TEST_METHOD(slot_of_a_dead_reader_is_freed)
+		{
+			static const std::wstring RING{ L"Local\\test_event_ring_dead" };
+			died::event_ring ring{ RING, 64 };
+			Assert::IsTrue(ring.open());
+			died::ring_reader reader{ RING };
+			Assert::IsTrue(reader.open());
+
+			// a reader of a process gone without close(): no process has this id
+			auto mapping = ::OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, RING.c_str());
+			auto header = static_cast<died::ring_header*>(::MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+			Assert::IsNotNull(header);
+			header->mConsumers[1].mProcess.store(0xfffffffc);
+
+			Assert::AreEqual(ring.stats().mConsumers, 1ull);
+			Assert::AreEqual(header->mConsumers[1].mProcess.load(), 0u);
+			::UnmapViewOfFile(header);
+			::CloseHandle(mapping);
+		}
+	};
+}
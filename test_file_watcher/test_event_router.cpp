@@ -0,0 +1,103 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include "event_router.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	class recording_sink : public died::event_sink
+	{
+	public:
+		void deliver(std::vector<died::classified_event> const& events) override
+		{
+			for (auto const& el : events) {
+				mPaths.emplace_back(el.mPath);
+			}
+		}
+
+		std::vector<std::wstring> mPaths;
+	};
+
+	TEST_CLASS(test_event_router)
+	{
+	public:
+
+		TEST_METHOD(routes_by_prefix_and_kind)
+		{
+			died::event_router router;
+			auto src = std::make_shared<recording_sink>();
+			auto removes = std::make_shared<recording_sink>();
+			auto all = std::make_shared<recording_sink>();
+			router.subscribe({ L"indexer", { L"D:\\Work\\src" }, died::ALL_KINDS, src });
+			router.subscribe({ L"backup", { L"D:\\" }, died::kind_bit(died::event_kind::remove), removes });
+			router.subscribe({ L"audit", {}, died::ALL_KINDS, all });
+
+			died::event_batch batch;
+			batch.add(died::event_kind::modify, L"d:\\work\\SRC\\main.cpp");
+			batch.add(died::event_kind::modify, L"D:\\work\\srcold\\main.cpp");
+			batch.add(died::event_kind::remove, L"D:\\work\\src\\old.cpp");
+			batch.add(died::event_kind::rename_only, L"E:\\moved.cpp", L"D:\\work\\src\\moved.cpp");
+			router.deliver(batch.events());
+
+			// a folder is matched by whole names, a rename by its old path too
+			Assert::AreEqual(src->mPaths.size(), size_t(3));
+			Assert::AreEqual(src->mPaths[0], std::wstring(L"d:\\work\\SRC\\main.cpp"));
+			Assert::AreEqual(src->mPaths[2], std::wstring(L"E:\\moved.cpp"));
+			Assert::AreEqual(removes->mPaths.size(), size_t(1));
+			Assert::AreEqual(all->mPaths.size(), size_t(4));
+
+			auto stats = router.stats();
+			Assert::AreEqual(stats.size(), size_t(3));
+			Assert::AreEqual(stats[0].mDelivered, 3ull);
+		}
+
+		TEST_METHOD(globs_and_unsubscribe)
+		{
+			died::event_router router;
+			auto docs = std::make_shared<recording_sink>();
+			auto temp = std::make_shared<recording_sink>();
+			auto id = router.subscribe({ L"docs", { L"D:\\Users\\*\\Documents\\**\\*.docx" }, died::ALL_KINDS, docs });
+			router.subscribe({ L"temp", { L"**\\~$*" }, died::ALL_KINDS, temp });
+
+			died::event_batch batch;
+			batch.add(died::event_kind::modify, L"D:\\Users\\kim\\Documents\\1.docx");
+			batch.add(died::event_kind::modify, L"D:\\Users\\kim\\Documents\\a\\b\\2.DOCX");
+			batch.add(died::event_kind::modify, L"D:\\Users\\kim\\Desktop\\3.docx");
+			batch.add(died::event_kind::create_only, L"C:\\tmp\\~$1.docx");
+			router.deliver(batch.events());
+			Assert::AreEqual(docs->mPaths.size(), size_t(2));
+			Assert::AreEqual(temp->mPaths.size(), size_t(1));
+
+			Assert::IsTrue(router.unsubscribe(id));
+			Assert::IsFalse(router.unsubscribe(id));
+			router.deliver(batch.events());
+			Assert::AreEqual(docs->mPaths.size(), size_t(2));
+			Assert::AreEqual(temp->mPaths.size(), size_t(2));
+		}
+
+		TEST_METHOD(batches_reach_only_their_targets)
+		{
+			died::event_router router;
+			std::vector<std::shared_ptr<recording_sink>> sinks;
+			for (int i = 0; i < 100; ++i) {
+				sinks.push_back(std::make_shared<recording_sink>());
+				router.subscribe({ L"folder", { L"D:\\f" + std::to_wstring(i) }, died::ALL_KINDS, sinks.back() });
+			}
+
+			// the same event index in consecutive batches is routed again
+			for (int round = 0; round < 3; ++round) {
+				died::event_batch batch;
+				batch.add(died::event_kind::modify, L"D:\\f7\\1.txt");
+				batch.add(died::event_kind::modify, L"D:\\f42\\2.txt", L"D:\\f7\\2.txt");
+				router.deliver(batch.events());
+			}
+			Assert::AreEqual(sinks[7]->mPaths.size(), size_t(6));
+			Assert::AreEqual(sinks[42]->mPaths.size(), size_t(3));
+			Assert::IsTrue(sinks[8]->mPaths.empty());
+		}
+	};
+}
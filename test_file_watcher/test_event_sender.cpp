@@ -0,0 +1,70 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <string>
+#include "event_frame.h"
+#include "event_sender.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	TEST_CLASS(test_event_sender)
+	{
+	public:
+
+		TEST_METHOD(frame_round_trip)
+		{
+			static const std::wstring NAME{ L"Save as" };
+			died::event_batch batch;
+			batch.add(died::event_kind::rename_only, L"D:\\test\\new.txt", L"D:\\test\\old.txt").mStillOpen = true;
+			auto& pattern = batch.add(died::event_kind::pattern, L"D:\\test\\1.docx", L"D:\\test\\~WRL0001.tmp", L"D:\\test\\~$1.docx");
+			pattern.mName = &NAME;
+			pattern.mSource = 2;
+
+			std::vector<uint8_t> body;
+			auto now = died::event_clock::now();
+			for (auto const& el : batch.events()) {
+				died::encode_event(el, 1000000000, now, body);
+			}
+			died::frame_header header;
+			header.mCount = 2;
+			header.mBytes = static_cast<uint32_t>(body.size());
+
+			std::vector<died::received_event> events;
+			Assert::IsTrue(died::decode_frame(header, body.data(), events));
+			Assert::AreEqual(events.size(), size_t(2));
+			Assert::AreEqual(events[0].mName, std::wstring(L"Rename only"));
+			Assert::AreEqual(events[0].mOldPath, std::wstring(L"D:\\test\\old.txt"));
+			Assert::IsTrue(events[0].mStillOpen);
+			Assert::AreEqual(events[1].mName, NAME);
+			Assert::AreEqual(events[1].mAuxPath, std::wstring(L"D:\\test\\~$1.docx"));
+			Assert::AreEqual(events[1].mSource, 2u);
+
+			// a cut frame is refused
+			header.mBytes -= 2;
+			events.clear();
+			Assert::IsFalse(died::decode_frame(header, body.data(), events));
+		}
+
+		TEST_METHOD(full_queue_is_saturated)
+		{
+			// not started: nothing is sent, the queue only fills
+			died::event_sender sender{ L"\\\\.\\pipe\\test_event_sender", 64 };
+			died::event_batch batch;
+			for (int i = 0; i < 47; ++i) {
+				batch.add(died::event_kind::modify, L"D:\\test\\" + std::to_wstring(i) + L".txt");
+			}
+			sender.deliver(batch.events());
+			Assert::IsFalse(sender.saturated());
+
+			batch.clear();
+			for (int i = 0; i < 20; ++i) {
+				batch.add(died::event_kind::modify, L"D:\\test\\more.txt");
+			}
+			sender.deliver(batch.events());
+			Assert::IsTrue(sender.saturated());
+			Assert::AreEqual(sender.depth(), size_t(64));
+			Assert::AreEqual(sender.stats().mDropped, 3ull);
+		}
+	};
+}
@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <string>
+#include "event_spool.h"
+#include "std_filesystem.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	namespace
+	{
+		std::wstring spool_dir()
+		{
+			auto dir = std::filesystem::temp_directory_path() / L"test_event_spool";
+			std::filesystem::remove_all(dir);
+			return dir.wstring();
+		}
+
+		void append(died::event_spool& spool, size_t from, size_t to)
+		{
+			for (auto i = from; i < to; ++i) {
+				auto text = std::to_string(i);
+				Assert::IsTrue(spool.append(reinterpret_cast<uint8_t const*>(text.data()), text.size()));
+			}
+		}
+
+		std::string text_of(std::vector<uint8_t> const& record)
+		{
+			return std::string(std::begin(record), std::end(record));
+		}
+	}
+
+	TEST_CLASS(test_event_spool)
+	{
+	public:
+
+		TEST_METHOD(uncommitted_records_survive_restart)
+		{
+			auto dir = spool_dir();
+			std::vector<uint8_t> record;
+			{
+				died::event_spool spool{ dir, 4096 };
+				Assert::IsTrue(spool.open());
+				append(spool, 0, 1000);
+
+				for (int i = 0; i < 500; ++i) {
+					Assert::IsTrue(spool.read(record));
+				}
+				spool.commit();
+
+				// sent, never acknowledged
+				for (int i = 0; i < 100; ++i) {
+					Assert::IsTrue(spool.read(record));
+				}
+			}
+
+			died::event_spool spool{ dir, 4096 };
+			Assert::IsTrue(spool.open());
+			Assert::AreEqual(spool.committed(), 500ull);
+			Assert::AreEqual(spool.stats().mBacklog, 500ull);
+			Assert::IsTrue(spool.read(record));
+			Assert::AreEqual(text_of(record), std::string("500"));
+
+			spool.rewind();
+			size_t count = 0;
+			while (spool.read(record)) {
+				++count;
+			}
+			Assert::AreEqual(count, size_t(500));
+			Assert::AreEqual(text_of(record), std::string("999"));
+		}
+
+		TEST_METHOD(read_segments_are_recycled)
+		{
+			died::event_spool spool{ spool_dir(), 4096 };
+			Assert::IsTrue(spool.open());
+			std::vector<uint8_t> record;
+			for (size_t round = 0; round < 10; ++round) {
+				append(spool, round * 1000, round * 1000 + 1000);
+				while (spool.read(record)) {
+				}
+				spool.commit();
+				spool.sync();
+			}
+			Assert::AreEqual(text_of(record), std::string("9999"));
+			Assert::AreEqual(spool.committed(), 10000ull);
+			Assert::IsTrue(spool.stats().mRecycled > 0);
+
+			// too large for a segment
+			std::vector<uint8_t> large(4096);
+			Assert::IsFalse(spool.append(large.data(), large.size()));
+		}
+	};
+}
@@ -0,0 +1,138 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <chrono>
+#include <string>
+#include <vector>
+#include "event_store.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	namespace
+	{
+		// 'count' modify events of 10 files, one milli-second apart, the last one now
+		void deliver_modifies(died::event_store& store, size_t count)
+		{
+			auto now = died::event_clock::now();
+			died::event_batch batch;
+			for (size_t i = 0; i < count; ++i) {
+				auto& ev = batch.add(died::event_kind::modify, L"D:\\work\\" + std::to_wstring(i % 10) + L".txt");
+				ev.mLast = now - std::chrono::milliseconds(count - i);
+			}
+			store.deliver(batch.events());
+		}
+
+		std::vector<died::stored_event> query(died::event_store const& store, died::store_query const& q, died::scan_stats* stats = nullptr)
+		{
+			std::vector<died::stored_event> result;
+			auto scanned = store.scan(q, [&](died::stored_event const& ev) { result.push_back(ev); });
+			if (stats) {
+				*stats = scanned;
+			}
+			return result;
+		}
+	}
+
+	TEST_CLASS(test_event_store)
+	{
+	public:
+
+		TEST_METHOD(folder_query_matches_whole_names)
+		{
+			died::event_store store;
+			died::event_batch batch;
+			batch.add(died::event_kind::modify, L"D:\\Work\\src\\main.cpp");
+			batch.add(died::event_kind::remove, L"D:\\work\\srcold\\main.cpp");
+			batch.add(died::event_kind::create_only, L"d:\\WORK\\SRC\\lib\\util.cpp");
+			batch.add(died::event_kind::folder_remove, L"D:\\work\\src");
+			store.deliver(batch.events());
+
+			died::store_query q;
+			q.mFolder = L"d:\\work\\src\\";
+			auto events = query(store, q);
+			Assert::AreEqual(events.size(), size_t(3));
+			Assert::AreEqual(store.path_of(events[0].mPath), std::wstring(L"D:\\Work\\src\\main.cpp"));
+			Assert::AreEqual(store.path_of(events[1].mPath), std::wstring(L"D:\\Work\\src\\lib\\util.cpp"));
+			Assert::AreEqual(store.path_of(events[1].mParent), std::wstring(L"D:\\Work\\src\\lib"));
+			Assert::IsTrue(died::event_kind::folder_remove == events[2].mKind);
+
+			// kinds, unknown folder
+			q.mKinds = died::kind_bit(died::event_kind::create_only);
+			Assert::AreEqual(query(store, q).size(), size_t(1));
+			q.mFolder = L"E:\\work";
+			Assert::IsTrue(query(store, q).empty());
+		}
+
+		TEST_METHOD(blocks_out_of_range_are_skipped)
+		{
+			died::event_store store;
+			deliver_modifies(store, 10 * died::event_store::BLOCK_EVENTS + 100);
+			auto all = query(store, {});
+			Assert::AreEqual(all.size(), 10 * died::event_store::BLOCK_EVENTS + 100);
+			for (size_t i = 1; i < all.size(); ++i) {
+				Assert::IsTrue(all[i - 1].mTime <= all[i].mTime);
+			}
+
+			// the events of the 4th block only
+			died::store_query q;
+			q.mFrom = all[3 * died::event_store::BLOCK_EVENTS].mTime;
+			q.mTo = all[4 * died::event_store::BLOCK_EVENTS - 1].mTime;
+			died::scan_stats stats;
+			auto events = query(store, q, &stats);
+			Assert::AreEqual(stats.mScanned, 1ull);
+			Assert::AreEqual(stats.mSkipped, 9ull);
+			Assert::AreEqual(events.size(), died::event_store::BLOCK_EVENTS);
+			Assert::AreEqual(store.path_of(events.front().mPath), std::wstring(L"D:\\work\\8.txt"));
+
+			// no block has a remove
+			q = {};
+			q.mKinds = died::kind_bit(died::event_kind::remove);
+			Assert::IsTrue(query(store, q, &stats).empty());
+			Assert::AreEqual(stats.mScanned, 0ull);
+
+			// 1 ms apart, repeated paths: 5 bytes per event
+			auto size = store.stats();
+			Assert::AreEqual(size.mBlocks, 10ull);
+			Assert::AreEqual(size.mPaths, 12ull);
+			Assert::IsTrue(size.mBytes < 10 * died::event_store::BLOCK_EVENTS * 6);
+		}
+
+		TEST_METHOD(oldest_blocks_are_evicted)
+		{
+			died::event_store store{ 2 * died::event_store::BLOCK_EVENTS };
+			deliver_modifies(store, 5 * died::event_store::BLOCK_EVENTS);
+			auto stats = store.stats();
+			Assert::AreEqual(stats.mEvents, 2ull * died::event_store::BLOCK_EVENTS);
+			Assert::AreEqual(stats.mEvicted, 3ull * died::event_store::BLOCK_EVENTS);
+			Assert::AreEqual(query(store, {}).size(), 2 * died::event_store::BLOCK_EVENTS);
+		}
+
+		TEST_METHOD(evicted_paths_leave_the_dictionary)
+		{
+			// a new file per event, a folder per block
+			died::event_store store{ 2 * died::event_store::BLOCK_EVENTS };
+			for (size_t blk = 0; blk < 5; ++blk) {
+				died::event_batch batch;
+				for (size_t i = 0; i < died::event_store::BLOCK_EVENTS; ++i) {
+					batch.add(died::event_kind::create_only, L"D:\\build\\" + std::to_wstring(blk) + L"\\" + std::to_wstring(i) + L".obj");
+				}
+				store.deliver(batch.events());
+			}
+
+			// D:, build, the folders and files of the 2 kept blocks
+			Assert::AreEqual(store.stats().mPaths, 2ull + 2 * (1 + died::event_store::BLOCK_EVENTS));
+			died::store_query q;
+			q.mFolder = L"D:\\build\\0";
+			Assert::IsTrue(query(store, q).empty());
+
+			// sealed blocks filtered by folder without the dictionary
+			q.mFolder = L"D:\\build\\4";
+			died::scan_stats stats;
+			auto events = query(store, q, &stats);
+			Assert::AreEqual(events.size(), died::event_store::BLOCK_EVENTS);
+			Assert::AreEqual(stats.mSkipped, 1ull);
+			Assert::AreEqual(store.path_of(events.back().mParent), std::wstring(L"D:\\build\\4"));
+		}
+	};
+}
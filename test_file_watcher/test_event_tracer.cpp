@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <string>
+#include <thread>
+#include "event_tracer.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	namespace
+	{
+		size_t count_of(std::string const& text, std::string const& part)
+		{
+			size_t count = 0;
+			for (auto pos = text.find(part); std::string::npos != pos; pos = text.find(part, pos + 1)) {
+				++count;
+			}
+			return count;
+		}
+	}
+
+	TEST_CLASS(test_event_tracer)
+	{
+	public:
+
+		TEST_METHOD(disabled_records_nothing)
+		{
+			died::event_tracer::enable(false);
+			died::event_tracer::clear();
+			{
+				TRACE_SCOPE("disabled_scope");
+				TRACE_INSTANT("disabled_instant");
+			}
+			auto json = died::event_tracer::chrome_json();
+			Assert::AreEqual(count_of(json, "disabled_"), size_t{ 0 });
+		}
+
+		TEST_METHOD(scope_and_instant)
+		{
+			died::event_tracer::clear();
+			died::event_tracer::enable(true);
+			{
+				TRACE_SCOPE("outer_scope");
+				TRACE_INSTANT("inner_instant");
+			}
+			died::event_tracer::enable(false);
+
+			auto json = died::event_tracer::chrome_json();
+			Assert::AreEqual(json.find("{\"displayTimeUnit\""), size_t{ 0 });
+			Assert::AreEqual(count_of(json, "\"name\":\"outer_scope\",\"ph\":\"B\""), size_t{ 1 });
+			Assert::AreEqual(count_of(json, "\"name\":\"outer_scope\",\"ph\":\"E\""), size_t{ 1 });
+			Assert::AreEqual(count_of(json, "\"name\":\"inner_instant\",\"ph\":\"i\""), size_t{ 1 });
+			Assert::IsTrue(json.find("inner_instant") > json.find("outer_scope"));
+		}
+
+		TEST_METHOD(ring_keeps_latest)
+		{
+			died::event_tracer::clear();
+			died::event_tracer::enable(true);
+			std::thread writer([]() {
+				for (size_t i = 0; i < died::event_tracer::RING_SIZE + 100; ++i) {
+					TRACE_INSTANT("wrapped");
+				}
+				TRACE_INSTANT("last");
+			});
+			writer.join();
+			died::event_tracer::enable(false);
+
+			// the writer has exited, its ring is still exported.
+			// the oldest slot is the next one written => never exported
+			auto json = died::event_tracer::chrome_json();
+			Assert::AreEqual(count_of(json, "\"wrapped\""), died::event_tracer::RING_SIZE - 2);
+			Assert::AreEqual(count_of(json, "\"last\""), size_t{ 1 });
+		}
+
+		TEST_METHOD(exited_thread_ring_is_reused)
+		{
+			died::event_tracer::clear();
+			died::event_tracer::enable(true);
+			auto run = [](char const* name) {
+				std::thread writer([name]() {
+					TRACE_INSTANT(name);
+				});
+				writer.join();
+			};
+			run("first_writer");
+			auto rings = died::event_tracer::ring_count();
+			for (int i = 0; i < 4; ++i) {
+				run("next_writer");
+			}
+			died::event_tracer::enable(false);
+
+			// one ring for all of them, it holds the records of the last writer
+			Assert::AreEqual(died::event_tracer::ring_count(), rings);
+			auto json = died::event_tracer::chrome_json();
+			Assert::AreEqual(count_of(json, "\"next_writer\""), size_t{ 1 });
+		}
+	};
+}
\ No newline at end of file
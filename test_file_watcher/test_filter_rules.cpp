@@ -0,0 +1,75 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <fstream>
+#include <string>
+#include "filter_rules.h"
+#include "std_filesystem.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	namespace
+	{
+		using rule = died::fat::UnnecessaryDirectory::Rule;
+
+		std::wstring rule_file(std::string const& text)
+		{
+			auto path = std::filesystem::temp_directory_path() / L"test_filter_rules.ini";
+			std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+			out << text;
+			return path.wstring();
+		}
+
+		rule match(std::shared_ptr<const died::fat::UnnecessaryDirectory> const& rules, std::wstring path)
+		{
+			return rules->match(died::file_notify_info{ std::move(path) });
+		}
+	}
+
+	TEST_CLASS(test_filter_rules)
+	{
+	public:
+
+		TEST_METHOD(compile_reads_rules_and_rejects_bad_lines)
+		{
+			auto rules = std::shared_ptr<const died::fat::UnnecessaryDirectory>(died::filter_rules::compile(rule_file(
+				"# comment\n"
+				"appdata = yes\n"
+				"exclude = D:\\build\\\n")));
+			Assert::IsTrue(nullptr != rules);
+			Assert::IsTrue(rule::userDefine == match(rules, L"D:\\build\\out.obj"));
+			Assert::IsTrue(rule::appData == match(rules, L"C:\\Users\\me\\AppData\\x.txt"));
+			Assert::IsTrue(rule::none == match(rules, L"D:\\test\\1.txt"));
+
+			Assert::IsTrue(nullptr == died::filter_rules::compile(rule_file("exclude D:\\build\n")));
+			Assert::IsTrue(nullptr == died::filter_rules::compile(rule_file("include = D:\\build\n")));
+		}
+
+		TEST_METHOD(reload_publishes_a_new_version)
+		{
+			auto path = rule_file("exclude = D:\\build\\\n");
+			died::filter_rules rules{ path };
+			auto version = rules.version();
+			auto defaults = rules.current();
+			Assert::IsTrue(rule::userDefine == match(defaults, L"D:\\work\\1.txt"));
+
+			Assert::IsTrue(rules.reload());
+			Assert::AreEqual(rules.version(), version + 1);
+			Assert::IsTrue(rule::userDefine == match(rules.current(), L"D:\\build\\1.txt"));
+			Assert::IsTrue(rule::none == match(rules.current(), L"D:\\work\\1.txt"));
+
+			// a reader still holding the old version keeps using it
+			Assert::IsTrue(rule::userDefine == match(defaults, L"D:\\work\\1.txt"));
+
+			// a bad file keeps the version, a missing one goes back to the built-in rules
+			rule_file("exclude D:\\build\n");
+			Assert::IsFalse(rules.reload());
+			Assert::AreEqual(rules.version(), version + 1);
+			std::filesystem::remove(path);
+			Assert::IsFalse(rules.reload());
+			Assert::AreEqual(rules.version(), version + 2);
+			Assert::IsTrue(rule::userDefine == match(rules.current(), L"D:\\work\\1.txt"));
+		}
+	};
+}
@@ -0,0 +1,189 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <stdexcept>
+#include <string>
+#include <Windows.h>
+#include "notify_to_server.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace
+{
+	// a message is valid during the call only
+	struct received
+	{
+		died::notify_kind mKind{};
+		unsigned long long mSeq{};
+		std::wstring mAction;
+		std::wstring mPath;
+		bool mStillOpen{};
+	};
+
+	received copy_of(died::notify_message const& msg)
+	{
+		return { msg.mKind, msg.mSeq, std::wstring{ msg.mAction }, msg.path(), msg.mStillOpen };
+	}
+
+	void send(died::notify_to_server& sender, died::event_kind kind, std::wstring path)
+	{
+		died::event_batch batch;
+		batch.add(kind, std::move(path));
+		sender.deliver(batch.events());
+	}
+}
+
+namespace test_file_watcher
+{
+	TEST_CLASS(test_notify_to_server)
+	{
+	public:
+
+		TEST_METHOD(plain_consumer_gets_final_only)
+		{
+			died::notify_to_server sender;
+			std::vector<received> plain;
+			sender.add_consumer(L"plain", false, [&plain](auto const& msg) { plain.push_back(copy_of(msg)); });
+
+			// nobody wants a guess
+			Assert::AreEqual(sender.provisional(L"Create only", L"D:\\test\\1.txt", std::chrono::steady_clock::now()), 0ull);
+
+			send(sender, died::event_kind::create_only, L"D:\\test\\1.txt");
+			Assert::AreEqual(plain.size(), size_t(1));
+			Assert::IsTrue(died::notify_kind::final == plain[0].mKind);
+		}
+
+		TEST_METHOD(provisional_is_confirmed_or_replaced)
+		{
+			died::notify_to_server sender;
+			std::vector<received> fast;
+			std::vector<received> plain;
+			sender.add_consumer(L"fast", true, [&fast](auto const& msg) { fast.push_back(copy_of(msg)); });
+			sender.add_consumer(L"plain", false, [&plain](auto const& msg) { plain.push_back(copy_of(msg)); });
+
+			auto now = std::chrono::steady_clock::now();
+			auto first = sender.provisional(L"Create only", L"D:\\test\\1.txt", now);
+			auto second = sender.provisional(L"Create only", L"D:\\test\\2.txt", now);
+			Assert::AreNotEqual(first, second);
+			Assert::AreEqual(fast.size(), size_t(2));
+			Assert::IsTrue(plain.empty());
+
+			send(sender, died::event_kind::create_only, L"D:\\test\\1.txt");
+			Assert::IsTrue(died::notify_kind::confirm == fast.back().mKind);
+			Assert::AreEqual(fast.back().mSeq, first);
+
+			send(sender, died::event_kind::modify, L"D:\\test\\2.txt");
+			Assert::IsTrue(died::notify_kind::replace == fast.back().mKind);
+			Assert::AreEqual(fast.back().mAction, std::wstring(L"Modify"));
+
+			// plain consumer never sees the guesses
+			Assert::AreEqual(plain.size(), size_t(2));
+			Assert::IsTrue(died::notify_kind::final == plain.back().mKind);
+		}
+
+		TEST_METHOD(unreported_guess_is_retracted)
+		{
+			died::notify_to_server sender;
+			std::vector<received> fast;
+			sender.add_consumer(L"fast", true, [&fast](auto const& msg) { fast.push_back(copy_of(msg)); });
+
+			auto now = std::chrono::steady_clock::now();
+			sender.provisional(L"Create only", L"D:\\test\\~tmp.txt", now);
+			sender.provisional(L"Create only", L"D:\\test\\lost.txt", now);
+
+			// temporary file erased without report
+			sender.settle(L"D:\\test\\~tmp.txt");
+			Assert::IsTrue(died::notify_kind::retract == fast.back().mKind);
+
+			// never processed
+			sender.expire(now + std::chrono::seconds(10), 5000);
+			Assert::AreEqual(fast.back().mPath, std::wstring(L"D:\\test\\lost.txt"));
+
+			auto stats = sender.stats();
+			Assert::AreEqual(stats.mProvisional, 2ull);
+			Assert::AreEqual(stats.mRetracted, 2ull);
+			Assert::AreEqual(stats.retraction_rate(), 1.0);
+		}
+
+		TEST_METHOD(classified_batch_keeps_legacy_text)
+		{
+			died::notify_to_server sender;
+			std::vector<received> fast;
+			sender.add_consumer(L"fast", true, [&fast](auto const& msg) { fast.push_back(copy_of(msg)); });
+
+			auto seq = sender.provisional(L"Create only", L"D:\\test\\new.txt", std::chrono::steady_clock::now());
+
+			died::event_batch batch;
+			batch.add(died::event_kind::rename_only, L"D:\\test\\new.txt", L"D:\\test\\old.txt");
+			batch.add(died::event_kind::modify, L"D:\\test\\1.txt").mStillOpen = true;
+			sender.deliver(batch.events());
+
+			// the guess on the new name is resolved by the rename
+			Assert::AreEqual(fast.size(), size_t(3));
+			Assert::IsTrue(died::notify_kind::replace == fast[1].mKind);
+			Assert::AreEqual(fast[1].mSeq, seq);
+			Assert::AreEqual(fast[1].mAction, std::wstring(L"Rename only"));
+			Assert::AreEqual(fast[1].mPath, std::wstring(L"D:\\test\\old.txt, D:\\test\\new.txt"));
+			Assert::IsTrue(died::notify_kind::final == fast[2].mKind);
+			Assert::AreEqual(fast[2].mPath, std::wstring(L"D:\\test\\1.txt"));
+			Assert::IsTrue(fast[2].mStillOpen);
+		}
+
+		TEST_METHOD(consumer_may_call_back)
+		{
+			died::notify_to_server sender;
+			std::vector<received> fast;
+			std::vector<size_t> pending;
+			sender.add_consumer(L"fast", true, [&](auto const& msg) {
+				// delivered without the lock: the guess of a final event is already resolved
+				fast.push_back(copy_of(msg));
+				pending.push_back(sender.pending());
+				if (died::notify_kind::confirm == msg.mKind) {
+					send(sender, died::event_kind::modify, msg.path());
+				}
+			});
+
+			sender.provisional(L"Create only", L"D:\\test\\1.txt", std::chrono::steady_clock::now());
+			send(sender, died::event_kind::create_only, L"D:\\test\\1.txt");
+
+			// the message sent from the consumer comes after the one it answers
+			Assert::AreEqual(fast.size(), size_t(3));
+			Assert::IsTrue(died::notify_kind::confirm == fast[1].mKind);
+			Assert::IsTrue(died::notify_kind::final == fast[2].mKind);
+			Assert::AreEqual(fast[2].mAction, std::wstring(L"Modify"));
+			Assert::AreEqual(pending[1], size_t(0));
+		}
+
+		TEST_METHOD(failing_consumer_does_not_stop_delivery)
+		{
+			died::notify_to_server sender;
+			std::vector<received> plain;
+			sender.add_consumer(L"failing", false, [](auto const&) { throw std::runtime_error("consumer down"); });
+			sender.add_consumer(L"plain", false, [&plain](auto const& msg) { plain.push_back(copy_of(msg)); });
+
+			send(sender, died::event_kind::create_only, L"D:\\test\\1.txt");
+			send(sender, died::event_kind::remove, L"D:\\test\\2.txt");
+			Assert::AreEqual(plain.size(), size_t(2));
+			Assert::AreEqual(sender.failures(), 2ull);
+		}
+
+		TEST_METHOD(consumer_added_while_watching)
+		{
+			died::notify_to_server sender;
+			std::vector<received> first;
+			std::vector<received> late;
+			sender.add_consumer(L"first", false, [&](auto const& msg) {
+				first.push_back(copy_of(msg));
+				if (late.empty() && first.size() == 1) {
+					// the list being delivered is not changed under the loop
+					sender.add_consumer(L"late", false, [&late](auto const& msg) { late.push_back(copy_of(msg)); });
+				}
+			});
+
+			send(sender, died::event_kind::create_only, L"D:\\test\\1.txt");
+			Assert::IsTrue(late.empty());
+			send(sender, died::event_kind::remove, L"D:\\test\\1.txt");
+			Assert::AreEqual(first.size(), size_t(2));
+			Assert::AreEqual(late.size(), size_t(1));
+		}
+	};
+}
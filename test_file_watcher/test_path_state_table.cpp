@@ -0,0 +1,147 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <string>
+#include <Windows.h>
+#include "state_shards.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	TEST_CLASS(test_path_state_table)
+	{
+	public:
+
+		TEST_METHOD(one_entry_per_path)
+		{
+			died::path_state_table table;
+			table.push(died::path_action::added, died::file_notify_info{ L"D:\\test\\1.txt", FILE_ACTION_ADDED });
+			table.push(died::path_action::modified, died::file_notify_info{ L"D:\\test\\1.txt", FILE_ACTION_MODIFIED });
+			table.push(died::path_action::attribute, died::file_notify_info{ L"D:\\test\\1.txt", FILE_ACTION_MODIFIED });
+			Assert::AreEqual(table.size(), size_t(1));
+
+			auto state = table.find(L"D:\\test\\1.txt");
+			Assert::IsTrue(state.has(died::path_action::added));
+			Assert::IsTrue(state.has(died::path_action::modified));
+			Assert::IsTrue(state.has(died::path_action::attribute));
+			Assert::IsFalse(state.has(died::path_action::removed));
+
+			// erase all changes => entry is gone
+			table.erase(L"D:\\test\\1.txt", died::PENDING_CHANGES);
+			Assert::IsFalse(static_cast<bool>(table.find(L"D:\\test\\1.txt")));
+			Assert::IsFalse(static_cast<bool>(table.front(died::path_action::added)));
+		}
+
+		TEST_METHOD(queue_in_arrival_order)
+		{
+			died::path_state_table table;
+			table.push(died::path_action::added, died::file_notify_info{ L"D:\\test\\1.txt", FILE_ACTION_ADDED });
+			table.push(died::path_action::added, died::file_notify_info{ L"D:\\test\\2.txt", FILE_ACTION_ADDED });
+			// update keeps the position
+			table.push(died::path_action::added, died::file_notify_info{ L"D:\\test\\1.txt", FILE_ACTION_ADDED });
+
+			Assert::AreEqual(table.front(died::path_action::added).mPath, std::wstring(L"D:\\test\\1.txt"));
+			table.next(died::path_action::added);
+			Assert::AreEqual(table.front(died::path_action::added).mPath, std::wstring(L"D:\\test\\2.txt"));
+
+			// still pending => visited again
+			table.next(died::path_action::added);
+			Assert::AreEqual(table.front(died::path_action::added).mPath, std::wstring(L"D:\\test\\1.txt"));
+
+			// erased => skipped
+			table.erase(L"D:\\test\\1.txt", died::pending_bit(died::path_action::added));
+			Assert::AreEqual(table.front(died::path_action::added).mPath, std::wstring(L"D:\\test\\2.txt"));
+		}
+
+		TEST_METHOD(rename_links)
+		{
+			died::path_state_table table;
+			auto now = std::chrono::steady_clock::now();
+			table.push_rename({ L"D:\\test\\8.docx", L"D:\\test\\8.docx~RF1.TMP", now });
+			table.push_rename({ L"D:\\test\\~.tmp", L"D:\\test\\8.docx", now });
+
+			auto first = table.front_rename();
+			Assert::AreEqual(first.mOldName, std::wstring(L"D:\\test\\8.docx"));
+			Assert::AreEqual(first.mNewName, std::wstring(L"D:\\test\\8.docx~RF1.TMP"));
+
+			// both renames share 8.docx
+			auto oldName = table.find(first.mOldName);
+			auto newName = table.find(first.mNewName);
+			Assert::IsTrue(oldName.has(died::path_action::renamed));
+			Assert::AreEqual(died::rename_family(first, oldName, newName), 2u);
+
+			table.unlink(first.mOldName, first.mNewName);
+			Assert::IsFalse(static_cast<bool>(table.find(L"D:\\test\\8.docx~RF1.TMP")));
+
+			auto second = table.front_rename();
+			Assert::AreEqual(second.mOldName, std::wstring(L"D:\\test\\~.tmp"));
+			Assert::AreEqual(died::rename_family(second, table.find(second.mOldName), table.find(second.mNewName)), 1u);
+
+			// erasing the changes keeps the rename link
+			table.erase(second.mNewName, died::PENDING_CHANGES);
+			Assert::IsTrue(table.find(second.mNewName).has(died::path_action::renamed));
+		}
+
+		TEST_METHOD(pending_since_first_event)
+		{
+			died::path_state_table table;
+			auto const index = static_cast<size_t>(died::path_action::modified);
+			table.push(died::path_action::modified, died::file_notify_info{ L"D:\\test\\1.log", FILE_ACTION_MODIFIED });
+			auto since = table.find(L"D:\\test\\1.log").mSince[index];
+
+			// an always-written file keeps its first time
+			table.push(died::path_action::modified, died::file_notify_info{ L"D:\\test\\1.log", FILE_ACTION_MODIFIED });
+			auto state = table.find(L"D:\\test\\1.log");
+			Assert::IsTrue(since == state.mSince[index]);
+			Assert::IsTrue(state.mTime[index] >= since);
+			Assert::IsTrue(state.waiting(died::path_action::modified) >= state.alive(died::path_action::modified));
+		}
+
+		TEST_METHOD(find_by_name)
+		{
+			died::path_state_table table;
+			table.push(died::path_action::removed, died::file_notify_info{ L"C:\\tmp\\1.zip", FILE_ACTION_REMOVED });
+
+			Assert::IsTrue(static_cast<bool>(table.find_by_name(died::path_action::removed, L"1.zip", L"D:\\test")));
+			Assert::IsFalse(static_cast<bool>(table.find_by_name(died::path_action::removed, L"1.zip", L"C:\\tmp")));
+			Assert::IsFalse(static_cast<bool>(table.find_by_name(died::path_action::added, L"1.zip", L"D:\\test")));
+		}
+
+		TEST_METHOD(unsettled_in_folder)
+		{
+			died::path_state_table table;
+			table.push(died::path_action::added, died::file_notify_info{ L"D:\\test\\1.txt", FILE_ACTION_ADDED });
+			Assert::AreEqual(table.unsettled_in(L"D:\\test"), size_t(0));
+
+			table.push(died::path_action::removed, died::file_notify_info{ L"D:\\test\\2.txt", FILE_ACTION_REMOVED });
+			table.push_rename({ L"D:\\test\\3.txt", L"D:\\test\\4.txt", std::chrono::steady_clock::now() });
+			Assert::AreEqual(table.unsettled_in(L"D:\\test"), size_t(3));
+
+			table.erase(L"D:\\test\\2.txt", died::PENDING_CHANGES);
+			table.unlink(L"D:\\test\\3.txt", L"D:\\test\\4.txt");
+			Assert::AreEqual(table.unsettled_in(L"D:\\test"), size_t(0));
+		}
+
+		TEST_METHOD(shards_by_parent_directory)
+		{
+			died::state_shards shards{ 4 };
+			Assert::AreEqual(shards.shard_of(L"D:\\test\\1.txt"), shards.shard_of(L"D:\\test\\2.txt"));
+
+			// move source is found in any shard
+			shards.push(died::path_action::removed, died::file_notify_info{ L"C:\\tmp\\1.zip", FILE_ACTION_REMOVED });
+			Assert::IsTrue(shards.of(L"C:\\tmp\\1.zip").find(L"C:\\tmp\\1.zip").has(died::path_action::removed));
+			Assert::IsTrue(static_cast<bool>(shards.find_by_name(died::path_action::removed, L"1.zip", L"D:\\test")));
+		}
+
+		TEST_METHOD(capacity_drops_oldest)
+		{
+			died::path_state_table table{ 8 };
+			for (int i = 0; i < 9; ++i) {
+				table.push(died::path_action::modified, died::file_notify_info{ L"D:\\test\\" + std::to_wstring(i), FILE_ACTION_MODIFIED });
+			}
+			Assert::AreEqual(table.size(), size_t(8));
+			Assert::IsFalse(static_cast<bool>(table.find(L"D:\\test\\0")));
+			Assert::AreEqual(table.front(died::path_action::modified).mPath, std::wstring(L"D:\\test\\1"));
+		}
+	};
+}
@@ -0,0 +1,66 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <string>
+#include <Windows.h>
+#include "pipeline_latency.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	TEST_CLASS(test_pipeline_latency)
+	{
+	public:
+
+		TEST_METHOD(histogram_percentiles)
+		{
+			died::latency_histogram histogram;
+			for (unsigned long long i = 1; i <= 1000; ++i) {
+				histogram.record(i * 1000);
+			}
+
+			auto snap = histogram.snapshot();
+			Assert::AreEqual(snap.mCount, 1000ull);
+			Assert::AreEqual(snap.mMax, 1000000ull);
+
+			// log-linear buckets => a few percent off
+			Assert::IsTrue(snap.mP50 > 480000 && snap.mP50 < 520000);
+			Assert::IsTrue(snap.mP99 > 960000 && snap.mP99 <= 1000000);
+		}
+
+		TEST_METHOD(buckets_are_increasing)
+		{
+			unsigned long long last = 0;
+			for (size_t i = 1; i < died::latency_histogram::BUCKETS; ++i) {
+				auto value = died::latency_histogram::value_of(i);
+				Assert::IsTrue(value > last);
+				Assert::AreEqual(died::latency_histogram::bucket_of(value), i);
+				last = value;
+			}
+		}
+
+		TEST_METHOD(stages_per_event_class)
+		{
+			died::pipeline_latency latency{ { L"Create only", L"Modify" } };
+
+			auto read = std::chrono::steady_clock::now();
+			died::event_stamps stamps{ read, read + std::chrono::microseconds(10), read + std::chrono::microseconds(30), read + std::chrono::microseconds(60) };
+			latency.record(L"Modify", stamps, read + std::chrono::milliseconds(3), read + std::chrono::milliseconds(4));
+			latency.record(L"Unknown", stamps, read + std::chrono::milliseconds(3), read + std::chrono::milliseconds(4));
+
+			// not stamped => not counted
+			latency.record(L"Create only", died::event_stamps{}, read, read);
+
+			auto reports = latency.snapshot();
+			Assert::AreEqual(reports.size(), size_t(2));
+			Assert::AreEqual(reports[0].mClass, std::wstring(L"Modify"));
+			Assert::AreEqual(reports[1].mClass, std::wstring(L"Other"));
+
+			auto const& stages = reports[0].mStages;
+			Assert::AreEqual(stages[static_cast<size_t>(died::latency_stage::parse)].mMax, 10ull);
+			Assert::AreEqual(stages[static_cast<size_t>(died::latency_stage::filter)].mMax, 20ull);
+			Assert::AreEqual(stages[static_cast<size_t>(died::latency_stage::insert)].mMax, 30ull);
+			Assert::AreEqual(stages[static_cast<size_t>(died::latency_stage::end_to_end)].mMax, 4000ull);
+		}
+	};
+}
@@ -0,0 +1,58 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <string>
+#include <thread>
+#include <Windows.h>
+#include "pipeline_metrics.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	TEST_CLASS(test_pipeline_metrics)
+	{
+	public:
+
+		TEST_METHOD(sharded_counter_sums_threads)
+		{
+			died::sharded_counter counter;
+			std::vector<std::thread> threads;
+			for (int i = 0; i < 8; ++i) {
+				threads.emplace_back([&counter]() {
+					for (int n = 0; n < 10000; ++n) {
+						counter.add();
+					}
+				});
+			}
+			for (auto& el : threads) {
+				el.join();
+			}
+			Assert::AreEqual(counter.value(), 80000ull);
+		}
+
+		TEST_METHOD(prometheus_text_format)
+		{
+			died::pipeline_metrics metrics{ { L"Create only", L"Modify" } };
+			metrics.received(died::watcher_kind::file_name);
+			metrics.received(died::watcher_kind::file_name);
+			metrics.filtered(died::fat::UnnecessaryDirectory::Rule::appData);
+			metrics.filtered(died::fat::UnnecessaryDirectory::Rule::none);
+			metrics.classified(L"Modify");
+			metrics.classified(L"Unknown");
+
+			died::metric_family depth{ "file_watcher_pending", "Events waiting in a model.", "gauge", "model" };
+			depth.mSamples.emplace_back(L"C:\\\"x\"", 3);
+			auto text = metrics.prometheus_text({ depth });
+
+			auto has = [&text](std::string const& line) {
+				return std::string::npos != text.find(line + "\n");
+			};
+			Assert::IsTrue(has("# TYPE file_watcher_events_received_total counter"));
+			Assert::IsTrue(has("file_watcher_events_received_total{watcher=\"file_name\"} 2"));
+			Assert::IsTrue(has("file_watcher_events_filtered_total{rule=\"app_data\"} 1"));
+			Assert::IsTrue(has("file_watcher_classifications_total{type=\"Modify\"} 1"));
+			Assert::IsTrue(has("file_watcher_classifications_total{type=\"Other\"} 1"));
+			Assert::IsTrue(has("file_watcher_pending{model=\"C:\\\\\\\"x\\\"\"} 3"));
+		}
+	};
+}
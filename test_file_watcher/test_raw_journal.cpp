@@ -0,0 +1,118 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <string>
+#include "raw_journal.h"
+#include "std_filesystem.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace test_file_watcher
+{
+	namespace
+	{
+		std::wstring journal_dir()
+		{
+			auto dir = std::filesystem::temp_directory_path() / L"test_raw_journal";
+			std::filesystem::remove_all(dir);
+			return dir.wstring();
+		}
+
+		size_t segment_count(std::wstring const& dir)
+		{
+			size_t count = 0;
+			for (auto const& el : std::filesystem::directory_iterator(dir)) {
+				count += L".fwr" == el.path().extension().wstring();
+			}
+			return count;
+		}
+	}
+
+	TEST_CLASS(test_raw_journal)
+	{
+	public:
+
+		TEST_METHOD(events_read_back_in_order)
+		{
+			auto dir = journal_dir();
+			{
+				died::raw_journal journal{ dir };
+				Assert::IsTrue(journal.start());
+				for (unsigned long i = 0; i < 1000; ++i) {
+					auto path = L"D:\\test\\" + std::to_wstring(i % 10) + L".txt";
+					journal.write(i % 2 ? died::watcher_kind::attribute : died::watcher_kind::file_name, died::file_notify_info{ path, i % 5 + 1 });
+				}
+				journal.stop();
+
+				auto stats = journal.stats();
+				Assert::AreEqual(stats.mWritten, 1000ull);
+				Assert::AreEqual(stats.mDropped, 0ull);
+				// 10 paths interned, every other record is a few bytes
+				Assert::IsTrue(stats.mBytes < 1000 * 8);
+			}
+
+			std::vector<died::raw_event> events;
+			std::wstring error;
+			Assert::IsTrue(died::read_raw_journal(dir, events, error));
+			Assert::AreEqual(events.size(), size_t(1000));
+			for (unsigned long i = 0; i < 1000; ++i) {
+				Assert::AreEqual(events[i].mPath, L"D:\\test\\" + std::to_wstring(i % 10) + L".txt");
+				Assert::AreEqual(events[i].mAction, i % 5 + 1);
+				Assert::IsTrue((i % 2 ? died::watcher_kind::attribute : died::watcher_kind::file_name) == events[i].mKind);
+				Assert::IsTrue(!i || events[i - 1].mTime <= events[i].mTime);
+			}
+
+			// out of range: nothing
+			events.clear();
+			Assert::IsTrue(died::read_raw_journal(dir, events, error, 0, 1));
+			Assert::IsTrue(events.empty());
+		}
+
+		TEST_METHOD(oldest_segments_are_deleted)
+		{
+			auto dir = journal_dir();
+			died::raw_journal journal{ dir, 16384, 4096, 2 };
+			Assert::IsTrue(journal.start());
+			for (unsigned long i = 0; i < 5000; ++i) {
+				journal.write(died::watcher_kind::file_name, died::file_notify_info{ L"D:\\test\\" + std::to_wstring(i) + L".txt", 1 });
+			}
+			journal.stop();
+			Assert::IsTrue(journal.stats().mSegments > 2);
+			Assert::AreEqual(segment_count(dir), size_t(2));
+
+			// the newest events remain, each segment decoded with its own path table
+			std::vector<died::raw_event> events;
+			std::wstring error;
+			Assert::IsTrue(died::read_raw_journal(dir, events, error));
+			Assert::IsFalse(events.empty());
+			Assert::AreEqual(events.back().mPath, std::wstring(L"D:\\test\\4999.txt"));
+		}
+
+		TEST_METHOD(restart_continues_the_numbering)
+		{
+			auto dir = journal_dir();
+			for (int run = 0; run < 2; ++run) {
+				died::raw_journal journal{ dir };
+				Assert::IsTrue(journal.start());
+				journal.write(died::watcher_kind::folder_name, died::file_notify_info{ L"D:\\test\\run" + std::to_wstring(run), 2ul });
+				journal.stop();
+			}
+			Assert::AreEqual(segment_count(dir), size_t(2));
+
+			std::vector<died::raw_event> events;
+			std::wstring error;
+			Assert::IsTrue(died::read_raw_journal(dir, events, error));
+			Assert::AreEqual(events.size(), size_t(2));
+			Assert::AreEqual(events[0].mPath, std::wstring(L"D:\\test\\run0"));
+			Assert::AreEqual(events[1].mPath, std::wstring(L"D:\\test\\run1"));
+			Assert::IsTrue(died::watcher_kind::folder_name == events[1].mKind);
+		}
+
+		TEST_METHOD(missing_directory_is_an_error)
+		{
+			std::vector<died::raw_event> events;
+			std::wstring error;
+			Assert::IsFalse(died::read_raw_journal(journal_dir(), events, error));
+			Assert::IsFalse(error.empty());
+		}
+	};
+}
@@ -0,0 +1,186 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include <string>
+#include <vector>
+#include <Windows.h>
+#include "stability_tracker.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace
+{
+	using verdict = died::stability_tracker::verdict;
+
+	// Virtual event_clock for one test, real again after it
+	struct virtual_clock
+	{
+		died::event_clock::time_point mStart{ std::chrono::steady_clock::time_point{} + std::chrono::hours(1) };
+
+		virtual_clock()
+		{
+			died::event_clock::set_virtual(mStart);
+		}
+
+		~virtual_clock()
+		{
+			died::event_clock::set_real();
+		}
+
+		died::event_clock::time_point at(int ms)
+		{
+			auto time = mStart + std::chrono::milliseconds(ms);
+			died::event_clock::advance_to(time);
+			return time;
+		}
+	};
+
+	// A file as the synchronous probe sees it, with the times it was probed
+	struct fake_file
+	{
+		died::busy_probe mProbe;
+		died::busy_probe::result mResult{ died::busy_probe::result::idle };
+		unsigned long long mSize{};
+		std::vector<died::event_clock::time_point> mProbed;
+
+		fake_file()
+		{
+			mProbe.set_synchronous(true);
+			mProbe.set_prober([this](std::wstring const&) {
+				mProbed.push_back(died::event_clock::now());
+				died::busy_probe::info probed;
+				probed.mResult = mResult;
+				probed.mSize = mSize;
+				probed.mTime = died::event_clock::now();
+				return probed;
+			});
+		}
+	};
+}
+
+namespace test_file_watcher
+{
+	TEST_CLASS(test_stability_tracker)
+	{
+	public:
+
+		TEST_METHOD(stable_after_the_quiet_period)
+		{
+			virtual_clock clock;
+			fake_file file;
+			died::stability_tracker tracker{ file.mProbe };
+			auto lastEvent = clock.at(0);
+
+			// first sample is the baseline, the quiet period runs from the last event
+			Assert::IsTrue(verdict::changing == tracker.check(L"D:\\test\\1.txt", lastEvent));
+			clock.at(500);
+			Assert::IsTrue(verdict::changing == tracker.check(L"D:\\test\\1.txt", lastEvent));
+			Assert::AreEqual(file.mProbed.size(), size_t(1));
+
+			clock.at(1000);
+			Assert::IsTrue(tracker.is_stable(L"D:\\test\\1.txt", lastEvent));
+			Assert::AreEqual(file.mProbed.size(), size_t(2));
+		}
+
+		TEST_METHOD(new_event_restarts_the_quiet_period)
+		{
+			virtual_clock clock;
+			fake_file file;
+			died::stability_tracker tracker{ file.mProbe };
+			clock.at(1000);
+			Assert::IsTrue(tracker.is_stable(L"D:\\test\\1.txt", clock.mStart));
+
+			auto lastEvent = clock.at(1500);
+			Assert::IsTrue(verdict::changing == tracker.check(L"D:\\test\\1.txt", lastEvent));
+			clock.at(2500);
+			Assert::IsTrue(tracker.is_stable(L"D:\\test\\1.txt", lastEvent));
+		}
+
+		TEST_METHOD(size_change_is_a_change)
+		{
+			virtual_clock clock;
+			fake_file file;
+			died::stability_tracker tracker{ file.mProbe };
+			auto lastEvent = clock.at(0);
+			tracker.check(L"D:\\test\\1.txt", lastEvent);
+
+			// written without notification => the quiet period runs from the probe that saw it
+			file.mSize = 4096;
+			clock.at(1000);
+			Assert::IsTrue(verdict::changing == tracker.check(L"D:\\test\\1.txt", lastEvent));
+			clock.at(1250);
+			Assert::IsTrue(verdict::changing == tracker.check(L"D:\\test\\1.txt", lastEvent));
+			clock.at(2000);
+			Assert::IsTrue(tracker.is_stable(L"D:\\test\\1.txt", lastEvent));
+		}
+
+		TEST_METHOD(busy_file_backs_off)
+		{
+			virtual_clock clock;
+			fake_file file;
+			file.mResult = died::busy_probe::result::busy;
+			died::stability_tracker tracker{ file.mProbe };
+			auto lastEvent = clock.at(0);
+
+			// asked every 50 ms, sampled at 250 ms then twice as late, up to 8 s
+			for (int ms = 0; ms <= 40000; ms += 50) {
+				Assert::IsTrue(verdict::changing == tracker.check(L"D:\\test\\1.txt", lastEvent));
+				clock.at(ms + 50);
+			}
+			std::vector<long long> gaps;
+			for (size_t i = 1; i < file.mProbed.size(); ++i) {
+				gaps.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(file.mProbed[i] - file.mProbed[i - 1]).count());
+			}
+			std::vector<long long> expected{ 250, 500, 1000, 2000, 4000, 8000, 8000, 8000, 8000 };
+			Assert::IsTrue(expected == gaps);
+
+			// released => stable at the next sample, the last busy one is older than the quiet period
+			file.mResult = died::busy_probe::result::idle;
+			clock.at(47700);
+			Assert::IsTrue(verdict::changing == tracker.check(L"D:\\test\\1.txt", lastEvent));
+			clock.at(47750);
+			Assert::IsTrue(tracker.is_stable(L"D:\\test\\1.txt", lastEvent));
+
+			// a new event on it starts from the first sample interval
+			file.mResult = died::busy_probe::result::busy;
+			lastEvent = clock.at(50000);
+			auto probes = file.mProbed.size();
+			tracker.check(L"D:\\test\\1.txt", lastEvent);
+			clock.at(50250);
+			tracker.check(L"D:\\test\\1.txt", lastEvent);
+			Assert::AreEqual(file.mProbed.size(), probes + 2);
+		}
+
+		TEST_METHOD(pending_probe_keeps_the_verdict)
+		{
+			virtual_clock clock;
+			died::busy_probe probe{ 1, 0 };
+			probe.set_synchronous(true);
+			died::stability_tracker tracker{ probe };
+			Assert::IsTrue(verdict::unknown == tracker.check(L"D:\\test\\1.txt", clock.mStart));
+			clock.at(5000);
+			Assert::IsFalse(tracker.is_stable(L"D:\\test\\1.txt", clock.mStart));
+		}
+
+		TEST_METHOD(forget_drops_the_history)
+		{
+			virtual_clock clock;
+			fake_file file;
+			died::stability_tracker tracker{ file.mProbe };
+			auto lastEvent = clock.at(0);
+			tracker.check(L"D:\\test\\1.txt", lastEvent);
+			clock.at(1000);
+			Assert::IsTrue(tracker.is_stable(L"D:\\test\\1.txt", lastEvent));
+
+			// the next sample is a new baseline, the size seen before is not compared
+			tracker.forget(L"D:\\test\\1.txt");
+			file.mSize = 4096;
+			clock.at(2000);
+			Assert::IsTrue(tracker.is_stable(L"D:\\test\\1.txt", lastEvent));
+
+			// tracked again => a later change is seen
+			file.mSize = 8192;
+			clock.at(3000);
+			Assert::IsTrue(verdict::changing == tracker.check(L"D:\\test\\1.txt", lastEvent));
+		}
+	};
+}